@@ -19,6 +19,15 @@
 #include "asio/ssl/context_base.hpp"
 #include "asio/ssl/error.hpp"
 #include "asio/ssl/rfc2818_verification.hpp"
+#include "asio/ssl/dtls/buffer_pool.hpp"
+#include "asio/ssl/dtls/io_context_pool.hpp"
+#include "asio/ssl/dtls/message_slot.hpp"
+#include "asio/ssl/dtls/null_engine.hpp"
+#include "asio/ssl/dtls/pinned_key_set.hpp"
+#include "asio/ssl/dtls/psk_key_store.hpp"
+#include "asio/ssl/dtls/server_name_map.hpp"
+#include "asio/ssl/dtls/session_cache.hpp"
+#include "asio/ssl/dtls/shared_context.hpp"
 #include "asio/ssl/dtls/socket.hpp"
 #include "asio/ssl/stream_base.hpp"
 #include "asio/ssl/verify_context.hpp"
@@ -3,16 +3,28 @@
 
 #include "asio/detail/push_options.hpp"
 
-#include "asio/io_service.hpp"
+#include "asio/associated_cancellation_slot.hpp"
 #include "asio/basic_socket.hpp"
 #include "asio/basic_io_object.hpp"
+#include "asio/detail/bind_handler.hpp"
 #include "asio/ssl/dtls/socket.hpp"
+#include "asio/detail/handler_alloc_helpers.hpp"
 #include "asio/detail/memory.hpp"
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/type_traits.hpp"
+#include "asio/execution_context.hpp"
+#include "asio/is_executor.hpp"
 #include "asio/ssl/dtls/detail/cookie_generate_callback.hpp"
 #include "asio/ssl/dtls/detail/cookie_verify_callback.hpp"
 #include "asio/ssl/error.hpp"
 #include "asio/error_code.hpp"
 #include "asio/ssl/dtls/context.hpp"
+#include "asio/ssl/dtls/io_context_pool.hpp"
+#include "asio/post.hpp"
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 
 namespace asio {
@@ -31,17 +43,64 @@ public:
   typedef typename DatagramSocketType::endpoint_type endpoint_type;
   typedef typename DatagramSocketType::protocol_type protocol_type;
 
-  acceptor(asio::io_service &serv,
-                typename DatagramSocketType::endpoint_type &ep)
-    : service_(serv)
-    , sock_(serv)
+  /// The type of the executor associated with the object.
+  typedef typename DatagramSocketType::executor_type executor_type;
+
+  /// Construct an acceptor on an executor.
+  /**
+   * This constructor creates an acceptor whose socket, and so every
+   * operation and timer of the acceptor, runs on the given executor.
+   *
+   * @param ex The executor that the acceptor will use, by default, to
+   * dispatch handlers for any asynchronous operations performed on it.
+   *
+   * @param ep An endpoint of the protocol the acceptor will use.
+   */
+  template <typename Executor>
+  acceptor(const Executor& ex, const endpoint_type& ep,
+      typename enable_if<is_executor<Executor>::value>::type* = 0)
+    : sock_(ex)
+    , remoteEndPoint_()
+    , cookie_generate_callback_(nullptr)
+    , cookie_verify_callback_(nullptr)
+    , connection_ids_(new connection_id_registry)
+    , io_context_pool_(nullptr)
+  {
+    sock_.open(ep.protocol());
+  }
+
+  /// Construct an acceptor on an execution context.
+  /**
+   * This constructor creates an acceptor that runs on the executor of the
+   * given execution context, such as an io_context.
+   *
+   * @param context An execution context which provides the executor that the
+   * acceptor will use, by default, to dispatch handlers for any asynchronous
+   * operations performed on it.
+   *
+   * @param ep An endpoint of the protocol the acceptor will use.
+   */
+  template <typename ExecutionContext>
+  acceptor(ExecutionContext& context, const endpoint_type& ep,
+      typename enable_if<
+        is_convertible<ExecutionContext&, execution_context&>::value
+      >::type* = 0)
+    : sock_(context)
     , remoteEndPoint_()
     , cookie_generate_callback_(nullptr)
     , cookie_verify_callback_(nullptr)
+    , connection_ids_(new connection_id_registry)
+    , io_context_pool_(nullptr)
   {
     sock_.open(ep.protocol());
   }
 
+  /// Get the executor associated with the object.
+  executor_type get_executor() ASIO_NOEXCEPT
+  {
+    return sock_.get_executor();
+  }
+
   /// Open the acceptor using the specified protocol.
   /**
    * This function opens the socket acceptor so that it will use the specified
@@ -373,6 +432,27 @@ public:
         <typename DatagramSocketType::endpoint_type, CookieCallback>(callback);
   }
 
+  /// Spread accepted sessions over the io_contexts of a pool.
+  /**
+   * Once its cookie has been verified, the socket passed to async_accept()
+   * is moved to the io_context chosen by the pool before its transport is
+   * opened, so that its operations and their handlers run there. The accept
+   * handler itself still runs on the acceptor's executor. As the handshake
+   * then reads the received ClientHello on another thread, the accept buffer
+   * must not be reused for the next accept before the handshake completes.
+   *
+   * The pool must outlive the acceptor and the sockets it places. Sockets
+   * whose executor type cannot be constructed from an io_context's executor
+   * stay on their executor. A socket on a strand gets a new strand on the
+   * chosen io_context.
+   *
+   * @param pool The pool to place sessions with.
+   */
+  void set_io_context_pool(io_context_pool& pool)
+  {
+    io_context_pool_ = &pool;
+  }
+
   /// Perform an IO control command on the acceptor.
   /**
    * This function is used to execute an IO control command on the acceptor.
@@ -692,6 +772,142 @@ public:
         void (asio::error_code,
               size_t)> init(handler);
 
+    start_accept(sock, buffer, init.completion_handler, ec);
+
+    return init.result.get();
+  }
+
+#if defined(ASIO_HAS_CO_AWAIT) || defined(GENERATING_DOCUMENTATION)
+  /// Accept a new connection in a coroutine.
+  /**
+   * This function returns an awaitable that accepts a connection into the
+   * given socket when a coroutine awaits it, as async_accept() does. The
+   * state of the operation is kept in the awaitable, and so in the coroutine
+   * frame, instead of being allocated. The co_await expression yields the
+   * size of the ClientHello received into the buffer, to be passed to the
+   * socket's buffered handshake.
+   *
+   * @param sock The socket into which the new connection will be accepted.
+   *
+   * @param buffer The buffer to receive the ClientHello into. It must stay
+   * valid until the co_await expression completes.
+   *
+   * @throws asio::system_error Thrown from the co_await expression on
+   * failure.
+   */
+  template <typename MutableBuffer>
+  auto co_accept(socket<DatagramSocketType>& sock, const MutableBuffer& buffer)
+  {
+    return co_accept(sock, buffer, 0);
+  }
+
+  /// Accept a new connection in a coroutine.
+  /**
+   * This function returns an awaitable that accepts a connection into the
+   * given socket when a coroutine awaits it, without allocating.
+   *
+   * @param sock The socket into which the new connection will be accepted.
+   *
+   * @param buffer The buffer to receive the ClientHello into.
+   *
+   * @param ec Set to indicate what error occurred, if any, when the co_await
+   * expression completes.
+   */
+  template <typename MutableBuffer>
+  auto co_accept(socket<DatagramSocketType>& sock, const MutableBuffer& buffer,
+      asio::error_code& ec)
+  {
+    return co_accept(sock, buffer, &ec);
+  }
+
+  /// Accept a new connection in an asio::awaitable coroutine.
+  /**
+   * This function returns an asio::awaitable that accepts a connection into
+   * the given socket when the coroutine awaits it, as async_accept() does.
+   * The co_await expression yields the size of the ClientHello received into
+   * the buffer.
+   *
+   * @param sock The socket into which the new connection will be accepted.
+   *
+   * @param buffer The buffer to receive the ClientHello into.
+   *
+   * @param token The asio::use_awaitable completion token.
+   */
+  template <typename MutableBuffer, typename Executor>
+  auto co_accept(socket<DatagramSocketType>& sock, const MutableBuffer& buffer,
+      const asio::use_awaitable_t<Executor>& token)
+  {
+    accept_initiation<MutableBuffer> initiation = { this, &sock, buffer };
+    return asio::async_initiate<const asio::use_awaitable_t<Executor>&,
+      void (asio::error_code, std::size_t)>(initiation, token);
+  }
+#endif // defined(ASIO_HAS_CO_AWAIT) || defined(GENERATING_DOCUMENTATION)
+
+  /// Route datagrams with a socket's connection ID to the socket.
+  /**
+   * Once a session with a connection ID has been accepted, datagrams that
+   * carry the ID but arrive on the acceptor's socket, because the client's
+   * address changed, move the session to the new address instead of being
+   * treated as a new connection. See context::enable_connection_id() and
+   * socket::migrate().
+   *
+   * The session is moved by a function posted to the socket's executor, so
+   * that it does not race with operations on the socket as long as these are
+   * started from that executor too, e.g. through a strand. The socket must
+   * be unregistered before it is destroyed; migrations posted before then
+   * do nothing. Sockets may be registered and unregistered from any thread.
+   *
+   * @param sock A socket whose handshake has completed. Sockets without a
+   * connection ID are ignored.
+   */
+  void register_connection_id(dtls_sock& sock)
+  {
+    std::string cid = sock.connection_id();
+    if (cid.empty())
+      return;
+
+    asio::detail::mutex::scoped_lock lock(connection_ids_->mutex_);
+    dtls_sock*& entry = connection_ids_->sockets_[cid];
+    if (!entry)
+      ++connection_ids_->lengths_[cid.size()];
+    entry = &sock;
+  }
+
+  /// Stop routing datagrams to a socket.
+  void unregister_connection_id(dtls_sock& sock)
+  {
+    std::string cid = sock.connection_id();
+    asio::detail::mutex::scoped_lock lock(connection_ids_->mutex_);
+    typename std::unordered_map<std::string, dtls_sock*>::iterator it =
+      connection_ids_->sockets_.find(cid);
+    if (it != connection_ids_->sockets_.end() && it->second == &sock)
+    {
+      connection_ids_->sockets_.erase(it);
+      if (--connection_ids_->lengths_[cid.size()] == 0)
+        connection_ids_->lengths_.erase(cid.size());
+    }
+  }
+
+#if !defined(ASIO_NO_DEPRECATED)
+  /// (Deprecated: Use get_executor().) Get the io_context associated with
+  /// the object.
+  /**
+   * Only available when the acceptor runs on the executor of an io_context.
+   */
+  asio::io_context& get_service()
+  {
+    return sock_.get_executor().context();
+  }
+#endif // !defined(ASIO_NO_DEPRECATED)
+
+private:
+  // Set up the socket's cookie callbacks and start receiving a ClientHello.
+  // Returns false if the accept could not be started.
+  template <typename MutableBuffer, typename AcceptHandler>
+  bool start_accept(socket<DatagramSocketType>& sock,
+      const MutableBuffer& buffer, AcceptHandler& handler,
+      asio::error_code& ec)
+  {
     if(cookie_generate_callback_ == nullptr ||
        cookie_verify_callback_ == nullptr)
     {
@@ -702,41 +918,68 @@ public:
 #endif
       ec = asio::error_code(::ERR_get_error(),
                             asio::error::get_ssl_category());
-      return;
+      return false;
     }
 
     sock.set_cookie_generate_callback(*cookie_generate_callback_, ec);
     if(ec)
     {
-      return;
+      return false;
     }
 
     sock.set_cookie_verify_callback(*cookie_verify_callback_, ec);
     if(ec)
     {
-      return;
+      return false;
     }
 
     sock_.async_receive_from(buffer,
                             remoteEndPoint_,
-    dtls_acceptor_callback_helper<MoveAcceptHandler>(*this, init.completion_handler, sock, buffer));
-
-    return init.result.get();
+    dtls_acceptor_callback_helper<AcceptHandler>(*this, handler, sock, buffer));
+    return true;
   }
 
-  /// Get the service associated with the I/O object.
-  asio::io_service& get_service()
+#if defined(ASIO_HAS_CO_AWAIT)
+  template <typename MutableBuffer>
+  struct accept_initiation
   {
-    return service_;
-  }
+    template <typename AcceptHandler>
+    bool operator()(AcceptHandler& handler, asio::error_code& ec) const
+    {
+      return acceptor_->start_accept(*sock_, buffer_, handler, ec);
+    }
 
-  /// Get the service associated with the I/O object.
-  const asio::io_service& get_service() const
+    // Called by async_initiate(). An accept that cannot start completes the
+    // handler with the error.
+    template <typename AcceptHandler>
+    void operator()(ASIO_MOVE_ARG(AcceptHandler) handler) const
+    {
+      typename decay<AcceptHandler>::type handler2(
+          ASIO_MOVE_CAST(AcceptHandler)(handler));
+      asio::error_code ec;
+      if (!acceptor_->start_accept(*sock_, buffer_, handler2, ec))
+      {
+        asio::post(acceptor_->sock_.get_executor(),
+            asio::detail::bind_handler(
+              ASIO_MOVE_CAST(typename decay<AcceptHandler>::type)(handler2),
+              ec, std::size_t(0)));
+      }
+    }
+
+    acceptor* acceptor_;
+    socket<DatagramSocketType>* sock_;
+    MutableBuffer buffer_;
+  };
+
+  template <typename MutableBuffer>
+  auto co_accept(socket<DatagramSocketType>& sock, const MutableBuffer& buffer,
+      asio::error_code* ec)
   {
-    return service_;
+    accept_initiation<MutableBuffer> initiation = { this, &sock, buffer };
+    return detail::awaitable_initiated_op<
+      accept_initiation<MutableBuffer>, std::size_t>(initiation, ec, "accept");
   }
-
-private:
+#endif // defined(ASIO_HAS_CO_AWAIT)
 
   template <typename AcceptHandler>
   class dtls_acceptor_callback_helper
@@ -759,6 +1002,12 @@ private:
       {
         ah_(ec, size);
       }
+      else if (migrate(asio::buffer(buffer_, size)))
+      {
+        acceptor_.sock_.async_receive_from(
+           buffer_, acceptor_.remoteEndPoint_,
+             ASIO_MOVE_CAST(dtls_acceptor_callback_helper)(*this));
+      }
       else
       {
         asio::error_code ec;
@@ -766,6 +1015,9 @@ private:
                             buffer_,
                             ec, acceptor_.remoteEndPoint_))
         {
+          if (acceptor_.io_context_pool_)
+            sock_.place(*acceptor_.io_context_pool_);
+
           sock_.next_layer().open(acceptor_.sock_.local_endpoint().protocol());
 
           asio::socket_base::reuse_address option(true);
@@ -779,12 +1031,73 @@ private:
         else
         {
           acceptor_.sock_.async_receive_from(
-             buffer_, acceptor_.remoteEndPoint_, *this);
+             buffer_, acceptor_.remoteEndPoint_,
+             ASIO_MOVE_CAST(dtls_acceptor_callback_helper)(*this));
         }
       }
     }
 
+    // Cancelling the accept handler's slot cancels the receive of the
+    // ClientHello.
+    typedef typename associated_cancellation_slot<AcceptHandler>::type
+      cancellation_slot_type;
+
+    cancellation_slot_type get_cancellation_slot() const ASIO_NOEXCEPT
+    {
+      return asio::get_associated_cancellation_slot(ah_);
+    }
+
+    // The memory for receiving the ClientHello comes from the accept
+    // handler.
+    friend void* asio_handler_allocate(std::size_t size,
+        dtls_acceptor_callback_helper* this_handler)
+    {
+      return asio_handler_alloc_helpers::allocate(size, this_handler->ah_);
+    }
+
+    friend void asio_handler_deallocate(void* pointer, std::size_t size,
+        dtls_acceptor_callback_helper* this_handler)
+    {
+      asio_handler_alloc_helpers::deallocate(pointer, size, this_handler->ah_);
+    }
+
   private:
+    // Pass a datagram with a known connection ID to its session. Returns
+    // false if the datagram belongs to no registered session.
+    bool migrate(const asio::const_buffer& datagram)
+    {
+      // The connection ID follows the type, version, epoch and sequence
+      // number of a record (RFC 9146 section 4). Its length is not encoded,
+      // so each length of the registered IDs is tried.
+      const std::size_t cid_offset = 11;
+      const unsigned char* p =
+        static_cast<const unsigned char*>(datagram.data());
+      if (datagram.size() < cid_offset
+          || p[0] != detail::record_layer::tls12_cid)
+        return false;
+
+      connection_id_registry& registry = *acceptor_.connection_ids_;
+      asio::detail::mutex::scoped_lock lock(registry.mutex_);
+      for (std::map<std::size_t, std::size_t>::const_iterator length =
+            registry.lengths_.begin(); length != registry.lengths_.end()
+          && datagram.size() >= cid_offset + length->first; ++length)
+      {
+        typename std::unordered_map<std::string, dtls_sock*>::iterator it =
+          registry.sockets_.find(std::string(
+                reinterpret_cast<const char*>(p + cid_offset),
+                length->first));
+        if (it != registry.sockets_.end())
+        {
+          asio::post(it->second->get_executor(),
+              migration(acceptor_.connection_ids_, it->first, *it->second,
+                acceptor_.remoteEndPoint_, datagram));
+          return true;
+        }
+      }
+
+      return false;
+    }
+
     acceptor<DatagramSocketType> &acceptor_;
     AcceptHandler ah_;
     socket<DatagramSocketType> &sock_;
@@ -792,11 +1105,64 @@ private:
   };
 
 
-  io_service& service_;
+  // The sockets registered by connection ID. Shared with the migrations
+  // posted to them, which may run after the acceptor is gone.
+  struct connection_id_registry
+  {
+    asio::detail::mutex mutex_;
+    std::unordered_map<std::string, dtls_sock*> sockets_;
+
+    // The number of registered IDs of each length.
+    std::map<std::size_t, std::size_t> lengths_;
+  };
+
+  // Moves a session to the address a datagram with its connection ID came
+  // from. Runs on the socket's executor, and only while the socket is still
+  // registered. The datagram is copied, as the acceptor reuses its buffer.
+  class migration
+  {
+  public:
+    migration(
+        const asio::detail::shared_ptr<connection_id_registry>& registry,
+        const std::string& cid, dtls_sock& sock, const endpoint_type& peer,
+        const asio::const_buffer& datagram)
+      : registry_(registry),
+        cid_(cid),
+        sock_(&sock),
+        peer_(peer),
+        datagram_(static_cast<const unsigned char*>(datagram.data()),
+            static_cast<const unsigned char*>(datagram.data())
+              + datagram.size())
+    {
+    }
+
+    void operator()()
+    {
+      asio::detail::mutex::scoped_lock lock(registry_->mutex_);
+      typename std::unordered_map<std::string, dtls_sock*>::iterator it =
+        registry_->sockets_.find(cid_);
+      if (it == registry_->sockets_.end() || it->second != sock_)
+        return;
+
+      // Datagrams that fail to authenticate are dropped.
+      asio::error_code ec;
+      sock_->migrate(peer_, asio::buffer(datagram_), ec);
+    }
+
+  private:
+    asio::detail::shared_ptr<connection_id_registry> registry_;
+    std::string cid_;
+    dtls_sock* sock_;
+    endpoint_type peer_;
+    std::vector<unsigned char> datagram_;
+  };
+
   DatagramSocketType sock_;
   typename DatagramSocketType::endpoint_type remoteEndPoint_;
   detail::cookie_generate_callback_base* cookie_generate_callback_;
   detail::cookie_verify_callback_base* cookie_verify_callback_;
+  asio::detail::shared_ptr<connection_id_registry> connection_ids_;
+  io_context_pool* io_context_pool_;
 };
 
 } // namespace dtls
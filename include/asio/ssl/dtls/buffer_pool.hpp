@@ -0,0 +1,253 @@
+//
+// ssl/dtls/buffer_pool.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_BUFFER_POOL_HPP
+#define ASIO_SSL_DTLS_BUFFER_POOL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include "asio/buffer.hpp"
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/noncopyable.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+class buffer_lease;
+
+/// A pool of receive buffers shared by sockets.
+/**
+ * Sockets given a pool with socket::set_receive_pool() receive every
+ * datagram into a block of the pool instead of a buffer of their own, and
+ * their lease receives open records where they lie in the block. A block
+ * returns to the pool once the socket has moved on and the last lease on it
+ * has been dropped.
+ *
+ * Blocks are allocated when the pool has none to spare and are kept until
+ * the pool is destroyed. All functions are thread-safe, and leases may be
+ * passed to and dropped on any thread. The pool must outlive its leases and
+ * the sockets using it.
+ *
+ * @par Example
+ * @code
+ * asio::ssl::dtls::buffer_pool pool(2048);
+ * sock.set_receive_pool(pool);
+ * sock.async_receive(
+ *     [](const asio::error_code& ec, asio::ssl::dtls::buffer_lease lease)
+ *     {
+ *       if (!ec)
+ *         forward(lease.data());
+ *     });
+ * @endcode
+ */
+class buffer_pool
+  : private noncopyable
+{
+public:
+  /// Constructor.
+  /**
+   * @param block_size The size of each block. Datagrams larger than this
+   * cannot be received. The default holds the largest possible record.
+   */
+  ASIO_DECL explicit buffer_pool(std::size_t block_size = 17 * 1024);
+
+  /// Destructor. Frees all blocks; no lease may be left.
+  ASIO_DECL ~buffer_pool();
+
+  /// Get the size of each block.
+  ASIO_DECL std::size_t block_size() const;
+
+  /// Lease a whole block, allocating it if the pool has none to spare.
+  ASIO_DECL buffer_lease acquire();
+
+  /// Get the number of blocks waiting in the pool to be leased.
+  ASIO_DECL std::size_t idle() const;
+
+  /// Get the number of blocks allocated by the pool.
+  ASIO_DECL std::size_t allocated() const;
+
+private:
+  friend class buffer_lease;
+
+  // The header of a block, followed by its data.
+  struct block
+  {
+    block* next_;
+    buffer_pool* pool_;
+    std::atomic<std::size_t> leases_;
+  };
+
+  // Called when the last lease on a block has been dropped.
+  ASIO_DECL void release(block* b);
+
+  ASIO_DECL static std::size_t header_size();
+  ASIO_DECL static unsigned char* data(block* b);
+
+  mutable asio::detail::mutex mutex_;
+  std::size_t block_size_;
+  std::size_t allocated_;
+
+  // The blocks waiting to be leased.
+  block* idle_;
+  std::size_t idle_count_;
+};
+
+/// A reference-counted lease on part of a block of a buffer_pool.
+/**
+ * Copies of a lease share the block, which returns to its pool when the last
+ * of them is destroyed. Leases on the same block may refer to different
+ * parts of it.
+ */
+class buffer_lease
+{
+public:
+  /// Construct an empty lease.
+  buffer_lease() ASIO_NOEXCEPT
+    : block_(0)
+  {
+  }
+
+  /// Share the block of another lease.
+  buffer_lease(const buffer_lease& other) ASIO_NOEXCEPT
+    : block_(other.block_),
+      data_(other.data_)
+  {
+    add_lease();
+  }
+
+  /// Share the block of another lease, referring to part of it.
+  /**
+   * @param other The lease whose block is shared.
+   *
+   * @param data The part of the block the new lease refers to.
+   */
+  buffer_lease(const buffer_lease& other,
+      const asio::mutable_buffer& data) ASIO_NOEXCEPT
+    : block_(other.block_),
+      data_(data)
+  {
+    add_lease();
+  }
+
+#if defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+  /// Move a lease.
+  buffer_lease(buffer_lease&& other) ASIO_NOEXCEPT
+    : block_(other.block_),
+      data_(other.data_)
+  {
+    other.block_ = 0;
+    other.data_ = asio::mutable_buffer();
+  }
+#endif // defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+
+  /// Drop the lease.
+  ~buffer_lease()
+  {
+    drop();
+  }
+
+  /// Share the block of another lease, dropping the current one.
+  buffer_lease& operator=(const buffer_lease& other) ASIO_NOEXCEPT
+  {
+    buffer_lease tmp(other);
+    swap(tmp);
+    return *this;
+  }
+
+#if defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+  /// Move a lease, dropping the current one.
+  buffer_lease& operator=(buffer_lease&& other) ASIO_NOEXCEPT
+  {
+    buffer_lease tmp(ASIO_MOVE_CAST(buffer_lease)(other));
+    swap(tmp);
+    return *this;
+  }
+#endif // defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+
+  /// Get the leased data.
+  asio::mutable_buffer data() const ASIO_NOEXCEPT
+  {
+    return data_;
+  }
+
+  /// Get the size of the leased data.
+  std::size_t size() const ASIO_NOEXCEPT
+  {
+    return data_.size();
+  }
+
+  /// Whether this is the only lease on its block.
+  bool unique() const ASIO_NOEXCEPT
+  {
+    return block_ && block_->leases_.load(std::memory_order_acquire) == 1;
+  }
+
+  /// Whether the lease holds a block.
+  bool empty() const ASIO_NOEXCEPT
+  {
+    return block_ == 0;
+  }
+
+  /// Swap two leases.
+  void swap(buffer_lease& other) ASIO_NOEXCEPT
+  {
+    buffer_pool::block* b = block_;
+    block_ = other.block_;
+    other.block_ = b;
+    asio::mutable_buffer d = data_;
+    data_ = other.data_;
+    other.data_ = d;
+  }
+
+private:
+  friend class buffer_pool;
+
+  // Takes over the pool's reference on the block.
+  buffer_lease(buffer_pool::block* b, const asio::mutable_buffer& data)
+    : block_(b),
+      data_(data)
+  {
+  }
+
+  void add_lease()
+  {
+    if (block_)
+      block_->leases_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void drop()
+  {
+    if (block_ && block_->leases_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      block_->pool_->release(block_);
+    block_ = 0;
+  }
+
+  buffer_pool::block* block_;
+  asio::mutable_buffer data_;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/impl/buffer_pool.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_BUFFER_POOL_HPP
@@ -26,6 +26,13 @@
 #include "asio/ssl/detail/password_callback.hpp"
 #include "asio/ssl/detail/verify_callback.hpp"
 #include "asio/ssl/verify_mode.hpp"
+#include "asio/ssl/dtls/pinned_key_set.hpp"
+#include "asio/ssl/dtls/psk_key_store.hpp"
+#include "asio/ssl/dtls/server_name_map.hpp"
+#include "asio/ssl/dtls/session_cache.hpp"
+#include "asio/ssl/dtls/detail/private_key_operation.hpp"
+#include "asio/ssl/dtls/detail/psk_callback.hpp"
+#include "asio/ssl/dtls/detail/ticket_key_store.hpp"
 
 #include "asio/detail/push_options.hpp"
 
@@ -73,6 +80,15 @@ public:
 
   ASIO_STATIC_CONSTANT(long, cookie_exchange = SSL_OP_COOKIE_EXCHANGE);
 
+  /// Bitmask type for the certificate types a peer may authenticate with.
+  typedef int certificate_types;
+
+  /// Authentication with an X.509 certificate chain.
+  ASIO_STATIC_CONSTANT(int, x509_certificate = 1);
+
+  /// Authentication with a raw public key (RFC 7250).
+  ASIO_STATIC_CONSTANT(int, raw_public_key = 2);
+
   /// Constructor.
   ASIO_DECL explicit context(dtls_method m);
 
@@ -741,6 +757,685 @@ public:
   ASIO_SYNC_OP_VOID set_password_callback(PasswordCallback callback,
       asio::error_code& ec);
 
+  /// Use an external cache for server-side sessions.
+  /**
+   * This function replaces OpenSSL's internal session cache, which is local
+   * to the context and guarded by a single lock, with the given cache. New
+   * sessions are stored in it and resumption attempts look sessions up in
+   * it, so the cache may be shared between contexts and processes. Clients
+   * that resume with a session ticket do not involve the cache.
+   *
+   * @param cache The cache to be used. It is not copied and must outlive the
+   * context.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_sess_set_new_cb, @c SSL_CTX_sess_set_get_cb and
+   * @c SSL_CTX_sess_set_remove_cb.
+   */
+  ASIO_DECL void set_session_cache(session_cache& cache);
+
+  /// Use an external cache for server-side sessions.
+  /**
+   * This function replaces OpenSSL's internal session cache, which is local
+   * to the context and guarded by a single lock, with the given cache. New
+   * sessions are stored in it and resumption attempts look sessions up in
+   * it, so the cache may be shared between contexts and processes. Clients
+   * that resume with a session ticket do not involve the cache.
+   *
+   * @param cache The cache to be used. It is not copied and must outlive the
+   * context.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_sess_set_new_cb, @c SSL_CTX_sess_set_get_cb and
+   * @c SSL_CTX_sess_set_remove_cb.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_session_cache(
+      session_cache& cache, asio::error_code& ec);
+
+  /// Set the context in which cached sessions may be resumed.
+  /**
+   * Sessions are only resumed by contexts with the same session id context.
+   * Servers that verify client certificates must set one for resumption to
+   * work.
+   *
+   * @param id The session id context, at most 32 bytes long.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set_session_id_context.
+   */
+  ASIO_DECL void set_session_id_context(const std::string& id);
+
+  /// Set the context in which cached sessions may be resumed.
+  /**
+   * Sessions are only resumed by contexts with the same session id context.
+   * Servers that verify client certificates must set one for resumption to
+   * work.
+   *
+   * @param id The session id context, at most 32 bytes long.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set_session_id_context.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_session_id_context(
+      const std::string& id, asio::error_code& ec);
+
+  /// The length of a session ticket key.
+  /**
+   * A key consists of a 16 byte name, which is sent in clear with every
+   * ticket, a 32 byte HMAC-SHA256 key and a 32 byte AES-256 key, in this
+   * order. This is the layout of commonly used 80 byte ticket key files.
+   */
+  ASIO_STATIC_CONSTANT(std::size_t, session_ticket_key_length = 80);
+
+  /// Counters describing how clients resumed with session tickets.
+  struct session_ticket_statistics
+  {
+    /// Tickets decrypted with the current key.
+    std::size_t hits;
+
+    /// Tickets protected by an unknown key, leading to a full handshake.
+    std::size_t misses;
+
+    /// Tickets decrypted with the previous key and replaced by new ones.
+    std::size_t renewals;
+  };
+
+  /// Set the keys protecting session tickets.
+  /**
+   * This function enables stateless session resumption with tickets
+   * protected by the given keys, rather than by a random key private to this
+   * context. Contexts in different processes or on different hosts that are
+   * given the same keys accept each other's tickets.
+   *
+   * @param current The key used to issue tickets and to decrypt them.
+   *
+   * @param previous A key only used to decrypt tickets, or an empty buffer.
+   * Clients presenting such a ticket are issued a new one.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set_tlsext_ticket_key_evp_cb, or
+   * @c SSL_CTX_set_tlsext_ticket_key_cb before OpenSSL 3.0.
+   */
+  ASIO_DECL void set_session_ticket_keys(const const_buffer& current,
+      const const_buffer& previous);
+
+  /// Set the keys protecting session tickets.
+  /**
+   * This function enables stateless session resumption with tickets
+   * protected by the given keys, rather than by a random key private to this
+   * context. Contexts in different processes or on different hosts that are
+   * given the same keys accept each other's tickets.
+   *
+   * @param current The key used to issue tickets and to decrypt them.
+   *
+   * @param previous A key only used to decrypt tickets, or an empty buffer.
+   * Clients presenting such a ticket are issued a new one.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set_tlsext_ticket_key_evp_cb, or
+   * @c SSL_CTX_set_tlsext_ticket_key_cb before OpenSSL 3.0.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_session_ticket_keys(
+      const const_buffer& current, const const_buffer& previous,
+      asio::error_code& ec);
+
+  /// Rotate the session ticket keys.
+  /**
+   * The given key becomes the current key. The current key becomes the
+   * previous key, so tickets issued with it remain valid until the next
+   * rotation. To rotate on a schedule, call this function from a timer.
+   * Session tickets are enabled if they were not already.
+   *
+   * @param next The new current key.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  ASIO_DECL void rotate_session_ticket_key(const const_buffer& next);
+
+  /// Rotate the session ticket keys.
+  /**
+   * The given key becomes the current key. The current key becomes the
+   * previous key, so tickets issued with it remain valid until the next
+   * rotation. To rotate on a schedule, call this function from a timer.
+   * Session tickets are enabled if they were not already.
+   *
+   * @param next The new current key.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID rotate_session_ticket_key(
+      const const_buffer& next, asio::error_code& ec);
+
+  /// Generate a random session ticket key.
+  /**
+   * The key may be given to several contexts, including ones in other
+   * processes, to let them share tickets.
+   *
+   * @returns A key of session_ticket_key_length bytes.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  ASIO_DECL static std::string generate_session_ticket_key();
+
+  /// Generate a random session ticket key.
+  /**
+   * The key may be given to several contexts, including ones in other
+   * processes, to let them share tickets.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @returns A key of session_ticket_key_length bytes, or an empty string if
+   * an error occurred.
+   */
+  ASIO_DECL static std::string generate_session_ticket_key(
+      asio::error_code& ec);
+
+  /// Get the session ticket counters.
+  /**
+   * The counters only include tickets handled with keys set by
+   * set_session_ticket_keys() or rotate_session_ticket_key().
+   */
+  ASIO_DECL session_ticket_statistics session_ticket_stats() const;
+
+  /// Set the callback used by a server to look up pre-shared keys.
+  /**
+   * This function enables handshakes authenticated by a pre-shared key
+   * rather than by certificates. A PSK cipher suite must also be enabled.
+   *
+   * @param callback The function object to be used for looking up the key
+   * of a client identity. The function signature of the handler must be:
+   * @code bool psk_server_callback(
+   *   const std::string& identity, // The identity sent by the client.
+   *   std::string& key // Set to the key of the identity.
+   * ); @endcode
+   * The return value of the callback is true if the identity is known.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set_psk_server_callback.
+   */
+  template <typename PskServerCallback>
+  void set_psk_server_callback(PskServerCallback callback);
+
+  /// Set the callback used by a server to look up pre-shared keys.
+  /**
+   * This function enables handshakes authenticated by a pre-shared key
+   * rather than by certificates. A PSK cipher suite must also be enabled.
+   *
+   * @param callback The function object to be used for looking up the key
+   * of a client identity. The function signature of the handler must be:
+   * @code bool psk_server_callback(
+   *   const std::string& identity, // The identity sent by the client.
+   *   std::string& key // Set to the key of the identity.
+   * ); @endcode
+   * The return value of the callback is true if the identity is known.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set_psk_server_callback.
+   */
+  template <typename PskServerCallback>
+  ASIO_SYNC_OP_VOID set_psk_server_callback(PskServerCallback callback,
+      asio::error_code& ec);
+
+  /// Look up a server's pre-shared keys in a key store.
+  /**
+   * This function is equivalent to calling set_psk_server_callback() with a
+   * callback that calls psk_key_store::find().
+   *
+   * @param store The key store to be used. It is not copied and must outlive
+   * the context.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  ASIO_DECL void set_psk_key_store(psk_key_store& store);
+
+  /// Look up a server's pre-shared keys in a key store.
+  /**
+   * This function is equivalent to calling set_psk_server_callback() with a
+   * callback that calls psk_key_store::find().
+   *
+   * @param store The key store to be used. It is not copied and must outlive
+   * the context.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_psk_key_store(
+      psk_key_store& store, asio::error_code& ec);
+
+  /// Set the identity hint sent by a server.
+  /**
+   * The hint is passed to the client's PSK callback, e.g. to let it choose
+   * between the identities it has for different servers.
+   *
+   * @param hint The identity hint.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_use_psk_identity_hint.
+   */
+  ASIO_DECL void use_psk_identity_hint(const std::string& hint);
+
+  /// Set the identity hint sent by a server.
+  /**
+   * The hint is passed to the client's PSK callback, e.g. to let it choose
+   * between the identities it has for different servers.
+   *
+   * @param hint The identity hint.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_use_psk_identity_hint.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID use_psk_identity_hint(
+      const std::string& hint, asio::error_code& ec);
+
+  /// Set the callback used by a client to choose a pre-shared key.
+  /**
+   * A client that always uses the same identity may instead call
+   * socket::set_psk_identity().
+   *
+   * @param callback The function object to be used for choosing the
+   * identity and key. The function signature of the handler must be:
+   * @code bool psk_client_callback(
+   *   const std::string& hint, // The server's identity hint, or empty.
+   *   std::string& identity, // Set to the identity to send.
+   *   std::string& key // Set to the key of the identity.
+   * ); @endcode
+   * The return value of the callback is false to abort the handshake.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set_psk_client_callback.
+   */
+  template <typename PskClientCallback>
+  void set_psk_client_callback(PskClientCallback callback);
+
+  /// Set the callback used by a client to choose a pre-shared key.
+  /**
+   * A client that always uses the same identity may instead call
+   * socket::set_psk_identity().
+   *
+   * @param callback The function object to be used for choosing the
+   * identity and key. The function signature of the handler must be:
+   * @code bool psk_client_callback(
+   *   const std::string& hint, // The server's identity hint, or empty.
+   *   std::string& identity, // Set to the identity to send.
+   *   std::string& key // Set to the key of the identity.
+   * ); @endcode
+   * The return value of the callback is false to abort the handshake.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set_psk_client_callback.
+   */
+  template <typename PskClientCallback>
+  ASIO_SYNC_OP_VOID set_psk_client_callback(PskClientCallback callback,
+      asio::error_code& ec);
+
+  /// Set the cipher suites offered or accepted.
+  /**
+   * @param ciphers A list of cipher suites in OpenSSL's cipher list format,
+   * e.g. "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-CHACHA20-POLY1305".
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set_cipher_list.
+   */
+  ASIO_DECL void set_cipher_list(const std::string& ciphers);
+
+  /// Set the cipher suites offered or accepted.
+  /**
+   * @param ciphers A list of cipher suites in OpenSSL's cipher list format,
+   * e.g. "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-CHACHA20-POLY1305".
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set_cipher_list.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_cipher_list(
+      const std::string& ciphers, asio::error_code& ec);
+
+  /// Set the groups used for the ECDHE key exchange.
+  /**
+   * @param groups A colon separated list of groups in order of preference,
+   * e.g. "X25519:P-256".
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set1_groups_list, or @c SSL_CTX_set1_curves_list
+   * before OpenSSL 1.1.0.
+   */
+  ASIO_DECL void set_groups_list(const std::string& groups);
+
+  /// Set the groups used for the ECDHE key exchange.
+  /**
+   * @param groups A colon separated list of groups in order of preference,
+   * e.g. "X25519:P-256".
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set1_groups_list, or @c SSL_CTX_set1_curves_list
+   * before OpenSSL 1.1.0.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_groups_list(
+      const std::string& groups, asio::error_code& ec);
+
+  /// Set the signature algorithms used to authenticate the handshake.
+  /**
+   * @param sigalgs A colon separated list of signature algorithms in order of
+   * preference, e.g. "ECDSA+SHA256:RSA+SHA256".
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set1_sigalgs_list.
+   */
+  ASIO_DECL void set_sigalgs_list(const std::string& sigalgs);
+
+  /// Set the signature algorithms used to authenticate the handshake.
+  /**
+   * @param sigalgs A colon separated list of signature algorithms in order of
+   * preference, e.g. "ECDSA+SHA256:RSA+SHA256".
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set1_sigalgs_list.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_sigalgs_list(
+      const std::string& sigalgs, asio::error_code& ec);
+
+  /// Configure the context for handshakes that are cheap to compute.
+  /**
+   * This function restricts the key exchange to ECDHE over X25519 or P-256,
+   * prefers ECDSA signatures, and only enables AEAD cipher suites. AES-GCM is
+   * preferred if the CPU has AES instructions and ChaCha20-Poly1305
+   * otherwise. A server also uses its own cipher preference, except that it
+   * honours clients that put ChaCha20-Poly1305 first.
+   *
+   * For the full benefit, the certificate should have an ECDSA key.
+   *
+   * @returns A description of the settings and of the CPU features they were
+   * chosen for, suitable for logging at startup.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  ASIO_DECL std::string use_fast_handshake_profile();
+
+  /// Configure the context for handshakes that are cheap to compute.
+  /**
+   * This function restricts the key exchange to ECDHE over X25519 or P-256,
+   * prefers ECDSA signatures, and only enables AEAD cipher suites. AES-GCM is
+   * preferred if the CPU has AES instructions and ChaCha20-Poly1305
+   * otherwise. A server also uses its own cipher preference, except that it
+   * honours clients that put ChaCha20-Poly1305 first.
+   *
+   * For the full benefit, the certificate should have an ECDSA key.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @returns A description of the settings and of the CPU features they were
+   * chosen for, suitable for logging at startup.
+   */
+  ASIO_DECL std::string use_fast_handshake_profile(asio::error_code& ec);
+
+  /// Run private key operations of the handshake on an executor.
+  /**
+   * This function replaces the context's RSA or ECDSA private key with one
+   * whose signing operations are posted to the given executor, typically a
+   * thread pool. While a signature is computed the handshake is suspended
+   * and the I/O thread is free to serve other sessions, so the handshake
+   * rate scales with the executor instead of the I/O threads.
+   *
+   * Asynchronous handshakes resume once the signature is available,
+   * synchronous handshakes block until then. A synchronous handshake
+   * computes the signature itself if the executor has not started it yet,
+   * so it may also run on a thread the executor depends on. The key must
+   * have been loaded before this function is called.
+   *
+   * @param executor The executor on which the operations run.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Uses OpenSSL's asynchronous jobs (@c SSL_MODE_ASYNC). Where they
+   * are not available, e.g. without OpenSSL 1.1.0, the operations run on
+   * the I/O thread as before.
+   */
+  template <typename Executor>
+  void offload_private_key_operations(const Executor& executor);
+
+  /// Run private key operations of the handshake on an executor.
+  /**
+   * This function replaces the context's RSA or ECDSA private key with one
+   * whose signing operations are posted to the given executor.
+   *
+   * @param executor The executor on which the operations run.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::invalid_argument if no private key is loaded, or to
+   * asio::error::operation_not_supported for keys other than RSA and ECDSA.
+   */
+  template <typename Executor>
+  ASIO_SYNC_OP_VOID offload_private_key_operations(
+      const Executor& executor, asio::error_code& ec);
+
+  /// Select the context of a handshake by the server name the client sent.
+  /**
+   * When a client sends a server name indication that matches an entry of
+   * the map, the certificate, private key, verification mode and options of
+   * the entry's context replace those of this context for the handshake.
+   * Handshakes without a matching name continue with this context.
+   *
+   * The session cache, ticket keys and PSK callbacks are always those of
+   * this context, also after another context has been selected. Those set
+   * on the contexts of the map are not used by its handshakes.
+   *
+   * @param map The map to be used. It is not copied and must outlive the
+   * context.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set_tlsext_servername_callback.
+   */
+  ASIO_DECL void set_server_name_map(server_name_map& map);
+
+  /// Select the context of a handshake by the server name the client sent.
+  /**
+   * When a client sends a server name indication that matches an entry of
+   * the map, the certificate, private key, verification mode and options of
+   * the entry's context replace those of this context for the handshake.
+   * The session cache, ticket keys and PSK callbacks remain those of this
+   * context.
+   *
+   * @param map The map to be used. It is not copied and must outlive the
+   * context.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set_tlsext_servername_callback.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_server_name_map(
+      server_name_map& map, asio::error_code& ec);
+
+  /// Set the certificate types the server may authenticate with.
+  /**
+   * With raw public keys (RFC 7250) the server sends only its public key
+   * instead of a certificate chain, which keeps its handshake flight small.
+   * The key loaded with use_private_key() is sent, a certificate is not
+   * required. When both types are allowed raw public keys are preferred, and
+   * X.509 is used with peers that do not support them.
+   *
+   * @param types A bitmask of x509_certificate and raw_public_key.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set1_server_cert_type. Raw public keys require
+   * OpenSSL 3.2 or later.
+   */
+  ASIO_DECL void set_server_certificate_types(certificate_types types);
+
+  /// Set the certificate types the server may authenticate with.
+  /**
+   * With raw public keys (RFC 7250) the server sends only its public key
+   * instead of a certificate chain, which keeps its handshake flight small.
+   *
+   * @param types A bitmask of x509_certificate and raw_public_key.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::operation_not_supported if raw public keys are requested
+   * but not supported by OpenSSL.
+   *
+   * @note Calls @c SSL_CTX_set1_server_cert_type.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_server_certificate_types(
+      certificate_types types, asio::error_code& ec);
+
+  /// Set the certificate types the client may authenticate with.
+  /**
+   * This function is the counterpart of set_server_certificate_types() for
+   * servers that request client authentication.
+   *
+   * @param types A bitmask of x509_certificate and raw_public_key.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set1_client_cert_type. Raw public keys require
+   * OpenSSL 3.2 or later.
+   */
+  ASIO_DECL void set_client_certificate_types(certificate_types types);
+
+  /// Set the certificate types the client may authenticate with.
+  /**
+   * This function is the counterpart of set_server_certificate_types() for
+   * servers that request client authentication.
+   *
+   * @param types A bitmask of x509_certificate and raw_public_key.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set1_client_cert_type.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_client_certificate_types(
+      certificate_types types, asio::error_code& ec);
+
+  /// Authenticate peers by comparing their public key with a set of keys.
+  /**
+   * This function replaces certificate verification: a peer is accepted if
+   * its raw public key, or the public key of its certificate, is in the
+   * set. Certificate chains are neither built nor validated, so a peer may
+   * send just its own certificate. Verify callbacks are not called.
+   *
+   * Peer verification has to be requested with set_verify_mode() as usual.
+   *
+   * @param keys The set to be used. It is not copied and must outlive the
+   * context.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_CTX_set_cert_verify_callback.
+   */
+  ASIO_DECL void set_pinned_keys(pinned_key_set& keys);
+
+  /// Authenticate peers by comparing their public key with a set of keys.
+  /**
+   * This function replaces certificate verification: a peer is accepted if
+   * its raw public key, or the public key of its certificate, is in the
+   * set.
+   *
+   * @param keys The set to be used. It is not copied and must outlive the
+   * context.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_CTX_set_cert_verify_callback.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID set_pinned_keys(
+      pinned_key_set& keys, asio::error_code& ec);
+
+  /// Negotiate connection IDs, so sessions survive address changes.
+  /**
+   * This function makes sessions offer or accept connection IDs, using the
+   * record format of RFC 9146. Each side picks a random ID of the given
+   * length that the peer puts into every record it sends, so that a server
+   * can find the session of a record after the client's address or port has
+   * changed. See socket::migrate() and acceptor::register_connection_id().
+   *
+   * Connection IDs are non-interoperable: they only work between peers that
+   * both use this implementation. OpenSSL does not implement RFC 9146 and
+   * sends the final handshake flight without connection IDs, which the RFC
+   * does not allow. The extension is therefore negotiated under a private
+   * extension number instead of the one assigned by RFC 9146, so that other
+   * implementations ignore it and the handshake completes without
+   * connection IDs.
+   *
+   * Connection IDs are only agreed for DTLS 1.2 with an AES-GCM or
+   * ChaCha20-Poly1305 cipher suite. Records with connection IDs are handled
+   * by the fast path, which is enabled by the handshake as if
+   * socket::enable_fast_path() had been called.
+   *
+   * @param length The length of the local connection ID, at most 255. With
+   * a length of 0 the peer is asked to send records without an ID, while
+   * records sent to it still carry the ID it chose.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note The extension is added with @c SSL_CTX_add_custom_ext.
+   */
+  ASIO_DECL void enable_connection_id(std::size_t length);
+
+  /// Negotiate connection IDs, so sessions survive address changes.
+  /**
+   * This function makes sessions offer or accept connection IDs. They are
+   * non-interoperable and only work between peers that both use this
+   * implementation, see the overload above.
+   *
+   * @param length The length of the local connection ID, at most 255.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::operation_not_supported before OpenSSL 1.1.1.
+   *
+   * @note Calls @c SSL_CTX_add_custom_ext.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID enable_connection_id(
+      std::size_t length, asio::error_code& ec);
+
+  /// Negotiate heartbeats, so sessions can be kept alive cheaply.
+  /**
+   * This function makes sessions offer or accept the heartbeat extension of
+   * RFC 6520, which lets either side probe the other with heartbeat
+   * requests that are answered by the DTLS layer itself. See
+   * socket::async_heartbeat().
+   *
+   * Heartbeats are only agreed for DTLS 1.2 with an AES-GCM or
+   * ChaCha20-Poly1305 cipher suite. With another suite the handshake
+   * completes without them, even if the peer agreed to them. Heartbeat
+   * records are handled by the fast path, which is enabled by the handshake
+   * as if socket::enable_fast_path() had been called.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note OpenSSL no longer implements heartbeats, so the extension is added
+   * with @c SSL_CTX_add_custom_ext.
+   */
+  ASIO_DECL void enable_heartbeat();
+
+  /// Negotiate heartbeats, so sessions can be kept alive cheaply.
+  /**
+   * This function makes sessions offer or accept the heartbeat extension of
+   * RFC 6520.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::operation_not_supported before OpenSSL 1.1.1.
+   *
+   * @note Calls @c SSL_CTX_add_custom_ext.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID enable_heartbeat(asio::error_code& ec);
+
 private:
   struct bio_cleanup;
   struct x509_cleanup;
@@ -771,6 +1466,163 @@ private:
   // Helper function to make a BIO from a memory buffer.
   ASIO_DECL BIO* make_buffer_bio(const const_buffer& b);
 
+  // The SSL_CTX ex_data index holding the external session cache.
+  ASIO_DECL static int session_cache_index();
+
+  // Callback used when OpenSSL has established a new session.
+  ASIO_DECL static int new_session_function(SSL* ssl, SSL_SESSION* session);
+
+  // Callback used when OpenSSL looks for a session to resume.
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  ASIO_DECL static SSL_SESSION* get_session_function(
+      SSL* ssl, const unsigned char* id, int length, int* copy);
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  ASIO_DECL static SSL_SESSION* get_session_function(
+      SSL* ssl, unsigned char* id, int length, int* copy);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+
+  // Callback used when OpenSSL invalidates a session.
+  ASIO_DECL static void remove_session_function(
+      SSL_CTX* ctx, SSL_SESSION* session);
+
+  // The SSL_CTX ex_data index holding the session ticket keys.
+  ASIO_DECL static int ticket_key_index();
+
+  // Get the session ticket keys, creating them if needed.
+  ASIO_DECL dtls::detail::ticket_key_store* ticket_keys(asio::error_code& ec);
+
+  // Callback used when OpenSSL encrypts or decrypts a session ticket.
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+  ASIO_DECL static int ticket_key_function(SSL* ssl, unsigned char* name,
+      unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int enc);
+#else // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+  ASIO_DECL static int ticket_key_function(SSL* ssl, unsigned char* name,
+      unsigned char* iv, EVP_CIPHER_CTX* cipher, HMAC_CTX* mac, int enc);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+
+  // Adapts a psk_key_store to the PSK server callback signature.
+  struct psk_key_store_lookup
+  {
+    psk_key_store* store;
+
+    bool operator()(const std::string& identity, std::string& key) const
+    {
+      return store->find(identity, key);
+    }
+  };
+
+  // The SSL_CTX ex_data indexes holding the PSK callbacks.
+  ASIO_DECL static int psk_server_callback_index();
+  ASIO_DECL static int psk_client_callback_index();
+
+  // Helper function used to set a PSK server callback.
+  ASIO_DECL ASIO_SYNC_OP_VOID do_set_psk_server_callback(
+      dtls::detail::psk_server_callback_base* callback, asio::error_code& ec);
+
+  // Helper function used to set a PSK client callback.
+  ASIO_DECL ASIO_SYNC_OP_VOID do_set_psk_client_callback(
+      dtls::detail::psk_client_callback_base* callback, asio::error_code& ec);
+
+  // Callback used when a server needs the key of a client identity.
+  ASIO_DECL static unsigned int psk_server_callback_function(SSL* ssl,
+      const char* identity, unsigned char* psk, unsigned int max_psk_length);
+
+  // Callback used when a client needs an identity and key.
+  ASIO_DECL static unsigned int psk_client_callback_function(SSL* ssl,
+      const char* hint, char* identity, unsigned int max_identity_length,
+      unsigned char* psk, unsigned int max_psk_length);
+
+  // Helper function used to set the server or client certificate types.
+  ASIO_DECL ASIO_SYNC_OP_VOID do_set_certificate_types(bool server,
+      certificate_types types, asio::error_code& ec);
+
+  // Callback used to verify a peer against the pinned keys.
+  ASIO_DECL static int pinned_key_verify_function(
+      X509_STORE_CTX* ctx, void* arg);
+
+  // The extension type of connection IDs. RFC 9146 assigns 54, but the
+  // handshake does not follow the RFC, so a number from the private use
+  // range keeps other implementations from agreeing to it.
+  ASIO_STATIC_CONSTANT(unsigned int, connection_id_extension = 0xff36);
+
+  // The SSL_CTX ex_data index holding the local connection ID length.
+  ASIO_DECL static int connection_id_length_index();
+
+  // Callback used when OpenSSL adds the connection ID extension.
+  ASIO_DECL static int connection_id_add_function(SSL* ssl,
+      unsigned int type, unsigned int context, const unsigned char** out,
+      std::size_t* out_length, X509* cert, std::size_t chain_index,
+      int* alert, void* arg);
+
+  // Callback used when OpenSSL frees the connection ID extension.
+  ASIO_DECL static void connection_id_free_function(SSL* ssl,
+      unsigned int type, unsigned int context, const unsigned char* out,
+      void* arg);
+
+  // Callback used when OpenSSL received the connection ID extension.
+  ASIO_DECL static int connection_id_parse_function(SSL* ssl,
+      unsigned int type, unsigned int context, const unsigned char* in,
+      std::size_t in_length, X509* cert, std::size_t chain_index,
+      int* alert, void* arg);
+
+  // The extension type of heartbeats, from RFC 6520.
+  ASIO_STATIC_CONSTANT(unsigned int, heartbeat_extension = 15);
+
+  // Callback used when OpenSSL adds the heartbeat extension.
+  ASIO_DECL static int heartbeat_add_function(SSL* ssl,
+      unsigned int type, unsigned int context, const unsigned char** out,
+      std::size_t* out_length, X509* cert, std::size_t chain_index,
+      int* alert, void* arg);
+
+  // Callback used when OpenSSL received the heartbeat extension.
+  ASIO_DECL static int heartbeat_parse_function(SSL* ssl,
+      unsigned int type, unsigned int context, const unsigned char* in,
+      std::size_t in_length, X509* cert, std::size_t chain_index,
+      int* alert, void* arg);
+
+  // Callback used when a client sent a server name indication.
+  ASIO_DECL static int server_name_function(SSL* ssl, int* alert, void* arg);
+
+  // The SSL ex_data index holding the context a handshake started with, set
+  // once the server name selected another one.
+  ASIO_DECL static int session_context_index();
+
+  // Get the context whose session cache, ticket keys and PSK callbacks a
+  // handshake uses.
+  ASIO_DECL static SSL_CTX* session_context(SSL* ssl);
+
+  // The SSL_CTX ex_data index holding the private key executor.
+  ASIO_DECL static int private_key_executor_index();
+
+  // Helper function used to offload private key operations.
+  ASIO_DECL ASIO_SYNC_OP_VOID do_offload_private_key_operations(
+      dtls::detail::private_key_executor_base* executor, asio::error_code& ec);
+
+  // Get the executor for a private key operation of the handshake running
+  // on this thread, or 0 if the operation has to be performed inline.
+  ASIO_DECL static dtls::detail::private_key_executor_base*
+  private_key_operation_executor();
+
+  // Run the operation on the executor while the handshake is suspended.
+  ASIO_DECL static void run_private_key_operation(
+      dtls::detail::private_key_executor_base* executor,
+      const asio::detail::shared_ptr<
+        dtls::detail::private_key_operation>& op);
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+#if !defined(OPENSSL_NO_EC)
+  // Callback used when OpenSSL signs with an offloaded ECDSA key.
+  ASIO_DECL static int ecdsa_sign_function(int type,
+      const unsigned char* digest, int digest_length, unsigned char* sig,
+      unsigned int* sig_length, const BIGNUM* kinv, const BIGNUM* r,
+      EC_KEY* key);
+#endif // !defined(OPENSSL_NO_EC)
+
+  // Callback used when OpenSSL signs with an offloaded RSA key.
+  ASIO_DECL static int rsa_private_encrypt_function(int length,
+      const unsigned char* from, unsigned char* to, RSA* key, int padding);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+
   // The underlying native implementation.
   native_handle_type handle_;
 
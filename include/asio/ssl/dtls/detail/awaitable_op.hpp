@@ -0,0 +1,491 @@
+//
+// ssl/dtls/detail/awaitable_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_AWAITABLE_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_AWAITABLE_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#if defined(ASIO_HAS_CO_AWAIT)
+
+#include <cstddef>
+#include <new>
+#if defined(ASIO_HAS_STD_COROUTINE)
+# include <coroutine>
+#else // defined(ASIO_HAS_STD_COROUTINE)
+# include <experimental/coroutine>
+#endif // defined(ASIO_HAS_STD_COROUTINE)
+#include "asio/associated_allocator.hpp"
+#include "asio/associated_executor.hpp"
+#include "asio/async_result.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/detail/throw_error.hpp"
+#include "asio/detail/type_traits.hpp"
+#include "asio/error_code.hpp"
+#include "asio/post.hpp"
+#include "asio/use_awaitable.hpp"
+#include "asio/ssl/dtls/detail/datagram_io.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+#if defined(ASIO_HAS_STD_COROUTINE)
+typedef std::coroutine_handle<void> awaiting_coroutine;
+#else // defined(ASIO_HAS_STD_COROUTINE)
+typedef std::experimental::coroutine_handle<void> awaiting_coroutine;
+#endif // defined(ASIO_HAS_STD_COROUTINE)
+
+// The state of an operation awaited by a coroutine. It is part of the
+// awaiter, and so lives in the coroutine frame while the coroutine is
+// suspended. The memory the operation needs for its steps on the transport
+// is taken from here as well, so that its steps do not allocate. The
+// awaiters are standard awaitables. asio::awaitable coroutines reject them in
+// await_transform, so the co_ functions also take asio::use_awaitable and
+// then start the operation through datagram_io_initiation.
+class awaitable_state
+  : private noncopyable
+{
+public:
+  // Each step frees its memory before the next one is allocated, so one
+  // block is normally in use. The second covers a step that is allocated
+  // before the previous one has been freed. The wait on the retransmission
+  // timer takes its memory from the socket's deadline instead.
+  enum
+  {
+    block_size = 512,
+    block_count = 2
+  };
+
+  explicit awaitable_state(asio::error_code* ec, const char* what)
+    : ec_out_(ec),
+      what_(what),
+      bytes_transferred_(0)
+  {
+    for (int i = 0; i < block_count; ++i)
+      used_[i] = false;
+  }
+
+  bool await_ready() const ASIO_NOEXCEPT
+  {
+    return false;
+  }
+
+  // Called on the socket's executor when the operation completes.
+  void complete(const asio::error_code& ec, std::size_t bytes_transferred)
+  {
+    ec_ = ec;
+    bytes_transferred_ = bytes_transferred;
+    coroutine_.resume();
+  }
+
+  // Record an error that prevented the operation from starting.
+  void fail(const asio::error_code& ec)
+  {
+    ec_ = ec;
+  }
+
+  // Get the memory for a step of the operation. Falls back to the heap if
+  // the step does not fit.
+  void* allocate(std::size_t size)
+  {
+    for (int i = 0; i < block_count; ++i)
+    {
+      if (!used_[i] && size <= block_size)
+      {
+        used_[i] = true;
+        return blocks_[i];
+      }
+    }
+    return ::operator new(size);
+  }
+
+  void deallocate(void* pointer)
+  {
+    for (int i = 0; i < block_count; ++i)
+    {
+      if (pointer == blocks_[i])
+      {
+        used_[i] = false;
+        return;
+      }
+    }
+    ::operator delete(pointer);
+  }
+
+protected:
+  // Report the result, throwing if no error_code was passed.
+  std::size_t result()
+  {
+    if (ec_out_)
+      *ec_out_ = ec_;
+    else
+      asio::detail::throw_error(ec_, what_);
+    return bytes_transferred_;
+  }
+
+  awaiting_coroutine coroutine_;
+
+private:
+  asio::error_code* ec_out_;
+  const char* what_;
+  asio::error_code ec_;
+  std::size_t bytes_transferred_;
+  bool used_[block_count];
+  alignas(std::max_align_t) unsigned char blocks_[block_count][block_size];
+};
+
+// The allocator associated with the handler of an awaited operation.
+template <typename T>
+class awaitable_allocator
+{
+public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind
+  {
+    typedef awaitable_allocator<U> other;
+  };
+
+  explicit awaitable_allocator(awaitable_state& state) ASIO_NOEXCEPT
+    : state_(&state)
+  {
+  }
+
+  template <typename U>
+  awaitable_allocator(const awaitable_allocator<U>& other) ASIO_NOEXCEPT
+    : state_(other.state_)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(state_->allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* p, std::size_t)
+  {
+    state_->deallocate(p);
+  }
+
+  bool operator==(const awaitable_allocator& other) const ASIO_NOEXCEPT
+  {
+    return state_ == other.state_;
+  }
+
+  bool operator!=(const awaitable_allocator& other) const ASIO_NOEXCEPT
+  {
+    return state_ != other.state_;
+  }
+
+private:
+  template <typename> friend class awaitable_allocator;
+
+  awaitable_state* state_;
+};
+
+// Resumes the coroutine when the awaited operation completes.
+class awaitable_handler
+{
+public:
+  explicit awaitable_handler(awaitable_state& state)
+    : state_(&state)
+  {
+  }
+
+  void operator()(const asio::error_code& ec,
+      std::size_t bytes_transferred = 0)
+  {
+    state_->complete(ec, bytes_transferred);
+  }
+
+  awaitable_state* state_;
+};
+
+inline void* asio_handler_allocate(std::size_t size,
+    awaitable_handler* this_handler)
+{
+  return this_handler->state_->allocate(size);
+}
+
+inline void asio_handler_deallocate(void* pointer, std::size_t,
+    awaitable_handler* this_handler)
+{
+  this_handler->state_->deallocate(pointer);
+}
+
+// Nothing to do before an awaited operation starts. A preparation returns
+// false, setting the error_code, if the operation cannot start.
+struct null_prepare
+{
+  bool operator()(asio::error_code&) const
+  {
+    return true;
+  }
+};
+
+// Awaits an operation run by async_datagram_io(). The result is the number
+// of bytes transferred, or nothing if Result is void.
+template <typename ReceiveFunction, typename SendFunction,
+    typename Core, typename Operation, typename Result,
+    typename Prepare = null_prepare>
+class awaitable_datagram_op
+  : public awaitable_state
+{
+public:
+  awaitable_datagram_op(const ReceiveFunction& rf, const SendFunction& sf,
+      Core& core, const Operation& op, asio::error_code* ec,
+      const char* what, const Prepare& prepare = Prepare())
+    : awaitable_state(ec, what),
+      receive_(rf),
+      send_(sf),
+      core_(core),
+      op_(op),
+      prepare_(prepare)
+  {
+  }
+
+  // The operation is prepared and started once the coroutine is suspended,
+  // so that it sees the socket as it is when awaited and may be resumed on
+  // another thread.
+  bool await_suspend(awaiting_coroutine coroutine)
+  {
+    asio::error_code ec;
+    if (!prepare_(ec))
+    {
+      fail(ec);
+      return false;
+    }
+
+    coroutine_ = coroutine;
+    awaitable_handler handler(*this);
+    async_datagram_io(receive_, send_, core_, op_, handler);
+    return true;
+  }
+
+  Result await_resume()
+  {
+    return static_cast<Result>(result());
+  }
+
+private:
+  ReceiveFunction receive_;
+  SendFunction send_;
+  Core& core_;
+  Operation op_;
+  Prepare prepare_;
+};
+
+// Completes an operation whose preparation failed, as the operation would
+// have completed.
+template <typename Operation, typename Handler>
+class prepare_failed_handler
+{
+public:
+  prepare_failed_handler(const Operation& op, Handler& handler,
+      const asio::error_code& ec)
+    : op_(op),
+      handler_(ASIO_MOVE_CAST(Handler)(handler)),
+      ec_(ec)
+  {
+  }
+
+  void operator()()
+  {
+    op_.call_handler(handler_, ec_, 0);
+  }
+
+//private:
+  Operation op_;
+  Handler handler_;
+  asio::error_code ec_;
+};
+
+// Starts an operation run by async_datagram_io() for async_initiate(). With
+// asio::use_awaitable it is called when the coroutine awaits the operation.
+// A preparation that fails completes the handler with its error.
+template <typename ReceiveFunction, typename SendFunction,
+    typename Core, typename Operation, typename Prepare = null_prepare>
+class datagram_io_initiation
+{
+public:
+  datagram_io_initiation(const ReceiveFunction& rf, const SendFunction& sf,
+      Core& core, const Operation& op, const Prepare& prepare = Prepare())
+    : receive_(rf),
+      send_(sf),
+      core_(&core),
+      op_(op),
+      prepare_(prepare)
+  {
+  }
+
+  template <typename Handler>
+  void operator()(ASIO_MOVE_ARG(Handler) handler) const
+  {
+    typedef typename decay<Handler>::type handler_type;
+    handler_type handler2(ASIO_MOVE_CAST(Handler)(handler));
+
+    asio::error_code ec;
+    if (!prepare_(ec))
+    {
+      asio::post(core_->executor_,
+          prepare_failed_handler<Operation, handler_type>(op_, handler2, ec));
+      return;
+    }
+
+    async_datagram_io(receive_, send_, *core_, op_, handler2);
+  }
+
+private:
+  ReceiveFunction receive_;
+  SendFunction send_;
+  Core* core_;
+  Operation op_;
+  Prepare prepare_;
+};
+
+// Awaits an operation started by an initiation function, which is called
+// with the handler and an error_code. It returns false if the operation
+// could not be started, in which case the coroutine continues right away.
+template <typename Initiation, typename Result>
+class awaitable_initiated_op
+  : public awaitable_state
+{
+public:
+  awaitable_initiated_op(const Initiation& initiation, asio::error_code* ec,
+      const char* what)
+    : awaitable_state(ec, what),
+      initiation_(initiation)
+  {
+  }
+
+  bool await_suspend(awaiting_coroutine coroutine)
+  {
+    coroutine_ = coroutine;
+    awaitable_handler handler(*this);
+    asio::error_code ec;
+    if (initiation_(handler, ec))
+      return true;
+
+    fail(ec);
+    return false;
+  }
+
+  Result await_resume()
+  {
+    return static_cast<Result>(result());
+  }
+
+private:
+  Initiation initiation_;
+};
+
+template <typename Result, typename ReceiveFunction, typename SendFunction,
+    typename Core, typename Operation>
+inline awaitable_datagram_op<ReceiveFunction,
+    SendFunction, Core, Operation, Result>
+make_awaitable_datagram_op(const ReceiveFunction& rf, const SendFunction& sf,
+    Core& core, const Operation& op, asio::error_code* ec, const char* what)
+{
+  return awaitable_datagram_op<ReceiveFunction,
+    SendFunction, Core, Operation, Result>(rf, sf, core, op, ec, what);
+}
+
+template <typename Result, typename ReceiveFunction, typename SendFunction,
+    typename Core, typename Operation, typename Prepare>
+inline awaitable_datagram_op<ReceiveFunction,
+    SendFunction, Core, Operation, Result, Prepare>
+make_awaitable_datagram_op(const ReceiveFunction& rf, const SendFunction& sf,
+    Core& core, const Operation& op, asio::error_code* ec, const char* what,
+    const Prepare& prepare)
+{
+  return awaitable_datagram_op<ReceiveFunction, SendFunction,
+    Core, Operation, Result, Prepare>(rf, sf, core, op, ec, what, prepare);
+}
+
+template <typename ReceiveFunction, typename SendFunction,
+    typename Core, typename Operation>
+inline datagram_io_initiation<ReceiveFunction, SendFunction, Core, Operation>
+make_datagram_io_initiation(const ReceiveFunction& rf,
+    const SendFunction& sf, Core& core, const Operation& op)
+{
+  return datagram_io_initiation<ReceiveFunction,
+    SendFunction, Core, Operation>(rf, sf, core, op);
+}
+
+template <typename ReceiveFunction, typename SendFunction,
+    typename Core, typename Operation, typename Prepare>
+inline datagram_io_initiation<ReceiveFunction,
+    SendFunction, Core, Operation, Prepare>
+make_datagram_io_initiation(const ReceiveFunction& rf,
+    const SendFunction& sf, Core& core, const Operation& op,
+    const Prepare& prepare)
+{
+  return datagram_io_initiation<ReceiveFunction, SendFunction,
+    Core, Operation, Prepare>(rf, sf, core, op, prepare);
+}
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+
+template <typename Operation, typename Handler, typename Allocator>
+struct associated_allocator<
+    ssl::dtls::detail::prepare_failed_handler<Operation, Handler>, Allocator>
+{
+  typedef typename associated_allocator<Handler, Allocator>::type type;
+
+  static type get(
+      const ssl::dtls::detail::prepare_failed_handler<Operation, Handler>& h,
+      const Allocator& a = Allocator()) ASIO_NOEXCEPT
+  {
+    return associated_allocator<Handler, Allocator>::get(h.handler_, a);
+  }
+};
+
+template <typename Operation, typename Handler, typename Executor>
+struct associated_executor<
+    ssl::dtls::detail::prepare_failed_handler<Operation, Handler>, Executor>
+{
+  typedef typename associated_executor<Handler, Executor>::type type;
+
+  static type get(
+      const ssl::dtls::detail::prepare_failed_handler<Operation, Handler>& h,
+      const Executor& ex = Executor()) ASIO_NOEXCEPT
+  {
+    return associated_executor<Handler, Executor>::get(h.handler_, ex);
+  }
+};
+
+template <typename Allocator>
+struct associated_allocator<ssl::dtls::detail::awaitable_handler, Allocator>
+{
+  typedef ssl::dtls::detail::awaitable_allocator<void> type;
+
+  static type get(const ssl::dtls::detail::awaitable_handler& h,
+      const Allocator& = Allocator()) ASIO_NOEXCEPT
+  {
+    return type(*h.state_);
+  }
+};
+
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // defined(ASIO_HAS_CO_AWAIT)
+
+#endif // ASIO_SSL_DTLS_DETAIL_AWAITABLE_OP_HPP
@@ -0,0 +1,116 @@
+//
+// ssl/dtls/detail/batch_read_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_BATCH_READ_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_BATCH_READ_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+#include "asio/ssl/dtls/message_slot.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Reads messages into the slots until they are full or no more input can be
+// had without waiting. The operation waits for the first message only;
+// after that it goes on while records are left in the input or datagrams
+// are waiting on the transport. The handler is passed the number of slots
+// filled, also when an error ends the batch.
+template <typename NextLayer>
+class batch_read_op
+{
+public:
+  batch_read_op(message_slot* slots, std::size_t count,
+      const asio::const_buffer& input, NextLayer& next_layer)
+    : slots_(slots),
+      count_(count),
+      input_(&input),
+      next_layer_(&next_layer),
+      filled_(0)
+  {
+  }
+
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    ec = asio::error_code();
+    while (filled_ < count_)
+    {
+      message_slot& slot = slots_[filled_];
+      std::size_t length = 0;
+      engine_base::want result = eng.read(slot.buffer, ec, length);
+      if (result != engine_base::want_nothing || ec)
+      {
+        if (filled_ == 0 || ec
+            || result != engine_base::want_input_and_retry
+            || input_waiting())
+          return result;
+        break;
+      }
+
+      slot.size = length;
+      slot.complete = !eng.payload_pending();
+      ++filled_;
+    }
+
+    bytes_transferred = filled_;
+    return engine_base::want_nothing;
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t&) const
+  {
+    handler(ec, filled_);
+  }
+
+private:
+  // Whether more input can be read without waiting.
+  bool input_waiting() const
+  {
+    if (input_->size() != 0)
+      return true;
+
+    asio::error_code ec;
+    return next_layer_->available(ec) != 0 && !ec;
+  }
+
+  message_slot* slots_;
+  std::size_t count_;
+
+  // The core's unconsumed input.
+  const asio::const_buffer* input_;
+
+  NextLayer* next_layer_;
+
+  // The number of slots filled so far.
+  mutable std::size_t filled_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_BATCH_READ_OP_HPP
@@ -0,0 +1,132 @@
+//
+// ssl/dtls/detail/batch_write_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_BATCH_WRITE_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_BATCH_WRITE_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <iterator>
+#include <vector>
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Writes every buffer of the sequence as a message of its own. All messages
+// are passed to the engine before any output is taken from it, so that the
+// records are sent back to back by one operation. The handler is passed the
+// number of messages written, or on failure the number of messages whose
+// output had all been sent.
+template <typename ConstBufferSequence>
+class batch_write_op
+{
+public:
+  batch_write_op(const ConstBufferSequence& buffers, const engine& eng)
+    : buffers_(buffers),
+      engine_(&eng),
+      next_(0),
+      output_(false),
+      start_(eng.taken_output())
+  {
+  }
+
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    typedef decltype(asio::buffer_sequence_begin(buffers_)) iterator;
+
+    // Resume after the messages written by an earlier call, which returned
+    // to let the engine's output or input be handled first.
+    iterator i = asio::buffer_sequence_begin(buffers_);
+    iterator end = asio::buffer_sequence_end(buffers_);
+    std::advance(i, next_);
+
+    ec = asio::error_code();
+    for (; i != end; ++i)
+    {
+      std::size_t length = 0;
+      engine_base::want result = eng.write(
+          asio::const_buffer(*i), ec, length);
+      if (ec)
+        return result;
+
+      if (result == engine_base::want_output)
+        output_ = true;
+      else if (result != engine_base::want_nothing)
+        return result;
+
+      ++next_;
+      ends_.push_back(eng.queued_output());
+    }
+
+    bytes_transferred = next_;
+    return output_ ? engine_base::want_output : engine_base::want_nothing;
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t& bytes_transferred) const
+  {
+    handler(ec, ec ? sent() : bytes_transferred);
+  }
+
+private:
+  // The number of messages whose output has all been sent. Output taken by
+  // this operation ends with the datagram whose send failed.
+  std::size_t sent() const
+  {
+    engine::output_position taken = engine_->taken_output();
+    if (taken.bytes != start_.bytes || taken.records != start_.records)
+      taken = engine_->last_output();
+
+    std::size_t count = 0;
+    while (count < ends_.size()
+        && ends_[count].bytes <= taken.bytes
+        && ends_[count].records <= taken.records)
+      ++count;
+    return count;
+  }
+
+  ConstBufferSequence buffers_;
+  const engine* engine_;
+
+  // The number of messages passed to the engine so far.
+  mutable std::size_t next_;
+
+  // Whether any of them left output to be sent.
+  mutable bool output_;
+
+  // The output taken before the operation started, and the end of the
+  // output of each message passed to the engine.
+  engine::output_position start_;
+  mutable std::vector<engine::output_position> ends_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_BATCH_WRITE_OP_HPP
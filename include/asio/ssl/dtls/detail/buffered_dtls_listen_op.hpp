@@ -17,7 +17,9 @@
 
 #include "asio/detail/config.hpp"
 
-#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
 
 #include "asio/detail/push_options.hpp"
 
@@ -35,21 +37,22 @@ public:
   {
   }
 
-  ssl::dtls::detail::engine::want operator()(dtls::detail::engine& eng,
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
       asio::error_code& ec,
       std::size_t& bytes_transferred) const
   {
     eng.put_input(buffer_);
     bytes_transferred = asio::buffer_size(buffer_);
-    ssl::dtls::detail::engine::want result = eng.dtls_listen(ec);
+    engine_base::want result = eng.dtls_listen(ec);
 
     // Don't retry -> call again to retry
-    if(result == ssl::dtls::detail::engine::want_output_and_retry)
+    if(result == engine_base::want_output_and_retry)
     {
-      result = ssl::dtls::detail::engine::want_output;
+      result = engine_base::want_output;
     }
 
-    if(result == ssl::dtls::detail::engine::want_output)
+    if(result == engine_base::want_output)
     {
       // This is not what we transfered, but allows to indicate a wrong cookie
       bytes_transferred = 0;
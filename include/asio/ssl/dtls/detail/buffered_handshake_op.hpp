@@ -17,7 +17,10 @@
 
 #include "asio/detail/config.hpp"
 
-#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/stream_base.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
 
 #include "asio/detail/push_options.hpp"
 
@@ -38,7 +41,8 @@ public:
   {
   }
 
-  engine::want operator()(engine& eng,
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
       asio::error_code& ec,
       std::size_t& bytes_transferred) const
   {
@@ -56,8 +60,8 @@ public:
   }
 
 private:
-  template <typename Iterator>
-  engine::want process(engine& eng,
+  template <typename Engine, typename Iterator>
+  engine_base::want process(Engine& eng,
       asio::error_code& ec,
       std::size_t& bytes_transferred,
       Iterator begin, Iterator end) const
@@ -67,8 +71,8 @@ private:
 
     for (;;)
     {
-      engine::want want = eng.handshake(type_, ec);
-      if (want != engine::want_input_and_retry
+      engine_base::want want = eng.handshake(type_, ec);
+      if (want != engine_base::want_input_and_retry
           || bytes_transferred == total_buffer_size_)
         return want;
 
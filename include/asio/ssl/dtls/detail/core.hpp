@@ -17,13 +17,31 @@
 
 #include "asio/detail/config.hpp"
 
-#if defined(ASIO_HAS_BOOST_DATE_TIME)
-# include "asio/deadline_timer.hpp"
-#else // defined(ASIO_HAS_BOOST_DATE_TIME)
-# include "asio/steady_timer.hpp"
-#endif // defined(ASIO_HAS_BOOST_DATE_TIME)
+#include <atomic>
+#include "asio/ssl/dtls/detail/crypto_pipeline.hpp"
+#include "asio/ssl/dtls/detail/deadline.hpp"
 #include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/ssl/dtls/detail/path_mtu.hpp"
+#include "asio/ssl/dtls/detail/pending_queue.hpp"
+#include "asio/ssl/dtls/detail/send_queue.hpp"
+#include "asio/ssl/dtls/buffer_pool.hpp"
+#include "asio/ssl/dtls/io_context_pool.hpp"
 #include "asio/buffer.hpp"
+#include "asio/any_io_executor.hpp"
+#include "asio/basic_waitable_timer.hpp"
+#include "asio/detail/memory.hpp"
+#include "asio/detail/scoped_ptr.hpp"
+#include "asio/detail/type_traits.hpp"
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/steady_timer.hpp"
+#include "asio/version.hpp"
+
+// Cancellation slots, and the any_io_executor default of the transports,
+// are needed by the socket's operations.
+#if defined(ASIO_VERSION) && (ASIO_VERSION < 101900)
+# error Asio 1.19 or later is required.
+#endif // defined(ASIO_VERSION) && (ASIO_VERSION < 101900)
 
 #include "asio/detail/push_options.hpp"
 
@@ -32,100 +50,355 @@ namespace ssl {
 namespace dtls {
 namespace detail {
 
-struct core
+// The state shared by a socket's operations. The engine is a policy that
+// protects records, see engine_base. The operations, including those of the
+// timers, run on the executor of the socket's transport.
+template <typename Engine, typename Executor>
+struct basic_core
 {
+  typedef Engine engine_type;
+
+  typedef Executor executor_type;
+
+  typedef pending_queue<Executor> queue_type;
+
+  typedef asio::basic_waitable_timer<asio::chrono::steady_clock,
+      asio::wait_traits<asio::chrono::steady_clock>, Executor> timer_type;
+
+  typedef operation_deadline<Executor> deadline_type;
+
   // According to the OpenSSL documentation, this is the buffer size that is
   // sufficient to hold the largest possible TLS record.
   enum { max_tls_record_size = 17 * 1024 };
 
-  core(SSL_CTX* context, asio::io_context& io_context)
+  basic_core(SSL_CTX* context, const Executor& executor)
     : engine_(context),
-      pending_read_(io_context),
-      pending_write_(io_context),
+      executor_(executor),
+      pending_read_(executor),
+      pending_write_(executor),
       output_buffer_space_(max_tls_record_size),
       output_buffer_(asio::buffer(output_buffer_space_)),
-      input_buffer_space_(max_tls_record_size),
-      input_buffer_(asio::buffer(input_buffer_space_))
+      receive_pool_(0),
+      retransmit_armed_(false),
+      path_mtu_(0),
+      heartbeat_interval_(asio::steady_timer::duration::zero()),
+      send_queue_(0),
+      io_context_pool_(0),
+      placed_io_context_(0),
+      owned_send_failures_(0)
   {
-    pending_read_.expires_at(neg_infin());
-    pending_write_.expires_at(neg_infin());
   }
 
-  ~core()
+#if defined(ASIO_HAS_MOVE)
+  // The buffers refer to the vectors' storage, which is carried over by the
+  // vector move, so they stay valid in the new object.
+  basic_core(basic_core&& other)
+    : engine_(ASIO_MOVE_CAST(Engine)(other.engine_)),
+      executor_(other.executor_),
+      pending_read_(ASIO_MOVE_CAST(queue_type)(other.pending_read_)),
+      pending_write_(ASIO_MOVE_CAST(queue_type)(other.pending_write_)),
+      output_buffer_space_(
+          ASIO_MOVE_CAST(std::vector<unsigned char>)(
+            other.output_buffer_space_)),
+      output_buffer_(other.output_buffer_),
+      input_buffer_space_(
+          ASIO_MOVE_CAST(std::vector<unsigned char>)(
+            other.input_buffer_space_)),
+      input_buffer_(other.input_buffer_),
+      input_(other.input_),
+      receive_pool_(other.receive_pool_),
+      input_lease_(ASIO_MOVE_CAST(buffer_lease)(other.input_lease_)),
+      retransmit_deadline_(other.retransmit_deadline_.release()),
+      retransmit_armed_(other.retransmit_armed_),
+      path_mtu_(other.path_mtu_),
+      heartbeat_timer_(other.heartbeat_timer_.release()),
+      heartbeat_interval_(other.heartbeat_interval_),
+      send_queue_(other.send_queue_.load(std::memory_order_relaxed)),
+      send_queue_owner_(
+          ASIO_MOVE_CAST(asio::detail::shared_ptr<send_queue>)(
+            other.send_queue_owner_)),
+      crypto_pipeline_(other.crypto_pipeline_.release()),
+      io_context_pool_(other.io_context_pool_),
+      placed_io_context_(other.placed_io_context_),
+      receive_deadline_(other.receive_deadline_.release()),
+      send_deadline_(other.send_deadline_.release()),
+      owned_send_failures_(other.owned_send_failures_)
   {
+    other.output_buffer_ = asio::mutable_buffer();
+    other.input_buffer_ = asio::mutable_buffer();
+    other.input_ = asio::const_buffer();
+    other.send_queue_.store(0, std::memory_order_relaxed);
+    other.io_context_pool_ = 0;
+    other.placed_io_context_ = 0;
   }
 
-  // The SSL engine.
-  engine engine_;
+  basic_core& operator=(basic_core&& other)
+  {
+    if (this != &other)
+    {
+      if (io_context_pool_)
+        io_context_pool_->release(*placed_io_context_);
+      engine_ = ASIO_MOVE_CAST(Engine)(other.engine_);
+      executor_ = other.executor_;
+      pending_read_ = ASIO_MOVE_CAST(queue_type)(other.pending_read_);
+      pending_write_ = ASIO_MOVE_CAST(queue_type)(other.pending_write_);
+      output_buffer_space_ = ASIO_MOVE_CAST(std::vector<unsigned char>)(
+          other.output_buffer_space_);
+      output_buffer_ = other.output_buffer_;
+      input_buffer_space_ = ASIO_MOVE_CAST(std::vector<unsigned char>)(
+          other.input_buffer_space_);
+      input_buffer_ = other.input_buffer_;
+      input_ = other.input_;
+      receive_pool_ = other.receive_pool_;
+      input_lease_ = ASIO_MOVE_CAST(buffer_lease)(other.input_lease_);
+      retransmit_deadline_.reset(other.retransmit_deadline_.release());
+      retransmit_armed_ = other.retransmit_armed_;
+      path_mtu_ = other.path_mtu_;
+      heartbeat_timer_.reset(other.heartbeat_timer_.release());
+      heartbeat_interval_ = other.heartbeat_interval_;
+      send_queue_.store(other.send_queue_.load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+      other.send_queue_.store(0, std::memory_order_relaxed);
+      send_queue_owner_ = ASIO_MOVE_CAST(asio::detail::shared_ptr<send_queue>)(
+          other.send_queue_owner_);
+      crypto_pipeline_.reset(other.crypto_pipeline_.release());
+      io_context_pool_ = other.io_context_pool_;
+      other.io_context_pool_ = 0;
+      placed_io_context_ = other.placed_io_context_;
+      other.placed_io_context_ = 0;
+      receive_deadline_.reset(other.receive_deadline_.release());
+      send_deadline_.reset(other.send_deadline_.release());
+      owned_send_failures_ = other.owned_send_failures_;
+      other.output_buffer_ = asio::mutable_buffer();
+      other.input_buffer_ = asio::mutable_buffer();
+      other.input_ = asio::const_buffer();
+    }
+    return *this;
+  }
+#endif // defined(ASIO_HAS_MOVE)
 
-#if defined(ASIO_HAS_BOOST_DATE_TIME)
-  // Timer used for storing queued read operations.
-  asio::deadline_timer pending_read_;
+  ~basic_core()
+  {
+    if (io_context_pool_)
+      io_context_pool_->release(*placed_io_context_);
+  }
 
-  // Timer used for storing queued write operations.
-  asio::deadline_timer pending_write_;
+  // Move the core's operations to an io_context chosen by a pool. Only valid
+  // while no operation is pending. Returns the chosen io_context, or null if
+  // the pool is empty or the executor cannot be made from the executor of an
+  // io_context, in which case the core stays where it is.
+  asio::io_context* place(io_context_pool& pool)
+  {
+    return place(pool,
+        is_constructible<Executor, asio::io_context::executor_type>());
+  }
 
-  // Helper function for obtaining a time value that always fires.
-  static asio::deadline_timer::time_type neg_infin()
+  asio::io_context* place(io_context_pool&, false_type)
   {
-    return boost::posix_time::neg_infin;
+    return 0;
   }
 
-  // Helper function for obtaining a time value that never fires.
-  static asio::deadline_timer::time_type pos_infin()
+  asio::io_context* place(io_context_pool& pool, true_type)
   {
-    return boost::posix_time::pos_infin;
+    asio::io_context* io_context = pool.place();
+    if (!io_context)
+      return 0;
+
+    if (io_context_pool_)
+      io_context_pool_->release(*placed_io_context_);
+    io_context_pool_ = &pool;
+    placed_io_context_ = io_context;
+
+    executor_ = Executor(io_context->get_executor());
+    pending_read_ = queue_type(executor_);
+    pending_write_ = queue_type(executor_);
+    retransmit_deadline_.reset();
+    heartbeat_timer_.reset();
+    receive_deadline_.reset();
+    send_deadline_.reset();
+    return io_context;
+  }
+
+  // Get the buffer to receive the next datagram into. With a receive pool,
+  // a new block is leased unless no other lease is left on the current one;
+  // otherwise the core's own buffer is allocated on first use. Only called
+  // once the engine has consumed all input.
+  asio::mutable_buffer receive_buffer()
+  {
+    if (receive_pool_)
+    {
+      if (!input_lease_.unique())
+      {
+        input_lease_ = receive_pool_->acquire();
+        input_buffer_ = input_lease_.data();
+      }
+    }
+    else if (input_buffer_.size() == 0 || !input_lease_.empty())
+    {
+      if (input_buffer_space_.empty())
+        input_buffer_space_.resize(max_tls_record_size);
+      input_lease_ = buffer_lease();
+      input_buffer_ = asio::buffer(input_buffer_space_);
+    }
+
+    return input_buffer_;
   }
 
-  // Helper function to get a timer's expiry time.
-  static asio::deadline_timer::time_type expiry(
-      const asio::deadline_timer& timer)
+  // The deadline of receives and handshakes, created on first use.
+  deadline_type& receive_deadline()
   {
-    return timer.expires_at();
+    if (!receive_deadline_.get())
+      receive_deadline_.reset(new deadline_type(executor_));
+    return *receive_deadline_;
   }
-#else // defined(ASIO_HAS_BOOST_DATE_TIME)
-  // Timer used for storing queued read operations.
-  asio::steady_timer pending_read_;
 
-  // Timer used for storing queued write operations.
-  asio::steady_timer pending_write_;
+  // The deadline of sends, created on first use.
+  deadline_type& send_deadline()
+  {
+    if (!send_deadline_.get())
+      send_deadline_.reset(new deadline_type(executor_));
+    return *send_deadline_;
+  }
 
-  // Helper function for obtaining a time value that always fires.
-  static asio::steady_timer::time_point neg_infin()
+  // The deadline interrupting a handshake receive when a retransmission is
+  // due, created on first use.
+  deadline_type& retransmit_deadline()
   {
-    return (asio::steady_timer::time_point::min)();
+    if (!retransmit_deadline_.get())
+      retransmit_deadline_.reset(new deadline_type(executor_));
+    return *retransmit_deadline_;
   }
 
-  // Helper function for obtaining a time value that never fires.
-  static asio::steady_timer::time_point pos_infin()
+  // The timer between heartbeat requests, created on first use.
+  timer_type& heartbeat_timer()
   {
-    return (asio::steady_timer::time_point::max)();
+    if (!heartbeat_timer_.get())
+      heartbeat_timer_.reset(new timer_type(executor_));
+    return *heartbeat_timer_;
   }
 
-  // Helper function to get a timer's expiry time.
-  static asio::steady_timer::time_point expiry(
-      const asio::steady_timer& timer)
+  // Called when a receive started by async_datagram_receive_timeout
+  // completes. Returns true if the retransmission timer interrupted it.
+  bool retransmit_expired(const asio::error_code& ec)
   {
-    return timer.expiry();
+    if (!retransmit_armed_)
+      return false;
+
+    retransmit_armed_ = false;
+    return retransmit_deadline_->disarm()
+      && ec == asio::error::operation_aborted;
   }
-#endif // defined(ASIO_HAS_BOOST_DATE_TIME)
+
+  // Set the engine's MTU to the current path MTU, if path MTU discovery is
+  // enabled.
+  asio::error_code update_path_mtu(asio::error_code& ec)
+  {
+    ec = asio::error_code();
+    if (!path_mtu_)
+      return ec;
+
+    std::size_t mtu = path_mtu_->query(ec);
+    if (!ec && !engine_.set_mtu(static_cast<int>(mtu)))
+      ec = asio::error::invalid_argument;
+    return ec;
+  }
+
+  // Called when a send to the transport fails. If the datagram was too big
+  // for the path, the MTU is lowered to the one the transport now reports.
+  // With @c retransmit set a handshake flight is then treated as lost, so
+  // that it is resent in smaller fragments when its timer expires.
+  void path_mtu_exceeded(asio::error_code& ec, bool retransmit)
+  {
+    if (ec != asio::error::message_size || !path_mtu_)
+      return;
+
+    asio::error_code update_ec;
+    update_path_mtu(update_ec);
+    if (!update_ec && retransmit && engine_.in_handshake())
+      ec = asio::error_code();
+  }
+
+  // The SSL engine.
+  Engine engine_;
+
+  // The executor running the transport's operations.
+  Executor executor_;
+
+  // Queue of operations waiting to read from the transport.
+  queue_type pending_read_;
+
+  // Queue of operations waiting to write to the transport.
+  queue_type pending_write_;
 
   // Buffer space used to prepare output intended for the transport.
   std::vector<unsigned char> output_buffer_space_;
 
   // A buffer that may be used to prepare output intended for the transport.
-  const asio::mutable_buffer output_buffer_;
+  asio::mutable_buffer output_buffer_;
 
-  // Buffer space used to read input intended for the engine.
+  // Buffer space used to read input intended for the engine, unless a
+  // receive pool is set. Allocated by receive_buffer().
   std::vector<unsigned char> input_buffer_space_;
 
   // A buffer that may be used to read input intended for the engine.
-  const asio::mutable_buffer input_buffer_;
+  asio::mutable_buffer input_buffer_;
 
   // The buffer pointing to the engine's unconsumed input.
   asio::const_buffer input_;
+
+  // The pool whose blocks input is read into, if set.
+  buffer_pool* receive_pool_;
+
+  // The block of the receive pool holding the input. Lease receives share
+  // it, so that their plaintext stays where it was opened.
+  buffer_lease input_lease_;
+
+  // Interrupts a handshake receive when a retransmission is due, by
+  // cancelling only that receive. Allocated separately, as the cancellation
+  // signal cannot be moved.
+  asio::detail::scoped_ptr<deadline_type> retransmit_deadline_;
+
+  // Whether the deadline is armed for the current receive.
+  bool retransmit_armed_;
+
+  // Set while path MTU discovery is enabled.
+  path_mtu_base* path_mtu_;
+
+  // Timer between heartbeat requests, once heartbeats have been started.
+  asio::detail::scoped_ptr<timer_type> heartbeat_timer_;
+
+  // The time between heartbeat requests, zero once they are cancelled.
+  asio::steady_timer::duration heartbeat_interval_;
+
+  // Messages queued for sending from any thread, once queue_send() has been
+  // used. Allocated separately, as the queue cannot be moved, and shared
+  // with its drain. The pointer is published atomically, as the queue may be
+  // created by any thread; the owner is only touched by the one creating it
+  // and on the socket's executor.
+  std::atomic<send_queue*> send_queue_;
+  asio::detail::shared_ptr<send_queue> send_queue_owner_;
+
+  // Opens and seals records on worker threads, if enabled.
+  asio::detail::scoped_ptr<crypto_pipeline> crypto_pipeline_;
+
+  // The pool that placed the core on its io_context, if any.
+  io_context_pool* io_context_pool_;
+
+  // The io_context chosen by the pool.
+  asio::io_context* placed_io_context_;
+
+  // Deadlines of the operations given one. Allocated separately, as the
+  // cancellation signal cannot be moved.
+  asio::detail::scoped_ptr<deadline_type> receive_deadline_;
+  asio::detail::scoped_ptr<deadline_type> send_deadline_;
+
+  // The number of owned sends without a handler that failed.
+  std::size_t owned_send_failures_;
 };
 
+// The core of sockets using OpenSSL on the default executor of a transport.
+typedef basic_core<engine, asio::any_io_executor> core;
+
 } // namespace detail
 } // namespace dtls
 } // namespace ssl
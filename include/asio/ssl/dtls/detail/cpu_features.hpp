@@ -0,0 +1,73 @@
+//
+// ssl/dtls/detail/cpu_features.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_CPU_FEATURES_HPP
+#define ASIO_SSL_DTLS_DETAIL_CPU_FEATURES_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#if defined(__i386__) || defined(__x86_64__) \
+  || defined(_M_IX86) || defined(_M_X64)
+# define ASIO_DTLS_X86_CPU 1
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# else // defined(_MSC_VER)
+#  include <cpuid.h>
+# endif // defined(_MSC_VER)
+#elif defined(__aarch64__) && defined(__linux__)
+# define ASIO_DTLS_AARCH64_LINUX_CPU 1
+# include <sys/auxv.h>
+# include <asm/hwcap.h>
+#endif
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Whether the CPU has AES instructions, in which case AES-GCM outperforms
+// ChaCha20-Poly1305. Also requires carry-less multiplication on x86, which
+// GHASH depends on.
+inline bool has_hardware_aes()
+{
+#if defined(ASIO_DTLS_X86_CPU)
+# if defined(_MSC_VER)
+  int info[4] = { 0, 0, 0, 0 };
+  __cpuid(info, 1);
+  unsigned int ecx = static_cast<unsigned int>(info[2]);
+# else // defined(_MSC_VER)
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+# endif // defined(_MSC_VER)
+  const unsigned int aesni = 1u << 25;
+  const unsigned int pclmulqdq = 1u << 1;
+  return (ecx & aesni) != 0 && (ecx & pclmulqdq) != 0;
+#elif defined(ASIO_DTLS_AARCH64_LINUX_CPU)
+  return (::getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(__APPLE__) && defined(__aarch64__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_CPU_FEATURES_HPP
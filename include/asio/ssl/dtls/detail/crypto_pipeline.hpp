@@ -0,0 +1,460 @@
+//
+// ssl/dtls/detail/crypto_pipeline.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_CRYPTO_PIPELINE_HPP
+#define ASIO_SSL_DTLS_DETAIL_CRYPTO_PIPELINE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <vector>
+#include "asio/buffer.hpp"
+#include "asio/detail/cstdint.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/error.hpp"
+#include "asio/error_code.hpp"
+#include "asio/post.hpp"
+#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+#include "asio/ssl/dtls/detail/record_layer.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Work done on a worker of a crypto pipeline. Once it is done, its owner is
+// notified on the socket's executor.
+class crypto_job
+  : private noncopyable
+{
+public:
+  crypto_job()
+    : complete_(0),
+      owner_(0),
+      executor_(0),
+      post_(0)
+  {
+  }
+
+  virtual ~crypto_job()
+  {
+  }
+
+  // Called on the worker.
+  void run()
+  {
+    perform();
+    post_(executor_, this);
+  }
+
+  // Set by the owner before the job is posted. The executor must stay valid
+  // until the job has completed.
+  template <typename Executor>
+  void complete_on(const Executor& executor)
+  {
+    executor_ = &executor;
+    post_ = &crypto_job::post_completion<Executor>;
+  }
+
+  void (*complete_)(void* owner, crypto_job* job);
+  void* owner_;
+
+protected:
+  virtual void perform() = 0;
+
+private:
+  template <typename Executor>
+  static void post_completion(const void* executor, crypto_job* job)
+  {
+    asio::post(*static_cast<const Executor*>(executor), completion(job));
+  }
+
+  const void* executor_;
+  void (*post_)(const void* executor, crypto_job* job);
+
+  struct completion
+  {
+    explicit completion(crypto_job* job)
+      : job_(job)
+    {
+    }
+
+    void operator()()
+    {
+      job_->complete_(job_->owner_, job_);
+    }
+
+    crypto_job* job_;
+  };
+};
+
+// Opens the records of a received datagram.
+class open_job : public crypto_job
+{
+public:
+  struct record
+  {
+    unsigned char content_type;
+    uint64_t seq;
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  open_job(const record_layer& layer, EVP_CIPHER_CTX* ctx)
+    : size_(0),
+      done_(false),
+      layer_(&layer),
+      ctx_(ctx),
+      datagram_(17 * 1024)
+  {
+  }
+
+  ~open_job()
+  {
+    ::EVP_CIPHER_CTX_free(ctx_);
+  }
+
+  // The buffer to receive the datagram into.
+  asio::mutable_buffer buffer()
+  {
+    return asio::buffer(datagram_);
+  }
+
+  // The records that were opened, in the order they appear in the datagram.
+  const std::vector<record>& records() const
+  {
+    return records_;
+  }
+
+  asio::const_buffer plaintext(const record& r) const
+  {
+    return asio::buffer(asio::buffer(plaintext_) + r.offset, r.length);
+  }
+
+  // The length of the received datagram, and whether its records have
+  // been opened.
+  std::size_t size_;
+  bool done_;
+
+private:
+  void perform()
+  {
+    // Records that fail to open are dropped, as is the rest of a malformed
+    // datagram.
+    records_.clear();
+    plaintext_.resize(size_);
+    asio::const_buffer rest(asio::buffer(datagram_, size_));
+    std::size_t offset = 0;
+    while (std::size_t length = layer_->received_record_length(rest))
+    {
+      record r = { 0, 0, offset, 0 };
+      if (layer_->open_detached(ctx_, asio::buffer(rest, length),
+            asio::buffer(plaintext_) + offset,
+            r.content_type, r.length, r.seq))
+      {
+        records_.push_back(r);
+        offset += r.length;
+      }
+      rest = rest + length;
+    }
+  }
+
+  const record_layer* layer_;
+  EVP_CIPHER_CTX* ctx_;
+  std::vector<unsigned char> datagram_;
+  std::vector<unsigned char> plaintext_;
+  std::vector<record> records_;
+};
+
+// Seals a part of the send queue's batch into records with sequence numbers
+// reserved beforehand.
+class seal_job : public crypto_job
+{
+public:
+  seal_job(const record_layer& layer, EVP_CIPHER_CTX* ctx)
+    : first_seq_(0),
+      failures_(0),
+      layer_(&layer),
+      ctx_(ctx)
+  {
+  }
+
+  ~seal_job()
+  {
+    ::EVP_CIPHER_CTX_free(ctx_);
+  }
+
+  // The payloads to seal, and the sequence number of the first one.
+  std::vector<asio::const_buffer> payloads_;
+  uint64_t first_seq_;
+
+  // The sealed records, and the number of payloads that failed to seal.
+  std::vector<asio::mutable_buffer> records_;
+  std::size_t failures_;
+
+  // Hand over the memory holding the records, as it may still be referred
+  // to by the engine.
+  void retire(std::vector<std::vector<unsigned char> >& retired)
+  {
+    retired.push_back(std::vector<unsigned char>());
+    retired.back().swap(output_);
+    records_.clear();
+  }
+
+private:
+  void perform()
+  {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < payloads_.size(); ++i)
+      total += layer_->headroom() + payloads_[i].size() + layer_->tailroom();
+    output_.resize(total);
+
+    records_.clear();
+    failures_ = 0;
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < payloads_.size(); ++i)
+    {
+      asio::error_code ec;
+      std::size_t length = layer_->seal_detached(ctx_,
+          record_layer::application_data, payloads_[i],
+          asio::buffer(output_) + offset, first_seq_ + i, ec);
+      if (ec)
+      {
+        ++failures_;
+        continue;
+      }
+
+      records_.push_back(asio::buffer(&output_[0] + offset, length));
+      offset += length;
+    }
+  }
+
+  const record_layer* layer_;
+  EVP_CIPHER_CTX* ctx_;
+  std::vector<unsigned char> output_;
+};
+
+// Runs crypto jobs on an executor.
+class crypto_executor_base
+{
+public:
+  virtual ~crypto_executor_base()
+  {
+  }
+
+  virtual void post(crypto_job& job) = 0;
+};
+
+template <typename Executor>
+class crypto_executor : public crypto_executor_base
+{
+public:
+  explicit crypto_executor(const Executor& executor)
+    : executor_(executor)
+  {
+  }
+
+  virtual void post(crypto_job& job)
+  {
+    asio::post(executor_, runner(job));
+  }
+
+private:
+  struct runner
+  {
+    explicit runner(crypto_job& job)
+      : job_(&job)
+    {
+    }
+
+    void operator()()
+    {
+      job_->run();
+    }
+
+    crypto_job* job_;
+  };
+
+  Executor executor_;
+};
+
+// Opens and seals the records of a session on worker threads. Each job has
+// its own copy of the record layer's cipher contexts, so that up to depth
+// datagrams are opened, and up to depth parts of a send batch sealed, at the
+// same time. Only the cryptography runs on the workers; replay protection,
+// sequence numbers and the delivery of records stay on the socket's
+// executor, in the order the datagrams were received or queued.
+class crypto_pipeline
+  : private noncopyable
+{
+public:
+  enum
+  {
+    // The most records sealed in one round. Records sent by other operations
+    // while a round is being sealed carry higher sequence numbers but may go
+    // out first, so a round has to fit well into the peer's replay window of
+    // 64 records.
+    max_sealed_records = 32
+  };
+
+  crypto_pipeline(crypto_executor_base* executor, std::size_t depth)
+    : seals_pending_(0),
+      seal_jobs_used_(0),
+      executor_(executor),
+      depth_(depth),
+      layer_(0)
+  {
+  }
+
+  ~crypto_pipeline()
+  {
+    clear();
+    delete executor_;
+  }
+
+  // Create the jobs for the record layer once it is active. Returns false
+  // if its cipher contexts cannot be copied.
+  bool prepare(const record_layer& layer)
+  {
+    if (layer_ == &layer)
+      return true;
+
+    clear();
+    for (std::size_t i = 0; i < depth_; ++i)
+    {
+      EVP_CIPHER_CTX* open_ctx = layer.new_open_context();
+      EVP_CIPHER_CTX* seal_ctx = layer.new_seal_context();
+      if (!open_ctx || !seal_ctx)
+      {
+        ::EVP_CIPHER_CTX_free(open_ctx);
+        ::EVP_CIPHER_CTX_free(seal_ctx);
+        clear();
+        return false;
+      }
+      open_jobs_.push_back(new open_job(layer, open_ctx));
+      seal_jobs_.push_back(new seal_job(layer, seal_ctx));
+    }
+
+    layer_ = &layer;
+    return true;
+  }
+
+  std::size_t depth() const
+  {
+    return depth_;
+  }
+
+  open_job& open(std::size_t index)
+  {
+    return *open_jobs_[index % depth_];
+  }
+
+  seal_job& seal(std::size_t index)
+  {
+    return *seal_jobs_[index];
+  }
+
+  void post(crypto_job& job)
+  {
+    executor_->post(job);
+  }
+
+  // Release the sealed records of the last round once it has been sent. The
+  // records of a failed round are kept until a later round has been sent,
+  // as the engine may still refer to them.
+  void release_seals(bool failed)
+  {
+    if (failed)
+    {
+      for (std::size_t i = 0; i < seal_jobs_used_; ++i)
+        seal_jobs_[i]->retire(retired_);
+    }
+    else
+      retired_.clear();
+    seal_jobs_used_ = 0;
+  }
+
+  // The number of seal jobs still running, and the number used by the
+  // current round. Owned by the send queue's drain.
+  std::size_t seals_pending_;
+  std::size_t seal_jobs_used_;
+
+private:
+  void clear()
+  {
+    for (std::size_t i = 0; i < open_jobs_.size(); ++i)
+      delete open_jobs_[i];
+    for (std::size_t i = 0; i < seal_jobs_.size(); ++i)
+      delete seal_jobs_[i];
+    open_jobs_.clear();
+    seal_jobs_.clear();
+    layer_ = 0;
+  }
+
+  crypto_executor_base* executor_;
+  std::size_t depth_;
+  const record_layer* layer_;
+  std::vector<open_job*> open_jobs_;
+  std::vector<seal_job*> seal_jobs_;
+  std::vector<std::vector<unsigned char> > retired_;
+};
+
+// Only sessions using OpenSSL have a record layer that can be pipelined.
+inline record_layer* pipeline_record_layer(engine& eng)
+{
+  return eng.active_record_layer();
+}
+
+template <typename Engine>
+inline record_layer* pipeline_record_layer(Engine&)
+{
+  return 0;
+}
+
+inline engine_base::want pipeline_accept_record(engine& eng,
+    const open_job& job, const open_job::record& r, asio::error_code& ec)
+{
+  return eng.accept_record(r.content_type, r.seq, job.plaintext(r), ec);
+}
+
+template <typename Engine>
+inline engine_base::want pipeline_accept_record(Engine&,
+    const open_job&, const open_job::record&, asio::error_code& ec)
+{
+  ec = asio::error::operation_not_supported;
+  return engine_base::want_nothing;
+}
+
+inline engine_base::want pipeline_write_sealed(engine& eng,
+    const asio::mutable_buffer& record, asio::error_code& ec)
+{
+  return eng.write_sealed(record, ec);
+}
+
+template <typename Engine>
+inline engine_base::want pipeline_write_sealed(Engine&,
+    const asio::mutable_buffer&, asio::error_code& ec)
+{
+  ec = asio::error::operation_not_supported;
+  return engine_base::want_nothing;
+}
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_CRYPTO_PIPELINE_HPP
@@ -7,11 +7,16 @@
 
 #include "asio/detail/config.hpp"
 
+#include "asio/associated_allocator.hpp"
+#include "asio/associated_cancellation_slot.hpp"
+#include "asio/associated_executor.hpp"
+#include "asio/bind_cancellation_slot.hpp"
+#include "asio/detail/type_traits.hpp"
 #include "asio/error_code.hpp"
 #include "asio/steady_timer.hpp"
+#include "asio/ssl/dtls/detail/core.hpp"
 
 #include "asio/detail/push_options.hpp"
-#include <functional>
 namespace asio{
 namespace ssl{
 namespace dtls {
@@ -113,50 +118,102 @@ private:
   SocketType& socket_;
 };
 
-template <typename SocketType>
+// The callback of a receive started by async_datagram_receive_timeout. It
+// takes the forwarder out of the callback's own slot before calling it.
+template <typename CallBack>
+class retransmit_receive_handler
+{
+public:
+  explicit retransmit_receive_handler(CallBack& cb)
+    : cb_(ASIO_MOVE_CAST(CallBack)(cb))
+  {
+  }
+
+  void operator()(const asio::error_code& ec, std::size_t bytes_transferred)
+  {
+    typename associated_cancellation_slot<CallBack>::type slot =
+      asio::get_associated_cancellation_slot(cb_);
+    if (slot.is_connected())
+      slot.clear();
+
+    cb_(ec, bytes_transferred);
+  }
+
+//private:
+  CallBack cb_;
+};
+
+// Receives a datagram while the engine's retransmission timer runs. When
+// the timer expires first the receive, and nothing else on the transport, is
+// cancelled through the core's retransmission deadline, and datagram_io_op
+// lets the engine retransmit its last flight. A cancellation slot the
+// callback already has, such as that of an operation's deadline, is passed
+// on to the receive until it completes.
+template <typename SocketType, typename Core>
 class async_datagram_receive_timeout
 {
 public:
   typedef typename SocketType::message_flags message_flags;
 
-  async_datagram_receive_timeout(SocketType& socket)
+  async_datagram_receive_timeout(SocketType& socket, Core& core)
     : socket_(socket)
-    , timer_(socket.get_io_context())
-    , timeout_(new asio::steady_timer::duration(chrono::seconds(1)))
+    , core_(core)
   {
-    timer_.expires_after(asio::steady_timer::duration::max());
-  }
 
-  async_datagram_receive_timeout(const async_datagram_receive_timeout& other)
-      : socket_(other.socket_)
-      , timer_(socket_.get_io_context())
-      , timeout_(other.timeout_)
-  {
-      timer_.expires_after(asio::steady_timer::duration::max());
   }
 
   template <typename Buffer, typename CallBack>
-  void operator()(const Buffer& buffer, ASIO_MOVE_ARG(CallBack) cb)
+  void operator()(const Buffer& buffer, ASIO_MOVE_ARG(CallBack) cb) const
   {
-    socket_.async_receive(buffer, message_flags(),
-                          ASIO_MOVE_CAST(CallBack)(cb));
-
-    SocketType &socket = socket_;
-    timer_.async_wait([&socket](const asio::error_code &ec)
+    asio::steady_timer::duration timeout;
+    if (buffer.size() == 0 || !core_.engine_.retransmit_timeout(timeout))
     {
-        if(!ec)
-        {
-            socket.close();
-        }
-    });
+      socket_.async_receive(buffer, message_flags(),
+                            ASIO_MOVE_CAST(CallBack)(cb));
+      return;
+    }
+
+    // Only one receive at a time owns the read side, so the deadline is
+    // free unless an earlier receive never completed.
+    typename Core::deadline_type& deadline = core_.retransmit_deadline();
+    if (!deadline.arm(timeout))
+    {
+      socket_.async_receive(buffer, message_flags(),
+                            ASIO_MOVE_CAST(CallBack)(cb));
+      return;
+    }
+    core_.retransmit_armed_ = true;
+
+    typedef typename decay<CallBack>::type callback_type;
+    typename associated_cancellation_slot<callback_type>::type slot =
+      asio::get_associated_cancellation_slot(cb);
+    if (slot.is_connected())
+      slot.template emplace<forwarder>(&deadline);
 
-    timer_.expires_after(*timeout_);
+    socket_.async_receive(buffer, message_flags(),
+        asio::bind_cancellation_slot(deadline.slot(),
+          retransmit_receive_handler<callback_type>(cb)));
   }
 
 private:
+  // Passes the cancellation of the callback's own slot on to the receive.
+  struct forwarder
+  {
+    explicit forwarder(typename Core::deadline_type* deadline)
+      : deadline_(deadline)
+    {
+    }
+
+    void operator()(asio::cancellation_type_t type)
+    {
+      deadline_->emit(type);
+    }
+
+    typename Core::deadline_type* deadline_;
+  };
+
   SocketType& socket_;
-  asio::steady_timer timer_;
-  asio::detail::shared_ptr<asio::steady_timer::duration > timeout_;
+  Core& core_;
 };
 
 template <typename SocketType>
@@ -189,6 +246,33 @@ private:
 } // namespace detail
 } // namespace dtls
 } // namespace ssl
+
+template <typename CallBack, typename Allocator>
+struct associated_allocator<
+    ssl::dtls::detail::retransmit_receive_handler<CallBack>, Allocator>
+{
+  typedef typename associated_allocator<CallBack, Allocator>::type type;
+
+  static type get(const ssl::dtls::detail::retransmit_receive_handler<CallBack>& h,
+      const Allocator& a = Allocator()) ASIO_NOEXCEPT
+  {
+    return associated_allocator<CallBack, Allocator>::get(h.cb_, a);
+  }
+};
+
+template <typename CallBack, typename Executor>
+struct associated_executor<
+    ssl::dtls::detail::retransmit_receive_handler<CallBack>, Executor>
+{
+  typedef typename associated_executor<CallBack, Executor>::type type;
+
+  static type get(const ssl::dtls::detail::retransmit_receive_handler<CallBack>& h,
+      const Executor& ex = Executor()) ASIO_NOEXCEPT
+  {
+    return associated_executor<CallBack, Executor>::get(h.cb_, ex);
+  }
+};
+
 } // namespace asio
 
 #include "asio/detail/pop_options.hpp"
@@ -17,8 +17,11 @@
 
 #include "asio/detail/config.hpp"
 
-#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/associated_cancellation_slot.hpp"
+#include "asio/detail/bind_handler.hpp"
+#include "asio/post.hpp"
 #include "asio/ssl/dtls/detail/core.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
 #include "asio/write.hpp"
 #include "asio/socket_base.hpp"
 
@@ -29,24 +32,27 @@ namespace ssl {
 namespace dtls {
 namespace detail {
 
-template <typename ReceiveFunction, typename SendFunction, typename Operation>
+template <typename ReceiveFunction, typename SendFunction,
+          typename Core, typename Operation>
 std::size_t datagram_io(
     const ReceiveFunction& receive,
     const SendFunction& send,
-    core& core,
+    Core& core,
     const Operation& op,
     asio::error_code& ec)
 {
   std::size_t bytes_transferred = 0;
   do switch (op(core.engine_, ec, bytes_transferred))
   {
-  case engine::want_input_and_retry:
+  case engine_base::want_input_and_retry:
 
     // If the input buffer is empty then we need to read some more data from
     // the underlying transport.
     if (core.input_.size() == 0)
-      core.input_ = asio::buffer(core.input_buffer_,
-          receive(core.input_buffer_, ec));
+    {
+      asio::mutable_buffer buffer = core.receive_buffer();
+      core.input_ = asio::buffer(buffer, receive(buffer, ec));
+    }
 
     // Pass the new input data to the engine.
     core.input_ = core.engine_.put_input(core.input_);
@@ -54,20 +60,35 @@ std::size_t datagram_io(
     // Try the operation again.
     continue;
 
-  case engine::want_output_and_retry:
+  case engine_base::want_private_key_and_retry:
+
+    // Wait for the private key operation, or perform it here if its worker
+    // has not started it, then try the operation again.
+    core.engine_.pending_private_key_operation()->wait();
+    continue;
+
+  case engine_base::want_output_and_retry:
 
     // Get output data from the engine and write it to the underlying
-    // transport.
-    send(core.engine_.get_output(core.output_buffer_), ec);
+    // transport, one datagram at a time.
+    do
+    {
+      send(core.engine_.get_output(core.output_buffer_), ec);
+      core.path_mtu_exceeded(ec, false);
+    } while (!ec && core.engine_.output_pending());
 
     // Try the operation again.
     continue;
 
-  case engine::want_output:
+  case engine_base::want_output:
 
     // Get output data from the engine and write it to the underlying
-    // transport.
-    send(core.engine_.get_output(core.output_buffer_), ec);
+    // transport, one datagram at a time.
+    do
+    {
+      send(core.engine_.get_output(core.output_buffer_), ec);
+      core.path_mtu_exceeded(ec, false);
+    } while (!ec && core.engine_.output_pending());
 
     // Operation is complete. Return result to caller.
     core.engine_.map_error_code(ec);
@@ -87,21 +108,24 @@ std::size_t datagram_io(
 }
 
 template <typename ReceiveFunction, typename SendFunction,
-          typename Operation, typename Handler>
+          typename Core, typename Operation, typename Handler>
 class datagram_io_op
 {
 public:
   datagram_io_op(
       const ReceiveFunction& receive,
       const SendFunction& send,
-      core& core,
+      Core& core,
       const Operation& op, Handler& handler)
     : receive_function_(receive),
       send_function_(send),
       core_(core),
       op_(op),
       start_(0),
-      want_(engine::want_nothing),
+      want_(engine_base::want_nothing),
+      owns_read_(false),
+      owns_write_(false),
+      retransmit_(false),
       bytes_transferred_(0),
       handler_(ASIO_MOVE_CAST(Handler)(handler))
   {
@@ -115,6 +139,9 @@ public:
       op_(other.op_),
       start_(other.start_),
       want_(other.want_),
+      owns_read_(other.owns_read_),
+      owns_write_(other.owns_write_),
+      retransmit_(other.retransmit_),
       ec_(other.ec_),
       bytes_transferred_(other.bytes_transferred_),
       handler_(other.handler_)
@@ -125,9 +152,12 @@ public:
     : receive_function_(other.receive_function_),
       send_function_(other.send_function_),
       core_(other.core_),
-      op_(other.op_),
+      op_(ASIO_MOVE_CAST(Operation)(other.op_)),
       start_(other.start_),
       want_(other.want_),
+      owns_read_(other.owns_read_),
+      owns_write_(other.owns_write_),
+      retransmit_(other.retransmit_),
       ec_(other.ec_),
       bytes_transferred_(other.bytes_transferred_),
       handler_(ASIO_MOVE_CAST(Handler)(other.handler_))
@@ -135,17 +165,61 @@ public:
   }
 #endif // defined(ASIO_HAS_MOVE)
 
+  // Called by a pending_queue once ownership of it has been handed over, or
+  // by the private key operation once it has completed. Either fails with
+  // operation_aborted if the op was cancelled while parked.
+  void operator()(const asio::error_code& ec)
+  {
+    typename associated_cancellation_slot<Handler>::type slot =
+      asio::get_associated_cancellation_slot(handler_);
+    if (slot.is_connected())
+      slot.clear();
+
+    if (ec)
+    {
+      release_read();
+      release_write();
+      op_.call_handler(handler_, ec, 0);
+    }
+    else if (want_ == engine_base::want_private_key_and_retry)
+    {
+      // The private key operation has completed, retry the operation.
+      (*this)(asio::error_code(), ~std::size_t(0));
+    }
+    else if (want_ == engine_base::want_input_and_retry)
+    {
+      owns_read_ = true;
+
+      // Retry the operation, the previous reader may already have passed
+      // everything we need to the engine.
+      (*this)(asio::error_code(), ~std::size_t(0));
+    }
+    else
+    {
+      owns_write_ = true;
+
+      // Our output may already have been flushed by the previous writer, in
+      // which case there is nothing left to send.
+      asio::mutable_buffer output =
+        core_.engine_.get_output(core_.output_buffer_);
+      if (output.size() != 0)
+        send_function_(output, ASIO_MOVE_CAST(datagram_io_op)(*this));
+      else
+        (*this)(asio::error_code(), 0);
+    }
+  }
+
   void operator()(asio::error_code ec,
-      std::size_t bytes_transferred = ~std::size_t(0), int start = 0)
+      std::size_t bytes_transferred, int start = 0)
   {
     switch (start_ = start)
     {
     case 1: // Called after at least one async operation.
       do
       {
-        switch (want_ = op_(core_.engine_, ec_, bytes_transferred_))
+        switch (want_ = perform())
         {
-        case engine::want_input_and_retry:
+        case engine_base::want_input_and_retry:
 
           // If the input buffer already has data in it we can pass it to the
           // engine and then retry the operation immediately.
@@ -157,49 +231,62 @@ public:
 
           // The engine wants more data to be read from input. However, we
           // cannot allow more than one read operation at a time on the
-          // underlying transport. The pending_read_ timer's expiry is set to
-          // pos_infin if a read is in progress, and neg_infin otherwise.
-          if (core_.expiry(core_.pending_read_) == core_.neg_infin())
+          // underlying transport. If another operation is reading, wait on
+          // the pending_read_ queue until ownership is handed to us.
+          if (!owns_read_ && !core_.pending_read_.try_acquire())
           {
-            // Prevent other read operations from being started.
-            core_.pending_read_.expires_at(core_.pos_infin());
-
-            // Start reading some data from the underlying transport.
-            receive_function_(
-                asio::buffer(core_.input_buffer_),
+            core_.pending_read_.async_wait(
                 ASIO_MOVE_CAST(datagram_io_op)(*this));
+
+            // Yield control until ownership is handed over. Control resumes
+            // in the unary operator() above.
+            return;
           }
-          else
-          {
-            // Wait until the current read operation completes.
-            core_.pending_read_.async_wait(ASIO_MOVE_CAST(datagram_io_op)(*this));
-          }
+          owns_read_ = true;
+
+          // Start reading some data from the underlying transport.
+          receive_function_(core_.receive_buffer(),
+              ASIO_MOVE_CAST(datagram_io_op)(*this));
 
           // Yield control until asynchronous operation completes. Control
           // resumes at the "default:" label below.
           return;
 
-        case engine::want_output_and_retry:
-        case engine::want_output:
+        case engine_base::want_private_key_and_retry:
+
+          // No input is needed while the private key operation runs.
+          release_read();
+
+          // Park until the private key operation has completed. Control
+          // resumes in the unary operator() above.
+          core_.engine_.pending_private_key_operation()->async_wait(
+              ASIO_MOVE_CAST(datagram_io_op)(*this), core_.executor_);
+          return;
+
+        case engine_base::want_output_and_retry:
+        case engine_base::want_output:
+
+          // No more input is needed for now, let the next reader proceed.
+          release_read();
 
           // The engine wants some data to be written to the output. However, we
           // cannot allow more than one write operation at a time on the
-          // underlying transport. The pending_write_ timer's expiry is set to
-          // pos_infin if a write is in progress, and neg_infin otherwise.
-          if (core_.expiry(core_.pending_write_) == core_.neg_infin())
+          // underlying transport. If another operation is writing, wait on
+          // the pending_write_ queue until ownership is handed to us.
+          if (!owns_write_ && !core_.pending_write_.try_acquire())
           {
-            // Prevent other write operations from being started.
-            core_.pending_write_.expires_at(core_.pos_infin());
+            core_.pending_write_.async_wait(
+                ASIO_MOVE_CAST(datagram_io_op)(*this));
 
-            // Start writing all the data to the underlying transport.
-            send_function_(core_.engine_.get_output(core_.output_buffer_),
-                                   ASIO_MOVE_CAST(datagram_io_op)(*this));
-          }
-          else
-          {
-            // Wait until the current write operation completes.
-            core_.pending_write_.async_wait(ASIO_MOVE_CAST(datagram_io_op)(*this));
+            // Yield control until ownership is handed over. Control resumes
+            // in the unary operator() above.
+            return;
           }
+          owns_write_ = true;
+
+          // Start writing all the data to the underlying transport.
+          send_function_(core_.engine_.get_output(core_.output_buffer_),
+                                 ASIO_MOVE_CAST(datagram_io_op)(*this));
 
           // Yield control until asynchronous operation completes. Control
           // resumes at the "default:" label below.
@@ -207,19 +294,22 @@ public:
 
         default:
 
+          // No more input is needed, let the next reader proceed.
+          release_read();
+
           // The SSL operation is done and we can invoke the handler, but we
           // have to keep in mind that this function might be being called from
           // the async operation's initiating function. In this case we're not
-          // allowed to call the handler directly. Instead, issue a zero-sized
-          // read so the handler runs "as-if" posted using io_context::post().
+          // allowed to call the handler directly. Instead, post it to the
+          // executor. A zero-sized read would not do here, as it waits for
+          // and consumes a datagram.
           if (start)
           {
-            receive_function_(
-                asio::buffer(core_.input_buffer_, 0),
-                ASIO_MOVE_CAST(datagram_io_op)(*this));
+            asio::post(core_.executor_, asio::detail::bind_handler(
+                  ASIO_MOVE_CAST(datagram_io_op)(*this), ec_, 0));
 
-            // Yield control until asynchronous operation completes. Control
-            // resumes at the "default:" label below.
+            // Yield control until the handler is run. Control resumes at the
+            // "default:" label below.
             return;
           }
           else
@@ -231,37 +321,67 @@ public:
 
         default:
         if (bytes_transferred == ~std::size_t(0))
-          bytes_transferred = 0; // Timer cancellation, no data transferred.
+          bytes_transferred = 0; // Resumed from a queue, no data transferred.
+        else if (want_ == engine_base::want_input_and_retry
+            && core_.retransmit_expired(ec))
+        {
+          // The retransmission timer interrupted the receive. Let the engine
+          // resend its last flight before the operation is retried.
+          retransmit_ = true;
+          continue;
+        }
         else if (!ec_)
+        {
+          // A handshake flight too big for the path is resent by the
+          // retransmission timer once the MTU has been lowered.
+          if (want_ == engine_base::want_output_and_retry
+              || want_ == engine_base::want_output)
+            core_.path_mtu_exceeded(ec, true);
           ec_ = ec;
+        }
 
         switch (want_)
         {
-        case engine::want_input_and_retry:
-
-          // Add received data to the engine's input.
-          core_.input_ = asio::buffer(
-              core_.input_buffer_, bytes_transferred);
-          core_.input_ = core_.engine_.put_input(core_.input_);
-
-          // Release any waiting read operations.
-          core_.pending_read_.expires_at(core_.neg_infin());
+        case engine_base::want_private_key_and_retry:
 
           // Try the operation again.
           continue;
 
-        case engine::want_output_and_retry:
+        case engine_base::want_input_and_retry:
 
-          // Release any waiting write operations.
-          core_.pending_write_.expires_at(core_.neg_infin());
+          // Add received data to the engine's input. The read side stays
+          // ours until the operation no longer wants input.
+          if (bytes_transferred != 0)
+          {
+            core_.input_ = asio::buffer(
+                core_.input_buffer_, bytes_transferred);
+            core_.input_ = core_.engine_.put_input(core_.input_);
+          }
 
           // Try the operation again.
           continue;
 
-        case engine::want_output:
+        case engine_base::want_output_and_retry:
+        case engine_base::want_output:
 
-          // Release any waiting write operations.
-          core_.pending_write_.expires_at(core_.neg_infin());
+          // Output larger than the MTU is sent one datagram at a time.
+          if (!ec_ && core_.engine_.output_pending())
+          {
+            send_function_(core_.engine_.get_output(core_.output_buffer_),
+                ASIO_MOVE_CAST(datagram_io_op)(*this));
+
+            // Yield control until asynchronous operation completes. Control
+            // resumes at the "default:" label above.
+            return;
+          }
+
+          // Hand the write side to the next waiting operation.
+          release_write();
+
+          // Try the operation again, or fall through to call the handler
+          // once the operation is complete.
+          if (want_ == engine_base::want_output_and_retry)
+            continue;
 
           // Fall through to call handler.
 
@@ -277,74 +397,110 @@ public:
         }
       } while (!ec_);
 
-      // Operation failed. Pass the result to the handler.
+      // Operation failed. Release the transport and pass the result to the
+      // handler.
+      release_read();
+      release_write();
       op_.call_handler(handler_, core_.engine_.map_error_code(ec_), 0);
     }
   }
 
+  // Run the operation, or the retransmission it was interrupted for.
+  engine_base::want perform()
+  {
+    if (retransmit_)
+    {
+      retransmit_ = false;
+      return core_.engine_.handle_timeout(ec_);
+    }
+
+    return op_(core_.engine_, ec_, bytes_transferred_);
+  }
+
+  void release_read()
+  {
+    if (owns_read_)
+    {
+      owns_read_ = false;
+      core_.pending_read_.release();
+    }
+  }
+
+  void release_write()
+  {
+    if (owns_write_)
+    {
+      owns_write_ = false;
+      core_.pending_write_.release();
+    }
+  }
+
 //private:
   ReceiveFunction receive_function_;
   SendFunction send_function_;
-  core& core_;
+  Core& core_;
   Operation op_;
   int start_;
-  engine::want want_;
+  engine_base::want want_;
+  bool owns_read_;
+  bool owns_write_;
+  bool retransmit_;
   asio::error_code ec_;
   std::size_t bytes_transferred_;
   Handler handler_;
 };
 
 template <typename ReceiveFunction, typename SendFunction,
-          typename Operation, typename Handler>
+          typename Core, typename Operation, typename Handler>
 inline void* asio_handler_allocate(std::size_t size,
-    datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>* this_handler)
+    datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>* this_handler)
 {
   return asio_handler_alloc_helpers::allocate(
       size, this_handler->handler_);
 }
 
 template <typename ReceiveFunction, typename SendFunction,
-          typename Operation, typename Handler>
+          typename Core, typename Operation, typename Handler>
 inline void asio_handler_deallocate(void* pointer, std::size_t size,
-    datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>* this_handler)
+    datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>* this_handler)
 {
   asio_handler_alloc_helpers::deallocate(
       pointer, size, this_handler->handler_);
 }
 
 template <typename ReceiveFunction, typename SendFunction,
-          typename Operation, typename Handler>
+          typename Core, typename Operation, typename Handler>
 inline bool asio_handler_is_continuation(
-    datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>* this_handler)
+    datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>* this_handler)
 {
   return this_handler->start_ == 0 ? true
     : asio_handler_cont_helpers::is_continuation(this_handler->handler_);
 }
 
 template <typename Function, typename ReceiveFunction, typename SendFunction,
-          typename Operation, typename Handler>
+          typename Core, typename Operation, typename Handler>
 inline void asio_handler_invoke(Function& function,
-    datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>* this_handler)
+    datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>* this_handler)
 {
   asio_handler_invoke_helpers::invoke(
       function, this_handler->handler_);
 }
 
 template <typename Function, typename ReceiveFunction, typename SendFunction,
-          typename Operation, typename Handler>
+          typename Core, typename Operation, typename Handler>
 inline void asio_handler_invoke(const Function& function,
-    datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>* this_handler)
+    datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>* this_handler)
 {
   asio_handler_invoke_helpers::invoke(
       function, this_handler->handler_);
 }
 
 template <typename ReceiveFunction, typename SendFunction,
-          typename Operation, typename Handler>
+          typename Core, typename Operation, typename Handler>
 inline void async_datagram_io(const ReceiveFunction& rf, const SendFunction& sf,
-    core& core, const Operation& op, Handler& handler)
+    Core& core, const Operation& op, Handler& handler)
 {
-  datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>(
+  datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>(
     rf, sf, core, op, handler)(
       asio::error_code(), 0, 1);
 }
@@ -353,34 +509,51 @@ inline void async_datagram_io(const ReceiveFunction& rf, const SendFunction& sf,
 } // namespace dtls
 } // namespace ssl
 
-template <typename ReceiveFunction, typename SendFunction, typename Operation,
-    typename Handler, typename Allocator>
+template <typename ReceiveFunction, typename SendFunction, typename Core,
+    typename Operation, typename Handler, typename Allocator>
 struct associated_allocator<
-    ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>, Allocator>
+    ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>, Allocator>
 {
   typedef typename associated_allocator<Handler, Allocator>::type type;
 
-  static type get(const ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>& h,
+  static type get(const ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>& h,
       const Allocator& a = Allocator()) ASIO_NOEXCEPT
   {
     return associated_allocator<Handler, Allocator>::get(h.handler_, a);
   }
 };
 
-template <typename ReceiveFunction, typename SendFunction, typename Operation,
-    typename Handler, typename Executor>
+template <typename ReceiveFunction, typename SendFunction, typename Core,
+    typename Operation, typename Handler, typename Executor>
 struct associated_executor<
-    ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>, Executor>
+    ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>, Executor>
 {
   typedef typename associated_executor<Handler, Executor>::type type;
 
-  static type get(const ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Operation, Handler>& h,
+  static type get(const ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>& h,
       const Executor& ex = Executor()) ASIO_NOEXCEPT
   {
     return associated_executor<Handler, Executor>::get(h.handler_, ex);
   }
 };
 
+// Each step on the transport is cancelled through the handler's slot.
+template <typename ReceiveFunction, typename SendFunction, typename Core,
+    typename Operation, typename Handler, typename CancellationSlot>
+struct associated_cancellation_slot<
+    ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>, CancellationSlot>
+{
+  typedef typename associated_cancellation_slot<
+    Handler, CancellationSlot>::type type;
+
+  static type get(const ssl::dtls::detail::datagram_io_op<ReceiveFunction, SendFunction, Core, Operation, Handler>& h,
+      const CancellationSlot& s = CancellationSlot()) ASIO_NOEXCEPT
+  {
+    return associated_cancellation_slot<
+      Handler, CancellationSlot>::get(h.handler_, s);
+  }
+};
+
 } // namespace asio
 
 #include "asio/detail/pop_options.hpp"
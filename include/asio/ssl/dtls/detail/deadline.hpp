@@ -0,0 +1,466 @@
+//
+// ssl/dtls/detail/deadline.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_DEADLINE_HPP
+#define ASIO_SSL_DTLS_DETAIL_DEADLINE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstddef>
+#include "asio/associated_allocator.hpp"
+#include "asio/associated_cancellation_slot.hpp"
+#include "asio/associated_executor.hpp"
+#include "asio/basic_waitable_timer.hpp"
+#include "asio/bind_cancellation_slot.hpp"
+#include "asio/cancellation_signal.hpp"
+#include "asio/detail/bind_handler.hpp"
+#include "asio/detail/memory.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/error.hpp"
+#include "asio/error_code.hpp"
+#include "asio/post.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// The memory of the waits on a deadline's timer, and the link from them back
+// to the deadline. The waits share it, so that a wait still queued when the
+// deadline is destroyed finds the deadline gone and can still free its
+// memory. A freed block is kept for the next wait instead of going back to
+// the heap, so that arming the deadline does not allocate once it has run.
+class deadline_state
+  : private noncopyable
+{
+public:
+  // A wait on the timer is freed before the next one is allocated unless the
+  // deadline is armed again before a cancelled wait has run, so two blocks
+  // cover it.
+  enum
+  {
+    block_size = 256,
+    block_count = 2
+  };
+
+  explicit deadline_state(void* owner)
+    : owner_(owner)
+  {
+    for (int i = 0; i < block_count; ++i)
+      blocks_[i] = 0;
+  }
+
+  ~deadline_state()
+  {
+    for (int i = 0; i < block_count; ++i)
+      ::operator delete(blocks_[i]);
+  }
+
+  void* allocate(std::size_t size)
+  {
+    if (size <= block_size)
+    {
+      for (int i = 0; i < block_count; ++i)
+      {
+        if (blocks_[i])
+        {
+          void* pointer = blocks_[i];
+          blocks_[i] = 0;
+          return pointer;
+        }
+      }
+      size = block_size;
+    }
+    return ::operator new(size);
+  }
+
+  void deallocate(void* pointer, std::size_t size)
+  {
+    if (size <= block_size)
+    {
+      for (int i = 0; i < block_count; ++i)
+      {
+        if (!blocks_[i])
+        {
+          blocks_[i] = pointer;
+          return;
+        }
+      }
+    }
+    ::operator delete(pointer);
+  }
+
+  // The deadline, or null once it has been destroyed.
+  void* owner_;
+
+private:
+  void* blocks_[block_count];
+};
+
+// The allocator associated with a wait on a deadline's timer.
+template <typename T>
+class deadline_allocator
+{
+public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind
+  {
+    typedef deadline_allocator<U> other;
+  };
+
+  explicit deadline_allocator(deadline_state& state) ASIO_NOEXCEPT
+    : state_(&state)
+  {
+  }
+
+  template <typename U>
+  deadline_allocator(const deadline_allocator<U>& other) ASIO_NOEXCEPT
+    : state_(other.state_)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(state_->allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* p, std::size_t n)
+  {
+    state_->deallocate(p, sizeof(T) * n);
+  }
+
+  bool operator==(const deadline_allocator& other) const ASIO_NOEXCEPT
+  {
+    return state_ == other.state_;
+  }
+
+  bool operator!=(const deadline_allocator& other) const ASIO_NOEXCEPT
+  {
+    return state_ != other.state_;
+  }
+
+private:
+  template <typename> friend class deadline_allocator;
+
+  deadline_state* state_;
+};
+
+// Completes a wait on a deadline's timer. A wait that had already completed
+// when the deadline was destroyed still runs, so the deadline is only reached
+// through the shared state.
+template <typename Deadline>
+class deadline_expiry
+{
+public:
+  deadline_expiry(const asio::detail::shared_ptr<deadline_state>& state,
+      std::size_t generation)
+    : state_(state),
+      generation_(generation)
+  {
+  }
+
+  void operator()(const asio::error_code& ec)
+  {
+    if (!ec && state_->owner_)
+      static_cast<Deadline*>(state_->owner_)->expire(generation_);
+  }
+
+//private:
+  asio::detail::shared_ptr<deadline_state> state_;
+  std::size_t generation_;
+};
+
+template <typename Deadline>
+inline void* asio_handler_allocate(std::size_t size,
+    deadline_expiry<Deadline>* this_handler)
+{
+  return this_handler->state_->allocate(size);
+}
+
+template <typename Deadline>
+inline void asio_handler_deallocate(void* pointer, std::size_t size,
+    deadline_expiry<Deadline>* this_handler)
+{
+  this_handler->state_->deallocate(pointer, size);
+}
+
+// A deadline shared by the operations of one direction of a socket. The
+// timer is reused by every operation with a deadline, so that none of them
+// needs a timer of its own. When the timer expires the transport operation
+// in progress is cancelled through a cancellation signal, and the steps the
+// operation has not started yet complete with operation_aborted at once.
+//
+// Only one operation at a time may use the deadline. While it is armed,
+// arm() refuses to start the timer for another.
+template <typename Executor>
+class operation_deadline
+  : private noncopyable
+{
+public:
+  typedef asio::basic_waitable_timer<asio::chrono::steady_clock,
+      asio::wait_traits<asio::chrono::steady_clock>, Executor> timer_type;
+
+  explicit operation_deadline(const Executor& executor)
+    : timer_(executor),
+      executor_(executor),
+      state_(new deadline_state(this)),
+      generation_(0),
+      armed_(false),
+      expired_(false)
+  {
+  }
+
+  ~operation_deadline()
+  {
+    state_->owner_ = 0;
+  }
+
+  // Start the timer for the next operation. Returns false if another
+  // operation is still using the deadline.
+  bool arm(const typename timer_type::duration& timeout)
+  {
+    if (armed_)
+      return false;
+
+    ++generation_;
+    armed_ = true;
+    expired_ = false;
+    timer_.expires_after(timeout);
+    timer_.async_wait(
+        deadline_expiry<operation_deadline>(state_, generation_));
+    return true;
+  }
+
+  // Stop the timer once the operation has completed. Returns true if the
+  // deadline had expired.
+  bool disarm()
+  {
+    ++generation_;
+    armed_ = false;
+    timer_.cancel();
+    bool expired = expired_;
+    expired_ = false;
+    return expired;
+  }
+
+  bool expired() const
+  {
+    return expired_;
+  }
+
+  const Executor& executor()
+  {
+    return executor_;
+  }
+
+  asio::cancellation_slot slot()
+  {
+    return signal_.slot();
+  }
+
+  // Pass the cancellation of an operation's handler on to the transport
+  // operation in progress.
+  void emit(asio::cancellation_type_t type)
+  {
+    signal_.emit(type);
+  }
+
+  // Called when a wait on the timer completes without being cancelled.
+  void expire(std::size_t generation)
+  {
+    if (generation == generation_)
+    {
+      expired_ = true;
+      signal_.emit(asio::cancellation_type::terminal);
+    }
+  }
+
+private:
+  timer_type timer_;
+  Executor executor_;
+  asio::cancellation_signal signal_;
+  asio::detail::shared_ptr<deadline_state> state_;
+
+  // Tells the expiry of an earlier operation from that of the current one.
+  std::size_t generation_;
+  bool armed_;
+  bool expired_;
+};
+
+// Wraps the receive or send function of an operation with a deadline. Each
+// step on the transport is bound to the deadline's cancellation slot.
+template <typename Function, typename Deadline>
+class deadline_function
+{
+public:
+  deadline_function(const Function& function, Deadline& deadline)
+    : function_(function),
+      deadline_(&deadline)
+  {
+  }
+
+  template <typename Buffer, typename CallBack>
+  void operator()(const Buffer& buffer, ASIO_MOVE_ARG(CallBack) cb) const
+  {
+    if (deadline_->expired())
+    {
+      // The deadline expired while the operation was waiting for its turn
+      // on the transport.
+      asio::post(deadline_->executor(), asio::detail::bind_handler(
+            ASIO_MOVE_CAST(CallBack)(cb),
+            asio::error_code(asio::error::operation_aborted), 0));
+      return;
+    }
+
+    function_(buffer, asio::bind_cancellation_slot(
+          deadline_->slot(), ASIO_MOVE_CAST(CallBack)(cb)));
+  }
+
+private:
+  Function function_;
+  Deadline* deadline_;
+};
+
+template <typename Function, typename Deadline>
+inline deadline_function<Function, Deadline> make_deadline_function(
+    const Function& function, Deadline& deadline)
+{
+  return deadline_function<Function, Deadline>(function, deadline);
+}
+
+// Wraps the handler of an operation with a deadline. It stops the timer,
+// reports an expired deadline as timed_out and passes the cancellation of
+// the handler's own slot on to the deadline. The steps of the operation are
+// cancelled through the deadline's slot, including those still waiting for
+// their turn on the transport.
+template <typename Handler, typename Deadline>
+class deadline_handler
+{
+public:
+  deadline_handler(Handler& handler, Deadline& deadline)
+    : handler_(ASIO_MOVE_CAST(Handler)(handler)),
+      deadline_(&deadline)
+  {
+    typename associated_cancellation_slot<Handler>::type slot =
+      asio::get_associated_cancellation_slot(handler_);
+    if (slot.is_connected())
+      slot.template emplace<forwarder>(deadline_);
+  }
+
+  void operator()(const asio::error_code& ec)
+  {
+    handler_(complete(ec));
+  }
+
+  void operator()(const asio::error_code& ec, std::size_t bytes_transferred)
+  {
+    handler_(complete(ec), bytes_transferred);
+  }
+
+  asio::error_code complete(asio::error_code ec)
+  {
+    if (deadline_->disarm() && ec == asio::error::operation_aborted)
+      ec = asio::error::timed_out;
+
+    typename associated_cancellation_slot<Handler>::type slot =
+      asio::get_associated_cancellation_slot(handler_);
+    if (slot.is_connected())
+      slot.clear();
+
+    return ec;
+  }
+
+//private:
+  struct forwarder
+  {
+    explicit forwarder(Deadline* deadline)
+      : deadline_(deadline)
+    {
+    }
+
+    void operator()(asio::cancellation_type_t type)
+    {
+      deadline_->emit(type);
+    }
+
+    Deadline* deadline_;
+  };
+
+  Handler handler_;
+  Deadline* deadline_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+
+template <typename Deadline, typename Allocator>
+struct associated_allocator<
+    ssl::dtls::detail::deadline_expiry<Deadline>, Allocator>
+{
+  typedef ssl::dtls::detail::deadline_allocator<void> type;
+
+  static type get(const ssl::dtls::detail::deadline_expiry<Deadline>& h,
+      const Allocator& = Allocator()) ASIO_NOEXCEPT
+  {
+    return type(*h.state_);
+  }
+};
+
+template <typename Handler, typename Deadline, typename Allocator>
+struct associated_allocator<
+    ssl::dtls::detail::deadline_handler<Handler, Deadline>, Allocator>
+{
+  typedef typename associated_allocator<Handler, Allocator>::type type;
+
+  static type get(const ssl::dtls::detail::deadline_handler<Handler, Deadline>& h,
+      const Allocator& a = Allocator()) ASIO_NOEXCEPT
+  {
+    return associated_allocator<Handler, Allocator>::get(h.handler_, a);
+  }
+};
+
+template <typename Handler, typename Deadline, typename Executor>
+struct associated_executor<
+    ssl::dtls::detail::deadline_handler<Handler, Deadline>, Executor>
+{
+  typedef typename associated_executor<Handler, Executor>::type type;
+
+  static type get(const ssl::dtls::detail::deadline_handler<Handler, Deadline>& h,
+      const Executor& ex = Executor()) ASIO_NOEXCEPT
+  {
+    return associated_executor<Handler, Executor>::get(h.handler_, ex);
+  }
+};
+
+template <typename Handler, typename Deadline, typename CancellationSlot>
+struct associated_cancellation_slot<
+    ssl::dtls::detail::deadline_handler<Handler, Deadline>, CancellationSlot>
+{
+  typedef asio::cancellation_slot type;
+
+  static type get(const ssl::dtls::detail::deadline_handler<Handler, Deadline>& h,
+      const CancellationSlot& = CancellationSlot()) ASIO_NOEXCEPT
+  {
+    return h.deadline_->slot();
+  }
+};
+
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_DEADLINE_HPP
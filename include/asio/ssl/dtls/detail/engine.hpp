@@ -17,7 +17,11 @@
 
 #include "asio/detail/config.hpp"
 
+#include <deque>
+#include <string>
+#include <vector>
 #include "asio/buffer.hpp"
+#include "asio/detail/chrono.hpp"
 #include "asio/detail/static_mutex.hpp"
 #include "asio/ssl/detail/openssl_types.hpp"
 #include "asio/ssl/detail/verify_callback.hpp"
@@ -25,6 +29,9 @@
 #include "asio/ssl/verify_mode.hpp"
 #include "asio/ssl/dtls/detail/cookie_generate_callback.hpp"
 #include "asio/ssl/dtls/detail/cookie_verify_callback.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+#include "asio/ssl/dtls/detail/private_key_operation.hpp"
+#include "asio/ssl/dtls/detail/record_layer.hpp"
 
 #include "asio/detail/push_options.hpp"
 
@@ -33,34 +40,20 @@ namespace ssl {
 namespace dtls {
 namespace detail {
 
-class engine
+class engine : public engine_base
 {
 public:
-  enum want
-  {
-    // Returned by functions to indicate that the engine wants input. The input
-    // buffer should be updated to point to the data. The engine then needs to
-    // be called again to retry the operation.
-    want_input_and_retry = -2,
-
-    // Returned by functions to indicate that the engine wants to write output.
-    // The output buffer points to the data to be written. The engine then
-    // needs to be called again to retry the operation.
-    want_output_and_retry = -1,
-
-    // Returned by functions to indicate that the engine doesn't need input or
-    // output.
-    want_nothing = 0,
-
-    // Returned by functions to indicate that the engine wants to write output.
-    // The output buffer points to the data to be written. After that the
-    // operation is complete, and the engine does not need to be called again.
-    want_output = 1
-  };
-
   // Construct a new engine for the specified context.
   ASIO_DECL explicit engine(SSL_CTX* context);
 
+#if defined(ASIO_HAS_MOVE)
+  // Move-construct an engine from another.
+  ASIO_DECL engine(engine&& other) ASIO_NOEXCEPT;
+
+  // Move-assign an engine from another.
+  ASIO_DECL engine& operator=(engine&& other) ASIO_NOEXCEPT;
+#endif // defined(ASIO_HAS_MOVE)
+
   // Destructor.
   ASIO_DECL ~engine();
 
@@ -70,6 +63,15 @@ public:
   // Set the MTU used for handshaking
   ASIO_DECL bool set_mtu(int mtu);
 
+  // Get the MTU set by set_mtu(), or 0 if none was set.
+  ASIO_DECL int mtu() const;
+
+  // Get the largest payload whose record fits into one datagram of the MTU.
+  ASIO_DECL std::size_t max_payload_length() const;
+
+  // Whether the handshake has been started but not yet completed.
+  ASIO_DECL bool in_handshake() const;
+
   // Set temporary data for cookie validation
   ASIO_DECL void set_dtls_tmp_data(void* data);
 
@@ -98,6 +100,10 @@ public:
   ASIO_DECL asio::error_code set_verify_callback(
       ssl::detail::verify_callback_base* callback, asio::error_code& ec);
 
+  // Set the identity and pre-shared key used by a client.
+  ASIO_DECL asio::error_code set_psk_identity(const std::string& identity,
+      const asio::const_buffer& key, asio::error_code& ec);
+
   // Perform an DTLS_v1_listen to verify the dtls cookie
   ASIO_DECL want dtls_listen(asio::error_code& ec);
 
@@ -106,6 +112,27 @@ public:
   ASIO_DECL want handshake(
       stream_base::handshake_type type, asio::error_code& ec);
 
+  // Configure handshake retransmissions. The first retransmission happens
+  // after initial_timeout, and the timeout doubles with every retransmission
+  // up to 60 seconds. A zero handshake_timeout means no overall deadline.
+  ASIO_DECL void set_retransmission(
+      const asio::chrono::steady_clock::duration& initial_timeout,
+      unsigned int max_retransmits,
+      const asio::chrono::steady_clock::duration& handshake_timeout);
+
+  // Get the time after which handle_timeout() must be called. Returns false
+  // if the engine is not waiting for a handshake flight.
+  ASIO_DECL bool retransmit_timeout(
+      asio::chrono::steady_clock::duration& timeout) const;
+
+  // Retransmit the last handshake flight if its timer has expired. Fails
+  // with error::timed_out once the retransmissions or the handshake deadline
+  // are exhausted.
+  ASIO_DECL want handle_timeout(asio::error_code& ec);
+
+  // Get the private key operation the handshake waits for, if any.
+  ASIO_DECL private_key_operation* pending_private_key_operation() const;
+
   // Perform a graceful shutdown of the SSL session.
   ASIO_DECL want shutdown(asio::error_code& ec);
 
@@ -117,14 +144,107 @@ public:
   ASIO_DECL want read(const asio::mutable_buffer& data,
       asio::error_code& ec, std::size_t& bytes_transferred);
 
+  // Whether part of the last record's payload did not fit into the last
+  // read and is waiting for the next one.
+  ASIO_DECL bool payload_pending() const;
+
+  // Whether read_in_place() can be used for the next read, i.e. the record
+  // layer is active and no plaintext is left from an earlier read.
+  ASIO_DECL bool can_read_in_place() const;
+
+  // Read the payload of the next application data record without copying
+  // it. The record is opened where it lies in the input, which must be
+  // writable and stay valid as long as the plaintext is used.
+  ASIO_DECL want read_in_place(asio::const_buffer& plaintext,
+      asio::error_code& ec);
+
+  // Seal and open application data records without OpenSSL once the session
+  // is established. Requires DTLS 1.2 and an AEAD cipher suite.
+  ASIO_DECL asio::error_code enable_record_layer(asio::error_code& ec);
+
+  // Bytes to reserve in front of a payload passed to write_in_place().
+  ASIO_DECL std::size_t record_headroom() const;
+
+  // Bytes to reserve behind a payload passed to write_in_place().
+  ASIO_DECL std::size_t record_tailroom() const;
+
+  // Write a payload of the given length that sits at record_headroom() bytes
+  // into the record buffer. The record is sealed in place and the buffer is
+  // returned by get_output(), so it must stay valid until it has been sent.
+  ASIO_DECL want write_in_place(const asio::mutable_buffer& record,
+      std::size_t length, asio::error_code& ec,
+      std::size_t& bytes_transferred);
+
+  // Get the record layer if it has taken over from OpenSSL, or 0.
+  ASIO_DECL record_layer* active_record_layer();
+
+  // Handle a record that was opened by record_layer::open_detached(), in
+  // the order the records were received. Returns want_nothing with the
+  // plaintext being application data, want_nothing with ec set if the
+  // record ends the session, want_output_and_retry if a response has been
+  // queued, or want_input_and_retry if the record has been discarded.
+  ASIO_DECL want accept_record(unsigned char content_type, uint64_t seq,
+      const asio::const_buffer& plaintext, asio::error_code& ec);
+
+  // Queue an application data record sealed by
+  // record_layer::seal_detached(). The buffer is returned by get_output(),
+  // so it must stay valid until it has been sent.
+  ASIO_DECL want write_sealed(const asio::mutable_buffer& record,
+      asio::error_code& ec);
+
   // Get output data to be written to the transport.
   ASIO_DECL asio::mutable_buffer get_output(
       const asio::mutable_buffer& data);
 
+  // Whether output is waiting to be written to the transport. A flight that
+  // is larger than the MTU is returned by get_output() a datagram at a time.
+  ASIO_DECL bool output_pending() const;
+
+  // A position in the output, counting the bytes OpenSSL wrote and the
+  // records queued by the record layer. Both are taken in order.
+  struct output_position
+  {
+    std::size_t bytes;
+    std::size_t records;
+  };
+
+  // The position behind the output queued so far.
+  ASIO_DECL output_position queued_output() const;
+
+  // The position behind the output returned by get_output() so far.
+  ASIO_DECL output_position taken_output() const;
+
+  // The position in front of the datagram get_output() returned last, i.e.
+  // the output taken before it.
+  ASIO_DECL output_position last_output() const;
+
   // Put input data that was read from the transport.
   ASIO_DECL asio::const_buffer put_input(
       const asio::const_buffer& data);
 
+  // Get the connection ID the peer puts into its records, or an empty
+  // string if none was negotiated.
+  ASIO_DECL std::string connection_id() const;
+
+  // Authenticate a datagram that arrived from a new peer address. Returns
+  // true if its first record carries our connection ID, opens correctly and
+  // is newer than all records received so far. The record is then handled
+  // by the next read.
+  ASIO_DECL bool accept_migration(const asio::const_buffer& datagram);
+
+  // Queue a heartbeat request, replacing one that is still unanswered. Fails
+  // with error::operation_not_supported unless heartbeats were negotiated
+  // and the peer accepts requests. Nothing is sent before the record layer
+  // has taken over.
+  ASIO_DECL want send_heartbeat(asio::error_code& ec);
+
+  // Whether the last heartbeat request is still unanswered.
+  ASIO_DECL bool heartbeat_pending() const;
+
+  // The round-trip time of the last answered heartbeat request, or zero if
+  // none has been answered yet.
+  ASIO_DECL asio::chrono::steady_clock::duration heartbeat_rtt() const;
+
   // Map an error::eof code returned by the underlying transport according to
   // the type and state of the SSL session. Returns a const reference to the
   // error code object, suitable for passing to a completion handler.
@@ -153,6 +273,18 @@ private:
       SSL *ssl, unsigned char *cookie, unsigned int length);
 #endif //(OPENSSL_VERSION_NUMBER >= 0x10100000L)
 
+  // Callback used when the SSL implementation wants a client's PSK identity.
+  ASIO_DECL static unsigned int psk_client_function(SSL* ssl,
+      const char* hint, char* identity, unsigned int max_identity_length,
+      unsigned char* psk, unsigned int max_psk_length);
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  // Callback used when the SSL implementation starts or backs off its
+  // retransmission timer.
+  ASIO_DECL static unsigned int retransmit_timer_function(
+      SSL* ssl, unsigned int previous_timeout_us);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+
 #if (OPENSSL_VERSION_NUMBER < 0x10000000L)
   // The SSL_accept function may not be thread safe. This mutex is used to
   // protect all calls to the SSL_accept function.
@@ -184,8 +316,108 @@ private:
   // Adapt the SSL_write function to the signature needed for perform().
   ASIO_DECL int do_write(void* data, std::size_t length);
 
+  // Get the number of bytes get_output() returns in the next datagram.
+  ASIO_DECL std::size_t datagram_length(std::size_t limit);
+
+  // Hand the session over to the record layer once OpenSSL has no records
+  // in flight and the peer no longer needs handshake retransmissions.
+  ASIO_DECL void try_activate_record_layer();
+
+  // Read application data through the record layer.
+  ASIO_DECL want read_record(const asio::mutable_buffer& data,
+      asio::error_code& ec, std::size_t& bytes_transferred);
+
+  // Handle an opened record of the record layer. See accept_record().
+  ASIO_DECL want handle_record(unsigned char content_type,
+      const unsigned char* plaintext, std::size_t length,
+      asio::error_code& ec);
+
+  // The heartbeat message types, and the length of the payload of our
+  // requests, which is also the minimum padding.
+  enum
+  {
+    heartbeat_request = 1,
+    heartbeat_response = 2,
+    heartbeat_payload_length = 16
+  };
+
+  // Answer a heartbeat request or match a response. Returns true if a
+  // response has been queued.
+  ASIO_DECL bool handle_heartbeat(
+      const unsigned char* message, std::size_t length);
+
+  // A record waiting to be passed to the transport. Records written in place
+  // are sealed in the caller's buffer, records passed to write() in
+  // sealed_output_, where they are found by offset as the vector may grow.
+  // All others are sealed by get_output().
+  struct pending_record
+  {
+    unsigned char content_type;
+    asio::const_buffer payload;
+    asio::mutable_buffer sealed;
+    std::size_t output_offset;
+    std::size_t output_length;
+  };
+
   SSL* ssl_;
   BIO* ext_bio_;
+
+  // Limits on handshake retransmissions.
+  unsigned int max_retransmits_;
+  asio::chrono::steady_clock::duration handshake_timeout_;
+
+  // Retransmissions so far, and when the handshake has to be complete.
+  unsigned int retransmits_;
+  bool handshake_started_;
+  asio::chrono::steady_clock::time_point handshake_deadline_;
+
+  // Created by enable_record_layer().
+  record_layer* record_layer_;
+
+  // Whether the peer has received our final handshake flight.
+  bool peer_finished_;
+
+  // The last record OpenSSL passed to the transport.
+  record_layer::sequence_state written_;
+
+  // Records to be sent, in the order they were written.
+  std::deque<pending_record> pending_records_;
+
+  // The output returned by get_output() so far, and before its last call.
+  output_position taken_output_;
+  output_position last_output_;
+
+  // Records sealed by write().
+  std::vector<unsigned char> sealed_output_;
+
+  // The received record not yet opened.
+  asio::const_buffer record_input_;
+
+  // Plaintext that did not fit into the caller's buffer.
+  std::vector<unsigned char> record_scratch_;
+  asio::const_buffer record_leftover_;
+
+  // The record that moved the session, opened by accept_migration() and
+  // waiting for the next read.
+  std::vector<unsigned char> migration_plaintext_;
+  unsigned char migration_content_type_;
+  bool migration_pending_;
+
+  // The last heartbeat request and response, and whether they are still
+  // waiting in pending_records_.
+  std::vector<unsigned char> heartbeat_request_;
+  std::vector<unsigned char> heartbeat_response_;
+  bool heartbeat_request_queued_;
+  bool heartbeat_response_queued_;
+
+  // Numbers the heartbeat requests, so that late responses are ignored.
+  uint64_t heartbeat_count_;
+
+  // Whether the last request is unanswered, when it was sent, and the
+  // round-trip time of the last answered one.
+  bool heartbeat_pending_;
+  asio::chrono::steady_clock::time_point heartbeat_sent_;
+  asio::chrono::steady_clock::duration heartbeat_rtt_;
 };
 
 } // namespace detail
@@ -0,0 +1,88 @@
+//
+// ssl/dtls/detail/engine_base.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_ENGINE_BASE_HPP
+#define ASIO_SSL_DTLS_DETAIL_ENGINE_BASE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// The states shared by all engines. An engine is the policy that turns
+// application data into datagrams and back; datagram_io drives it through
+// these states without knowing how records are protected.
+//
+// Besides deriving from this class, an engine used with a socket provides:
+//
+// - construction from an SSL_CTX*, which it may ignore, and move operations;
+// - handshake(), shutdown(), read() and write();
+// - get_output(), output_pending(), put_input() and map_error_code();
+// - retransmit_timeout(), handle_timeout() and in_handshake();
+// - pending_private_key_operation(), needed only if it returns
+//   want_private_key_and_retry;
+// - set_dtls_tmp_data(), set_mtu() and mtu().
+//
+// Socket functions that use anything else, such as cookies or peer
+// verification, are only available with engines that provide it.
+class engine_base
+{
+public:
+  enum want
+  {
+    // Returned by functions to indicate that the engine waits for a private
+    // key operation running elsewhere. The engine needs to be called again
+    // once pending_private_key_operation() has completed.
+    want_private_key_and_retry = -3,
+
+    // Returned by functions to indicate that the engine wants input. The input
+    // buffer should be updated to point to the data. The engine then needs to
+    // be called again to retry the operation.
+    want_input_and_retry = -2,
+
+    // Returned by functions to indicate that the engine wants to write output.
+    // The output buffer points to the data to be written. The engine then
+    // needs to be called again to retry the operation.
+    want_output_and_retry = -1,
+
+    // Returned by functions to indicate that the engine doesn't need input or
+    // output.
+    want_nothing = 0,
+
+    // Returned by functions to indicate that the engine wants to write output.
+    // The output buffer points to the data to be written. After that the
+    // operation is complete, and the engine does not need to be called again.
+    want_output = 1
+  };
+
+protected:
+  engine_base()
+  {
+  }
+
+  ~engine_base()
+  {
+  }
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_ENGINE_BASE_HPP
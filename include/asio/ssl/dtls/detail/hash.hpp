@@ -0,0 +1,54 @@
+//
+// ssl/dtls/detail/hash.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_HASH_HPP
+#define ASIO_SSL_DTLS_DETAIL_HASH_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstddef>
+#include <string>
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// FNV-1a, used to index session ids and PSK identities.
+inline std::size_t fnv1a_hash(const void* data, std::size_t size)
+{
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  unsigned long hash = 2166136261UL;
+  for (std::size_t i = 0; i < size; ++i)
+    hash = ((hash ^ p[i]) * 16777619UL) & 0xffffffffUL;
+  return static_cast<std::size_t>(hash);
+}
+
+// FNV-1a as a hash function object for strings.
+struct string_hash
+{
+  std::size_t operator()(const std::string& s) const
+  {
+    return fnv1a_hash(s.data(), s.size());
+  }
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_HASH_HPP
@@ -0,0 +1,242 @@
+//
+// ssl/dtls/detail/heartbeat_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_HEARTBEAT_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_HEARTBEAT_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/associated_allocator.hpp"
+#include "asio/associated_executor.hpp"
+#include "asio/detail/handler_alloc_helpers.hpp"
+#include "asio/detail/handler_cont_helpers.hpp"
+#include "asio/detail/handler_invoke_helpers.hpp"
+#include "asio/error.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/datagram_helper.hpp"
+#include "asio/ssl/dtls/detail/datagram_io.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+class heartbeat_op
+{
+public:
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    bytes_transferred = 0;
+    return eng.send_heartbeat(ec);
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t& bytes_transferred) const
+  {
+    handler(ec, bytes_transferred);
+  }
+};
+
+// Sends a heartbeat request every interval until the peer has left
+// max_misses requests in a row unanswered, or the heartbeat is cancelled.
+// Responses are matched by the socket's receive operations, so the handler
+// only runs once the loop ends.
+template <typename NextLayer, typename Core, typename Handler>
+class heartbeat_loop_op
+{
+public:
+  heartbeat_loop_op(NextLayer& next_layer, Core& core,
+      std::size_t max_misses, Handler& handler)
+    : next_layer_(next_layer),
+      core_(core),
+      max_misses_(max_misses),
+      misses_(0),
+      handler_(ASIO_MOVE_CAST(Handler)(handler))
+  {
+  }
+
+#if defined(ASIO_HAS_MOVE)
+  heartbeat_loop_op(const heartbeat_loop_op& other)
+    : next_layer_(other.next_layer_),
+      core_(other.core_),
+      max_misses_(other.max_misses_),
+      misses_(other.misses_),
+      handler_(other.handler_)
+  {
+  }
+
+  heartbeat_loop_op(heartbeat_loop_op&& other)
+    : next_layer_(other.next_layer_),
+      core_(other.core_),
+      max_misses_(other.max_misses_),
+      misses_(other.misses_),
+      handler_(ASIO_MOVE_CAST(Handler)(other.handler_))
+  {
+  }
+#endif // defined(ASIO_HAS_MOVE)
+
+  // Send a request. Does not call the handler directly, so it may be used
+  // by the initiating function.
+  void send()
+  {
+    async_datagram_io(
+        async_datagram_receive<NextLayer>(next_layer_),
+        async_datagram_send<NextLayer>(next_layer_),
+        core_, heartbeat_op(), *this);
+  }
+
+  // Called when the interval has elapsed.
+  void operator()(asio::error_code ec)
+  {
+    if (!ec && core_.heartbeat_interval_
+        == asio::steady_timer::duration::zero())
+      ec = asio::error::operation_aborted;
+
+    if (ec)
+    {
+      handler_(ec);
+      return;
+    }
+
+    if (!core_.engine_.heartbeat_pending())
+      misses_ = 0;
+    else if (++misses_ >= max_misses_)
+    {
+      handler_(asio::error_code(asio::error::timed_out));
+      return;
+    }
+
+    send();
+  }
+
+  // Called when the request has been sent.
+  void operator()(asio::error_code ec, std::size_t)
+  {
+    if (!ec && core_.heartbeat_interval_
+        == asio::steady_timer::duration::zero())
+      ec = asio::error::operation_aborted;
+
+    if (ec)
+    {
+      handler_(ec);
+      return;
+    }
+
+    typename Core::timer_type& timer = core_.heartbeat_timer();
+    timer.expires_after(core_.heartbeat_interval_);
+    timer.async_wait(ASIO_MOVE_CAST(heartbeat_loop_op)(*this));
+  }
+
+//private:
+  NextLayer& next_layer_;
+  Core& core_;
+  std::size_t max_misses_;
+  std::size_t misses_;
+  Handler handler_;
+};
+
+template <typename NextLayer, typename Core, typename Handler>
+inline void* asio_handler_allocate(std::size_t size,
+    heartbeat_loop_op<NextLayer, Core, Handler>* this_handler)
+{
+  return asio_handler_alloc_helpers::allocate(
+      size, this_handler->handler_);
+}
+
+template <typename NextLayer, typename Core, typename Handler>
+inline void asio_handler_deallocate(void* pointer, std::size_t size,
+    heartbeat_loop_op<NextLayer, Core, Handler>* this_handler)
+{
+  asio_handler_alloc_helpers::deallocate(
+      pointer, size, this_handler->handler_);
+}
+
+template <typename NextLayer, typename Core, typename Handler>
+inline bool asio_handler_is_continuation(
+    heartbeat_loop_op<NextLayer, Core, Handler>*)
+{
+  return true;
+}
+
+template <typename Function, typename NextLayer, typename Core,
+    typename Handler>
+inline void asio_handler_invoke(Function& function,
+    heartbeat_loop_op<NextLayer, Core, Handler>* this_handler)
+{
+  asio_handler_invoke_helpers::invoke(
+      function, this_handler->handler_);
+}
+
+template <typename Function, typename NextLayer, typename Core,
+    typename Handler>
+inline void asio_handler_invoke(const Function& function,
+    heartbeat_loop_op<NextLayer, Core, Handler>* this_handler)
+{
+  asio_handler_invoke_helpers::invoke(
+      function, this_handler->handler_);
+}
+
+template <typename NextLayer, typename Core, typename Handler>
+inline void async_heartbeat_loop(NextLayer& next_layer, Core& core,
+    std::size_t max_misses, Handler& handler)
+{
+  heartbeat_loop_op<NextLayer, Core, Handler>(
+      next_layer, core, max_misses, handler).send();
+}
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+
+template <typename NextLayer, typename Core, typename Handler,
+    typename Allocator>
+struct associated_allocator<
+    ssl::dtls::detail::heartbeat_loop_op<NextLayer, Core, Handler>, Allocator>
+{
+  typedef typename associated_allocator<Handler, Allocator>::type type;
+
+  static type get(
+      const ssl::dtls::detail::heartbeat_loop_op<NextLayer, Core, Handler>& h,
+      const Allocator& a = Allocator()) ASIO_NOEXCEPT
+  {
+    return associated_allocator<Handler, Allocator>::get(h.handler_, a);
+  }
+};
+
+template <typename NextLayer, typename Core, typename Handler,
+    typename Executor>
+struct associated_executor<
+    ssl::dtls::detail::heartbeat_loop_op<NextLayer, Core, Handler>, Executor>
+{
+  typedef typename associated_executor<Handler, Executor>::type type;
+
+  static type get(
+      const ssl::dtls::detail::heartbeat_loop_op<NextLayer, Core, Handler>& h,
+      const Executor& ex = Executor()) ASIO_NOEXCEPT
+  {
+    return associated_executor<Handler, Executor>::get(h.handler_, ex);
+  }
+};
+
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_HEARTBEAT_OP_HPP
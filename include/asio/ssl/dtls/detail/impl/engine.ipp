@@ -17,6 +17,8 @@
 
 #include "asio/detail/config.hpp"
 
+#include <cstring>
+#include "asio/detail/call_stack.hpp"
 #include "asio/detail/throw_error.hpp"
 #include "asio/error.hpp"
 #include "asio/ssl/dtls/detail/engine.hpp"
@@ -28,6 +30,7 @@
 
 #include <openssl/opensslv.h>
 #include <openssl/bio.h>
+#include <openssl/rand.h>
 
 namespace asio {
 namespace ssl {
@@ -35,8 +38,25 @@ namespace dtls {
 namespace detail {
 
 engine::engine(SSL_CTX* context)
-  : ssl_(::SSL_new(context))
+  : ssl_(::SSL_new(context)),
+    max_retransmits_(6),
+    handshake_timeout_(asio::chrono::seconds(60)),
+    retransmits_(0),
+    handshake_started_(false),
+    record_layer_(0),
+    peer_finished_(false),
+    migration_content_type_(0),
+    migration_pending_(false),
+    heartbeat_request_queued_(false),
+    heartbeat_response_queued_(false),
+    heartbeat_count_(0),
+    heartbeat_pending_(false),
+    heartbeat_rtt_(0)
 {
+  taken_output_.bytes = 0;
+  taken_output_.records = 0;
+  last_output_ = taken_output_;
+
   if (!ssl_)
   {
     asio::error_code ec(
@@ -62,16 +82,113 @@ engine::engine(SSL_CTX* context)
   SSL_set_app_data(ssl_, new ssl_app_data());
 }
 
+#if defined(ASIO_HAS_MOVE)
+engine::engine(engine&& other) ASIO_NOEXCEPT
+  : ssl_(other.ssl_),
+    ext_bio_(other.ext_bio_),
+    max_retransmits_(other.max_retransmits_),
+    handshake_timeout_(other.handshake_timeout_),
+    retransmits_(other.retransmits_),
+    handshake_started_(other.handshake_started_),
+    handshake_deadline_(other.handshake_deadline_),
+    record_layer_(other.record_layer_),
+    peer_finished_(other.peer_finished_),
+    written_(other.written_),
+    pending_records_(ASIO_MOVE_CAST(std::deque<pending_record>)(
+          other.pending_records_)),
+    taken_output_(other.taken_output_),
+    last_output_(other.last_output_),
+    sealed_output_(ASIO_MOVE_CAST(std::vector<unsigned char>)(
+          other.sealed_output_)),
+    record_input_(other.record_input_),
+    record_scratch_(ASIO_MOVE_CAST(std::vector<unsigned char>)(
+          other.record_scratch_)),
+    record_leftover_(other.record_leftover_),
+    migration_plaintext_(ASIO_MOVE_CAST(std::vector<unsigned char>)(
+          other.migration_plaintext_)),
+    migration_content_type_(other.migration_content_type_),
+    migration_pending_(other.migration_pending_),
+    heartbeat_request_(ASIO_MOVE_CAST(std::vector<unsigned char>)(
+          other.heartbeat_request_)),
+    heartbeat_response_(ASIO_MOVE_CAST(std::vector<unsigned char>)(
+          other.heartbeat_response_)),
+    heartbeat_request_queued_(other.heartbeat_request_queued_),
+    heartbeat_response_queued_(other.heartbeat_response_queued_),
+    heartbeat_count_(other.heartbeat_count_),
+    heartbeat_pending_(other.heartbeat_pending_),
+    heartbeat_sent_(other.heartbeat_sent_),
+    heartbeat_rtt_(other.heartbeat_rtt_)
+{
+  other.ssl_ = 0;
+  other.ext_bio_ = 0;
+  other.record_layer_ = 0;
+  other.record_input_ = asio::const_buffer();
+  other.record_leftover_ = asio::const_buffer();
+}
+
+engine& engine::operator=(engine&& other) ASIO_NOEXCEPT
+{
+  if (this != &other)
+  {
+    engine tmp(ASIO_MOVE_CAST(engine)(*this));
+    ssl_ = other.ssl_;
+    ext_bio_ = other.ext_bio_;
+    max_retransmits_ = other.max_retransmits_;
+    handshake_timeout_ = other.handshake_timeout_;
+    retransmits_ = other.retransmits_;
+    handshake_started_ = other.handshake_started_;
+    handshake_deadline_ = other.handshake_deadline_;
+    record_layer_ = other.record_layer_;
+    peer_finished_ = other.peer_finished_;
+    written_ = other.written_;
+    pending_records_ = ASIO_MOVE_CAST(std::deque<pending_record>)(
+        other.pending_records_);
+    taken_output_ = other.taken_output_;
+    last_output_ = other.last_output_;
+    sealed_output_ = ASIO_MOVE_CAST(std::vector<unsigned char>)(
+        other.sealed_output_);
+    record_input_ = other.record_input_;
+    record_scratch_ = ASIO_MOVE_CAST(std::vector<unsigned char>)(
+        other.record_scratch_);
+    record_leftover_ = other.record_leftover_;
+    migration_plaintext_ = ASIO_MOVE_CAST(std::vector<unsigned char>)(
+        other.migration_plaintext_);
+    migration_content_type_ = other.migration_content_type_;
+    migration_pending_ = other.migration_pending_;
+    heartbeat_request_ = ASIO_MOVE_CAST(std::vector<unsigned char>)(
+        other.heartbeat_request_);
+    heartbeat_response_ = ASIO_MOVE_CAST(std::vector<unsigned char>)(
+        other.heartbeat_response_);
+    heartbeat_request_queued_ = other.heartbeat_request_queued_;
+    heartbeat_response_queued_ = other.heartbeat_response_queued_;
+    heartbeat_count_ = other.heartbeat_count_;
+    heartbeat_pending_ = other.heartbeat_pending_;
+    heartbeat_sent_ = other.heartbeat_sent_;
+    heartbeat_rtt_ = other.heartbeat_rtt_;
+    other.ssl_ = 0;
+    other.ext_bio_ = 0;
+    other.record_layer_ = 0;
+    other.record_input_ = asio::const_buffer();
+    other.record_leftover_ = asio::const_buffer();
+  }
+  return *this;
+}
+#endif // defined(ASIO_HAS_MOVE)
+
 engine::~engine()
 {
-  if (SSL_get_app_data(ssl_))
+  delete record_layer_;
+
+  if (ssl_ && SSL_get_app_data(ssl_))
   {
     delete static_cast<detail::ssl_app_data*>(SSL_get_app_data(ssl_));
     SSL_set_app_data(ssl_, 0);
   }
 
-  ::BIO_free(ext_bio_);
-  ::SSL_free(ssl_);
+  if (ext_bio_)
+    ::BIO_free(ext_bio_);
+  if (ssl_)
+    ::SSL_free(ssl_);
 }
 
 SSL* engine::native_handle()
@@ -84,7 +201,55 @@ bool engine::set_mtu(int mtu)
   SSL_set_options(ssl_, SSL_OP_NO_QUERY_MTU);
 
   long mtu_val = mtu;
-  return (::SSL_set_mtu(ssl_, mtu) == mtu_val);
+  if (::SSL_set_mtu(ssl_, mtu) != mtu_val)
+    return false;
+
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+  appdata->set_mtu(mtu);
+  return true;
+}
+
+int engine::mtu() const
+{
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+  return appdata->getMtu();
+}
+
+std::size_t engine::max_payload_length() const
+{
+  int link_mtu = mtu();
+  if (link_mtu <= 0)
+    return SSL3_RT_MAX_PLAIN_LENGTH;
+
+  // The record layer knows its overhead exactly.
+  if (record_layer_ && record_layer_->is_active())
+  {
+    std::size_t overhead =
+      record_layer_->headroom() + record_layer_->tailroom();
+    std::size_t length = static_cast<std::size_t>(link_mtu) > overhead
+      ? static_cast<std::size_t>(link_mtu) - overhead : 0;
+    return length < SSL3_RT_MAX_PLAIN_LENGTH
+      ? length : SSL3_RT_MAX_PLAIN_LENGTH;
+  }
+
+  std::size_t length = 0;
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  // Exact once a cipher suite has been negotiated.
+  length = ::DTLS_get_data_mtu(ssl_);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+
+  // Otherwise assume the largest overhead of a DTLS 1.2 cipher suite: the
+  // record header, an explicit CBC IV, padding and an HMAC-SHA384.
+  const int max_record_overhead = DTLS1_RT_HEADER_LENGTH + 16 + 16 + 48;
+  if (length == 0 && link_mtu > max_record_overhead)
+    length = static_cast<std::size_t>(link_mtu - max_record_overhead);
+
+  return length < SSL3_RT_MAX_PLAIN_LENGTH ? length : SSL3_RT_MAX_PLAIN_LENGTH;
+}
+
+bool engine::in_handshake() const
+{
+  return handshake_started_ && !::SSL_is_init_finished(ssl_);
 }
 
 void engine::set_dtls_tmp_data(void* data)
@@ -234,6 +399,44 @@ int engine::verify_callback_function(int preverified, X509_STORE_CTX* ctx)
   return 0;
 }
 
+asio::error_code engine::set_psk_identity(const std::string& identity,
+    const asio::const_buffer& key, asio::error_code& ec)
+{
+#if !defined(OPENSSL_NO_PSK)
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+
+  appdata->set_psk_identity(identity,
+      std::string(static_cast<const char*>(key.data()), key.size()));
+
+  ::SSL_set_psk_client_callback(ssl_, &engine::psk_client_function);
+
+  ec = asio::error_code();
+  return ec;
+#else // !defined(OPENSSL_NO_PSK)
+  (void)identity;
+  (void)key;
+  ec = asio::error::operation_not_supported;
+  return ec;
+#endif // !defined(OPENSSL_NO_PSK)
+}
+
+unsigned int engine::psk_client_function(SSL* ssl,
+    const char*, char* identity, unsigned int max_identity_length,
+    unsigned char* psk, unsigned int max_psk_length)
+{
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl));
+
+  const std::string& id = appdata->getPskIdentity();
+  const std::string& key = appdata->getPskKey();
+  if (id.size() >= max_identity_length
+      || key.empty() || key.size() > max_psk_length)
+    return 0;
+
+  std::memcpy(identity, id.c_str(), id.size() + 1);
+  std::memcpy(psk, key.data(), key.size());
+  return static_cast<unsigned int>(key.size());
+}
+
 engine::want engine::dtls_listen(asio::error_code& ec)
 {
   return perform(&engine::do_dtls_listen, 0, 0, ec, 0);
@@ -242,12 +445,183 @@ engine::want engine::dtls_listen(asio::error_code& ec)
 engine::want engine::handshake(
     stream_base::handshake_type type, asio::error_code& ec)
 {
-  return perform((type == asio::ssl::stream_base::client)
+  if (!handshake_started_)
+  {
+    handshake_started_ = true;
+    handshake_deadline_ =
+      asio::chrono::steady_clock::now() + handshake_timeout_;
+  }
+
+  want result = perform((type == asio::ssl::stream_base::client)
       ? &engine::do_connect : &engine::do_accept, 0, 0, ec, 0);
+
+#if defined(SSL_MODE_ASYNC)
+  // Private key operations are only offloaded during the handshake. Keep
+  // reads and writes out of OpenSSL's asynchronous jobs.
+  if (::SSL_is_init_finished(ssl_))
+    ::SSL_clear_mode(ssl_, SSL_MODE_ASYNC);
+#endif // defined(SSL_MODE_ASYNC)
+
+  // OpenSSL cannot send or receive records with a connection ID or
+  // heartbeat records, so the record layer takes over once the handshake is
+  // complete. Should the session have ended up with a suite the record layer
+  // cannot handle, it stays on OpenSSL's record layer without the
+  // extensions.
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+  if (!ec && !record_layer_ && (appdata->isConnectionIdNegotiated()
+        || appdata->isHeartbeatNegotiated())
+      && ::SSL_is_init_finished(ssl_))
+  {
+    if (::SSL_version(ssl_) == DTLS1_2_VERSION
+        && record_layer::is_supported(::SSL_get_current_cipher(ssl_)))
+    {
+      enable_record_layer(ec);
+      if (ec)
+        return want_nothing;
+    }
+    else
+    {
+      appdata->set_connection_id_negotiated(false);
+      appdata->set_heartbeat_negotiated(false);
+    }
+  }
+
+  return result;
+}
+
+private_key_operation* engine::pending_private_key_operation() const
+{
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+  return appdata->getPrivateKeyOperation();
+}
+
+void engine::set_retransmission(
+    const asio::chrono::steady_clock::duration& initial_timeout,
+    unsigned int max_retransmits,
+    const asio::chrono::steady_clock::duration& handshake_timeout)
+{
+  max_retransmits_ = max_retransmits;
+  handshake_timeout_ = handshake_timeout;
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  long long timeout_us = asio::chrono::duration_cast<
+    asio::chrono::microseconds>(initial_timeout).count();
+  if (timeout_us < 1)
+    timeout_us = 1;
+  else if (timeout_us > 60000000)
+    timeout_us = 60000000;
+
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+  appdata->set_retransmit_timeout(static_cast<unsigned int>(timeout_us));
+  ::DTLS_set_timer_cb(ssl_, &engine::retransmit_timer_function);
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  // OpenSSL always starts with a one second timeout.
+  (void)initial_timeout;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+bool engine::retransmit_timeout(
+    asio::chrono::steady_clock::duration& timeout) const
+{
+  struct timeval tv;
+  if (::DTLSv1_get_timeout(ssl_, &tv) != 1)
+    return false;
+
+  timeout = asio::chrono::seconds(tv.tv_sec)
+    + asio::chrono::microseconds(tv.tv_usec);
+
+  // Wake up in time to enforce the handshake deadline.
+  if (handshake_started_
+      && handshake_timeout_ > asio::chrono::steady_clock::duration::zero())
+  {
+    asio::chrono::steady_clock::duration remaining =
+      handshake_deadline_ - asio::chrono::steady_clock::now();
+    if (remaining < asio::chrono::steady_clock::duration::zero())
+      remaining = asio::chrono::steady_clock::duration::zero();
+    if (remaining < timeout)
+      timeout = remaining;
+  }
+
+  return true;
+}
+
+engine::want engine::handle_timeout(asio::error_code& ec)
+{
+  if (handshake_started_
+      && handshake_timeout_ > asio::chrono::steady_clock::duration::zero()
+      && asio::chrono::steady_clock::now() >= handshake_deadline_)
+  {
+    ec = asio::error::timed_out;
+    return want_nothing;
+  }
+
+  // Give up rather than retransmit once more.
+  struct timeval tv;
+  if (::DTLSv1_get_timeout(ssl_, &tv) == 1
+      && tv.tv_sec == 0 && tv.tv_usec == 0
+      && retransmits_ >= max_retransmits_)
+  {
+    ec = asio::error::timed_out;
+    return want_nothing;
+  }
+
+  std::size_t pending_output_before = ::BIO_ctrl_pending(ext_bio_);
+  ::ERR_clear_error();
+  long result = ::DTLSv1_handle_timeout(ssl_);
+  if (result < 0)
+  {
+    int sys_error = static_cast<int>(::ERR_get_error());
+    ec = sys_error ? asio::error_code(sys_error,
+        asio::error::get_ssl_category()) : asio::error::timed_out;
+    return want_nothing;
+  }
+
+  if (result > 0)
+    ++retransmits_;
+
+  ec = asio::error_code();
+  return ::BIO_ctrl_pending(ext_bio_) > pending_output_before
+    ? want_output_and_retry : want_input_and_retry;
 }
 
 engine::want engine::shutdown(asio::error_code& ec)
 {
+  if (record_layer_ && record_layer_->is_active())
+  {
+    // OpenSSL no longer knows the record numbers, so send the close_notify
+    // alert ourselves.
+    if ((::SSL_get_shutdown(ssl_) & SSL_SENT_SHUTDOWN) == 0)
+    {
+      static const unsigned char close_notify[2] = { 1, 0 };
+      pending_record record = { record_layer::alert,
+        asio::buffer(close_notify), asio::mutable_buffer(), 0, 0 };
+      pending_records_.push_back(record);
+      int state = ::SSL_get_shutdown(ssl_) | SSL_SENT_SHUTDOWN;
+      ::SSL_set_shutdown(ssl_, state);
+
+      ec = asio::error_code();
+      return (state & SSL_RECEIVED_SHUTDOWN)
+        ? want_output : want_output_and_retry;
+    }
+
+    // Then wait for the peer's close_notify, discarding any data before it.
+    // As with SSL_shutdown, completion is reported as eof.
+    while ((::SSL_get_shutdown(ssl_) & SSL_RECEIVED_SHUTDOWN) == 0)
+    {
+      unsigned char discard[1];
+      std::size_t bytes_transferred = 0;
+      record_leftover_ = asio::const_buffer();
+      want result = read_record(asio::buffer(discard), ec, bytes_transferred);
+      if (result == want_input_and_retry || result == want_output_and_retry)
+        return result;
+      if (ec && ec != asio::error::eof)
+        return want_nothing;
+    }
+
+    ec = asio::error::eof;
+    return want_nothing;
+  }
+
   return perform(&engine::do_shutdown, 0, 0, ec, 0);
 }
 
@@ -260,6 +634,35 @@ engine::want engine::write(const asio::const_buffer& data,
     return engine::want_nothing;
   }
 
+  if (record_layer_ && record_layer_->is_active())
+  {
+    if (data.size() > SSL3_RT_MAX_PLAIN_LENGTH)
+    {
+      ec = asio::error::message_size;
+      return want_nothing;
+    }
+
+    // Seal the record now, so that a failure is reported to the writer. The
+    // buffer is reused once all records sealed into it have been taken.
+    if (pending_records_.empty())
+      sealed_output_.clear();
+    std::size_t offset = sealed_output_.size();
+    sealed_output_.resize(offset
+        + record_headroom() + data.size() + record_tailroom());
+    std::size_t size = record_layer_->seal(record_layer::application_data,
+        data, asio::buffer(sealed_output_) + offset, ec);
+    sealed_output_.resize(offset + size);
+    if (ec)
+      return want_nothing;
+
+    pending_record record = { record_layer::application_data,
+      asio::const_buffer(), asio::mutable_buffer(), offset, size };
+    pending_records_.push_back(record);
+
+    bytes_transferred = data.size();
+    return want_output;
+  }
+
   return perform(&engine::do_write,
       const_cast<void*>(data.data()),
       data.size(), ec, &bytes_transferred);
@@ -274,28 +677,480 @@ engine::want engine::read(const asio::mutable_buffer& data,
     return engine::want_nothing;
   }
 
-  return perform(&engine::do_read, data.data(),
+  if (record_layer_ && record_layer_->is_active())
+    return read_record(data, ec, bytes_transferred);
+
+  want result = perform(&engine::do_read, data.data(),
       data.size(), ec, &bytes_transferred);
+
+  // Application data from the peer means it has seen our final flight.
+  if (record_layer_ && !ec && result == want_nothing)
+  {
+    peer_finished_ = true;
+    try_activate_record_layer();
+  }
+
+  return result;
+}
+
+bool engine::payload_pending() const
+{
+  if (record_layer_ && record_layer_->is_active())
+    return migration_pending_ || record_leftover_.size() != 0;
+  return ::SSL_pending(ssl_) > 0;
+}
+
+bool engine::can_read_in_place() const
+{
+  return record_layer_ && record_layer_->is_active()
+    && !migration_pending_ && record_leftover_.size() == 0;
+}
+
+engine::want engine::read_in_place(asio::const_buffer& plaintext,
+    asio::error_code& ec)
+{
+  for (;;)
+  {
+    if (record_input_.size() == 0)
+    {
+      ec = asio::error_code();
+      return want_input_and_retry;
+    }
+
+    // The input was read into a buffer of the core, see put_input().
+    asio::mutable_buffer input(const_cast<void*>(record_input_.data()),
+        record_input_.size());
+    record_input_ = asio::const_buffer();
+
+    unsigned char content_type = 0;
+    if (!record_layer_->open_in_place(input, content_type, plaintext))
+      continue;
+
+    want result = handle_record(content_type,
+        static_cast<const unsigned char*>(plaintext.data()),
+        plaintext.size(), ec);
+    if (result != want_input_and_retry)
+      return result;
+  }
+}
+
+asio::error_code engine::enable_record_layer(asio::error_code& ec)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  if (!record_layer_)
+  {
+    record_layer* layer = new record_layer;
+    if (layer->init(ssl_, ec))
+    {
+      delete layer;
+      return ec;
+    }
+    record_layer_ = layer;
+
+    ssl_app_data* appdata =
+      static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+    if (appdata->isConnectionIdNegotiated())
+    {
+      std::string local_cid;
+      appdata->getLocalConnectionId(local_cid);
+      layer->set_connection_ids(appdata->getPeerConnectionId(), local_cid);
+    }
+
+    // The side that sent the final handshake flight must keep answering
+    // retransmissions through OpenSSL until the peer proves it has arrived.
+    bool sent_final_flight =
+      (::SSL_is_server(ssl_) != 0) != (::SSL_session_reused(ssl_) != 0);
+    peer_finished_ = !sent_final_flight;
+  }
+
+  try_activate_record_layer();
+
+  ec = asio::error_code();
+  return ec;
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  ec = asio::error::operation_not_supported;
+  return ec;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+std::size_t engine::record_headroom() const
+{
+  return record_layer_ ? record_layer_->headroom() : 0;
+}
+
+std::size_t engine::record_tailroom() const
+{
+  return record_layer_ ? record_layer_->tailroom() : 0;
+}
+
+engine::want engine::write_in_place(const asio::mutable_buffer& record,
+    std::size_t length, asio::error_code& ec,
+    std::size_t& bytes_transferred)
+{
+  if (record.size() < record_headroom() + length + record_tailroom())
+  {
+    ec = asio::error::invalid_argument;
+    return want_nothing;
+  }
+
+  if (!record_layer_ || !record_layer_->is_active())
+    return write(asio::buffer(record + record_headroom(), length),
+        ec, bytes_transferred);
+
+  if (length == 0)
+  {
+    ec = asio::error_code();
+    return want_nothing;
+  }
+
+  if (length > SSL3_RT_MAX_PLAIN_LENGTH)
+  {
+    ec = asio::error::message_size;
+    return want_nothing;
+  }
+
+  std::size_t size = record_layer_->seal_in_place(
+      record_layer::application_data, record, length, ec);
+  if (ec)
+    return want_nothing;
+
+  pending_record pending = { record_layer::application_data,
+    asio::const_buffer(), asio::buffer(record, size), 0, 0 };
+  pending_records_.push_back(pending);
+
+  bytes_transferred = length;
+  return want_output;
+}
+
+record_layer* engine::active_record_layer()
+{
+  return record_layer_ && record_layer_->is_active() ? record_layer_ : 0;
+}
+
+engine::want engine::accept_record(unsigned char content_type, uint64_t seq,
+    const asio::const_buffer& plaintext, asio::error_code& ec)
+{
+  if (!record_layer_ || !record_layer_->accept_sequence(seq))
+  {
+    ec = asio::error_code();
+    return want_input_and_retry;
+  }
+
+  return handle_record(content_type,
+      static_cast<const unsigned char*>(plaintext.data()),
+      plaintext.size(), ec);
+}
+
+engine::want engine::write_sealed(const asio::mutable_buffer& record,
+    asio::error_code& ec)
+{
+  pending_record pending = { record_layer::application_data,
+    asio::const_buffer(), record, 0, 0 };
+  pending_records_.push_back(pending);
+
+  ec = asio::error_code();
+  return want_output;
 }
 
 asio::mutable_buffer engine::get_output(
     const asio::mutable_buffer& data)
 {
-  int length = ::BIO_read(ext_bio_,
-      data.data(), static_cast<int>(data.size()));
+  last_output_ = taken_output_;
+
+  // Records are sent one per datagram, so that none exceeds the path MTU
+  // because of another.
+  while (!pending_records_.empty() && ::BIO_ctrl_pending(ext_bio_) == 0)
+  {
+    pending_record record = pending_records_.front();
+    pending_records_.pop_front();
+    ++taken_output_.records;
+
+    if (record.content_type == record_layer::heartbeat)
+    {
+      if (heartbeat_request_queued_
+          && record.payload.data() == &heartbeat_request_[0])
+      {
+        heartbeat_request_queued_ = false;
+        heartbeat_sent_ = asio::chrono::steady_clock::now();
+      }
+      else
+        heartbeat_response_queued_ = false;
+    }
+
+    if (record.sealed.size() != 0)
+      return record.sealed;
+
+    if (record.output_length != 0)
+      return asio::buffer(asio::buffer(sealed_output_)
+          + record.output_offset, record.output_length);
+
+    asio::error_code ec;
+    std::size_t length = record_layer_->seal(
+        record.content_type, record.payload, data, ec);
+    if (!ec)
+      return asio::buffer(data, length);
+  }
+
+  int length = ::BIO_read(ext_bio_, data.data(),
+      static_cast<int>(datagram_length(data.size())));
+
+  asio::mutable_buffer output(asio::buffer(data,
+      length > 0 ? static_cast<std::size_t>(length) : 0));
+  taken_output_.bytes += output.size();
+
+  if (!record_layer_ || !record_layer_->is_active())
+  {
+    record_layer::track(output, written_);
+    try_activate_record_layer();
+  }
+
+  return output;
+}
+
+bool engine::output_pending() const
+{
+  return ::BIO_ctrl_pending(ext_bio_) != 0 || !pending_records_.empty();
+}
+
+engine::output_position engine::queued_output() const
+{
+  output_position position = taken_output_;
+  position.bytes += ::BIO_ctrl_pending(ext_bio_);
+  position.records += pending_records_.size();
+  return position;
+}
+
+engine::output_position engine::taken_output() const
+{
+  return taken_output_;
+}
+
+engine::output_position engine::last_output() const
+{
+  return last_output_;
+}
+
+std::size_t engine::datagram_length(std::size_t limit)
+{
+  // OpenSSL sizes handshake fragments to the MTU, but a flight reaches the
+  // BIO pair as one stream. Cut it at record boundaries so that no datagram
+  // exceeds the MTU.
+  int link_mtu = mtu();
+  if (link_mtu <= 0
+      || ::BIO_ctrl_pending(ext_bio_) <= static_cast<std::size_t>(link_mtu))
+    return limit;
+
+  char* pending = 0;
+  int available = ::BIO_nread0(ext_bio_, &pending);
+  if (available <= 0)
+    return limit;
+
+  std::size_t length = 0;
+  asio::const_buffer rest(pending, static_cast<std::size_t>(available));
+  while (std::size_t size = record_layer::record_length(rest))
+  {
+    if (length != 0 && length + size > static_cast<std::size_t>(link_mtu))
+      break;
+    length += size;
+    rest = rest + size;
+  }
 
-  return asio::buffer(data,
-      length > 0 ? static_cast<std::size_t>(length) : 0);
+  // Records that wrap around the end of the BIO's buffer are sent together.
+  return length != 0 && length < limit ? length : limit;
 }
 
 asio::const_buffer engine::put_input(
     const asio::const_buffer& data)
 {
+  // OpenSSL does not understand records with a connection ID or heartbeat
+  // records. The first one shows that the peer has finished the handshake,
+  // but only once it has been authenticated, as anyone can send the header.
+  // Until then the datagram goes to OpenSSL, which drops it.
+  if (record_layer_ && !record_layer_->is_active() && data.size() != 0
+      && (*static_cast<const unsigned char*>(data.data())
+          == record_layer::tls12_cid
+        || *static_cast<const unsigned char*>(data.data())
+          == record_layer::heartbeat))
+  {
+    asio::const_buffer record(asio::buffer(data,
+          record_layer_->received_record_length(data)));
+    record_scratch_.resize(record_layer_->max_payload_length(record) + 1);
+    if (record.size() != 0
+        && record_layer_->authenticate(record, asio::buffer(record_scratch_)))
+    {
+      peer_finished_ = true;
+      try_activate_record_layer();
+    }
+  }
+
+  if (record_layer_ && record_layer_->is_active())
+  {
+    // Hand the records to read() one at a time. A malformed datagram is
+    // dropped as a whole.
+    std::size_t length = record_layer_->received_record_length(data);
+    record_input_ = asio::buffer(data, length);
+    return data + (length ? length : data.size());
+  }
+
   int length = ::BIO_write(ext_bio_,
       data.data(), static_cast<int>(data.size()));
 
-  return asio::buffer(data +
-      (length > 0 ? static_cast<std::size_t>(length) : 0));
+  std::size_t consumed = length > 0 ? static_cast<std::size_t>(length) : 0;
+
+  // Once the keys are known, records that still go through OpenSSL are also
+  // opened here, so that the replay window of the record layer holds them.
+  if (record_layer_ && record_layer_->is_initialized())
+  {
+    asio::const_buffer rest(asio::buffer(data, consumed));
+    while (std::size_t size = record_layer_->received_record_length(rest))
+    {
+      asio::const_buffer record(asio::buffer(rest, size));
+      record_scratch_.resize(record_layer_->max_payload_length(record) + 1);
+      unsigned char content_type = 0;
+      std::size_t plaintext_length = 0;
+      record_layer_->open(record, asio::buffer(record_scratch_),
+          content_type, plaintext_length);
+      rest = rest + size;
+    }
+  }
+
+  return asio::buffer(data + consumed);
+}
+
+std::string engine::connection_id() const
+{
+  std::string cid;
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+  if (appdata->isConnectionIdNegotiated())
+    appdata->getLocalConnectionId(cid);
+  return cid;
+}
+
+bool engine::accept_migration(const asio::const_buffer& datagram)
+{
+  if (!record_layer_ || !record_layer_->is_active() || connection_id().empty())
+    return false;
+
+  // Only a record newer than all others may move the session, so that
+  // replayed or delayed datagrams cannot divert it (RFC 9146 section 6).
+  std::size_t size = record_layer_->received_record_length(datagram);
+  if (size == 0)
+    return false;
+
+  // Opening the record marks it as received, so it must not be dropped.
+  std::vector<unsigned char> plaintext(
+      record_layer_->max_payload_length(asio::buffer(datagram, size)) + 1);
+  unsigned char content_type = 0;
+  std::size_t length = 0;
+  if (!record_layer_->open_newest(asio::buffer(datagram, size),
+        asio::buffer(plaintext), content_type, length))
+    return false;
+
+  plaintext.resize(length);
+  migration_plaintext_.swap(plaintext);
+  migration_content_type_ = content_type;
+  migration_pending_ = true;
+  return true;
+}
+
+engine::want engine::send_heartbeat(asio::error_code& ec)
+{
+  ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl_));
+  if (!appdata->isHeartbeatNegotiated()
+      || !appdata->getHeartbeatRequestsAllowed())
+  {
+    ec = asio::error::operation_not_supported;
+    return want_nothing;
+  }
+
+  ec = asio::error_code();
+  if (!record_layer_ || !record_layer_->is_active())
+    return want_nothing;
+
+  // Type, payload length, a payload made of the request number and random
+  // bytes, and the minimum padding of RFC 6520.
+  heartbeat_request_.resize(3 + 2 * heartbeat_payload_length);
+  unsigned char* p = &heartbeat_request_[0];
+  p[0] = heartbeat_request;
+  p[1] = 0;
+  p[2] = heartbeat_payload_length;
+  uint64_t count = ++heartbeat_count_;
+  for (int i = 10; i >= 3; --i, count >>= 8)
+    p[i] = static_cast<unsigned char>(count);
+  if (::RAND_bytes(p + 11, static_cast<int>(
+          heartbeat_request_.size() - 11)) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    return want_nothing;
+  }
+
+  // An unanswered request still waiting to be sent is replaced in place.
+  if (!heartbeat_request_queued_)
+  {
+    pending_record record = { record_layer::heartbeat,
+      asio::buffer(heartbeat_request_), asio::mutable_buffer(), 0, 0 };
+    pending_records_.push_back(record);
+    heartbeat_request_queued_ = true;
+  }
+  heartbeat_pending_ = true;
+
+  return want_output;
+}
+
+bool engine::heartbeat_pending() const
+{
+  return heartbeat_pending_;
+}
+
+asio::chrono::steady_clock::duration engine::heartbeat_rtt() const
+{
+  return heartbeat_rtt_;
+}
+
+bool engine::handle_heartbeat(
+    const unsigned char* message, std::size_t length)
+{
+  // Messages whose payload and padding do not fit are discarded, as RFC 6520
+  // requires.
+  if (length < 3)
+    return false;
+  std::size_t payload_length = (message[1] << 8) | message[2];
+  if (3 + payload_length + heartbeat_payload_length > length)
+    return false;
+
+  if (message[0] == heartbeat_request)
+  {
+    // A response that was not sent yet is dropped along with the request.
+    if (heartbeat_response_queued_)
+      return false;
+
+    heartbeat_response_.resize(3 + payload_length + heartbeat_payload_length);
+    unsigned char* p = &heartbeat_response_[0];
+    p[0] = heartbeat_response;
+    std::memcpy(p + 1, message + 1, 2 + payload_length);
+    if (::RAND_bytes(p + 3 + payload_length, heartbeat_payload_length) != 1)
+      return false;
+
+    pending_record record = { record_layer::heartbeat,
+      asio::buffer(heartbeat_response_), asio::mutable_buffer(), 0, 0 };
+    pending_records_.push_back(record);
+    heartbeat_response_queued_ = true;
+    return true;
+  }
+
+  if (message[0] == heartbeat_response && heartbeat_pending_
+      && !heartbeat_request_queued_
+      && payload_length == heartbeat_payload_length
+      && std::memcmp(message + 3, &heartbeat_request_[3],
+        heartbeat_payload_length) == 0)
+  {
+    heartbeat_rtt_ = asio::chrono::steady_clock::now() - heartbeat_sent_;
+    heartbeat_pending_ = false;
+  }
+
+  return false;
 }
 
 const asio::error_code& engine::map_error_code(
@@ -328,6 +1183,21 @@ const asio::error_code& engine::map_error_code(
   return ec;
 }
 
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+unsigned int engine::retransmit_timer_function(
+    SSL* ssl, unsigned int previous_timeout_us)
+{
+  if (previous_timeout_us == 0)
+  {
+    ssl_app_data* appdata = static_cast<ssl_app_data*>(SSL_get_app_data(ssl));
+    return appdata->getRetransmitTimeout();
+  }
+
+  // Back off exponentially, up to the 60 seconds allowed by RFC 6347.
+  return previous_timeout_us >= 30000000 ? 60000000 : previous_timeout_us * 2;
+}
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+
 #if (OPENSSL_VERSION_NUMBER < 0x10000000L)
 asio::detail::static_mutex& engine::accept_mutex()
 {
@@ -342,7 +1212,12 @@ engine::want engine::perform(int (engine::* op)(void*, std::size_t),
 {
   std::size_t pending_output_before = ::BIO_ctrl_pending(ext_bio_);
   ::ERR_clear_error();
-  int result = (this->*op)(data, length);
+  int result = 0;
+  {
+    // Lets private key methods find the engine whose handshake they sign.
+    asio::detail::call_stack<engine, engine>::context ctx(this, *this);
+    result = (this->*op)(data, length);
+  }
   int ssl_error = ::SSL_get_error(ssl_, result);
   int sys_error = static_cast<int>(::ERR_get_error());
   std::size_t pending_output_after = ::BIO_ctrl_pending(ext_bio_);
@@ -364,6 +1239,14 @@ engine::want engine::perform(int (engine::* op)(void*, std::size_t),
   if (result > 0 && bytes_transferred)
     *bytes_transferred = static_cast<std::size_t>(result);
 
+#if defined(SSL_ERROR_WANT_ASYNC)
+  if (ssl_error == SSL_ERROR_WANT_ASYNC)
+  {
+    ec = asio::error_code();
+    return want_private_key_and_retry;
+  }
+#endif // defined(SSL_ERROR_WANT_ASYNC)
+
   if (ssl_error == SSL_ERROR_WANT_WRITE)
   {
     ec = asio::error_code();
@@ -391,6 +1274,137 @@ engine::want engine::perform(int (engine::* op)(void*, std::size_t),
   }
 }
 
+void engine::try_activate_record_layer()
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  if (record_layer_ && !record_layer_->is_active() && peer_finished_
+      && ::SSL_is_init_finished(ssl_) && !::SSL_has_pending(ssl_)
+      && ::BIO_ctrl_pending(ext_bio_) == 0
+      && ::BIO_ctrl_wpending(ext_bio_) == 0)
+  {
+    record_layer_->activate(written_);
+  }
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+engine::want engine::read_record(const asio::mutable_buffer& data,
+    asio::error_code& ec, std::size_t& bytes_transferred)
+{
+  for (;;)
+  {
+    // Return what is left of a record that did not fit into the last read.
+    if (record_leftover_.size() != 0)
+    {
+      std::size_t length = asio::buffer_copy(data, record_leftover_);
+      record_leftover_ = record_leftover_ + length;
+
+      ec = asio::error_code();
+      bytes_transferred = length;
+      return want_nothing;
+    }
+
+    // The record that moved the session comes before any new input.
+    if (migration_pending_)
+    {
+      migration_pending_ = false;
+      want result = handle_record(migration_content_type_,
+          migration_plaintext_.data(), migration_plaintext_.size(), ec);
+      if (result == want_input_and_retry)
+        continue;
+      if (result != want_nothing || ec)
+        return result;
+
+      record_leftover_ = asio::buffer(migration_plaintext_);
+      continue;
+    }
+
+    if (record_input_.size() == 0)
+    {
+      ec = asio::error_code();
+      return want_input_and_retry;
+    }
+
+    asio::const_buffer input = record_input_;
+    record_input_ = asio::const_buffer();
+
+    // Open straight into the caller's buffer if the plaintext fits.
+    std::size_t max_length = record_layer_->max_payload_length(input);
+    asio::mutable_buffer output = data;
+    if (max_length > data.size())
+    {
+      record_scratch_.resize(max_length);
+      output = asio::buffer(record_scratch_);
+    }
+
+    unsigned char content_type = 0;
+    std::size_t length = 0;
+    if (!record_layer_->open(input, output, content_type, length))
+      continue;
+
+    want result = handle_record(content_type,
+        static_cast<const unsigned char*>(output.data()), length, ec);
+    if (result == want_input_and_retry)
+      continue;
+    if (result != want_nothing || ec)
+      return result;
+
+    // Application data.
+    if (output.data() != data.data())
+    {
+      record_leftover_ = asio::buffer(output, length);
+      continue;
+    }
+
+    bytes_transferred = length;
+    return want_nothing;
+  }
+}
+
+engine::want engine::handle_record(unsigned char content_type,
+    const unsigned char* plaintext, std::size_t length,
+    asio::error_code& ec)
+{
+  ec = asio::error_code();
+  switch (content_type)
+  {
+  case record_layer::application_data:
+    return length == 0 ? want_input_and_retry : want_nothing;
+
+  case record_layer::alert:
+    if (length != 2)
+      return want_input_and_retry;
+
+    if (plaintext[1] == SSL_AD_CLOSE_NOTIFY)
+    {
+      ::SSL_set_shutdown(ssl_,
+          ::SSL_get_shutdown(ssl_) | SSL_RECEIVED_SHUTDOWN);
+      ec = asio::error::eof;
+      return want_nothing;
+    }
+
+    if (plaintext[0] == SSL3_AL_FATAL)
+    {
+      ec = asio::error_code(
+          static_cast<int>(ERR_PACK(ERR_LIB_SSL, 0,
+              SSL_AD_REASON_OFFSET + plaintext[1])),
+          asio::error::get_ssl_category());
+      return want_nothing;
+    }
+
+    return want_input_and_retry;
+
+  case record_layer::heartbeat:
+    // Send the response, then go on reading.
+    return handle_heartbeat(plaintext, length)
+      ? want_output_and_retry : want_input_and_retry;
+
+  default:
+    // Handshake messages after the session is established would start a
+    // renegotiation, which is not supported.
+    return want_input_and_retry;
+  }
+}
+
 int engine::do_dtls_listen(void* data, std::size_t length)
 {
 #if (OPENSSL_VERSION_NUMBER >= 0x1010003fL)
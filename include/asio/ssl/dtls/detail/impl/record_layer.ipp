@@ -0,0 +1,681 @@
+//
+// ssl/dtls/detail/impl/record_layer.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_IMPL_RECORD_LAYER_IPP
+#define ASIO_SSL_DTLS_DETAIL_IMPL_RECORD_LAYER_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstring>
+#include <string>
+#include "asio/error.hpp"
+#include "asio/ssl/dtls/detail/record_layer.hpp"
+#include "asio/ssl/error.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+#include <openssl/evp.h>
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+# include <openssl/kdf.h>
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+namespace record_layer_helpers {
+
+inline void put_uint16(unsigned char* p, uint16_t v)
+{
+  p[0] = static_cast<unsigned char>(v >> 8);
+  p[1] = static_cast<unsigned char>(v);
+}
+
+inline uint16_t get_uint16(const unsigned char* p)
+{
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline void put_uint48(unsigned char* p, uint64_t v)
+{
+  for (int i = 5; i >= 0; --i, v >>= 8)
+    p[i] = static_cast<unsigned char>(v);
+}
+
+inline uint64_t get_uint48(const unsigned char* p)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < 6; ++i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+// Record sequence numbers are 48 bits wide.
+const uint64_t max_seq = (uint64_t(1) << 48) - 1;
+
+// Fill the 13 bytes of additional data: epoch, sequence number, content type,
+// version and payload length.
+inline void make_aad(unsigned char* aad, const unsigned char* seq_num,
+    unsigned char content_type, std::size_t length)
+{
+  std::memcpy(aad, seq_num, 8);
+  aad[8] = content_type;
+  aad[9] = 0xfe;
+  aad[10] = 0xfd;
+  put_uint16(aad + 11, static_cast<uint16_t>(length));
+}
+
+// Fill the additional data of a record with a connection ID, as defined by
+// RFC 9146 section 5.1. Returns its length.
+inline std::size_t make_cid_aad(unsigned char* aad,
+    const unsigned char* seq_num, const std::string& cid, std::size_t length)
+{
+  std::memset(aad, 0xff, 8);
+  aad[8] = record_layer::tls12_cid;
+  aad[9] = static_cast<unsigned char>(cid.size());
+  aad[10] = record_layer::tls12_cid;
+  aad[11] = 0xfe;
+  aad[12] = 0xfd;
+  std::memcpy(aad + 13, seq_num, 8);
+  std::memcpy(aad + 21, cid.data(), cid.size());
+  put_uint16(aad + 21 + cid.size(), static_cast<uint16_t>(length));
+  return 23 + cid.size();
+}
+
+} // namespace record_layer_helpers
+
+record_layer::record_layer()
+  : active_(false),
+    seal_ctx_(0),
+    open_ctx_(0),
+    fixed_iv_length_(0),
+    explicit_nonce_length_(0),
+    tag_length_(0),
+    epoch_(0),
+    write_seq_(0),
+    read_seq_(0),
+    replay_bitmap_(0)
+{
+}
+
+record_layer::~record_layer()
+{
+  reset();
+}
+
+void record_layer::reset()
+{
+  if (seal_ctx_)
+    ::EVP_CIPHER_CTX_free(seal_ctx_);
+  if (open_ctx_)
+    ::EVP_CIPHER_CTX_free(open_ctx_);
+  active_ = false;
+  seal_ctx_ = 0;
+  open_ctx_ = 0;
+  ::OPENSSL_cleanse(write_iv_, sizeof(write_iv_));
+  ::OPENSSL_cleanse(read_iv_, sizeof(read_iv_));
+}
+
+bool record_layer::is_supported(const SSL_CIPHER* cipher)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  switch (cipher ? ::SSL_CIPHER_get_cipher_nid(cipher) : NID_undef)
+  {
+  case NID_aes_128_gcm:
+  case NID_aes_256_gcm:
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+  case NID_chacha20_poly1305:
+#endif // !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+    return true;
+  default:
+    return false;
+  }
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  (void)cipher;
+  return false;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+void record_layer::set_connection_ids(
+    const std::string& write_cid, const std::string& read_cid)
+{
+  write_cid_ = write_cid;
+  read_cid_ = read_cid;
+}
+
+asio::error_code record_layer::init(SSL* ssl, asio::error_code& ec)
+{
+  reset();
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  if (::SSL_version(ssl) != DTLS1_2_VERSION || !::SSL_is_init_finished(ssl))
+  {
+    ec = asio::error::operation_not_supported;
+    return ec;
+  }
+
+  const SSL_CIPHER* cipher = ::SSL_get_current_cipher(ssl);
+  const EVP_CIPHER* evp_cipher = 0;
+  std::size_t key_length = 0;
+  switch (cipher ? ::SSL_CIPHER_get_cipher_nid(cipher) : NID_undef)
+  {
+  case NID_aes_128_gcm:
+    evp_cipher = ::EVP_aes_128_gcm();
+    key_length = 16;
+    fixed_iv_length_ = 4;
+    explicit_nonce_length_ = 8;
+    break;
+  case NID_aes_256_gcm:
+    evp_cipher = ::EVP_aes_256_gcm();
+    key_length = 32;
+    fixed_iv_length_ = 4;
+    explicit_nonce_length_ = 8;
+    break;
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+  case NID_chacha20_poly1305:
+    evp_cipher = ::EVP_chacha20_poly1305();
+    key_length = 32;
+    fixed_iv_length_ = 12;
+    explicit_nonce_length_ = 0;
+    break;
+#endif // !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+  default:
+    ec = asio::error::operation_not_supported;
+    return ec;
+  }
+  tag_length_ = 16;
+
+  // Expand the master secret into the key block as in RFC 5246 section 6.3.
+  // AEAD ciphers use no MAC keys, so the block starts with the write keys.
+  unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+  std::size_t master_length = ::SSL_SESSION_get_master_key(
+      ::SSL_get_session(ssl), master, sizeof(master));
+  unsigned char randoms[2 * SSL3_RANDOM_SIZE];
+  ::SSL_get_server_random(ssl, randoms, SSL3_RANDOM_SIZE);
+  ::SSL_get_client_random(ssl, randoms + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+  unsigned char key_block[2 * 32 + 2 * 12];
+  std::size_t key_block_length = 2 * (key_length + fixed_iv_length_);
+  static const char label[] = "key expansion";
+
+  ::ERR_clear_error();
+  EVP_PKEY_CTX* pctx = ::EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, 0);
+  bool derived = pctx
+    && ::EVP_PKEY_derive_init(pctx) > 0
+    && ::EVP_PKEY_CTX_set_tls1_prf_md(pctx,
+        ::SSL_CIPHER_get_handshake_digest(cipher)) > 0
+    && ::EVP_PKEY_CTX_set1_tls1_prf_secret(pctx,
+        master, static_cast<int>(master_length)) > 0
+    && ::EVP_PKEY_CTX_add1_tls1_prf_seed(pctx,
+        reinterpret_cast<const unsigned char*>(label),
+        static_cast<int>(sizeof(label) - 1)) > 0
+    && ::EVP_PKEY_CTX_add1_tls1_prf_seed(pctx,
+        randoms, static_cast<int>(sizeof(randoms))) > 0
+    && ::EVP_PKEY_derive(pctx, key_block, &key_block_length) > 0;
+  if (pctx)
+    ::EVP_PKEY_CTX_free(pctx);
+  ::OPENSSL_cleanse(master, sizeof(master));
+
+  if (!derived)
+  {
+    ::OPENSSL_cleanse(key_block, sizeof(key_block));
+    ec = asio::error_code(static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    return ec;
+  }
+
+  const unsigned char* client_key = key_block;
+  const unsigned char* server_key = client_key + key_length;
+  const unsigned char* client_iv = server_key + key_length;
+  const unsigned char* server_iv = client_iv + fixed_iv_length_;
+  bool is_server = ::SSL_is_server(ssl) != 0;
+
+  std::memcpy(write_iv_, is_server ? server_iv : client_iv, fixed_iv_length_);
+  std::memcpy(read_iv_, is_server ? client_iv : server_iv, fixed_iv_length_);
+
+  seal_ctx_ = ::EVP_CIPHER_CTX_new();
+  open_ctx_ = ::EVP_CIPHER_CTX_new();
+  bool ready = seal_ctx_ && open_ctx_
+    && ::EVP_EncryptInit_ex(seal_ctx_, evp_cipher, 0,
+        is_server ? server_key : client_key, 0) > 0
+    && ::EVP_DecryptInit_ex(open_ctx_, evp_cipher, 0,
+        is_server ? client_key : server_key, 0) > 0;
+  ::OPENSSL_cleanse(key_block, sizeof(key_block));
+
+  if (!ready)
+  {
+    ec = asio::error_code(static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    reset();
+    return ec;
+  }
+
+  // Renegotiation is not supported, so these are the keys of the first epoch.
+  epoch_ = 1;
+  write_seq_ = 0;
+  read_seq_ = 0;
+  replay_bitmap_ = 0;
+
+  ec = asio::error_code();
+  return ec;
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  (void)ssl;
+  ec = asio::error::operation_not_supported;
+  return ec;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+void record_layer::activate(const sequence_state& written)
+{
+  // Continue after the last record OpenSSL sent in the current epoch. The
+  // headers of received records are not authenticated before they have been
+  // opened, so they must not move the replay window.
+  write_seq_ = written.valid && written.epoch == epoch_ ? written.seq + 1 : 0;
+  active_ = true;
+}
+
+std::size_t record_layer::seal(unsigned char content_type,
+    const asio::const_buffer& payload, const asio::mutable_buffer& out,
+    asio::error_code& ec)
+{
+  if (write_seq_ > record_layer_helpers::max_seq)
+  {
+    ec = asio::error::message_size;
+    return 0;
+  }
+
+  std::size_t record_size = seal_detached(seal_ctx_,
+      content_type, payload, out, write_seq_, ec);
+  if (!ec)
+    ++write_seq_;
+  return record_size;
+}
+
+EVP_CIPHER_CTX* record_layer::new_seal_context() const
+{
+  return copy_context(seal_ctx_);
+}
+
+EVP_CIPHER_CTX* record_layer::new_open_context() const
+{
+  return copy_context(open_ctx_);
+}
+
+bool record_layer::reserve_sequence(std::size_t count, uint64_t& first)
+{
+  if (write_seq_ + count - 1 > record_layer_helpers::max_seq)
+    return false;
+
+  first = write_seq_;
+  write_seq_ += count;
+  return true;
+}
+
+std::size_t record_layer::seal_detached(EVP_CIPHER_CTX* ctx,
+    unsigned char content_type, const asio::const_buffer& payload,
+    const asio::mutable_buffer& out, uint64_t seq,
+    asio::error_code& ec) const
+{
+  using namespace record_layer_helpers;
+
+  std::size_t length = payload.size();
+  std::size_t record_size = headroom() + length + tailroom();
+  std::size_t header_size = header_length + write_cid_.size();
+  if (!ctx || out.size() < record_size || length > 16384)
+  {
+    ec = asio::error::invalid_argument;
+    return 0;
+  }
+
+  unsigned char* record = static_cast<unsigned char*>(out.data());
+  const unsigned char* in = static_cast<const unsigned char*>(payload.data());
+
+  // Record header: type, version, epoch, sequence number, connection ID,
+  // length. With a connection ID the real content type is encrypted behind
+  // the payload.
+  bool with_cid = !write_cid_.empty();
+  record[0] = with_cid ? static_cast<unsigned char>(tls12_cid) : content_type;
+  record[1] = 0xfe;
+  record[2] = 0xfd;
+  put_uint16(record + 3, epoch_);
+  put_uint48(record + 5, seq);
+  std::memcpy(record + 11, write_cid_.data(), write_cid_.size());
+  put_uint16(record + header_size - 2,
+      static_cast<uint16_t>(record_size - header_size));
+  const unsigned char* seq_num = record + 3;
+
+  // The explicit nonce of AES-GCM is the epoch and sequence number, which
+  // are unique for the lifetime of the keys.
+  std::memcpy(record + header_size, seq_num, explicit_nonce_length_);
+
+  unsigned char nonce[12];
+  make_nonce(write_iv_, seq_num, nonce);
+  unsigned char aad[23 + 255];
+  std::size_t inner_length = length + (with_cid ? 1 : 0);
+  std::size_t aad_length = 13;
+  if (with_cid)
+    aad_length = make_cid_aad(aad, seq_num, write_cid_, inner_length);
+  else
+    make_aad(aad, seq_num, content_type, length);
+
+  unsigned char* ciphertext = record + headroom();
+  int outl = 0;
+  bool sealed = ::EVP_EncryptInit_ex(ctx, 0, 0, 0, nonce) > 0
+    && ::EVP_EncryptUpdate(ctx, 0, &outl,
+        aad, static_cast<int>(aad_length)) > 0
+    && ::EVP_EncryptUpdate(ctx, ciphertext, &outl,
+        in, static_cast<int>(length)) > 0
+    && (!with_cid || ::EVP_EncryptUpdate(ctx, ciphertext + length,
+        &outl, &content_type, 1) > 0)
+    && ::EVP_EncryptFinal_ex(ctx, ciphertext + inner_length, &outl) > 0
+    && ::EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG,
+        static_cast<int>(tag_length_), ciphertext + inner_length) > 0;
+
+  if (!sealed)
+  {
+    ec = asio::error_code(static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    return 0;
+  }
+
+  ec = asio::error_code();
+  return record_size;
+}
+
+std::size_t record_layer::seal_in_place(unsigned char content_type,
+    const asio::mutable_buffer& record, std::size_t length,
+    asio::error_code& ec)
+{
+  if (record.size() < headroom() + length + tailroom())
+  {
+    ec = asio::error::invalid_argument;
+    return 0;
+  }
+
+  // EVP AEAD contexts allow the output to alias the input exactly.
+  return seal(content_type,
+      asio::buffer(static_cast<const unsigned char*>(record.data())
+        + headroom(), length), record, ec);
+}
+
+std::size_t record_layer::record_length(const asio::const_buffer& data)
+{
+  return record_length(data, 0);
+}
+
+std::size_t record_layer::record_length(
+    const asio::const_buffer& data, std::size_t cid_length)
+{
+  const unsigned char* p = static_cast<const unsigned char*>(data.data());
+  if (data.size() < header_length)
+    return 0;
+
+  std::size_t header_size = header_length
+    + (p[0] == tls12_cid ? cid_length : 0);
+  if (data.size() < header_size)
+    return 0;
+
+  std::size_t length = header_size
+    + record_layer_helpers::get_uint16(p + header_size - 2);
+  return length <= data.size() ? length : 0;
+}
+
+bool record_layer::open(const asio::const_buffer& record,
+    const asio::mutable_buffer& out, unsigned char& content_type,
+    std::size_t& length)
+{
+  return do_open(record, out, content_type, length, false);
+}
+
+bool record_layer::open_newest(const asio::const_buffer& record,
+    const asio::mutable_buffer& out, unsigned char& content_type,
+    std::size_t& length)
+{
+  return do_open(record, out, content_type, length, true);
+}
+
+bool record_layer::open_in_place(const asio::mutable_buffer& record,
+    unsigned char& content_type, asio::const_buffer& plaintext)
+{
+  // AEAD ciphers may decrypt over their input, so the plaintext is written
+  // to where the ciphertext starts.
+  std::size_t offset = header_length + read_cid_.size()
+    + explicit_nonce_length_;
+  if (record.size() < offset)
+    return false;
+
+  asio::mutable_buffer out = record + offset;
+  std::size_t length = 0;
+  if (!do_open(record, out, content_type, length, false))
+    return false;
+
+  plaintext = asio::buffer(out, length);
+  return true;
+}
+
+bool record_layer::authenticate(const asio::const_buffer& record,
+    const asio::mutable_buffer& scratch) const
+{
+  if (record.size() < header_length)
+    return false;
+
+  uint64_t seq = record_layer_helpers::get_uint48(
+      static_cast<const unsigned char*>(record.data()) + 5);
+  unsigned char content_type = 0;
+  std::size_t length = 0;
+  return check_replay(seq)
+    && open_detached(open_ctx_, record, scratch, content_type, length, seq);
+}
+
+bool record_layer::accept_sequence(uint64_t seq)
+{
+  if (!check_replay(seq))
+    return false;
+
+  update_replay(seq);
+  return true;
+}
+
+bool record_layer::do_open(const asio::const_buffer& record,
+    const asio::mutable_buffer& out, unsigned char& content_type,
+    std::size_t& length, bool newest_only)
+{
+  // Replays are rejected before spending time on the decryption.
+  if (record.size() < header_length)
+    return false;
+
+  uint64_t seq = record_layer_helpers::get_uint48(
+      static_cast<const unsigned char*>(record.data()) + 5);
+  if (!check_replay(seq) || (newest_only && seq <= read_seq_))
+    return false;
+
+  if (!open_detached(open_ctx_, record, out, content_type, length, seq))
+    return false;
+
+  update_replay(seq);
+  return true;
+}
+
+bool record_layer::open_detached(EVP_CIPHER_CTX* ctx,
+    const asio::const_buffer& record, const asio::mutable_buffer& out,
+    unsigned char& content_type, std::size_t& length, uint64_t& seq) const
+{
+  using namespace record_layer_helpers;
+
+  const unsigned char* p = static_cast<const unsigned char*>(record.data());
+  std::size_t size = received_record_length(record);
+  bool with_cid = !read_cid_.empty();
+  std::size_t header_size = header_length + read_cid_.size();
+  std::size_t overhead = header_size + explicit_nonce_length_ + tag_length_;
+
+  // Malformed records, records from other epochs and replays are discarded
+  // silently, as required by RFC 6347 section 4.1.2.7. Once a connection ID
+  // has been negotiated, records must carry it.
+  if (!ctx || size < overhead + (with_cid ? 1 : 0)
+      || size != record.size() || p[1] != 0xfe
+      || (p[0] == tls12_cid) != with_cid
+      || std::memcmp(p + 11, read_cid_.data(), read_cid_.size()) != 0
+      || get_uint16(p + 3) != epoch_)
+    return false;
+
+  seq = get_uint48(p + 5);
+  length = size - overhead;
+  if (out.size() < length)
+    return false;
+
+  content_type = p[0];
+  const unsigned char* seq_num = p + 3;
+
+  // Rebuild the nonce. For AES-GCM the explicit part is taken from the record
+  // as the peer may use any unique value.
+  unsigned char nonce[12];
+  if (explicit_nonce_length_)
+  {
+    std::memcpy(nonce, read_iv_, fixed_iv_length_);
+    std::memcpy(nonce + fixed_iv_length_,
+        p + header_size, explicit_nonce_length_);
+  }
+  else
+  {
+    make_nonce(read_iv_, seq_num, nonce);
+  }
+
+  unsigned char aad[23 + 255];
+  std::size_t aad_length = 13;
+  if (with_cid)
+    aad_length = make_cid_aad(aad, seq_num, read_cid_, length);
+  else
+    make_aad(aad, seq_num, content_type, length);
+
+  const unsigned char* ciphertext = p + header_size + explicit_nonce_length_;
+  unsigned char* plaintext = static_cast<unsigned char*>(out.data());
+  int outl = 0;
+  bool opened = ::EVP_DecryptInit_ex(ctx, 0, 0, 0, nonce) > 0
+    && ::EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+        static_cast<int>(tag_length_),
+        const_cast<unsigned char*>(ciphertext + length)) > 0
+    && ::EVP_DecryptUpdate(ctx, 0, &outl,
+        aad, static_cast<int>(aad_length)) > 0
+    && ::EVP_DecryptUpdate(ctx, plaintext, &outl,
+        ciphertext, static_cast<int>(length)) > 0
+    && ::EVP_DecryptFinal_ex(ctx, plaintext + outl, &outl) > 0;
+
+  if (!opened)
+  {
+    ::ERR_clear_error();
+    return false;
+  }
+
+  // The real content type is the last non-zero byte of the inner plaintext.
+  if (with_cid)
+  {
+    while (length > 0 && plaintext[length - 1] == 0)
+      --length;
+    if (length == 0)
+      return false;
+    content_type = plaintext[--length];
+  }
+
+  return true;
+}
+
+void record_layer::track(const asio::const_buffer& data,
+    sequence_state& state)
+{
+  using namespace record_layer_helpers;
+
+  asio::const_buffer rest(data);
+  while (std::size_t size = record_length(rest))
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(rest.data());
+    uint16_t epoch = get_uint16(p + 3);
+    uint64_t seq = get_uint48(p + 5);
+
+    if (!state.valid || epoch > state.epoch
+        || (epoch == state.epoch && seq > state.seq))
+    {
+      state.epoch = epoch;
+      state.seq = seq;
+      state.valid = true;
+    }
+
+    rest = rest + size;
+  }
+}
+
+EVP_CIPHER_CTX* record_layer::copy_context(EVP_CIPHER_CTX* ctx)
+{
+  if (!ctx)
+    return 0;
+
+  EVP_CIPHER_CTX* copy = ::EVP_CIPHER_CTX_new();
+  if (copy && ::EVP_CIPHER_CTX_copy(copy, ctx) <= 0)
+  {
+    ::EVP_CIPHER_CTX_free(copy);
+    ::ERR_clear_error();
+    copy = 0;
+  }
+  return copy;
+}
+
+void record_layer::make_nonce(const unsigned char* iv,
+    const unsigned char* seq_num, unsigned char* nonce) const
+{
+  if (explicit_nonce_length_)
+  {
+    std::memcpy(nonce, iv, fixed_iv_length_);
+    std::memcpy(nonce + fixed_iv_length_, seq_num, explicit_nonce_length_);
+  }
+  else
+  {
+    // RFC 7905: the padded 64-bit sequence number is xor'ed with the IV.
+    std::memcpy(nonce, iv, 12);
+    for (int i = 0; i < 8; ++i)
+      nonce[4 + i] ^= seq_num[i];
+  }
+}
+
+bool record_layer::check_replay(uint64_t seq) const
+{
+  if (seq > read_seq_)
+    return true;
+
+  uint64_t offset = read_seq_ - seq;
+  if (offset >= 64)
+    return false;
+
+  return (replay_bitmap_ & (uint64_t(1) << offset)) == 0;
+}
+
+void record_layer::update_replay(uint64_t seq)
+{
+  if (seq > read_seq_)
+  {
+    uint64_t shift = seq - read_seq_;
+    replay_bitmap_ = shift < 64 ? (replay_bitmap_ << shift) | 1 : 1;
+    read_seq_ = seq;
+  }
+  else
+  {
+    replay_bitmap_ |= uint64_t(1) << (read_seq_ - seq);
+  }
+}
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_IMPL_RECORD_LAYER_IPP
@@ -0,0 +1,66 @@
+//
+// ssl/dtls/detail/in_place_write_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_IN_PLACE_WRITE_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_IN_PLACE_WRITE_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+class in_place_write_op
+{
+public:
+  in_place_write_op(const asio::mutable_buffer& record, std::size_t length)
+    : record_(record),
+      length_(length)
+  {
+  }
+
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    return eng.write_in_place(record_, length_, ec, bytes_transferred);
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t& bytes_transferred) const
+  {
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  asio::mutable_buffer record_;
+  std::size_t length_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_IN_PLACE_WRITE_OP_HPP
@@ -0,0 +1,110 @@
+//
+// ssl/dtls/detail/lease_read_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_LEASE_READ_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_LEASE_READ_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/buffer_pool.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Reads the next message and passes a lease on it to the handler. Records
+// of the fast path are opened where they lie in the core's input block, and
+// the lease shares that block. Anything else is read into a block of its
+// own.
+class lease_read_op
+{
+public:
+  lease_read_op(buffer_pool& pool, const buffer_lease& input)
+    : pool_(&pool),
+      input_(&input)
+  {
+  }
+
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    if (!eng.can_read_in_place())
+    {
+      buffer_lease block = pool_->acquire();
+      engine_base::want result = eng.read(block.data(), ec, bytes_transferred);
+      if (result == engine_base::want_nothing && !ec)
+        result_ = buffer_lease(block,
+            asio::buffer(block.data(), bytes_transferred));
+      return result;
+    }
+
+    asio::const_buffer plaintext;
+    engine_base::want result = eng.read_in_place(plaintext, ec);
+    if (result != engine_base::want_nothing || ec)
+      return result;
+
+    // The input may still be in a buffer from before the pool was set.
+    const unsigned char* begin =
+      static_cast<const unsigned char*>(input_->data().data());
+    const unsigned char* p =
+      static_cast<const unsigned char*>(plaintext.data());
+    if (p >= begin && p + plaintext.size() <= begin + input_->size())
+    {
+      result_ = buffer_lease(*input_, asio::mutable_buffer(
+            const_cast<unsigned char*>(p), plaintext.size()));
+    }
+    else
+    {
+      buffer_lease block = pool_->acquire();
+      result_ = buffer_lease(block, asio::buffer(block.data(),
+            asio::buffer_copy(block.data(), plaintext)));
+    }
+
+    bytes_transferred = result_.size();
+    return result;
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t&) const
+  {
+    buffer_lease lease;
+    if (!ec)
+      lease.swap(result_);
+    handler(ec, ASIO_MOVE_CAST(buffer_lease)(lease));
+  }
+
+private:
+  buffer_pool* pool_;
+  const buffer_lease* input_;
+
+  // The lease on the message read last.
+  mutable buffer_lease result_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_LEASE_READ_OP_HPP
@@ -17,7 +17,8 @@
 
 #include "asio/detail/config.hpp"
 
-#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
 
 #include "asio/detail/push_options.hpp"
 
@@ -33,19 +34,20 @@ public:
   {
   }
 
-  ssl::dtls::detail::engine::want operator()(engine& eng,
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
       asio::error_code& ec,
       std::size_t& bytes_transferred) const
   {
     bytes_transferred = 0;
-    ssl::dtls::detail::engine::want result = eng.dtls_listen(ec);
+    engine_base::want result = eng.dtls_listen(ec);
 
-    if(result == ssl::dtls::detail::engine::want_output_and_retry)
+    if(result == engine_base::want_output_and_retry)
     {
-      result = ssl::dtls::detail::engine::want_output;
+      result = engine_base::want_output;
     }
 
-    if(result == ssl::dtls::detail::engine::want_output)
+    if(result == engine_base::want_output)
     {
       // This is not what we transfered, but allows to indicate a wrong cookie
       bytes_transferred = 0;
@@ -0,0 +1,229 @@
+//
+// ssl/dtls/detail/owned_send_handler.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_OWNED_SEND_HANDLER_HPP
+#define ASIO_SSL_DTLS_DETAIL_OWNED_SEND_HANDLER_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstddef>
+#include <new>
+#include "asio/associated_allocator.hpp"
+#include "asio/associated_cancellation_slot.hpp"
+#include "asio/associated_executor.hpp"
+#include "asio/buffer.hpp"
+#include "asio/detail/buffer_sequence_adapter.hpp"
+#include "asio/detail/handler_alloc_helpers.hpp"
+#include "asio/detail/handler_cont_helpers.hpp"
+#include "asio/detail/handler_invoke_helpers.hpp"
+#include "asio/detail/type_traits.hpp"
+#include "asio/error_code.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// The data of an owned buffer: the first buffer of a buffer sequence, or the
+// storage asio::buffer() finds in a container such as std::vector or
+// std::string.
+template <typename Buffer>
+inline asio::const_buffer owned_buffer_data(const Buffer& b,
+    typename enable_if<is_const_buffer_sequence<Buffer>::value>::type* = 0)
+{
+  return asio::detail::buffer_sequence_adapter<
+    asio::const_buffer, Buffer>::first(b);
+}
+
+template <typename Buffer>
+inline asio::const_buffer owned_buffer_data(const Buffer& b,
+    typename enable_if<!is_const_buffer_sequence<Buffer>::value>::type* = 0)
+{
+  return asio::buffer(b);
+}
+
+// Keeps the buffer of a send alive until its handler is called. The buffer
+// is moved into memory allocated through the handler's allocation hooks,
+// where its data stays put while the operation, and with it this handler,
+// is moved from step to step. The engine may hold on to the data until
+// another operation flushes it, so it must not move with the handler.
+template <typename Buffer, typename Handler>
+class owned_send_handler
+{
+public:
+  template <typename B>
+  owned_send_handler(ASIO_MOVE_ARG(B) buffer, Handler& handler)
+    : handler_(ASIO_MOVE_CAST(Handler)(handler)),
+      buffer_(0)
+  {
+    void* p = asio_handler_alloc_helpers::allocate(sizeof(Buffer), handler_);
+    buffer_ = new (p) Buffer(ASIO_MOVE_CAST(B)(buffer));
+  }
+
+  owned_send_handler(owned_send_handler&& other)
+    : handler_(ASIO_MOVE_CAST(Handler)(other.handler_)),
+      buffer_(other.buffer_)
+  {
+    other.buffer_ = 0;
+  }
+
+  // The buffer is freed with the handler if the operation never completes.
+  ~owned_send_handler()
+  {
+    release();
+  }
+
+  asio::const_buffer data() const
+  {
+    return owned_buffer_data(*buffer_);
+  }
+
+  // Free the buffer before the upcall, so that the handler may reuse the
+  // memory.
+  void operator()(const asio::error_code& ec, std::size_t bytes_transferred)
+  {
+    release();
+    handler_(ec, bytes_transferred);
+  }
+
+  void release()
+  {
+    if (buffer_)
+    {
+      buffer_->~Buffer();
+      asio_handler_alloc_helpers::deallocate(
+          buffer_, sizeof(Buffer), handler_);
+      buffer_ = 0;
+    }
+  }
+
+//private:
+  Handler handler_;
+  Buffer* buffer_;
+
+private:
+  // Disallow copying and assignment.
+  owned_send_handler(const owned_send_handler&);
+  owned_send_handler& operator=(const owned_send_handler&);
+};
+
+template <typename Buffer, typename Handler>
+inline void* asio_handler_allocate(std::size_t size,
+    owned_send_handler<Buffer, Handler>* this_handler)
+{
+  return asio_handler_alloc_helpers::allocate(
+      size, this_handler->handler_);
+}
+
+template <typename Buffer, typename Handler>
+inline void asio_handler_deallocate(void* pointer, std::size_t size,
+    owned_send_handler<Buffer, Handler>* this_handler)
+{
+  asio_handler_alloc_helpers::deallocate(
+      pointer, size, this_handler->handler_);
+}
+
+template <typename Buffer, typename Handler>
+inline bool asio_handler_is_continuation(
+    owned_send_handler<Buffer, Handler>* this_handler)
+{
+  return asio_handler_cont_helpers::is_continuation(
+      this_handler->handler_);
+}
+
+template <typename Function, typename Buffer, typename Handler>
+inline void asio_handler_invoke(Function& function,
+    owned_send_handler<Buffer, Handler>* this_handler)
+{
+  asio_handler_invoke_helpers::invoke(
+      function, this_handler->handler_);
+}
+
+template <typename Function, typename Buffer, typename Handler>
+inline void asio_handler_invoke(const Function& function,
+    owned_send_handler<Buffer, Handler>* this_handler)
+{
+  asio_handler_invoke_helpers::invoke(
+      function, this_handler->handler_);
+}
+
+// The handler of a send without one of the caller, counting the failures.
+class send_failure_counter
+{
+public:
+  explicit send_failure_counter(std::size_t& failures)
+    : failures_(&failures)
+  {
+  }
+
+  void operator()(const asio::error_code& ec, std::size_t)
+  {
+    if (ec)
+      ++*failures_;
+  }
+
+private:
+  std::size_t* failures_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+
+template <typename Buffer, typename Handler, typename Allocator>
+struct associated_allocator<
+    ssl::dtls::detail::owned_send_handler<Buffer, Handler>, Allocator>
+{
+  typedef typename associated_allocator<Handler, Allocator>::type type;
+
+  static type get(const ssl::dtls::detail::owned_send_handler<Buffer, Handler>& h,
+      const Allocator& a = Allocator()) ASIO_NOEXCEPT
+  {
+    return associated_allocator<Handler, Allocator>::get(h.handler_, a);
+  }
+};
+
+template <typename Buffer, typename Handler, typename Executor>
+struct associated_executor<
+    ssl::dtls::detail::owned_send_handler<Buffer, Handler>, Executor>
+{
+  typedef typename associated_executor<Handler, Executor>::type type;
+
+  static type get(const ssl::dtls::detail::owned_send_handler<Buffer, Handler>& h,
+      const Executor& ex = Executor()) ASIO_NOEXCEPT
+  {
+    return associated_executor<Handler, Executor>::get(h.handler_, ex);
+  }
+};
+
+template <typename Buffer, typename Handler, typename CancellationSlot>
+struct associated_cancellation_slot<
+    ssl::dtls::detail::owned_send_handler<Buffer, Handler>, CancellationSlot>
+{
+  typedef typename associated_cancellation_slot<
+    Handler, CancellationSlot>::type type;
+
+  static type get(const ssl::dtls::detail::owned_send_handler<Buffer, Handler>& h,
+      const CancellationSlot& s = CancellationSlot()) ASIO_NOEXCEPT
+  {
+    return associated_cancellation_slot<
+      Handler, CancellationSlot>::get(h.handler_, s);
+  }
+};
+
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_OWNED_SEND_HANDLER_HPP
@@ -0,0 +1,191 @@
+//
+// ssl/dtls/detail/path_mtu.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_PATH_MTU_HPP
+#define ASIO_SSL_DTLS_DETAIL_PATH_MTU_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstddef>
+#include "asio/error.hpp"
+#include "asio/detail/socket_option.hpp"
+#include "asio/detail/socket_types.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Queries the path MTU of a transport, so that the core can react to
+// datagrams that were too big for the path.
+class path_mtu_base
+{
+public:
+  // The IP and UDP header lengths, and the MTU every path has to support.
+  enum
+  {
+    udp_header_length = 8,
+    ipv4_header_length = 20,
+    ipv6_header_length = 40,
+    ipv4_minimum_mtu = 576,
+    ipv6_minimum_mtu = 1280,
+    default_link_mtu = 1500
+  };
+
+  virtual ~path_mtu_base()
+  {
+  }
+
+  // Get the largest UDP payload the path carries.
+  virtual std::size_t query(asio::error_code& ec) = 0;
+};
+
+template <typename SocketType>
+class path_mtu : public path_mtu_base
+{
+public:
+  explicit path_mtu(SocketType& socket)
+    : socket_(&socket)
+  {
+  }
+
+  // Stop the IP layer from fragmenting datagrams, so that a datagram too big
+  // for the path fails with error::message_size instead.
+  asio::error_code disable_fragmentation(asio::error_code& ec)
+  {
+    bool v6 = is_v6(ec);
+    if (ec)
+      return ec;
+
+    if (v6)
+    {
+#if defined(IPV6_MTU_DISCOVER) && defined(IPV6_PMTUDISC_DO)
+      socket_->lowest_layer().set_option(
+          asio::detail::socket_option::integer<
+            IPPROTO_IPV6, IPV6_MTU_DISCOVER>(IPV6_PMTUDISC_DO), ec);
+#elif defined(IPV6_DONTFRAG)
+      socket_->lowest_layer().set_option(
+          asio::detail::socket_option::integer<
+            IPPROTO_IPV6, IPV6_DONTFRAG>(1), ec);
+#else
+      ec = asio::error::operation_not_supported;
+#endif
+    }
+    else
+    {
+#if defined(IP_MTU_DISCOVER) && defined(IP_PMTUDISC_DO)
+      socket_->lowest_layer().set_option(
+          asio::detail::socket_option::integer<
+            IPPROTO_IP, IP_MTU_DISCOVER>(IP_PMTUDISC_DO), ec);
+#elif defined(IP_DONTFRAG)
+      socket_->lowest_layer().set_option(
+          asio::detail::socket_option::integer<
+            IPPROTO_IP, IP_DONTFRAG>(1), ec);
+#elif defined(IP_DONTFRAGMENT)
+      socket_->lowest_layer().set_option(
+          asio::detail::socket_option::integer<
+            IPPROTO_IP, IP_DONTFRAGMENT>(1), ec);
+#else
+      ec = asio::error::operation_not_supported;
+#endif
+    }
+
+    return ec;
+  }
+
+  // Get the path MTU the operating system learned from ICMP messages, less
+  // the IP and UDP headers. Requires a connected socket.
+  virtual std::size_t query(asio::error_code& ec)
+  {
+    bool v6 = is_v6(ec);
+    if (ec)
+      return 0;
+
+    int mtu = 0;
+    int header_length = 0;
+    int minimum_mtu = 0;
+    if (v6)
+    {
+#if defined(IPV6_MTU)
+      asio::detail::socket_option::integer<IPPROTO_IPV6, IPV6_MTU> option;
+      socket_->lowest_layer().get_option(option, ec);
+      mtu = option.value();
+#else
+      ec = asio::error::operation_not_supported;
+#endif
+      header_length = ipv6_header_length + udp_header_length;
+      minimum_mtu = ipv6_minimum_mtu;
+    }
+    else
+    {
+#if defined(IP_MTU)
+      asio::detail::socket_option::integer<IPPROTO_IP, IP_MTU> option;
+      socket_->lowest_layer().get_option(option, ec);
+      mtu = option.value();
+#else
+      ec = asio::error::operation_not_supported;
+#endif
+      header_length = ipv4_header_length + udp_header_length;
+      minimum_mtu = ipv4_minimum_mtu;
+    }
+
+    if (ec)
+      return 0;
+
+    // Never go below the minimum, which keeps a ClientHello in one datagram
+    // as the stateless cookie exchange requires.
+    if (mtu < minimum_mtu)
+      mtu = minimum_mtu;
+    return static_cast<std::size_t>(mtu - header_length);
+  }
+
+  // Get the UDP payload of a datagram that fills a typical Ethernet link.
+  std::size_t default_mtu(asio::error_code& ec)
+  {
+    bool v6 = is_v6(ec);
+    if (ec)
+      return 0;
+
+    return default_link_mtu - udp_header_length
+      - (v6 ? ipv6_header_length : ipv4_header_length);
+  }
+
+private:
+  bool is_v6(asio::error_code& ec)
+  {
+    int family = socket_->lowest_layer().local_endpoint(ec)
+      .protocol().family();
+    if (ec)
+      return false;
+
+    if (family != ASIO_OS_DEF(AF_INET) && family != ASIO_OS_DEF(AF_INET6))
+    {
+      ec = asio::error::operation_not_supported;
+      return false;
+    }
+
+    return family == ASIO_OS_DEF(AF_INET6);
+  }
+
+  SocketType* socket_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_PATH_MTU_HPP
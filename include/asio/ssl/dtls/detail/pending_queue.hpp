@@ -0,0 +1,259 @@
+//
+// ssl/dtls/detail/pending_queue.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_PENDING_QUEUE_HPP
+#define ASIO_SSL_DTLS_DETAIL_PENDING_QUEUE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <new>
+#include "asio/associated_cancellation_slot.hpp"
+#include "asio/detail/bind_handler.hpp"
+#include "asio/detail/handler_alloc_helpers.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/detail/type_traits.hpp"
+#include "asio/error.hpp"
+#include "asio/post.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Serializes one direction (read or write) of the underlying transport.
+//
+// At most one operation owns the queue at a time. Operations that cannot
+// take ownership are parked in an intrusive FIFO and, when the owner releases
+// the queue, ownership is handed directly to the first of them. The resumed
+// operation is posted to the socket's executor and invoked with a default
+// error_code. An operation cancelled through the slot of its handler while
+// parked leaves the queue and is invoked with operation_aborted instead.
+template <typename Executor>
+class pending_queue
+  : private noncopyable
+{
+public:
+  explicit pending_queue(const Executor& executor)
+    : executor_(executor),
+      owned_(false),
+      front_(0),
+      back_(0)
+  {
+  }
+
+#if defined(ASIO_HAS_MOVE)
+  // Move-construct a queue. Only valid while no operation is parked.
+  pending_queue(pending_queue&& other) ASIO_NOEXCEPT
+    : executor_(other.executor_),
+      owned_(other.owned_),
+      front_(other.front_),
+      back_(other.back_)
+  {
+    other.owned_ = false;
+    other.front_ = 0;
+    other.back_ = 0;
+  }
+
+  // Move-assign a queue. Only valid while no operation is parked.
+  pending_queue& operator=(pending_queue&& other) ASIO_NOEXCEPT
+  {
+    if (this != &other)
+    {
+      pending_queue tmp(ASIO_MOVE_CAST(pending_queue)(*this));
+      executor_ = other.executor_;
+      owned_ = other.owned_;
+      front_ = other.front_;
+      back_ = other.back_;
+      other.owned_ = false;
+      other.front_ = 0;
+      other.back_ = 0;
+    }
+    return *this;
+  }
+#endif // defined(ASIO_HAS_MOVE)
+
+  // Parked operations are destroyed without being invoked.
+  ~pending_queue()
+  {
+    while (waiter* w = front_)
+    {
+      front_ = w->next_;
+      w->destroy_(w);
+    }
+  }
+
+  // Take ownership if nobody else holds it. Returns true on success.
+  bool try_acquire()
+  {
+    if (owned_)
+      return false;
+
+    owned_ = true;
+    return true;
+  }
+
+  // Park an operation until ownership is handed over to it.
+  template <typename Handler>
+  void async_wait(ASIO_MOVE_ARG(Handler) handler)
+  {
+    typedef typename decay<Handler>::type handler_type;
+    typedef waiter_impl<handler_type> impl_type;
+
+    void* p = asio_handler_alloc_helpers::allocate(
+        sizeof(impl_type), handler);
+    impl_type* w = new (p) impl_type(handler);
+
+    if (back_)
+      back_->next_ = w;
+    else
+      front_ = w;
+    back_ = w;
+
+    typename associated_cancellation_slot<handler_type>::type slot =
+      asio::get_associated_cancellation_slot(w->handler_);
+    if (slot.is_connected())
+      slot.template emplace<canceller>(this, w);
+  }
+
+  // Give up ownership. If an operation is parked it becomes the new owner.
+  void release()
+  {
+    if (waiter* w = front_)
+    {
+      front_ = w->next_;
+      if (front_ == 0)
+        back_ = 0;
+      w->complete_(w, executor_, asio::error_code());
+    }
+    else
+    {
+      owned_ = false;
+    }
+  }
+
+private:
+  struct waiter
+  {
+    waiter* next_;
+    void (*complete_)(waiter*, const Executor&, const asio::error_code&);
+    void (*destroy_)(waiter*);
+  };
+
+  // Take a parked operation out of the queue and resume it with
+  // operation_aborted. Does nothing if it has been resumed already.
+  void cancel(waiter* target)
+  {
+    waiter* prev = 0;
+    for (waiter* w = front_; w; prev = w, w = w->next_)
+    {
+      if (w == target)
+      {
+        if (prev)
+          prev->next_ = w->next_;
+        else
+          front_ = w->next_;
+        if (back_ == w)
+          back_ = prev;
+        w->complete_(w, executor_, asio::error::operation_aborted);
+        return;
+      }
+    }
+  }
+
+  struct canceller
+  {
+    canceller(pending_queue* queue, waiter* w)
+      : queue_(queue),
+        waiter_(w)
+    {
+    }
+
+    void operator()(asio::cancellation_type_t)
+    {
+      queue_->cancel(waiter_);
+    }
+
+    pending_queue* queue_;
+    waiter* waiter_;
+  };
+
+  template <typename Handler>
+  struct waiter_impl : waiter
+  {
+    explicit waiter_impl(Handler& handler)
+      : handler_(ASIO_MOVE_CAST(Handler)(handler))
+    {
+      this->next_ = 0;
+      this->complete_ = &waiter_impl::do_complete;
+      this->destroy_ = &waiter_impl::do_destroy;
+    }
+
+    static void do_complete(waiter* base, const Executor& executor,
+        const asio::error_code& ec)
+    {
+      // Take the handler out and free the memory before the upcall, so the
+      // same memory can be reused by the posted operation. A handed over
+      // operation no longer listens to its slot, while a cancelled one is
+      // still running the canceller and leaves it to the operation.
+      waiter_impl* w = static_cast<waiter_impl*>(base);
+      Handler handler(ASIO_MOVE_CAST(Handler)(w->handler_));
+      w->~waiter_impl();
+      asio_handler_alloc_helpers::deallocate(w, sizeof(waiter_impl), handler);
+
+      if (!ec)
+        clear_slot(handler);
+
+      asio::post(executor, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(Handler)(handler), ec));
+    }
+
+    static void do_destroy(waiter* base)
+    {
+      waiter_impl* w = static_cast<waiter_impl*>(base);
+      Handler handler(ASIO_MOVE_CAST(Handler)(w->handler_));
+      clear_slot(handler);
+      w->~waiter_impl();
+      asio_handler_alloc_helpers::deallocate(w, sizeof(waiter_impl), handler);
+    }
+
+    static void clear_slot(Handler& handler)
+    {
+      typename associated_cancellation_slot<Handler>::type slot =
+        asio::get_associated_cancellation_slot(handler);
+      if (slot.is_connected())
+        slot.clear();
+    }
+
+    Handler handler_;
+  };
+
+  // The executor used to resume parked operations.
+  Executor executor_;
+
+  // Whether an operation currently owns the queue.
+  bool owned_;
+
+  // The parked operations, in arrival order.
+  waiter* front_;
+  waiter* back_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_PENDING_QUEUE_HPP
@@ -0,0 +1,531 @@
+//
+// ssl/dtls/detail/pipelined_receive_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_PIPELINED_RECEIVE_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_PIPELINED_RECEIVE_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <new>
+#include <vector>
+#include "asio/associated_allocator.hpp"
+#include "asio/associated_cancellation_slot.hpp"
+#include "asio/associated_executor.hpp"
+#include "asio/buffer.hpp"
+#include "asio/cancellation_signal.hpp"
+#include "asio/detail/bind_handler.hpp"
+#include "asio/detail/handler_alloc_helpers.hpp"
+#include "asio/detail/handler_cont_helpers.hpp"
+#include "asio/detail/handler_invoke_helpers.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/error.hpp"
+#include "asio/error_code.hpp"
+#include "asio/executor_work_guard.hpp"
+#include "asio/post.hpp"
+#include "asio/ssl/dtls/detail/crypto_pipeline.hpp"
+#include "asio/ssl/dtls/detail/datagram_helper.hpp"
+#include "asio/ssl/dtls/detail/datagram_io.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+#include "asio/ssl/dtls/detail/read_op.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Sends whatever output the engine has queued, such as a heartbeat response.
+class flush_op
+{
+public:
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    ec = asio::error_code();
+    bytes_transferred = 0;
+    return eng.output_pending()
+      ? engine_base::want_output : engine_base::want_nothing;
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t& bytes_transferred) const
+  {
+    handler(ec, bytes_transferred);
+  }
+};
+
+// A step of a pipelined_receive_op on the transport. The steps allocate,
+// run and are cancelled through the op's handler, and the op's own signal
+// cancels its reads and receives, and nothing else on the transport.
+template <typename Operation>
+class pipelined_receive_step
+{
+public:
+  enum kind { acquire, read, receive, flush };
+
+  pipelined_receive_step(Operation* op, kind k)
+    : op_(op),
+      kind_(k)
+  {
+  }
+
+  void operator()(const asio::error_code& ec)
+  {
+    op_->acquired(ec);
+  }
+
+  void operator()(const asio::error_code& ec, std::size_t n)
+  {
+    switch (kind_)
+    {
+    case read:
+      op_->read(ec, n);
+      break;
+    case receive:
+      op_->received(ec, n);
+      break;
+    default:
+      op_->flushed(ec);
+      break;
+    }
+  }
+
+  typename Operation::handler_type& handler() const
+  {
+    return op_->handler_;
+  }
+
+  // Flushes are not cancelled, they only send what the engine has queued.
+  asio::cancellation_slot slot() const
+  {
+    return kind_ == flush
+      ? asio::cancellation_slot() : op_->signal_.slot();
+  }
+
+private:
+  Operation* op_;
+  kind kind_;
+};
+
+// Receives datagrams until the session ends, opening up to the pipeline's
+// depth of them at a time on its workers. The records are delivered to the
+// message handler on the handler's associated executor, in the order the
+// datagrams arrived.
+// Until the record layer is active, and without a pipeline, records are
+// read through the engine one at a time instead.
+template <typename NextLayer, typename Core, typename MessageHandler,
+    typename Handler>
+class pipelined_receive_op
+  : private noncopyable
+{
+public:
+  typedef Handler handler_type;
+
+  // The op lives in memory allocated through the handler's hooks until the
+  // handler is called.
+  static void start(NextLayer& next_layer, Core& core,
+      MessageHandler& on_message, Handler& handler)
+  {
+    void* p = asio_handler_alloc_helpers::allocate(
+        sizeof(pipelined_receive_op), handler);
+    pipelined_receive_op* op = new (p)
+      pipelined_receive_op(next_layer, core, on_message, handler);
+
+    // Cancelling the handler's slot ends the op as if the session had.
+    typename associated_cancellation_slot<Handler>::type slot =
+      asio::get_associated_cancellation_slot(op->handler_);
+    if (slot.is_connected())
+      slot.template emplace<canceller>(op);
+
+    op->next();
+  }
+
+private:
+  friend class pipelined_receive_step<pipelined_receive_op>;
+  typedef pipelined_receive_step<pipelined_receive_op> step;
+
+  typedef typename associated_executor<Handler,
+    typename Core::executor_type>::type handler_executor_type;
+
+  pipelined_receive_op(NextLayer& next_layer, Core& core,
+      MessageHandler& on_message, Handler& handler)
+    : next_layer_(next_layer),
+      core_(core),
+      on_message_(ASIO_MOVE_CAST(MessageHandler)(on_message)),
+      handler_(ASIO_MOVE_CAST(Handler)(handler)),
+      handler_executor_(asio::get_associated_executor(
+            handler_, core_.executor_)),
+      io_work_(core_.executor_),
+      handler_work_(handler_executor_),
+      pipeline_(0),
+      head_(0),
+      tail_(0),
+      receiving_(false),
+      working_(0),
+      reading_(false),
+      flushing_(0),
+      waiting_(false),
+      owner_(false),
+      ending_(false)
+  {
+  }
+
+  // Start whatever can be started.
+  void next()
+  {
+    if (ending_)
+    {
+      finish();
+      return;
+    }
+
+    // Records left in the input by an earlier read, and plaintext the engine
+    // still holds, go through the engine.
+    record_layer* layer = pipeline_record_layer(core_.engine_);
+    crypto_pipeline* pipeline = core_.crypto_pipeline_.get();
+    if (!layer || !pipeline || core_.input_.size() != 0
+        || core_.engine_.payload_pending() || !pipeline->prepare(*layer))
+    {
+      if (reading_ || receiving_ || working_)
+        return;
+
+      release();
+      reading_ = true;
+      buffer_.resize(Core::max_tls_record_size);
+      step handler(this, step::read);
+      async_datagram_io(async_datagram_receive<NextLayer>(next_layer_),
+          async_datagram_send<NextLayer>(next_layer_), core_,
+          read_op<asio::mutable_buffer>(asio::buffer(buffer_)), handler);
+      return;
+    }
+
+    pipeline_ = pipeline;
+    if (reading_ || receiving_ || waiting_
+        || tail_ - head_ == pipeline_->depth())
+      return;
+
+    if (!owner_)
+    {
+      if (!core_.pending_read_.try_acquire())
+      {
+        waiting_ = true;
+        core_.pending_read_.async_wait(step(this, step::acquire));
+        return;
+      }
+      owner_ = true;
+    }
+
+    receiving_ = true;
+    async_datagram_receive<NextLayer> receive(next_layer_);
+    receive(pipeline_->open(tail_).buffer(), step(this, step::receive));
+  }
+
+  // The read side has been handed over, unless end() cancelled the wait.
+  void acquired(const asio::error_code& ec)
+  {
+    waiting_ = false;
+    owner_ = !ec;
+    next();
+  }
+
+  void read(const asio::error_code& ec, std::size_t bytes_transferred)
+  {
+    reading_ = false;
+    if (ec)
+      end(ec);
+    else if (bytes_transferred)
+      on_message_(asio::const_buffer(
+            asio::buffer(buffer_, bytes_transferred)));
+    next();
+  }
+
+  void received(const asio::error_code& ec, std::size_t bytes_transferred)
+  {
+    receiving_ = false;
+    if (ec)
+      end(ec);
+    else if (bytes_transferred && !ending_)
+    {
+      open_job& job = pipeline_->open(tail_++);
+      job.size_ = bytes_transferred;
+      job.done_ = false;
+      job.complete_on(handler_executor_);
+      job.complete_ = &pipelined_receive_op::opened;
+      job.owner_ = this;
+      ++working_;
+      pipeline_->post(job);
+    }
+
+    next();
+  }
+
+  static void opened(void* owner, crypto_job* job)
+  {
+    pipelined_receive_op* op = static_cast<pipelined_receive_op*>(owner);
+    static_cast<open_job*>(job)->done_ = true;
+    --op->working_;
+    op->deliver();
+  }
+
+  // Deliver the records of the datagrams opened so far, in order.
+  void deliver()
+  {
+    while (!ending_ && head_ != tail_ && pipeline_->open(head_).done_)
+    {
+      const open_job& job = pipeline_->open(head_++);
+      for (std::size_t i = 0; i < job.records().size() && !ending_; ++i)
+      {
+        asio::error_code ec;
+        engine_base::want want = pipeline_accept_record(
+            core_.engine_, job, job.records()[i], ec);
+        if (ec)
+          end(ec);
+        else if (want == engine_base::want_nothing)
+          on_message_(job.plaintext(job.records()[i]));
+        else if (want == engine_base::want_output_and_retry)
+          flush();
+      }
+    }
+
+    next();
+  }
+
+  void flush()
+  {
+    ++flushing_;
+    step handler(this, step::flush);
+    async_datagram_io(async_datagram_receive<NextLayer>(next_layer_),
+        async_datagram_send<NextLayer>(next_layer_), core_,
+        flush_op(), handler);
+  }
+
+  // A failed flush ends the op like a failed receive.
+  void flushed(const asio::error_code& ec)
+  {
+    --flushing_;
+    if (ec)
+      end(ec);
+    next();
+  }
+
+  // Stop receiving. The op's own read or receive that is still outstanding,
+  // or its wait for the read side, is cancelled, and the handler called by next() once nothing is
+  // outstanding. Other operations on the transport are left alone.
+  void end(const asio::error_code& ec)
+  {
+    if (!ending_)
+    {
+      ending_ = true;
+      ec_ = ec;
+    }
+
+    if (receiving_ || reading_ || waiting_)
+      signal_.emit(asio::cancellation_type::terminal);
+  }
+
+  // Call the handler if nothing is outstanding any more.
+  void finish()
+  {
+    if (reading_ || receiving_ || working_ || flushing_ || waiting_)
+      return;
+
+    release();
+    typename associated_cancellation_slot<Handler>::type slot =
+      asio::get_associated_cancellation_slot(handler_);
+    if (slot.is_connected())
+      slot.clear();
+
+    // Free the op before the upcall, so the handler may reuse the memory.
+    // The work is released only once the handler has been posted.
+    typename Core::executor_type executor(core_.executor_);
+    asio::error_code ec = ec_;
+    Handler handler(ASIO_MOVE_CAST(Handler)(handler_));
+    asio::executor_work_guard<typename Core::executor_type> io_work(
+        ASIO_MOVE_CAST(asio::executor_work_guard<
+          typename Core::executor_type>)(io_work_));
+    asio::executor_work_guard<handler_executor_type> handler_work(
+        ASIO_MOVE_CAST(asio::executor_work_guard<
+          handler_executor_type>)(handler_work_));
+    this->~pipelined_receive_op();
+    asio_handler_alloc_helpers::deallocate(
+        this, sizeof(pipelined_receive_op), handler);
+    asio::post(executor, asio::detail::bind_handler(
+          ASIO_MOVE_CAST(Handler)(handler), ec));
+  }
+
+  void release()
+  {
+    if (owner_)
+    {
+      owner_ = false;
+      core_.pending_read_.release();
+    }
+  }
+
+  struct canceller
+  {
+    explicit canceller(pipelined_receive_op* op) : op_(op) {}
+    void operator()(asio::cancellation_type_t)
+    {
+      op_->end(asio::error::operation_aborted);
+    }
+    pipelined_receive_op* op_;
+  };
+
+  NextLayer& next_layer_;
+  Core& core_;
+  MessageHandler on_message_;
+  Handler handler_;
+
+  // Where the steps and the delivery of opened datagrams run, so that the
+  // message handler is called in the handler's context.
+  handler_executor_type handler_executor_;
+
+  // Keep both executors running while only crypto jobs are outstanding,
+  // whose completions are posted to them from the workers.
+  asio::executor_work_guard<typename Core::executor_type> io_work_;
+  asio::executor_work_guard<handler_executor_type> handler_work_;
+
+  // Cancels the op's own read or receive.
+  asio::cancellation_signal signal_;
+  crypto_pipeline* pipeline_;
+
+  // The datagrams received and handed to the pipeline, delivered up to
+  // head_. Both count up, the jobs are used in turn.
+  std::size_t head_;
+  std::size_t tail_;
+
+  // Whether a receive is outstanding, and the number of running jobs.
+  bool receiving_;
+  std::size_t working_;
+
+  // Whether a read through the engine is outstanding, and its buffer.
+  bool reading_;
+  std::vector<unsigned char> buffer_;
+
+  // The number of flushes of engine output still outstanding.
+  std::size_t flushing_;
+
+  // Whether the op waits for, or owns, the read side of the transport.
+  bool waiting_;
+  bool owner_;
+
+  // Set once the session has ended or receiving failed.
+  bool ending_;
+  asio::error_code ec_;
+};
+
+template <typename Operation>
+inline void* asio_handler_allocate(std::size_t size,
+    pipelined_receive_step<Operation>* this_handler)
+{
+  return asio_handler_alloc_helpers::allocate(
+      size, this_handler->handler());
+}
+
+template <typename Operation>
+inline void asio_handler_deallocate(void* pointer, std::size_t size,
+    pipelined_receive_step<Operation>* this_handler)
+{
+  asio_handler_alloc_helpers::deallocate(
+      pointer, size, this_handler->handler());
+}
+
+template <typename Operation>
+inline bool asio_handler_is_continuation(
+    pipelined_receive_step<Operation>*)
+{
+  return true;
+}
+
+template <typename Function, typename Operation>
+inline void asio_handler_invoke(Function& function,
+    pipelined_receive_step<Operation>* this_handler)
+{
+  asio_handler_invoke_helpers::invoke(
+      function, this_handler->handler());
+}
+
+template <typename Function, typename Operation>
+inline void asio_handler_invoke(const Function& function,
+    pipelined_receive_step<Operation>* this_handler)
+{
+  asio_handler_invoke_helpers::invoke(
+      function, this_handler->handler());
+}
+
+template <typename NextLayer, typename Core, typename MessageHandler,
+    typename Handler>
+inline void async_pipelined_receive(NextLayer& next_layer, Core& core,
+    MessageHandler& on_message, Handler& handler)
+{
+  pipelined_receive_op<NextLayer, Core, MessageHandler, Handler>::start(
+      next_layer, core, on_message, handler);
+}
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+
+template <typename Operation, typename Allocator>
+struct associated_allocator<
+    ssl::dtls::detail::pipelined_receive_step<Operation>, Allocator>
+{
+  typedef typename associated_allocator<
+    typename Operation::handler_type, Allocator>::type type;
+
+  static type get(const ssl::dtls::detail::pipelined_receive_step<Operation>& h,
+      const Allocator& a = Allocator()) ASIO_NOEXCEPT
+  {
+    return associated_allocator<
+      typename Operation::handler_type, Allocator>::get(h.handler(), a);
+  }
+};
+
+template <typename Operation, typename Executor>
+struct associated_executor<
+    ssl::dtls::detail::pipelined_receive_step<Operation>, Executor>
+{
+  typedef typename associated_executor<
+    typename Operation::handler_type, Executor>::type type;
+
+  static type get(const ssl::dtls::detail::pipelined_receive_step<Operation>& h,
+      const Executor& ex = Executor()) ASIO_NOEXCEPT
+  {
+    return associated_executor<
+      typename Operation::handler_type, Executor>::get(h.handler(), ex);
+  }
+};
+
+template <typename Operation, typename CancellationSlot>
+struct associated_cancellation_slot<
+    ssl::dtls::detail::pipelined_receive_step<Operation>, CancellationSlot>
+{
+  typedef asio::cancellation_slot type;
+
+  static type get(const ssl::dtls::detail::pipelined_receive_step<Operation>& h,
+      const CancellationSlot& = CancellationSlot()) ASIO_NOEXCEPT
+  {
+    return h.slot();
+  }
+};
+
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_PIPELINED_RECEIVE_OP_HPP
@@ -0,0 +1,396 @@
+//
+// ssl/dtls/detail/private_key_operation.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_PRIVATE_KEY_OPERATION_HPP
+#define ASIO_SSL_DTLS_DETAIL_PRIVATE_KEY_OPERATION_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <new>
+#include <vector>
+#include "asio/associated_cancellation_slot.hpp"
+#include "asio/detail/bind_handler.hpp"
+#include "asio/detail/event.hpp"
+#include "asio/detail/handler_alloc_helpers.hpp"
+#include "asio/detail/memory.hpp"
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/detail/type_traits.hpp"
+#include "asio/error.hpp"
+#include "asio/executor_work_guard.hpp"
+#include "asio/post.hpp"
+#include "asio/ssl/detail/openssl_types.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+// Offloading hooks the signing function of a key through EC_KEY_METHOD and
+// RSA_METHOD, which OpenSSL 3.0 deprecates in favour of providers. Nothing
+// else offers a per-key hook without installing a provider, so the legacy
+// calls are kept and only their deprecation warnings are silenced around
+// them.
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+# if defined(__GNUC__)
+#  define ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD \
+     _Pragma("GCC diagnostic push") \
+     _Pragma("GCC diagnostic ignored \"-Wdeprecated-declarations\"")
+#  define ASIO_DTLS_END_LEGACY_KEY_METHOD \
+     _Pragma("GCC diagnostic pop")
+# elif defined(_MSC_VER)
+#  define ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD \
+     __pragma(warning(push)) \
+     __pragma(warning(disable:4996))
+#  define ASIO_DTLS_END_LEGACY_KEY_METHOD \
+     __pragma(warning(pop))
+# endif // defined(_MSC_VER)
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+
+#if !defined(ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD)
+# define ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD
+# define ASIO_DTLS_END_LEGACY_KEY_METHOD
+#endif // !defined(ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD)
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// A private key operation that runs on a worker while the handshake needing
+// it is suspended. The handshake waits for it either by blocking or by
+// parking its asynchronous operation, which is posted when the result is
+// available or when it is cancelled through the slot of its handler.
+class private_key_operation
+  : private noncopyable
+{
+public:
+  private_key_operation()
+    : result_length_(-1),
+      started_(false),
+      done_(false),
+      waiter_(0)
+  {
+  }
+
+  virtual ~private_key_operation()
+  {
+    if (waiter_)
+      waiter_->destroy_(waiter_);
+  }
+
+  // Perform the operation, unless it has been started already. Called on
+  // the worker, or by a blocking wait().
+  void run()
+  {
+    {
+      asio::detail::mutex::scoped_lock lock(mutex_);
+      if (started_)
+        return;
+      started_ = true;
+    }
+
+    perform();
+
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    done_ = true;
+    event_.signal_all(lock);
+    waiter* w = waiter_;
+    waiter_ = 0;
+    lock.unlock();
+
+    if (w)
+      w->complete_(w, asio::error_code());
+  }
+
+  // Whether the result is available.
+  bool done() const
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    return done_;
+  }
+
+  // Block until the result is available. If the worker has not started the
+  // operation yet it is performed on this thread instead, as the worker may
+  // need this thread to run, e.g. a single-threaded executor run by it.
+  void wait()
+  {
+    run();
+
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    while (!done_)
+      event_.wait(lock);
+  }
+
+  // Post the handler to the executor once the result is available. The
+  // handler is invoked with a default error_code, or with
+  // operation_aborted if it is cancelled through its slot first. The slot
+  // is not cleared once the result is available, as that may happen on the
+  // worker; the resumed operation must clear it.
+  template <typename Handler, typename Executor>
+  void async_wait(ASIO_MOVE_ARG(Handler) handler, const Executor& executor)
+  {
+    typedef typename decay<Handler>::type handler_type;
+    typedef waiter_impl<handler_type, Executor> impl_type;
+
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    if (done_)
+    {
+      lock.unlock();
+      asio::post(executor, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(Handler)(handler), asio::error_code()));
+      return;
+    }
+
+    void* p = asio_handler_alloc_helpers::allocate(
+        sizeof(impl_type), handler);
+    impl_type* w = new (p) impl_type(handler, executor);
+    waiter_ = w;
+
+    typename associated_cancellation_slot<handler_type>::type slot =
+      asio::get_associated_cancellation_slot(w->handler_);
+    if (slot.is_connected())
+      slot.template emplace<canceller>(this, w);
+  }
+
+  // The length of the result, or a negative value if the operation failed.
+  int result_length() const
+  {
+    return result_length_;
+  }
+
+  // The result.
+  const unsigned char* result() const
+  {
+    return result_.empty() ? 0 : &result_[0];
+  }
+
+protected:
+  // Compute the result.
+  virtual void perform() = 0;
+
+  std::vector<unsigned char> input_;
+  std::vector<unsigned char> result_;
+  int result_length_;
+
+private:
+  struct waiter
+  {
+    void (*complete_)(waiter*, const asio::error_code&);
+    void (*destroy_)(waiter*);
+  };
+
+  // Resume a parked operation with operation_aborted, unless the result
+  // has been published to it already.
+  void cancel(waiter* target)
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    if (waiter_ != target)
+      return;
+    waiter_ = 0;
+    lock.unlock();
+
+    target->complete_(target, asio::error::operation_aborted);
+  }
+
+  struct canceller
+  {
+    canceller(private_key_operation* op, waiter* w)
+      : op_(op),
+        waiter_(w)
+    {
+    }
+
+    void operator()(asio::cancellation_type_t)
+    {
+      op_->cancel(waiter_);
+    }
+
+    private_key_operation* op_;
+    waiter* waiter_;
+  };
+
+  template <typename Handler, typename Executor>
+  struct waiter_impl : waiter
+  {
+    waiter_impl(Handler& handler, const Executor& executor)
+      : handler_(ASIO_MOVE_CAST(Handler)(handler)),
+        work_(executor)
+    {
+      this->complete_ = &waiter_impl::do_complete;
+      this->destroy_ = &waiter_impl::do_destroy;
+    }
+
+    static void do_complete(waiter* base, const asio::error_code& ec)
+    {
+      // Take the handler out and free the memory before the upcall, so the
+      // same memory can be reused by the posted operation. The work is
+      // released only once the handler has been posted.
+      waiter_impl* w = static_cast<waiter_impl*>(base);
+      executor_work_guard<Executor> work(
+          ASIO_MOVE_CAST(executor_work_guard<Executor>)(w->work_));
+      Handler handler(ASIO_MOVE_CAST(Handler)(w->handler_));
+      w->~waiter_impl();
+      asio_handler_alloc_helpers::deallocate(w, sizeof(waiter_impl), handler);
+
+      asio::post(work.get_executor(), asio::detail::bind_handler(
+            ASIO_MOVE_CAST(Handler)(handler), ec));
+    }
+
+    static void do_destroy(waiter* base)
+    {
+      waiter_impl* w = static_cast<waiter_impl*>(base);
+      Handler handler(ASIO_MOVE_CAST(Handler)(w->handler_));
+      w->~waiter_impl();
+      asio_handler_alloc_helpers::deallocate(w, sizeof(waiter_impl), handler);
+    }
+
+    Handler handler_;
+
+    // Keeps the executor's context running while the operation is pending.
+    executor_work_guard<Executor> work_;
+  };
+
+  mutable asio::detail::mutex mutex_;
+  asio::detail::event event_;
+  bool started_;
+  bool done_;
+  waiter* waiter_;
+};
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD
+
+#if !defined(OPENSSL_NO_EC)
+// Computes an ECDSA signature with OpenSSL's default implementation.
+class ecdsa_sign_operation : public private_key_operation
+{
+public:
+  ecdsa_sign_operation(const unsigned char* digest, int length,
+      EC_KEY* key)
+    : key_(key)
+  {
+    input_.assign(digest, digest + length);
+    result_.resize(static_cast<std::size_t>(::ECDSA_size(key)));
+    ::EC_KEY_up_ref(key_);
+  }
+
+  ~ecdsa_sign_operation()
+  {
+    ::EC_KEY_free(key_);
+  }
+
+private:
+  void perform()
+  {
+    // The key's method only replaces the outer sign function, the
+    // signature itself is computed by its sign_sig function.
+    ECDSA_SIG* sig = ::ECDSA_do_sign_ex(&input_[0],
+        static_cast<int>(input_.size()), 0, 0, key_);
+    if (sig)
+    {
+      unsigned char* p = &result_[0];
+      result_length_ = ::i2d_ECDSA_SIG(sig, &p);
+      ::ECDSA_SIG_free(sig);
+    }
+  }
+
+  EC_KEY* key_;
+};
+#endif // !defined(OPENSSL_NO_EC)
+
+// Computes a raw RSA private key operation with OpenSSL's default
+// implementation.
+class rsa_private_encrypt_operation : public private_key_operation
+{
+public:
+  rsa_private_encrypt_operation(const unsigned char* from, int length,
+      RSA* key, int padding)
+    : key_(key),
+      padding_(padding)
+  {
+    input_.assign(from, from + length);
+    result_.resize(static_cast<std::size_t>(::RSA_size(key)));
+    ::RSA_up_ref(key_);
+  }
+
+  ~rsa_private_encrypt_operation()
+  {
+    ::RSA_free(key_);
+  }
+
+private:
+  void perform()
+  {
+    result_length_ = ::RSA_meth_get_priv_enc(::RSA_PKCS1_OpenSSL())(
+        static_cast<int>(input_.size()), &input_[0], &result_[0],
+        key_, padding_);
+  }
+
+  RSA* key_;
+  int padding_;
+};
+
+ASIO_DTLS_END_LEGACY_KEY_METHOD
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+
+// Runs private key operations on an executor.
+class private_key_executor_base
+{
+public:
+  virtual ~private_key_executor_base()
+  {
+  }
+
+  virtual void post(
+      const asio::detail::shared_ptr<private_key_operation>& op) = 0;
+};
+
+template <typename Executor>
+class private_key_executor : public private_key_executor_base
+{
+public:
+  explicit private_key_executor(const Executor& executor)
+    : executor_(executor)
+  {
+  }
+
+  virtual void post(
+      const asio::detail::shared_ptr<private_key_operation>& op)
+  {
+    asio::post(executor_, runner(op));
+  }
+
+private:
+  struct runner
+  {
+    explicit runner(const asio::detail::shared_ptr<private_key_operation>& op)
+      : op_(op)
+    {
+    }
+
+    void operator()()
+    {
+      op_->run();
+    }
+
+    asio::detail::shared_ptr<private_key_operation> op_;
+  };
+
+  Executor executor_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_PRIVATE_KEY_OPERATION_HPP
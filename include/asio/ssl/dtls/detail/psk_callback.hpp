@@ -0,0 +1,92 @@
+//
+// ssl/dtls/detail/psk_callback.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_PSK_CALLBACK_HPP
+#define ASIO_SSL_DTLS_DETAIL_PSK_CALLBACK_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <string>
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+class psk_server_callback_base
+{
+public:
+  virtual ~psk_server_callback_base()
+  {
+  }
+
+  virtual bool call(const std::string& identity, std::string& key) = 0;
+};
+
+template <typename PskServerCallback>
+class psk_server_callback : public psk_server_callback_base
+{
+public:
+  explicit psk_server_callback(PskServerCallback callback)
+    : callback_(callback)
+  {
+  }
+
+  virtual bool call(const std::string& identity, std::string& key)
+  {
+    return callback_(identity, key);
+  }
+
+private:
+  PskServerCallback callback_;
+};
+
+class psk_client_callback_base
+{
+public:
+  virtual ~psk_client_callback_base()
+  {
+  }
+
+  virtual bool call(const std::string& hint,
+      std::string& identity, std::string& key) = 0;
+};
+
+template <typename PskClientCallback>
+class psk_client_callback : public psk_client_callback_base
+{
+public:
+  explicit psk_client_callback(PskClientCallback callback)
+    : callback_(callback)
+  {
+  }
+
+  virtual bool call(const std::string& hint,
+      std::string& identity, std::string& key)
+  {
+    return callback_(hint, identity, key);
+  }
+
+private:
+  PskClientCallback callback_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_PSK_CALLBACK_HPP
@@ -0,0 +1,328 @@
+//
+// ssl/dtls/detail/queued_send_op.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_QUEUED_SEND_OP_HPP
+#define ASIO_SSL_DTLS_DETAIL_QUEUED_SEND_OP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <algorithm>
+#include "asio/error_code.hpp"
+#include "asio/executor_work_guard.hpp"
+#include "asio/detail/memory.hpp"
+#include "asio/ssl/dtls/detail/crypto_pipeline.hpp"
+#include "asio/ssl/dtls/detail/datagram_helper.hpp"
+#include "asio/ssl/dtls/detail/datagram_io.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+#include "asio/ssl/dtls/detail/send_queue.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Passes the messages of the send queue's batch to the engine. A message the
+// engine rejects is counted as a failure and skipped.
+class queued_send_op
+{
+public:
+  explicit queued_send_op(send_queue& queue)
+    : queue_(&queue)
+  {
+  }
+
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    std::vector<send_queue::message*>& batch = queue_->batch();
+    std::size_t& next = queue_->next();
+
+    bytes_transferred = 0;
+    bool written = false;
+    while (next < batch.size())
+    {
+      std::size_t length = 0;
+      engine_base::want want = eng.write(batch[next]->data(), ec, length);
+
+      // The engine needs to flush its output before it takes the message.
+      if (!ec && want == engine_base::want_output_and_retry)
+        return want;
+
+      ++next;
+      if (ec)
+      {
+        queue_->add_failure();
+        ec = asio::error_code();
+        continue;
+      }
+
+      bytes_transferred += length;
+      written = true;
+    }
+
+    return written ? engine_base::want_output : engine_base::want_nothing;
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t& bytes_transferred) const
+  {
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  send_queue* queue_;
+};
+
+// Passes the records sealed by the crypto pipeline's seal jobs to the
+// engine. The payloads that failed to seal are counted as failures.
+class sealed_send_op
+{
+public:
+  sealed_send_op(crypto_pipeline& pipeline, send_queue& queue)
+    : pipeline_(&pipeline),
+      queue_(&queue)
+  {
+  }
+
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
+      asio::error_code& ec,
+      std::size_t& bytes_transferred) const
+  {
+    bytes_transferred = 0;
+    bool written = false;
+    for (std::size_t i = 0; i < pipeline_->seal_jobs_used_; ++i)
+    {
+      seal_job& job = pipeline_->seal(i);
+      for (std::size_t n = 0; n < job.failures_; ++n)
+        queue_->add_failure();
+
+      for (std::size_t n = 0; n < job.records_.size(); ++n)
+      {
+        pipeline_write_sealed(eng, job.records_[n], ec);
+        if (ec)
+        {
+          queue_->add_failure();
+          ec = asio::error_code();
+          continue;
+        }
+
+        bytes_transferred += job.records_[n].size();
+        written = true;
+      }
+    }
+
+    return written ? engine_base::want_output : engine_base::want_nothing;
+  }
+
+  template <typename Handler>
+  void call_handler(Handler& handler,
+      const asio::error_code& ec,
+      const std::size_t& bytes_transferred) const
+  {
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  crypto_pipeline* pipeline_;
+  send_queue* queue_;
+};
+
+// Drains the send queue on the socket's executor. Each round takes everything
+// queued so far and sends it as one operation, until the queue is empty.
+//
+// With a crypto pipeline, the records of a round are sealed on its workers
+// instead, up to crypto_pipeline::max_sealed_records at a time, and passed
+// to the engine in the order they were queued once all are sealed.
+//
+// The drain shares the queue with the socket and finds the socket through
+// it before each step. Once the socket has been destroyed the remaining
+// messages are discarded.
+template <typename NextLayer, typename Core>
+class queued_send_drain_op
+{
+public:
+  explicit queued_send_drain_op(
+      const asio::detail::shared_ptr<send_queue>& queue)
+    : queue_(queue)
+  {
+  }
+
+  // Start a round.
+  void operator()()
+  {
+    Core* core = static_cast<Core*>(queue_->core());
+    if (!core)
+    {
+      abort();
+      return;
+    }
+
+    if (queue_->take_cancel())
+      queue_->drop();
+
+    if (!queue_->fill_batch())
+    {
+      queue_->complete_waiters();
+      return;
+    }
+
+    send(*core);
+  }
+
+  // Called when a round, or a sealed part of it, has been sent.
+  void operator()(const asio::error_code& ec, std::size_t)
+  {
+    Core* core = static_cast<Core*>(queue_->core());
+    if (!core)
+    {
+      abort();
+      return;
+    }
+
+    send_queue& queue = *queue_;
+    if (core->crypto_pipeline_.get())
+      core->crypto_pipeline_->release_seals(!!ec);
+
+    if (queue.take_cancel())
+      queue.drop();
+    else if (!ec && queue.next() < queue.batch().size())
+    {
+      send(*core);
+      return;
+    }
+
+    queue.release_batch(!!ec);
+    (*this)();
+  }
+
+private:
+  // Send the rest of the batch, or seal the next part of it.
+  void send(Core& core)
+  {
+    if (seal(core))
+      return;
+
+    NextLayer& next_layer = *static_cast<NextLayer*>(queue_->next_layer());
+    async_datagram_io(
+        async_datagram_receive<NextLayer>(next_layer),
+        async_datagram_send<NextLayer>(next_layer),
+        core, queued_send_op(*queue_), *this);
+  }
+
+  // Post seal jobs for the next part of the batch. Returns false if the
+  // batch is to be sent through the engine as usual.
+  bool seal(Core& core)
+  {
+    crypto_pipeline* pipeline = core.crypto_pipeline_.get();
+    record_layer* layer = pipeline
+      ? pipeline_record_layer(core.engine_) : 0;
+    if (!layer)
+      return false;
+
+    send_queue& queue = *queue_;
+    std::size_t count = (std::min)(queue.batch().size() - queue.next(),
+        static_cast<std::size_t>(crypto_pipeline::max_sealed_records));
+    uint64_t seq = 0;
+    if (count < 2 || !pipeline->prepare(*layer)
+        || !layer->reserve_sequence(count, seq))
+      return false;
+
+    std::size_t jobs = (std::min)(count, pipeline->depth());
+    seal_owner* owner = new seal_owner(*this, core.executor_);
+    pipeline->seals_pending_ = jobs;
+    pipeline->seal_jobs_used_ = jobs;
+    for (std::size_t i = 0, begin = 0; i < jobs; ++i)
+    {
+      std::size_t end = begin + (count - begin) / (jobs - i);
+      seal_job& job = pipeline->seal(i);
+      job.payloads_.clear();
+      for (std::size_t n = begin; n < end; ++n)
+        job.payloads_.push_back(queue.batch()[queue.next() + n]->data());
+      job.first_seq_ = seq + begin;
+      job.complete_on(core.executor_);
+      job.complete_ = &queued_send_drain_op::sealed;
+      job.owner_ = owner;
+      pipeline->post(job);
+      begin = end;
+    }
+
+    queue.next() += count;
+    return true;
+  }
+
+  // Called on the socket's executor as each seal job completes. The last one sends
+  // the sealed records.
+  static void sealed(void* owner, crypto_job*)
+  {
+    seal_owner* op = static_cast<seal_owner*>(owner);
+    Core& core = *static_cast<Core*>(op->op_.queue_->core());
+    crypto_pipeline& pipeline = *core.crypto_pipeline_;
+    if (--pipeline.seals_pending_ > 0)
+      return;
+
+    // The work is released once the send has been started.
+    queued_send_drain_op self(op->op_);
+    work_guard work(ASIO_MOVE_CAST(work_guard)(op->work_));
+    delete op;
+    NextLayer& next_layer =
+      *static_cast<NextLayer*>(self.queue_->next_layer());
+    async_datagram_io(
+        async_datagram_receive<NextLayer>(next_layer),
+        async_datagram_send<NextLayer>(next_layer),
+        core, sealed_send_op(pipeline, *self.queue_), self);
+  }
+
+  // Discard everything once the socket is gone, and end the drain.
+  void abort()
+  {
+    queue_->drop();
+    queue_->release_batch(true);
+    while (queue_->fill_batch())
+      queue_->drop();
+    queue_->complete_waiters();
+  }
+
+  typedef asio::executor_work_guard<typename Core::executor_type> work_guard;
+
+  // The drain while its seal jobs run. It keeps the socket's executor
+  // running until their completions, which the workers post to it, are done.
+  struct seal_owner
+  {
+    seal_owner(const queued_send_drain_op& op,
+        const typename Core::executor_type& executor)
+      : op_(op),
+        work_(executor)
+    {
+    }
+
+    queued_send_drain_op op_;
+    work_guard work_;
+  };
+
+  asio::detail::shared_ptr<send_queue> queue_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_QUEUED_SEND_OP_HPP
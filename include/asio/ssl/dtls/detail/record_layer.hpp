@@ -0,0 +1,271 @@
+//
+// ssl/dtls/detail/record_layer.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_RECORD_LAYER_HPP
+#define ASIO_SSL_DTLS_DETAIL_RECORD_LAYER_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <string>
+#include "asio/buffer.hpp"
+#include "asio/detail/cstdint.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/detail/openssl_types.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Seals and opens DTLS 1.2 AEAD records for an established session without
+// going through SSL_write/SSL_read.
+//
+// The traffic keys are derived from the session's master secret, so records
+// produced here are indistinguishable on the wire from records produced by
+// OpenSSL. Supported ciphers are AES-128-GCM, AES-256-GCM and
+// ChaCha20-Poly1305.
+//
+// Once connection IDs are set, records carry the RFC 9146 format, which
+// OpenSSL does not implement.
+class record_layer
+{
+public:
+  enum
+  {
+    // Size of the DTLS record header.
+    header_length = 13,
+
+    // Content types handled by the record layer.
+    change_cipher_spec = 20,
+    alert = 21,
+    handshake = 22,
+    application_data = 23,
+    heartbeat = 24,
+
+    // Outer content type of records carrying a connection ID (RFC 9146).
+    tls12_cid = 25
+  };
+
+  // Highest epoch and sequence number OpenSSL has sent, used to continue
+  // numbering where it left off.
+  struct sequence_state
+  {
+    sequence_state() : epoch(0), seq(0), valid(false) {}
+
+    uint16_t epoch;
+    uint64_t seq;
+    bool valid;
+  };
+
+  ASIO_DECL record_layer();
+
+  ASIO_DECL ~record_layer();
+
+  // Whether keys have been derived by init().
+  bool is_initialized() const
+  {
+    return seal_ctx_ != 0;
+  }
+
+  // Whether records are sealed and opened here instead of by OpenSSL.
+  bool is_active() const
+  {
+    return active_;
+  }
+
+  // Bytes needed in front of the payload when sealing in place.
+  std::size_t headroom() const
+  {
+    return header_length + write_cid_.size() + explicit_nonce_length_;
+  }
+
+  // Bytes needed behind the payload when sealing in place. Records with a
+  // connection ID carry the real content type behind the payload.
+  std::size_t tailroom() const
+  {
+    return tag_length_ + (write_cid_.empty() ? 0 : 1);
+  }
+
+  // Whether the session's cipher suite can be handled by the record layer.
+  ASIO_DECL static bool is_supported(const SSL_CIPHER* cipher);
+
+  // Set the connection ID placed into sent records, as requested by the
+  // peer, and the one expected in received records. Empty IDs select the
+  // standard record format.
+  ASIO_DECL void set_connection_ids(
+      const std::string& write_cid, const std::string& read_cid);
+
+  // Derive the traffic keys of an established session. The replay window
+  // starts empty; records may be opened from here on to fill it.
+  ASIO_DECL asio::error_code init(SSL* ssl, asio::error_code& ec);
+
+  // Take over from OpenSSL, continuing the record numbering after the last
+  // record it sent. The replay window is left as open() has built it, so it
+  // only holds records that have been authenticated.
+  ASIO_DECL void activate(const sequence_state& written);
+
+  // Drop all keys and state.
+  ASIO_DECL void reset();
+
+  // Seal a payload into a record. The output buffer must be at least
+  // headroom() + payload size + tailroom() bytes. Returns the record length.
+  ASIO_DECL std::size_t seal(unsigned char content_type,
+      const asio::const_buffer& payload, const asio::mutable_buffer& out,
+      asio::error_code& ec);
+
+  // Seal a payload of the given length that already sits at headroom() bytes
+  // into the record buffer. Returns the record length.
+  ASIO_DECL std::size_t seal_in_place(unsigned char content_type,
+      const asio::mutable_buffer& record, std::size_t length,
+      asio::error_code& ec);
+
+  // Create a copy of the sealing or opening cipher context, so that records
+  // can be sealed or opened on another thread. Returns 0 on failure. The
+  // copy must be freed with EVP_CIPHER_CTX_free().
+  ASIO_DECL EVP_CIPHER_CTX* new_seal_context() const;
+  ASIO_DECL EVP_CIPHER_CTX* new_open_context() const;
+
+  // Reserve the sequence numbers of count records to be sealed by
+  // seal_detached(). Returns false if they would run out.
+  ASIO_DECL bool reserve_sequence(std::size_t count, uint64_t& first);
+
+  // Seal a payload as seal() does, using the given cipher context and a
+  // sequence number reserved by reserve_sequence(). Does not modify the
+  // record layer, so it may run on any thread while the layer is active.
+  ASIO_DECL std::size_t seal_detached(EVP_CIPHER_CTX* ctx,
+      unsigned char content_type, const asio::const_buffer& payload,
+      const asio::mutable_buffer& out, uint64_t seq,
+      asio::error_code& ec) const;
+
+  // Length of the first record in the data, or 0 if it is malformed.
+  ASIO_DECL static std::size_t record_length(const asio::const_buffer& data);
+
+  // Length of the first record in the data, where records with a connection
+  // ID carry one of the given length. Returns 0 if it is malformed.
+  ASIO_DECL static std::size_t record_length(
+      const asio::const_buffer& data, std::size_t cid_length);
+
+  // Length of the first received record, or 0 if it is malformed.
+  std::size_t received_record_length(const asio::const_buffer& data) const
+  {
+    return record_length(data, read_cid_.size());
+  }
+
+  // Open a record into the output buffer, which must be at least as large
+  // as the plaintext. Returns false if the record has to be discarded, i.e.
+  // it is a replay, belongs to another epoch or fails authentication.
+  ASIO_DECL bool open(const asio::const_buffer& record,
+      const asio::mutable_buffer& out, unsigned char& content_type,
+      std::size_t& length);
+
+  // Open a record as open() does, but also discard it unless it is newer
+  // than every record received so far. Such a record may move the session
+  // to the address it came from (RFC 9146 section 6).
+  ASIO_DECL bool open_newest(const asio::const_buffer& record,
+      const asio::mutable_buffer& out, unsigned char& content_type,
+      std::size_t& length);
+
+  // Check a record as open() does, opening it into the scratch buffer, but
+  // without marking it as received. The record can still be opened after.
+  ASIO_DECL bool authenticate(const asio::const_buffer& record,
+      const asio::mutable_buffer& scratch) const;
+
+  // Open a record as open() does, decrypting it where its ciphertext lies.
+  // The plaintext is returned as part of the record's buffer.
+  ASIO_DECL bool open_in_place(const asio::mutable_buffer& record,
+      unsigned char& content_type, asio::const_buffer& plaintext);
+
+  // Open a record as open() does, using the given cipher context, but
+  // without replay protection. Does not modify the record layer, so it may
+  // run on any thread while the layer is active. The record's sequence
+  // number has to be passed to accept_sequence() in the order the records
+  // were received.
+  ASIO_DECL bool open_detached(EVP_CIPHER_CTX* ctx,
+      const asio::const_buffer& record, const asio::mutable_buffer& out,
+      unsigned char& content_type, std::size_t& length, uint64_t& seq) const;
+
+  // Apply replay protection to a record opened by open_detached(). Returns
+  // false if the record has to be discarded.
+  ASIO_DECL bool accept_sequence(uint64_t seq);
+
+  // Upper bound of the plaintext length of a record.
+  std::size_t max_payload_length(const asio::const_buffer& record) const
+  {
+    std::size_t overhead = header_length + read_cid_.size()
+      + explicit_nonce_length_ + tag_length_;
+    return record.size() > overhead ? record.size() - overhead : 0;
+  }
+
+  // Update the sequence state with all records in a datagram.
+  ASIO_DECL static void track(const asio::const_buffer& data,
+      sequence_state& state);
+
+private:
+  // Disallow copying and assignment.
+  record_layer(const record_layer&);
+  record_layer& operator=(const record_layer&);
+
+  // Open a record, optionally only if it is the newest one.
+  ASIO_DECL bool do_open(const asio::const_buffer& record,
+      const asio::mutable_buffer& out, unsigned char& content_type,
+      std::size_t& length, bool newest_only);
+
+  // Copy an initialized cipher context, or return 0.
+  ASIO_DECL static EVP_CIPHER_CTX* copy_context(EVP_CIPHER_CTX* ctx);
+
+  // Build the per-record nonce.
+  ASIO_DECL void make_nonce(const unsigned char* iv,
+      const unsigned char* seq_num, unsigned char* nonce) const;
+
+  // Replay protection as described in RFC 6347 section 4.1.2.6.
+  ASIO_DECL bool check_replay(uint64_t seq) const;
+  ASIO_DECL void update_replay(uint64_t seq);
+
+  bool active_;
+  EVP_CIPHER_CTX* seal_ctx_;
+  EVP_CIPHER_CTX* open_ctx_;
+
+  // Implicit part of the nonce for each direction.
+  unsigned char write_iv_[12];
+  unsigned char read_iv_[12];
+
+  // 4 for AES-GCM, whose nonce is completed by an explicit part carried in
+  // the record. 12 for ChaCha20-Poly1305, whose nonce is the IV xor'ed with
+  // the sequence number.
+  std::size_t fixed_iv_length_;
+  std::size_t explicit_nonce_length_;
+  std::size_t tag_length_;
+
+  // Connection IDs of sent and received records.
+  std::string write_cid_;
+  std::string read_cid_;
+
+  uint16_t epoch_;
+  uint64_t write_seq_;
+  uint64_t read_seq_;
+  uint64_t replay_bitmap_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/detail/impl/record_layer.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_DETAIL_RECORD_LAYER_HPP
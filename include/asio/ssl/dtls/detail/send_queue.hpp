@@ -0,0 +1,424 @@
+//
+// ssl/dtls/detail/send_queue.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_SEND_QUEUE_HPP
+#define ASIO_SSL_DTLS_DETAIL_SEND_QUEUE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include "asio/buffer.hpp"
+#include "asio/detail/bind_handler.hpp"
+#include "asio/detail/handler_alloc_helpers.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/error.hpp"
+#include "asio/error_code.hpp"
+#include "asio/post.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// Messages queued for sending by any number of threads and drained by one
+// operation at a time on the socket's executor.
+//
+// The queue is the intrusive multi-producer single-consumer queue by Dmitry
+// Vyukov: a producer links its message with one atomic exchange, and the
+// consumer takes messages without synchronizing with the producers. A
+// message whose producer has not finished linking it is picked up by the
+// next drain, which that producer schedules.
+//
+// The queue is shared by the socket and its drain, so that a drain still
+// scheduled when the socket is destroyed finds the socket gone instead of
+// touching it. A producer starting a drain takes its share of the queue
+// through shared_from_this().
+class send_queue
+  : public std::enable_shared_from_this<send_queue>,
+    private noncopyable
+{
+public:
+  // A message and its copy of the data, allocated in one block.
+  struct message
+  {
+    std::atomic<message*> next;
+    std::size_t size;
+
+    asio::const_buffer data() const
+    {
+      return asio::const_buffer(this + 1, size);
+    }
+  };
+
+  send_queue()
+    : head_(&stub_),
+      tail_(&stub_),
+      draining_(false),
+      cancelled_(false),
+      failures_(0),
+      next_layer_(0),
+      core_(0),
+      next_(0),
+      front_(0),
+      back_(0)
+  {
+    stub_.next.store(0, std::memory_order_relaxed);
+    stub_.size = 0;
+  }
+
+  // Waiters are destroyed without being invoked.
+  ~send_queue()
+  {
+    while (message* m = pop())
+      destroy(m);
+    free_batch();
+    free_retired();
+    while (waiter* w = front_)
+    {
+      front_ = w->next_;
+      w->destroy_(w);
+    }
+  }
+
+  // Set the socket the queue belongs to when it is constructed or moved.
+  void attach(void* next_layer, void* core)
+  {
+    next_layer_.store(next_layer, std::memory_order_release);
+    core_.store(core, std::memory_order_release);
+  }
+
+  // Clear the socket when it is destroyed. The drain then discards the
+  // messages.
+  void detach()
+  {
+    core_.store(0, std::memory_order_release);
+    next_layer_.store(0, std::memory_order_release);
+  }
+
+  // The socket's next layer and core, or null once it has been destroyed.
+  void* next_layer() const
+  {
+    return next_layer_.load(std::memory_order_acquire);
+  }
+
+  void* core() const
+  {
+    return core_.load(std::memory_order_acquire);
+  }
+
+  // Queue a copy of the data. Thread-safe. Returns true if no drain is
+  // scheduled, in which case the caller has to start one.
+  bool push(const asio::const_buffer& data)
+  {
+    void* p = ::operator new(sizeof(message) + data.size());
+    message* m = new (p) message;
+    m->next.store(0, std::memory_order_relaxed);
+    m->size = data.size();
+    std::memcpy(static_cast<unsigned char*>(p) + sizeof(message),
+        data.data(), data.size());
+
+    link(m);
+    return !draining_.exchange(true);
+  }
+
+  // Discard the messages queued so far at the drain's next step. Thread-safe.
+  void cancel()
+  {
+    cancelled_.store(true);
+  }
+
+  // Whether cancel() has been called since the last call.
+  bool take_cancel()
+  {
+    return cancelled_.exchange(false);
+  }
+
+  // Take all queued messages into the batch. Returns false if there were
+  // none and the drain is over.
+  bool fill_batch()
+  {
+    for (;;)
+    {
+      while (message* m = pop())
+        batch_.push_back(m);
+      next_ = 0;
+      if (!batch_.empty())
+        return true;
+
+      // Check again after ending the drain, as a producer that found it
+      // still running relies on it to pick up its message.
+      draining_.store(false);
+      if (empty() || draining_.exchange(true))
+        return false;
+    }
+  }
+
+  // The batch being sent, and the index of the next message to pass to the
+  // engine.
+  std::vector<message*>& batch()
+  {
+    return batch_;
+  }
+
+  std::size_t& next()
+  {
+    return next_;
+  }
+
+  // Count a message the engine rejected.
+  void add_failure()
+  {
+    failures_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Number of messages that were rejected by the engine or belonged to a
+  // batch that failed to send. Thread-safe.
+  std::size_t failures() const
+  {
+    return failures_.load(std::memory_order_relaxed);
+  }
+
+  // Discard the queued messages and those of the batch not yet passed to
+  // the engine, counting them as failures. The waiters are then completed
+  // with asio::error::operation_aborted.
+  void drop()
+  {
+    for (std::size_t i = next_; i < batch_.size(); ++i)
+    {
+      add_failure();
+      destroy(batch_[i]);
+    }
+    batch_.resize(next_);
+
+    while (message* m = pop())
+    {
+      add_failure();
+      destroy(m);
+    }
+
+    result_ = asio::error::operation_aborted;
+  }
+
+  // Wait for the drain to end. Only called on the socket's executor, where
+  // the handler is posted to.
+  template <typename Executor, typename Handler>
+  void async_wait(const Executor& executor, Handler& handler)
+  {
+    if (!draining_.load())
+    {
+      asio::post(executor, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(Handler)(handler), asio::error_code()));
+      return;
+    }
+
+    typedef waiter_impl<Executor, Handler> impl_type;
+    void* p = asio_handler_alloc_helpers::allocate(
+        sizeof(impl_type), handler);
+    impl_type* w = new (p) impl_type(executor, handler);
+
+    if (back_)
+      back_->next_ = w;
+    else
+      front_ = w;
+    back_ = w;
+  }
+
+  // Complete the waiters once the drain has ended.
+  void complete_waiters()
+  {
+    asio::error_code ec = result_;
+    result_ = asio::error_code();
+    while (waiter* w = front_)
+    {
+      front_ = w->next_;
+      if (front_ == 0)
+        back_ = 0;
+      w->complete_(w, ec);
+    }
+  }
+
+  // Release the messages of the batch once it has been sent. The engine may
+  // still refer to the messages of a failed batch, so those are kept until
+  // a later batch has been sent successfully.
+  void release_batch(bool failed)
+  {
+    if (failed)
+    {
+      failures_.fetch_add(batch_.size(), std::memory_order_relaxed);
+      retired_.insert(retired_.end(), batch_.begin(), batch_.end());
+      batch_.clear();
+      return;
+    }
+
+    free_batch();
+    free_retired();
+  }
+
+private:
+  struct waiter
+  {
+    waiter* next_;
+    void (*complete_)(waiter*, const asio::error_code&);
+    void (*destroy_)(waiter*);
+  };
+
+  template <typename Executor, typename Handler>
+  struct waiter_impl : waiter
+  {
+    waiter_impl(const Executor& executor, Handler& handler)
+      : executor_(executor),
+        handler_(ASIO_MOVE_CAST(Handler)(handler))
+    {
+      this->next_ = 0;
+      this->complete_ = &waiter_impl::do_complete;
+      this->destroy_ = &waiter_impl::do_destroy;
+    }
+
+    static void do_complete(waiter* base, const asio::error_code& ec)
+    {
+      // Take the handler out and free the memory before the upcall, so the
+      // same memory can be reused by the posted handler.
+      waiter_impl* w = static_cast<waiter_impl*>(base);
+      Executor executor(w->executor_);
+      Handler handler(ASIO_MOVE_CAST(Handler)(w->handler_));
+      w->~waiter_impl();
+      asio_handler_alloc_helpers::deallocate(w, sizeof(waiter_impl), handler);
+
+      asio::post(executor, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(Handler)(handler), ec));
+    }
+
+    static void do_destroy(waiter* base)
+    {
+      waiter_impl* w = static_cast<waiter_impl*>(base);
+      Handler handler(ASIO_MOVE_CAST(Handler)(w->handler_));
+      w->~waiter_impl();
+      asio_handler_alloc_helpers::deallocate(w, sizeof(waiter_impl), handler);
+    }
+
+    Executor executor_;
+    Handler handler_;
+  };
+
+  void link(message* m)
+  {
+    message* prev = head_.exchange(m, std::memory_order_acq_rel);
+    prev->next.store(m, std::memory_order_release);
+  }
+
+  message* pop()
+  {
+    message* tail = tail_;
+    message* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_)
+    {
+      if (!next)
+        return 0;
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next)
+    {
+      tail_ = next;
+      return tail;
+    }
+
+    // A producer is between its exchange and linking the message.
+    if (tail != head_.load(std::memory_order_acquire))
+      return 0;
+
+    // The tail is the last message. Put the stub behind it, so that it can
+    // be taken without racing with the next producer.
+    stub_.next.store(0, std::memory_order_relaxed);
+    link(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next)
+    {
+      tail_ = next;
+      return tail;
+    }
+
+    return 0;
+  }
+
+  bool empty() const
+  {
+    return tail_ == &stub_
+      && stub_.next.load(std::memory_order_acquire) == 0
+      && head_.load(std::memory_order_acquire) == &stub_;
+  }
+
+  static void destroy(message* m)
+  {
+    m->~message();
+    ::operator delete(m);
+  }
+
+  void free_batch()
+  {
+    for (std::size_t i = 0; i < batch_.size(); ++i)
+      destroy(batch_[i]);
+    batch_.clear();
+  }
+
+  void free_retired()
+  {
+    for (std::size_t i = 0; i < retired_.size(); ++i)
+      destroy(retired_[i]);
+    retired_.clear();
+  }
+
+  // Producers link messages at the head, the consumer takes them from the
+  // tail.
+  std::atomic<message*> head_;
+  message* tail_;
+  message stub_;
+
+  // Whether a drain is scheduled or running, and whether it is to discard
+  // the messages.
+  std::atomic<bool> draining_;
+  std::atomic<bool> cancelled_;
+
+  std::atomic<std::size_t> failures_;
+
+  // The socket's next layer and core.
+  std::atomic<void*> next_layer_;
+  std::atomic<void*> core_;
+
+  // Owned by the drain.
+  std::vector<message*> batch_;
+  std::size_t next_;
+  std::vector<message*> retired_;
+
+  // The handlers waiting for the drain to end, and the result passed to
+  // them. Owned by the socket's executor.
+  waiter* front_;
+  waiter* back_;
+  asio::error_code result_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_SEND_QUEUE_HPP
@@ -0,0 +1,137 @@
+//
+// ssl/dtls/detail/sharded_map.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_SHARDED_MAP_HPP
+#define ASIO_SSL_DTLS_DETAIL_SHARDED_MAP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/noncopyable.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// A hash map split into independently locked shards, so that lookups of
+// different keys rarely contend. The hash selects the shard, each of which
+// is an unordered_map of its own.
+template <typename Key, typename Value, typename Hash>
+class sharded_map
+  : private noncopyable
+{
+public:
+  explicit sharded_map(std::size_t shards)
+  {
+    if (shards == 0)
+      shards = 1;
+
+    shards_.reserve(shards);
+    for (std::size_t i = 0; i < shards; ++i)
+      shards_.push_back(new shard);
+  }
+
+  ~sharded_map()
+  {
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      delete shards_[i];
+  }
+
+  // Prepare the map to hold the given number of entries without rehashing.
+  void reserve(std::size_t count)
+  {
+    std::size_t per_shard = (count + shards_.size() - 1) / shards_.size();
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+    {
+      asio::detail::mutex::scoped_lock lock(shards_[i]->mutex_);
+      shards_[i]->map_.reserve(per_shard);
+    }
+  }
+
+  // Add an entry, replacing the value if the key is already present.
+  void assign(const Key& key, const Value& value)
+  {
+    shard& s = shard_for(key);
+    asio::detail::mutex::scoped_lock lock(s.mutex_);
+    s.map_[key] = value;
+  }
+
+  // Remove an entry. Returns true if it was present.
+  bool erase(const Key& key)
+  {
+    shard& s = shard_for(key);
+    asio::detail::mutex::scoped_lock lock(s.mutex_);
+    return s.map_.erase(key) != 0;
+  }
+
+  // Copy the value of an entry. Returns false if it is not present.
+  bool find(const Key& key, Value& value) const
+  {
+    shard& s = shard_for(key);
+    asio::detail::mutex::scoped_lock lock(s.mutex_);
+    typename map_type::const_iterator i = s.map_.find(key);
+    if (i == s.map_.end())
+      return false;
+
+    value = i->second;
+    return true;
+  }
+
+  bool contains(const Key& key) const
+  {
+    shard& s = shard_for(key);
+    asio::detail::mutex::scoped_lock lock(s.mutex_);
+    return s.map_.find(key) != s.map_.end();
+  }
+
+  std::size_t size() const
+  {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+    {
+      asio::detail::mutex::scoped_lock lock(shards_[i]->mutex_);
+      total += shards_[i]->map_.size();
+    }
+    return total;
+  }
+
+private:
+  typedef std::unordered_map<Key, Value, Hash> map_type;
+
+  struct shard
+  {
+    mutable asio::detail::mutex mutex_;
+    map_type map_;
+  };
+
+  shard& shard_for(const Key& key) const
+  {
+    return *shards_[Hash()(key) % shards_.size()];
+  }
+
+  std::vector<shard*> shards_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_SHARDED_MAP_HPP
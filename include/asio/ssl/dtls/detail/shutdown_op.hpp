@@ -17,7 +17,8 @@
 
 #include "asio/detail/config.hpp"
 
-#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
 
 #include "asio/detail/push_options.hpp"
 
@@ -29,7 +30,8 @@ namespace detail {
 class shutdown_op
 {
 public:
-  engine::want operator()(engine& eng,
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
       asio::error_code& ec,
       std::size_t& bytes_transferred) const
   {
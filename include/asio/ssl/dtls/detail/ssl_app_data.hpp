@@ -6,9 +6,11 @@
 #ifndef ASIO_SSL_DETAIL_SSL_APP_DATA_HPP
 #define ASIO_SSL_DETAIL_SSL_APP_DATA_HPP
 
+#include <string>
 #include "asio/ssl/detail/verify_callback.hpp"
 #include "asio/ssl/dtls/detail/cookie_generate_callback.hpp"
 #include "asio/ssl/dtls/detail/cookie_verify_callback.hpp"
+#include "asio/ssl/dtls/detail/private_key_operation.hpp"
 
 namespace asio {
 namespace ssl {
@@ -23,6 +25,12 @@ public:
      , cookie_generate_callback(0)
      , cookie_verify_callback(0)
      , dtls_tmp(0)
+     , retransmit_timeout_us(1000000)
+     , mtu(0)
+     , local_cid_set(false)
+     , cid_negotiated(false)
+     , heartbeat_negotiated(false)
+     , heartbeat_requests_allowed(false)
    {
    }
 
@@ -102,11 +110,123 @@ public:
      return dtls_tmp;
    }
 
+   void set_retransmit_timeout(unsigned int timeout_us)
+   {
+     retransmit_timeout_us = timeout_us;
+   }
+
+   unsigned int getRetransmitTimeout() const
+   {
+     return retransmit_timeout_us;
+   }
+
+   void set_mtu(int value)
+   {
+     mtu = value;
+   }
+
+   int getMtu() const
+   {
+     return mtu;
+   }
+
+   void set_private_key_operation(
+       const asio::detail::shared_ptr<private_key_operation>& op)
+   {
+     private_key_op = op;
+   }
+
+   private_key_operation* getPrivateKeyOperation() const
+   {
+     return private_key_op.get();
+   }
+
+   void set_psk_identity(const std::string& identity, const std::string& key)
+   {
+     psk_identity = identity;
+     psk_key = key;
+   }
+
+   const std::string& getPskIdentity() const
+   {
+     return psk_identity;
+   }
+
+   const std::string& getPskKey() const
+   {
+     return psk_key;
+   }
+
+   void set_local_connection_id(const std::string& cid)
+   {
+     local_cid = cid;
+     local_cid_set = true;
+   }
+
+   // Returns false if no local connection ID has been chosen yet.
+   bool getLocalConnectionId(std::string& cid) const
+   {
+     cid = local_cid;
+     return local_cid_set;
+   }
+
+   void set_peer_connection_id(const std::string& cid)
+   {
+     peer_cid = cid;
+   }
+
+   const std::string& getPeerConnectionId() const
+   {
+     return peer_cid;
+   }
+
+   void set_connection_id_negotiated(bool negotiated)
+   {
+     cid_negotiated = negotiated;
+   }
+
+   bool isConnectionIdNegotiated() const
+   {
+     return cid_negotiated;
+   }
+
+   void set_heartbeat_negotiated(bool negotiated)
+   {
+     heartbeat_negotiated = negotiated;
+   }
+
+   bool isHeartbeatNegotiated() const
+   {
+     return heartbeat_negotiated;
+   }
+
+   // Whether the peer's heartbeat extension allows us to send requests.
+   void set_heartbeat_requests_allowed(bool allowed)
+   {
+     heartbeat_requests_allowed = allowed;
+   }
+
+   bool getHeartbeatRequestsAllowed() const
+   {
+     return heartbeat_requests_allowed;
+   }
+
 private:
    ssl::detail::verify_callback_base* verify_certificate_callback;
    dtls::detail::cookie_generate_callback_base* cookie_generate_callback;
    dtls::detail::cookie_verify_callback_base* cookie_verify_callback;
    void *dtls_tmp;
+   unsigned int retransmit_timeout_us;
+   int mtu;
+   std::string psk_identity;
+   std::string psk_key;
+   asio::detail::shared_ptr<private_key_operation> private_key_op;
+   std::string local_cid;
+   bool local_cid_set;
+   std::string peer_cid;
+   bool cid_negotiated;
+   bool heartbeat_negotiated;
+   bool heartbeat_requests_allowed;
 };
 
 } // namespace detail
@@ -0,0 +1,154 @@
+//
+// ssl/dtls/detail/ticket_key_store.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_DETAIL_TICKET_KEY_STORE_HPP
+#define ASIO_SSL_DTLS_DETAIL_TICKET_KEY_STORE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include "asio/buffer.hpp"
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/ssl/detail/openssl_types.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+namespace detail {
+
+// The keys protecting session tickets, shared by all threads using a context.
+class ticket_key_store
+  : private noncopyable
+{
+public:
+  // A key in the layout used by common ticket key files: the name sent in the
+  // ticket, the HMAC-SHA256 key, then the AES-256-CBC key.
+  struct key
+  {
+    unsigned char name[16];
+    unsigned char hmac_key[32];
+    unsigned char aes_key[32];
+  };
+
+  enum { key_length = sizeof(key) };
+
+  // How a ticket key lookup was satisfied.
+  enum lookup_result
+  {
+    unknown_key = 0,
+    current_key = 1,
+    previous_key = 2
+  };
+
+  ticket_key_store()
+    : has_current_(false),
+      has_previous_(false),
+      hits_(0),
+      misses_(0),
+      renewals_(0)
+  {
+  }
+
+  ~ticket_key_store()
+  {
+    ::OPENSSL_cleanse(&current_, sizeof(current_));
+    ::OPENSSL_cleanse(&previous_, sizeof(previous_));
+  }
+
+  // Replace both keys. The previous key may be an empty buffer.
+  void set(const asio::const_buffer& current,
+      const asio::const_buffer& previous)
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    std::memcpy(&current_, current.data(), sizeof(current_));
+    has_current_ = true;
+    has_previous_ = previous.size() != 0;
+    if (has_previous_)
+      std::memcpy(&previous_, previous.data(), sizeof(previous_));
+    else
+      ::OPENSSL_cleanse(&previous_, sizeof(previous_));
+  }
+
+  // Make the given key current, keeping the current one for decryption.
+  void rotate(const asio::const_buffer& next)
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    previous_ = current_;
+    has_previous_ = has_current_;
+    std::memcpy(&current_, next.data(), sizeof(current_));
+    has_current_ = true;
+  }
+
+  // Get a copy of the key used to encrypt new tickets.
+  bool encryption_key(key& k) const
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    if (!has_current_)
+      return false;
+    k = current_;
+    return true;
+  }
+
+  // Get a copy of the key with the given name, counting the outcome.
+  lookup_result decryption_key(const unsigned char* name, key& k)
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    if (has_current_
+        && std::memcmp(name, current_.name, sizeof(current_.name)) == 0)
+    {
+      k = current_;
+      ++hits_;
+      return current_key;
+    }
+    if (has_previous_
+        && std::memcmp(name, previous_.name, sizeof(previous_.name)) == 0)
+    {
+      k = previous_;
+      ++renewals_;
+      return previous_key;
+    }
+    ++misses_;
+    return unknown_key;
+  }
+
+  void statistics(std::size_t& hits,
+      std::size_t& misses, std::size_t& renewals) const
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    hits = hits_;
+    misses = misses_;
+    renewals = renewals_;
+  }
+
+private:
+  mutable asio::detail::mutex mutex_;
+  key current_;
+  key previous_;
+  bool has_current_;
+  bool has_previous_;
+  std::size_t hits_;
+  std::size_t misses_;
+  std::size_t renewals_;
+};
+
+} // namespace detail
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_DETAIL_TICKET_KEY_STORE_HPP
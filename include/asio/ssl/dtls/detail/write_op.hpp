@@ -18,7 +18,9 @@
 #include "asio/detail/config.hpp"
 
 #include "asio/detail/buffer_sequence_adapter.hpp"
-#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
 
 #include "asio/detail/push_options.hpp"
 
@@ -36,7 +38,8 @@ public:
   {
   }
 
-  engine::want operator()(engine& eng,
+  template <typename Engine>
+  engine_base::want operator()(Engine& eng,
       asio::error_code& ec,
       std::size_t& bytes_transferred) const
   {
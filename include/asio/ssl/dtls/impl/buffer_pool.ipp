@@ -0,0 +1,118 @@
+//
+// ssl/dtls/impl/buffer_pool.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IMPL_BUFFER_POOL_IPP
+#define ASIO_SSL_DTLS_IMPL_BUFFER_POOL_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <new>
+#include "asio/ssl/dtls/buffer_pool.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+buffer_pool::buffer_pool(std::size_t block_size)
+  : block_size_(block_size),
+    allocated_(0),
+    idle_(0),
+    idle_count_(0)
+{
+}
+
+buffer_pool::~buffer_pool()
+{
+  while (block* b = idle_)
+  {
+    idle_ = b->next_;
+    b->~block();
+    ::operator delete(b);
+  }
+}
+
+std::size_t buffer_pool::block_size() const
+{
+  return block_size_;
+}
+
+buffer_lease buffer_pool::acquire()
+{
+  block* b = 0;
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    if (idle_)
+    {
+      b = idle_;
+      idle_ = b->next_;
+      --idle_count_;
+    }
+    else
+    {
+      ++allocated_;
+    }
+  }
+
+  if (!b)
+  {
+    void* p = ::operator new(header_size() + block_size_);
+    b = new (p) block;
+    b->pool_ = this;
+  }
+
+  b->next_ = 0;
+  b->leases_.store(1, std::memory_order_relaxed);
+  return buffer_lease(b, asio::buffer(data(b), block_size_));
+}
+
+std::size_t buffer_pool::idle() const
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  return idle_count_;
+}
+
+std::size_t buffer_pool::allocated() const
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  return allocated_;
+}
+
+void buffer_pool::release(block* b)
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  b->next_ = idle_;
+  idle_ = b;
+  ++idle_count_;
+}
+
+std::size_t buffer_pool::header_size()
+{
+  // The data of a block starts at a suitably aligned offset behind its
+  // header.
+  const std::size_t align = sizeof(void*) * 2;
+  return (sizeof(block) + align - 1) / align * align;
+}
+
+unsigned char* buffer_pool::data(block* b)
+{
+  return reinterpret_cast<unsigned char*>(b) + header_size();
+}
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_IMPL_BUFFER_POOL_IPP
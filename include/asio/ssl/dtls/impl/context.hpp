@@ -39,7 +39,7 @@ ASIO_SYNC_OP_VOID context::set_verify_callback(
     VerifyCallback callback, asio::error_code& ec)
 {
   do_set_verify_callback(
-      new detail::verify_callback<VerifyCallback>(callback), ec);
+      new ssl::detail::verify_callback<VerifyCallback>(callback), ec);
   ASIO_SYNC_OP_VOID_RETURN(ec);
 }
 
@@ -56,7 +56,58 @@ ASIO_SYNC_OP_VOID context::set_password_callback(
     PasswordCallback callback, asio::error_code& ec)
 {
   do_set_password_callback(
-      new detail::password_callback<PasswordCallback>(callback), ec);
+      new ssl::detail::password_callback<PasswordCallback>(callback), ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+template <typename PskServerCallback>
+void context::set_psk_server_callback(PskServerCallback callback)
+{
+  asio::error_code ec;
+  this->set_psk_server_callback(callback, ec);
+  asio::detail::throw_error(ec, "set_psk_server_callback");
+}
+
+template <typename PskServerCallback>
+ASIO_SYNC_OP_VOID context::set_psk_server_callback(
+    PskServerCallback callback, asio::error_code& ec)
+{
+  do_set_psk_server_callback(
+      new dtls::detail::psk_server_callback<PskServerCallback>(callback), ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+template <typename Executor>
+void context::offload_private_key_operations(const Executor& executor)
+{
+  asio::error_code ec;
+  this->offload_private_key_operations(executor, ec);
+  asio::detail::throw_error(ec, "offload_private_key_operations");
+}
+
+template <typename Executor>
+ASIO_SYNC_OP_VOID context::offload_private_key_operations(
+    const Executor& executor, asio::error_code& ec)
+{
+  do_offload_private_key_operations(
+      new dtls::detail::private_key_executor<Executor>(executor), ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+template <typename PskClientCallback>
+void context::set_psk_client_callback(PskClientCallback callback)
+{
+  asio::error_code ec;
+  this->set_psk_client_callback(callback, ec);
+  asio::detail::throw_error(ec, "set_psk_client_callback");
+}
+
+template <typename PskClientCallback>
+ASIO_SYNC_OP_VOID context::set_psk_client_callback(
+    PskClientCallback callback, asio::error_code& ec)
+{
+  do_set_psk_client_callback(
+      new dtls::detail::psk_client_callback<PskClientCallback>(callback), ec);
   ASIO_SYNC_OP_VOID_RETURN(ec);
 }
 
@@ -19,10 +19,24 @@
 #include "asio/detail/config.hpp"
 
 #include <cstring>
+#include <vector>
+#include "asio/detail/call_stack.hpp"
+#include "asio/detail/static_mutex.hpp"
 #include "asio/detail/throw_error.hpp"
 #include "asio/error.hpp"
 #include "asio/ssl/dtls/context.hpp"
 #include "asio/ssl/error.hpp"
+#include "asio/ssl/dtls/detail/cpu_features.hpp"
+#include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/ssl/dtls/detail/ssl_app_data.hpp"
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+# include <openssl/core_names.h>
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#include <openssl/rand.h>
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+# include <openssl/async.h>
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
 
 #include "asio/detail/push_options.hpp"
 
@@ -180,6 +194,40 @@ context::~context()
       SSL_CTX_set_app_data(handle_, 0);
     }
 
+    if (void* callback = ::SSL_CTX_get_ex_data(
+          handle_, psk_server_callback_index()))
+    {
+      delete static_cast<dtls::detail::psk_server_callback_base*>(callback);
+      ::SSL_CTX_set_ex_data(handle_, psk_server_callback_index(), 0);
+    }
+
+    if (void* callback = ::SSL_CTX_get_ex_data(
+          handle_, psk_client_callback_index()))
+    {
+      delete static_cast<dtls::detail::psk_client_callback_base*>(callback);
+      ::SSL_CTX_set_ex_data(handle_, psk_client_callback_index(), 0);
+    }
+
+    if (void* keys = ::SSL_CTX_get_ex_data(handle_, ticket_key_index()))
+    {
+      delete static_cast<dtls::detail::ticket_key_store*>(keys);
+      ::SSL_CTX_set_ex_data(handle_, ticket_key_index(), 0);
+    }
+
+    if (void* length = ::SSL_CTX_get_ex_data(
+          handle_, connection_id_length_index()))
+    {
+      delete static_cast<std::size_t*>(length);
+      ::SSL_CTX_set_ex_data(handle_, connection_id_length_index(), 0);
+    }
+
+    if (void* executor = ::SSL_CTX_get_ex_data(
+          handle_, private_key_executor_index()))
+    {
+      delete static_cast<dtls::detail::private_key_executor_base*>(executor);
+      ::SSL_CTX_set_ex_data(handle_, private_key_executor_index(), 0);
+    }
+
     ::SSL_CTX_free(handle_);
   }
 }
@@ -860,6 +908,330 @@ ASIO_SYNC_OP_VOID context::do_use_tmp_dh(
   ASIO_SYNC_OP_VOID_RETURN(ec);
 }
 
+void context::set_session_cache(session_cache& cache)
+{
+  asio::error_code ec;
+  set_session_cache(cache, ec);
+  asio::detail::throw_error(ec, "set_session_cache");
+}
+
+ASIO_SYNC_OP_VOID context::set_session_cache(
+    session_cache& cache, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  int index = session_cache_index();
+  if (index < 0 || ::SSL_CTX_set_ex_data(handle_, index, &cache) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  // The external cache replaces the internal one entirely, so OpenSSL's
+  // lock-protected session table stays empty.
+  ::SSL_CTX_set_session_cache_mode(handle_,
+      SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+  ::SSL_CTX_sess_set_new_cb(handle_, &context::new_session_function);
+  ::SSL_CTX_sess_set_get_cb(handle_, &context::get_session_function);
+  ::SSL_CTX_sess_set_remove_cb(handle_, &context::remove_session_function);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void context::set_session_id_context(const std::string& id)
+{
+  asio::error_code ec;
+  set_session_id_context(id, ec);
+  asio::detail::throw_error(ec, "set_session_id_context");
+}
+
+ASIO_SYNC_OP_VOID context::set_session_id_context(
+    const std::string& id, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  if (::SSL_CTX_set_session_id_context(handle_,
+        reinterpret_cast<const unsigned char*>(id.data()),
+        static_cast<unsigned int>(id.size())) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void context::set_session_ticket_keys(
+    const const_buffer& current, const const_buffer& previous)
+{
+  asio::error_code ec;
+  set_session_ticket_keys(current, previous, ec);
+  asio::detail::throw_error(ec, "set_session_ticket_keys");
+}
+
+ASIO_SYNC_OP_VOID context::set_session_ticket_keys(
+    const const_buffer& current, const const_buffer& previous,
+    asio::error_code& ec)
+{
+  if (current.size() != session_ticket_key_length
+      || (previous.size() != 0
+        && previous.size() != session_ticket_key_length))
+  {
+    ec = asio::error::invalid_argument;
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  dtls::detail::ticket_key_store* keys = ticket_keys(ec);
+  if (!keys)
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+
+  keys->set(current, previous);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void context::rotate_session_ticket_key(const const_buffer& next)
+{
+  asio::error_code ec;
+  rotate_session_ticket_key(next, ec);
+  asio::detail::throw_error(ec, "rotate_session_ticket_key");
+}
+
+ASIO_SYNC_OP_VOID context::rotate_session_ticket_key(
+    const const_buffer& next, asio::error_code& ec)
+{
+  if (next.size() != session_ticket_key_length)
+  {
+    ec = asio::error::invalid_argument;
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  dtls::detail::ticket_key_store* keys = ticket_keys(ec);
+  if (!keys)
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+
+  keys->rotate(next);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+std::string context::generate_session_ticket_key()
+{
+  asio::error_code ec;
+  std::string key = generate_session_ticket_key(ec);
+  asio::detail::throw_error(ec, "generate_session_ticket_key");
+  return key;
+}
+
+std::string context::generate_session_ticket_key(asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  unsigned char key[session_ticket_key_length];
+  if (::RAND_bytes(key, sizeof(key)) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    return std::string();
+  }
+
+  std::string result(reinterpret_cast<const char*>(key), sizeof(key));
+  ::OPENSSL_cleanse(key, sizeof(key));
+
+  ec = asio::error_code();
+  return result;
+}
+
+context::session_ticket_statistics context::session_ticket_stats() const
+{
+  session_ticket_statistics stats = { 0, 0, 0 };
+  if (void* keys = ::SSL_CTX_get_ex_data(handle_, ticket_key_index()))
+  {
+    static_cast<dtls::detail::ticket_key_store*>(keys)->statistics(
+        stats.hits, stats.misses, stats.renewals);
+  }
+  return stats;
+}
+
+void context::set_psk_key_store(psk_key_store& store)
+{
+  asio::error_code ec;
+  set_psk_key_store(store, ec);
+  asio::detail::throw_error(ec, "set_psk_key_store");
+}
+
+ASIO_SYNC_OP_VOID context::set_psk_key_store(
+    psk_key_store& store, asio::error_code& ec)
+{
+  psk_key_store_lookup lookup = { &store };
+  do_set_psk_server_callback(
+      new dtls::detail::psk_server_callback<psk_key_store_lookup>(lookup), ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void context::use_psk_identity_hint(const std::string& hint)
+{
+  asio::error_code ec;
+  use_psk_identity_hint(hint, ec);
+  asio::detail::throw_error(ec, "use_psk_identity_hint");
+}
+
+ASIO_SYNC_OP_VOID context::use_psk_identity_hint(
+    const std::string& hint, asio::error_code& ec)
+{
+#if !defined(OPENSSL_NO_PSK)
+  ::ERR_clear_error();
+
+  if (::SSL_CTX_use_psk_identity_hint(handle_, hint.c_str()) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#else // !defined(OPENSSL_NO_PSK)
+  (void)hint;
+  ec = asio::error::operation_not_supported;
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#endif // !defined(OPENSSL_NO_PSK)
+}
+
+void context::set_cipher_list(const std::string& ciphers)
+{
+  asio::error_code ec;
+  set_cipher_list(ciphers, ec);
+  asio::detail::throw_error(ec, "set_cipher_list");
+}
+
+ASIO_SYNC_OP_VOID context::set_cipher_list(
+    const std::string& ciphers, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  if (::SSL_CTX_set_cipher_list(handle_, ciphers.c_str()) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void context::set_groups_list(const std::string& groups)
+{
+  asio::error_code ec;
+  set_groups_list(groups, ec);
+  asio::detail::throw_error(ec, "set_groups_list");
+}
+
+ASIO_SYNC_OP_VOID context::set_groups_list(
+    const std::string& groups, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  if (::SSL_CTX_set1_groups_list(handle_, groups.c_str()) != 1)
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  if (::SSL_CTX_set1_curves_list(handle_, groups.c_str()) != 1)
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void context::set_sigalgs_list(const std::string& sigalgs)
+{
+  asio::error_code ec;
+  set_sigalgs_list(sigalgs, ec);
+  asio::detail::throw_error(ec, "set_sigalgs_list");
+}
+
+ASIO_SYNC_OP_VOID context::set_sigalgs_list(
+    const std::string& sigalgs, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  if (::SSL_CTX_set1_sigalgs_list(handle_, sigalgs.c_str()) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+std::string context::use_fast_handshake_profile()
+{
+  asio::error_code ec;
+  std::string description = use_fast_handshake_profile(ec);
+  asio::detail::throw_error(ec, "use_fast_handshake_profile");
+  return description;
+}
+
+std::string context::use_fast_handshake_profile(asio::error_code& ec)
+{
+  const bool hardware_aes = dtls::detail::has_hardware_aes();
+
+  // Only ephemeral ECDH key exchange and AEAD ciphers. RSA certificates keep
+  // working, but ECDSA is preferred as it is much cheaper to sign with.
+  std::string aes_gcm =
+    "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256";
+  std::string chacha20 =
+    "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305";
+  std::string ciphers = hardware_aes
+    ? aes_gcm + ":" + chacha20 : chacha20 + ":" + aes_gcm;
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  std::string groups = "X25519:P-256";
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  std::string groups = "P-256";
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  std::string sigalgs = "ECDSA+SHA256:ECDSA+SHA384:RSA+SHA256";
+
+  set_cipher_list(ciphers, ec);
+  if (!ec)
+    set_groups_list(groups, ec);
+  if (!ec)
+    set_sigalgs_list(sigalgs, ec);
+
+  options o = SSL_OP_CIPHER_SERVER_PREFERENCE;
+#if defined(SSL_OP_PRIORITIZE_CHACHA)
+  o |= SSL_OP_PRIORITIZE_CHACHA;
+#endif // defined(SSL_OP_PRIORITIZE_CHACHA)
+  if (!ec)
+    set_options(o, ec);
+  if (ec)
+    return std::string();
+
+  return "fast handshake profile: groups " + groups
+    + ", signature algorithms " + sigalgs + ", ciphers " + ciphers
+    + (hardware_aes ? " (AES instructions available)"
+      : " (no AES instructions, ChaCha20-Poly1305 preferred)");
+}
+
 ASIO_SYNC_OP_VOID context::do_set_verify_callback(
     ssl::detail::verify_callback_base* callback, asio::error_code& ec)
 {
@@ -953,6 +1325,1017 @@ int context::password_callback_function(
   return 0;
 }
 
+int context::session_cache_index()
+{
+  static int index = ::SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+int context::new_session_function(SSL* ssl, SSL_SESSION* session)
+{
+  session_cache* cache = static_cast<session_cache*>(
+      ::SSL_CTX_get_ex_data(session_context(ssl), session_cache_index()));
+  if (!cache)
+    return 0;
+
+  int length = ::i2d_SSL_SESSION(session, 0);
+  if (length <= 0)
+    return 0;
+
+  std::vector<unsigned char> der(static_cast<std::size_t>(length));
+  unsigned char* p = &der[0];
+  ::i2d_SSL_SESSION(session, &p);
+
+  unsigned int id_length = 0;
+  const unsigned char* id = ::SSL_SESSION_get_id(session, &id_length);
+  cache->store(asio::buffer(id, id_length), asio::buffer(der));
+
+  // No reference to the session is kept.
+  return 0;
+}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+SSL_SESSION* context::get_session_function(
+    SSL* ssl, const unsigned char* id, int length, int* copy)
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+SSL_SESSION* context::get_session_function(
+    SSL* ssl, unsigned char* id, int length, int* copy)
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+{
+  *copy = 0;
+
+  session_cache* cache = static_cast<session_cache*>(
+      ::SSL_CTX_get_ex_data(session_context(ssl), session_cache_index()));
+  if (!cache || length <= 0)
+    return 0;
+
+  std::string der;
+  if (!cache->load(asio::buffer(id, static_cast<std::size_t>(length)), der))
+    return 0;
+
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(der.data());
+  return ::d2i_SSL_SESSION(0, &p, static_cast<long>(der.size()));
+}
+
+void context::remove_session_function(SSL_CTX* ctx, SSL_SESSION* session)
+{
+  session_cache* cache = static_cast<session_cache*>(
+      ::SSL_CTX_get_ex_data(ctx, session_cache_index()));
+  if (!cache)
+    return;
+
+  unsigned int id_length = 0;
+  const unsigned char* id = ::SSL_SESSION_get_id(session, &id_length);
+  cache->erase(asio::buffer(id, id_length));
+}
+
+int context::psk_server_callback_index()
+{
+  static int index = ::SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+int context::psk_client_callback_index()
+{
+  static int index = ::SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+ASIO_SYNC_OP_VOID context::do_set_psk_server_callback(
+    dtls::detail::psk_server_callback_base* callback, asio::error_code& ec)
+{
+#if !defined(OPENSSL_NO_PSK)
+  ::ERR_clear_error();
+
+  int index = psk_server_callback_index();
+  void* old_callback = index < 0 ? 0 : ::SSL_CTX_get_ex_data(handle_, index);
+  if (index < 0 || ::SSL_CTX_set_ex_data(handle_, index, callback) != 1)
+  {
+    delete callback;
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  if (old_callback)
+    delete static_cast<dtls::detail::psk_server_callback_base*>(old_callback);
+
+  ::SSL_CTX_set_psk_server_callback(handle_,
+      &context::psk_server_callback_function);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#else // !defined(OPENSSL_NO_PSK)
+  delete callback;
+  ec = asio::error::operation_not_supported;
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#endif // !defined(OPENSSL_NO_PSK)
+}
+
+ASIO_SYNC_OP_VOID context::do_set_psk_client_callback(
+    dtls::detail::psk_client_callback_base* callback, asio::error_code& ec)
+{
+#if !defined(OPENSSL_NO_PSK)
+  ::ERR_clear_error();
+
+  int index = psk_client_callback_index();
+  void* old_callback = index < 0 ? 0 : ::SSL_CTX_get_ex_data(handle_, index);
+  if (index < 0 || ::SSL_CTX_set_ex_data(handle_, index, callback) != 1)
+  {
+    delete callback;
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  if (old_callback)
+    delete static_cast<dtls::detail::psk_client_callback_base*>(old_callback);
+
+  ::SSL_CTX_set_psk_client_callback(handle_,
+      &context::psk_client_callback_function);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#else // !defined(OPENSSL_NO_PSK)
+  delete callback;
+  ec = asio::error::operation_not_supported;
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#endif // !defined(OPENSSL_NO_PSK)
+}
+
+unsigned int context::psk_server_callback_function(SSL* ssl,
+    const char* identity, unsigned char* psk, unsigned int max_psk_length)
+{
+  dtls::detail::psk_server_callback_base* callback =
+    static_cast<dtls::detail::psk_server_callback_base*>(
+        ::SSL_CTX_get_ex_data(session_context(ssl),
+          psk_server_callback_index()));
+  if (!callback || !identity)
+    return 0;
+
+  // Returning 0 fails the handshake with an unknown_psk_identity alert.
+  std::string key;
+  unsigned int length = 0;
+  if (callback->call(identity, key)
+      && !key.empty() && key.size() <= max_psk_length)
+  {
+    std::memcpy(psk, key.data(), key.size());
+    length = static_cast<unsigned int>(key.size());
+  }
+
+  if (!key.empty())
+    ::OPENSSL_cleanse(&key[0], key.size());
+  return length;
+}
+
+unsigned int context::psk_client_callback_function(SSL* ssl,
+    const char* hint, char* identity, unsigned int max_identity_length,
+    unsigned char* psk, unsigned int max_psk_length)
+{
+  dtls::detail::psk_client_callback_base* callback =
+    static_cast<dtls::detail::psk_client_callback_base*>(
+        ::SSL_CTX_get_ex_data(session_context(ssl),
+          psk_client_callback_index()));
+  if (!callback)
+    return 0;
+
+  std::string id, key;
+  unsigned int length = 0;
+  if (callback->call(hint ? hint : "", id, key)
+      && id.size() < max_identity_length
+      && !key.empty() && key.size() <= max_psk_length)
+  {
+    std::memcpy(identity, id.c_str(), id.size() + 1);
+    std::memcpy(psk, key.data(), key.size());
+    length = static_cast<unsigned int>(key.size());
+  }
+
+  if (!key.empty())
+    ::OPENSSL_cleanse(&key[0], key.size());
+  return length;
+}
+
+int context::ticket_key_index()
+{
+  static int index = ::SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+dtls::detail::ticket_key_store* context::ticket_keys(asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  int index = ticket_key_index();
+  if (index < 0)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    return 0;
+  }
+
+  if (void* keys = ::SSL_CTX_get_ex_data(handle_, index))
+    return static_cast<dtls::detail::ticket_key_store*>(keys);
+
+  dtls::detail::ticket_key_store* keys = new dtls::detail::ticket_key_store;
+  if (::SSL_CTX_set_ex_data(handle_, index, keys) != 1)
+  {
+    delete keys;
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    return 0;
+  }
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+  ::SSL_CTX_set_tlsext_ticket_key_evp_cb(handle_,
+      &context::ticket_key_function);
+#else // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+  ::SSL_CTX_set_tlsext_ticket_key_cb(handle_, &context::ticket_key_function);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+  ::SSL_CTX_clear_options(handle_, SSL_OP_NO_TICKET);
+
+  return keys;
+}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+int context::ticket_key_function(SSL* ssl, unsigned char* name,
+    unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int enc)
+#else // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+int context::ticket_key_function(SSL* ssl, unsigned char* name,
+    unsigned char* iv, EVP_CIPHER_CTX* cipher, HMAC_CTX* mac, int enc)
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+{
+  dtls::detail::ticket_key_store* keys =
+    static_cast<dtls::detail::ticket_key_store*>(
+        ::SSL_CTX_get_ex_data(session_context(ssl), ticket_key_index()));
+  // Without keys no ticket is issued or accepted.
+  if (!keys)
+    return 0;
+
+  dtls::detail::ticket_key_store::key k;
+  int result = 1;
+
+  if (enc)
+  {
+    // Returning 0 issues no ticket.
+    if (!keys->encryption_key(k))
+      return 0;
+
+    std::memcpy(name, k.name, sizeof(k.name));
+    if (::RAND_bytes(iv, EVP_CIPHER_iv_length(::EVP_aes_256_cbc())) != 1
+        || ::EVP_EncryptInit_ex(cipher,
+          ::EVP_aes_256_cbc(), 0, k.aes_key, iv) != 1)
+      result = -1;
+  }
+  else
+  {
+    // Returning 0 makes OpenSSL fall back to a full handshake, and returning
+    // 2 makes it issue a new ticket protected by the current key.
+    switch (keys->decryption_key(name, k))
+    {
+    case dtls::detail::ticket_key_store::unknown_key:
+      return 0;
+    case dtls::detail::ticket_key_store::previous_key:
+      result = 2;
+      break;
+    default:
+      break;
+    }
+
+    if (::EVP_DecryptInit_ex(cipher,
+          ::EVP_aes_256_cbc(), 0, k.aes_key, iv) != 1)
+      result = -1;
+  }
+
+  if (result > 0)
+  {
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] =
+    {
+      ::OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+          k.hmac_key, sizeof(k.hmac_key)),
+      ::OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+      ::OSSL_PARAM_construct_end()
+    };
+    if (::EVP_MAC_CTX_set_params(mac, params) != 1)
+      result = -1;
+#else // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+    if (::HMAC_Init_ex(mac, k.hmac_key,
+          sizeof(k.hmac_key), ::EVP_sha256(), 0) != 1)
+      result = -1;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+  }
+
+  ::OPENSSL_cleanse(&k, sizeof(k));
+  return result;
+}
+
+void context::set_server_certificate_types(certificate_types types)
+{
+  asio::error_code ec;
+  set_server_certificate_types(types, ec);
+  asio::detail::throw_error(ec, "set_server_certificate_types");
+}
+
+ASIO_SYNC_OP_VOID context::set_server_certificate_types(
+    certificate_types types, asio::error_code& ec)
+{
+  do_set_certificate_types(true, types, ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void context::set_client_certificate_types(certificate_types types)
+{
+  asio::error_code ec;
+  set_client_certificate_types(types, ec);
+  asio::detail::throw_error(ec, "set_client_certificate_types");
+}
+
+ASIO_SYNC_OP_VOID context::set_client_certificate_types(
+    certificate_types types, asio::error_code& ec)
+{
+  do_set_certificate_types(false, types, ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+ASIO_SYNC_OP_VOID context::do_set_certificate_types(bool server,
+    certificate_types types, asio::error_code& ec)
+{
+  if ((types & (x509_certificate | raw_public_key)) == 0
+      || (types & ~(x509_certificate | raw_public_key)) != 0)
+  {
+    ec = asio::error::invalid_argument;
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30200000L)
+  ::ERR_clear_error();
+
+  // In order of preference.
+  unsigned char list[2];
+  std::size_t length = 0;
+  if (types & raw_public_key)
+    list[length++] = TLSEXT_cert_type_rpk;
+  if (types & x509_certificate)
+    list[length++] = TLSEXT_cert_type_x509;
+
+  int result = server
+    ? ::SSL_CTX_set1_server_cert_type(handle_, list, length)
+    : ::SSL_CTX_set1_client_cert_type(handle_, list, length);
+  if (result != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#else // (OPENSSL_VERSION_NUMBER >= 0x30200000L)
+  // X.509 is all there is.
+  (void)server;
+  if (types & raw_public_key)
+    ec = asio::error::operation_not_supported;
+  else
+    ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30200000L)
+}
+
+void context::set_pinned_keys(pinned_key_set& keys)
+{
+  asio::error_code ec;
+  set_pinned_keys(keys, ec);
+  asio::detail::throw_error(ec, "set_pinned_keys");
+}
+
+ASIO_SYNC_OP_VOID context::set_pinned_keys(
+    pinned_key_set& keys, asio::error_code& ec)
+{
+  ::SSL_CTX_set_cert_verify_callback(handle_,
+      &context::pinned_key_verify_function, &keys);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+int context::pinned_key_verify_function(X509_STORE_CTX* ctx, void* arg)
+{
+  EVP_PKEY* key = 0;
+#if (OPENSSL_VERSION_NUMBER >= 0x30200000L)
+  key = ::X509_STORE_CTX_get0_rpk(ctx);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x30200000L)
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  if (!key)
+  {
+    X509* cert = ::X509_STORE_CTX_get0_cert(ctx);
+    key = cert ? ::X509_get0_pubkey(cert) : 0;
+  }
+
+  bool pinned = key && static_cast<pinned_key_set*>(arg)->contains(key);
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+  key = ctx->cert ? ::X509_get_pubkey(ctx->cert) : 0;
+  bool pinned = key && static_cast<pinned_key_set*>(arg)->contains(key);
+  ::EVP_PKEY_free(key);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+
+  if (pinned)
+  {
+    ::X509_STORE_CTX_set_error(ctx, X509_V_OK);
+    return 1;
+  }
+
+  ::X509_STORE_CTX_set_error(ctx, X509_V_ERR_CERT_UNTRUSTED);
+  return 0;
+}
+
+void context::enable_connection_id(std::size_t length)
+{
+  asio::error_code ec;
+  enable_connection_id(length, ec);
+  asio::detail::throw_error(ec, "enable_connection_id");
+}
+
+ASIO_SYNC_OP_VOID context::enable_connection_id(
+    std::size_t length, asio::error_code& ec)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  if (length > 255)
+  {
+    ec = asio::error::invalid_argument;
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  if (void* stored = ::SSL_CTX_get_ex_data(
+        handle_, connection_id_length_index()))
+  {
+    *static_cast<std::size_t*>(stored) = length;
+    ec = asio::error_code();
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  std::size_t* stored = new std::size_t(length);
+  ::ERR_clear_error();
+  if (::SSL_CTX_add_custom_ext(handle_, connection_id_extension,
+        SSL_EXT_DTLS_ONLY | SSL_EXT_CLIENT_HELLO
+          | SSL_EXT_TLS1_2_SERVER_HELLO,
+        &context::connection_id_add_function,
+        &context::connection_id_free_function, stored,
+        &context::connection_id_parse_function, 0) != 1)
+  {
+    delete stored;
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ::SSL_CTX_set_ex_data(handle_, connection_id_length_index(), stored);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  (void)length;
+  ec = asio::error::operation_not_supported;
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+int context::connection_id_length_index()
+{
+  static int index = ::SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+int context::connection_id_add_function(SSL* ssl, unsigned int,
+    unsigned int context, const unsigned char** out, std::size_t* out_length,
+    X509*, std::size_t, int* alert, void* arg)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  dtls::detail::ssl_app_data* appdata =
+    static_cast<dtls::detail::ssl_app_data*>(SSL_get_app_data(ssl));
+
+  // Only agree to connection IDs if the record layer can carry them.
+  if (context & SSL_EXT_TLS1_2_SERVER_HELLO)
+  {
+    if (::SSL_version(ssl) != DTLS1_2_VERSION
+        || !dtls::detail::record_layer::is_supported(
+          ::SSL_get_pending_cipher(ssl)))
+      return 0;
+  }
+
+  // A client keeps its ID when the ClientHello is repeated with a cookie.
+  std::string cid;
+  if (!appdata->getLocalConnectionId(cid))
+  {
+    cid.resize(*static_cast<std::size_t*>(arg));
+    if (!cid.empty() && ::RAND_bytes(reinterpret_cast<unsigned char*>(
+            &cid[0]), static_cast<int>(cid.size())) != 1)
+    {
+      *alert = SSL_AD_INTERNAL_ERROR;
+      return -1;
+    }
+    appdata->set_local_connection_id(cid);
+  }
+
+  unsigned char* data = static_cast<unsigned char*>(
+      ::OPENSSL_malloc(cid.size() + 1));
+  if (!data)
+  {
+    *alert = SSL_AD_INTERNAL_ERROR;
+    return -1;
+  }
+  data[0] = static_cast<unsigned char>(cid.size());
+  std::memcpy(data + 1, cid.data(), cid.size());
+  *out = data;
+  *out_length = cid.size() + 1;
+
+  if (context & SSL_EXT_TLS1_2_SERVER_HELLO)
+    appdata->set_connection_id_negotiated(true);
+
+  return 1;
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  (void)ssl;
+  (void)context;
+  (void)out;
+  (void)out_length;
+  (void)alert;
+  (void)arg;
+  return 0;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+void context::connection_id_free_function(SSL*, unsigned int,
+    unsigned int, const unsigned char* out, void*)
+{
+  ::OPENSSL_free(const_cast<unsigned char*>(out));
+}
+
+int context::connection_id_parse_function(SSL* ssl, unsigned int,
+    unsigned int context, const unsigned char* in, std::size_t in_length,
+    X509*, std::size_t, int* alert, void*)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  if (in_length == 0 || in[0] != in_length - 1)
+  {
+    *alert = SSL_AD_DECODE_ERROR;
+    return 0;
+  }
+
+  dtls::detail::ssl_app_data* appdata =
+    static_cast<dtls::detail::ssl_app_data*>(SSL_get_app_data(ssl));
+  appdata->set_peer_connection_id(std::string(
+        reinterpret_cast<const char*>(in + 1), in_length - 1));
+
+  // A server only answers if it can handle connection IDs.
+  if (context & SSL_EXT_TLS1_2_SERVER_HELLO)
+  {
+    if (!dtls::detail::record_layer::is_supported(
+          ::SSL_get_pending_cipher(ssl)))
+    {
+      *alert = SSL_AD_ILLEGAL_PARAMETER;
+      return 0;
+    }
+    appdata->set_connection_id_negotiated(true);
+  }
+
+  return 1;
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  (void)ssl;
+  (void)context;
+  (void)in;
+  (void)in_length;
+  (void)alert;
+  return 0;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+void context::enable_heartbeat()
+{
+  asio::error_code ec;
+  enable_heartbeat(ec);
+  asio::detail::throw_error(ec, "enable_heartbeat");
+}
+
+ASIO_SYNC_OP_VOID context::enable_heartbeat(asio::error_code& ec)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  if (::SSL_CTX_has_client_custom_ext(handle_, heartbeat_extension))
+  {
+    ec = asio::error_code();
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ::ERR_clear_error();
+  if (::SSL_CTX_add_custom_ext(handle_, heartbeat_extension,
+        SSL_EXT_DTLS_ONLY | SSL_EXT_CLIENT_HELLO
+          | SSL_EXT_TLS1_2_SERVER_HELLO,
+        &context::heartbeat_add_function, 0, 0,
+        &context::heartbeat_parse_function, 0) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  ec = asio::error::operation_not_supported;
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+int context::heartbeat_add_function(SSL* ssl, unsigned int,
+    unsigned int context, const unsigned char** out, std::size_t* out_length,
+    X509*, std::size_t, int*, void*)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  // Only agree to heartbeats if the record layer can carry them.
+  if (context & SSL_EXT_TLS1_2_SERVER_HELLO)
+  {
+    if (::SSL_version(ssl) != DTLS1_2_VERSION
+        || !dtls::detail::record_layer::is_supported(
+          ::SSL_get_pending_cipher(ssl)))
+      return 0;
+
+    dtls::detail::ssl_app_data* appdata =
+      static_cast<dtls::detail::ssl_app_data*>(SSL_get_app_data(ssl));
+    appdata->set_heartbeat_negotiated(true);
+  }
+
+  // The mode peer_allowed_to_send, as requests are always answered.
+  static const unsigned char mode[1] = { 1 };
+  *out = mode;
+  *out_length = sizeof(mode);
+  return 1;
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  (void)ssl;
+  (void)context;
+  (void)out;
+  (void)out_length;
+  return 0;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+int context::heartbeat_parse_function(SSL* ssl, unsigned int,
+    unsigned int context, const unsigned char* in, std::size_t in_length,
+    X509*, std::size_t, int* alert, void*)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  // The modes peer_allowed_to_send and peer_not_allowed_to_send.
+  if (in_length != 1 || (in[0] != 1 && in[0] != 2))
+  {
+    *alert = SSL_AD_ILLEGAL_PARAMETER;
+    return 0;
+  }
+
+  dtls::detail::ssl_app_data* appdata =
+    static_cast<dtls::detail::ssl_app_data*>(SSL_get_app_data(ssl));
+  appdata->set_heartbeat_requests_allowed(in[0] == 1);
+
+  // A server that agrees to heartbeats with a suite the record layer cannot
+  // handle is ignored, and the session runs on OpenSSL's record layer
+  // without them.
+  if (context & SSL_EXT_TLS1_2_SERVER_HELLO)
+  {
+    if (::SSL_version(ssl) == DTLS1_2_VERSION
+        && dtls::detail::record_layer::is_supported(
+          ::SSL_get_pending_cipher(ssl)))
+      appdata->set_heartbeat_negotiated(true);
+  }
+
+  return 1;
+#else // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+  (void)ssl;
+  (void)context;
+  (void)in;
+  (void)in_length;
+  (void)alert;
+  return 0;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+}
+
+void context::set_server_name_map(server_name_map& map)
+{
+  asio::error_code ec;
+  set_server_name_map(map, ec);
+  asio::detail::throw_error(ec, "set_server_name_map");
+}
+
+ASIO_SYNC_OP_VOID context::set_server_name_map(
+    server_name_map& map, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  if (::SSL_CTX_set_tlsext_servername_callback(handle_,
+        &context::server_name_function) != 1
+      || ::SSL_CTX_set_tlsext_servername_arg(handle_, &map) != 1)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+int context::server_name_function(SSL* ssl, int* alert, void* arg)
+{
+  const char* name = ::SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  if (!name)
+    return SSL_TLSEXT_ERR_NOACK;
+
+  context* selected = static_cast<server_name_map*>(arg)->find(name);
+  if (!selected)
+    return SSL_TLSEXT_ERR_NOACK;
+
+  SSL_CTX* handle = selected->native_handle();
+  if (handle != ::SSL_get_SSL_CTX(ssl))
+  {
+    // Remember the context the callbacks were installed on, whose state
+    // they keep using after the switch.
+    if (!::SSL_get_ex_data(ssl, session_context_index()))
+      ::SSL_set_ex_data(ssl, session_context_index(), ::SSL_get_SSL_CTX(ssl));
+
+    // SSL_set_SSL_CTX only takes over the certificate and key.
+    if (!::SSL_set_SSL_CTX(ssl, handle))
+    {
+      *alert = SSL_AD_INTERNAL_ERROR;
+      return SSL_TLSEXT_ERR_ALERT_FATAL;
+    }
+
+    ::SSL_set_verify(ssl, ::SSL_CTX_get_verify_mode(handle),
+        ::SSL_get_verify_callback(ssl));
+    ::SSL_set_verify_depth(ssl, ::SSL_CTX_get_verify_depth(handle));
+    ::SSL_set_options(ssl, ::SSL_CTX_get_options(handle));
+  }
+
+  return SSL_TLSEXT_ERR_OK;
+}
+
+int context::session_context_index()
+{
+  static int index = ::SSL_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+SSL_CTX* context::session_context(SSL* ssl)
+{
+  if (void* handle = ::SSL_get_ex_data(ssl, session_context_index()))
+    return static_cast<SSL_CTX*>(handle);
+  return ::SSL_get_SSL_CTX(ssl);
+}
+
+int context::private_key_executor_index()
+{
+  static int index = ::SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+  return index;
+}
+
+ASIO_SYNC_OP_VOID context::do_offload_private_key_operations(
+    dtls::detail::private_key_executor_base* executor, asio::error_code& ec)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+  ::ERR_clear_error();
+
+  EVP_PKEY* key = ::SSL_CTX_get0_privatekey(handle_);
+  if (!key)
+  {
+    delete executor;
+    ec = asio::error::invalid_argument;
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  // Install a copy of the key whose signing function is ours. OpenSSL keeps
+  // using the certificate loaded before, as the public keys match.
+  EVP_PKEY* offloaded_key = 0;
+  ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD
+  switch (::EVP_PKEY_base_id(key))
+  {
+#if !defined(OPENSSL_NO_EC)
+  case EVP_PKEY_EC:
+    {
+      static EC_KEY_METHOD* method = 0;
+      static asio::detail::static_mutex method_mutex = ASIO_STATIC_MUTEX_INIT;
+      method_mutex.init();
+      asio::detail::static_mutex::scoped_lock lock(method_mutex);
+      if (!method)
+      {
+        method = ::EC_KEY_METHOD_new(::EC_KEY_OpenSSL());
+        if (method)
+        {
+          int (*sign_setup)(EC_KEY*, BN_CTX*, BIGNUM**, BIGNUM**) = 0;
+          ECDSA_SIG* (*sign_sig)(const unsigned char*, int,
+              const BIGNUM*, const BIGNUM*, EC_KEY*) = 0;
+          ::EC_KEY_METHOD_get_sign(method, 0, &sign_setup, &sign_sig);
+          ::EC_KEY_METHOD_set_sign(method,
+              &context::ecdsa_sign_function, sign_setup, sign_sig);
+        }
+      }
+      lock.unlock();
+
+      EC_KEY* ec_key = method ? ::EC_KEY_dup(::EVP_PKEY_get0_EC_KEY(key)) : 0;
+      if (ec_key && ::EC_KEY_set_method(ec_key, method) == 1)
+      {
+        offloaded_key = ::EVP_PKEY_new();
+        if (offloaded_key && ::EVP_PKEY_assign_EC_KEY(offloaded_key, ec_key))
+          ec_key = 0;
+      }
+      ::EC_KEY_free(ec_key);
+    }
+    break;
+#endif // !defined(OPENSSL_NO_EC)
+  case EVP_PKEY_RSA:
+    {
+      static RSA_METHOD* method = 0;
+      static asio::detail::static_mutex method_mutex = ASIO_STATIC_MUTEX_INIT;
+      method_mutex.init();
+      asio::detail::static_mutex::scoped_lock lock(method_mutex);
+      if (!method)
+      {
+        method = ::RSA_meth_dup(::RSA_PKCS1_OpenSSL());
+        if (method)
+          ::RSA_meth_set_priv_enc(method,
+              &context::rsa_private_encrypt_function);
+      }
+      lock.unlock();
+
+      RSA* rsa = method ? ::RSAPrivateKey_dup(::EVP_PKEY_get0_RSA(key)) : 0;
+      if (rsa && ::RSA_set_method(rsa, method) == 1)
+      {
+        offloaded_key = ::EVP_PKEY_new();
+        if (offloaded_key && ::EVP_PKEY_assign_RSA(offloaded_key, rsa))
+          rsa = 0;
+      }
+      ::RSA_free(rsa);
+    }
+    break;
+  default:
+    delete executor;
+    ec = asio::error::operation_not_supported;
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+  ASIO_DTLS_END_LEGACY_KEY_METHOD
+
+  int index = private_key_executor_index();
+  if (!offloaded_key || index < 0
+      || ::SSL_CTX_use_PrivateKey(handle_, offloaded_key) != 1)
+  {
+    ::EVP_PKEY_free(offloaded_key);
+    delete executor;
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+  ::EVP_PKEY_free(offloaded_key);
+
+  void* old_executor = ::SSL_CTX_get_ex_data(handle_, index);
+  if (::SSL_CTX_set_ex_data(handle_, index, executor) != 1)
+  {
+    delete executor;
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  if (old_executor)
+    delete static_cast<dtls::detail::private_key_executor_base*>(old_executor);
+
+  ::SSL_CTX_set_mode(handle_, SSL_MODE_ASYNC);
+
+  ec = asio::error_code();
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+  delete executor;
+  ec = asio::error::operation_not_supported;
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+}
+
+dtls::detail::private_key_executor_base*
+context::private_key_operation_executor()
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+  // Only a handshake running as an asynchronous job can be suspended.
+  if (!::ASYNC_get_current_job())
+    return 0;
+
+  dtls::detail::engine* engine =
+    asio::detail::call_stack<dtls::detail::engine,
+      dtls::detail::engine>::top();
+  if (!engine)
+    return 0;
+
+  return static_cast<dtls::detail::private_key_executor_base*>(
+      ::SSL_CTX_get_ex_data(::SSL_get_SSL_CTX(engine->native_handle()),
+        private_key_executor_index()));
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+  return 0;
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+}
+
+void context::run_private_key_operation(
+    dtls::detail::private_key_executor_base* executor,
+    const asio::detail::shared_ptr<dtls::detail::private_key_operation>& op)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+  dtls::detail::engine* engine =
+    asio::detail::call_stack<dtls::detail::engine,
+      dtls::detail::engine>::top();
+  dtls::detail::ssl_app_data* appdata =
+    static_cast<dtls::detail::ssl_app_data*>(
+        SSL_get_app_data(engine->native_handle()));
+
+  // Publish the operation before posting it, so the handshake knows what to
+  // wait for once the job is paused.
+  appdata->set_private_key_operation(op);
+  executor->post(op);
+
+  // The handshake resumes the job when the operation is done. Should the
+  // job be resumed early, or fail to pause, wait here.
+  while (!op->done())
+    if (!::ASYNC_pause_job())
+      op->wait();
+
+  appdata->set_private_key_operation(
+      asio::detail::shared_ptr<dtls::detail::private_key_operation>());
+#else // (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+  (void)executor;
+  op->wait();
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L) && defined(SSL_MODE_ASYNC)
+}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+ASIO_DTLS_BEGIN_LEGACY_KEY_METHOD
+
+#if !defined(OPENSSL_NO_EC)
+int context::ecdsa_sign_function(int type, const unsigned char* digest,
+    int digest_length, unsigned char* sig, unsigned int* sig_length,
+    const BIGNUM* kinv, const BIGNUM* r, EC_KEY* key)
+{
+  dtls::detail::private_key_executor_base* executor =
+    private_key_operation_executor();
+  if (!executor || kinv || r)
+  {
+    int (*sign)(int, const unsigned char*, int, unsigned char*,
+        unsigned int*, const BIGNUM*, const BIGNUM*, EC_KEY*) = 0;
+    ::EC_KEY_METHOD_get_sign(::EC_KEY_OpenSSL(), &sign, 0, 0);
+    return sign(type, digest, digest_length, sig, sig_length, kinv, r, key);
+  }
+
+  asio::detail::shared_ptr<dtls::detail::private_key_operation> op(
+      new dtls::detail::ecdsa_sign_operation(digest, digest_length, key));
+  run_private_key_operation(executor, op);
+
+  if (op->result_length() < 0)
+  {
+    *sig_length = 0;
+    return 0;
+  }
+
+  std::memcpy(sig, op->result(), op->result_length());
+  *sig_length = static_cast<unsigned int>(op->result_length());
+  return 1;
+}
+#endif // !defined(OPENSSL_NO_EC)
+
+int context::rsa_private_encrypt_function(int length,
+    const unsigned char* from, unsigned char* to, RSA* key, int padding)
+{
+  dtls::detail::private_key_executor_base* executor =
+    private_key_operation_executor();
+  if (!executor)
+  {
+    return ::RSA_meth_get_priv_enc(::RSA_PKCS1_OpenSSL())(
+        length, from, to, key, padding);
+  }
+
+  asio::detail::shared_ptr<dtls::detail::private_key_operation> op(
+      new dtls::detail::rsa_private_encrypt_operation(
+        from, length, key, padding));
+  run_private_key_operation(executor, op);
+
+  if (op->result_length() < 0)
+    return -1;
+
+  std::memcpy(to, op->result(), op->result_length());
+  return op->result_length();
+}
+
+ASIO_DTLS_END_LEGACY_KEY_METHOD
+#endif // (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+
 BIO* context::make_buffer_bio(const const_buffer& b)
 {
   return ::BIO_new_mem_buf(
@@ -0,0 +1,227 @@
+//
+// ssl/dtls/impl/io_context_pool.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IMPL_IO_CONTEXT_POOL_IPP
+#define ASIO_SSL_DTLS_IMPL_IO_CONTEXT_POOL_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/ssl/dtls/io_context_pool.hpp"
+
+#if defined(ASIO_WINDOWS)
+# include "asio/detail/socket_types.hpp"
+#else // defined(ASIO_WINDOWS)
+# include <time.h>
+#endif // defined(ASIO_WINDOWS)
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+io_context_pool::io_context_pool(placement policy)
+  : policy_(policy),
+    next_(0),
+    sample_interval_(asio::steady_timer::duration::zero())
+{
+}
+
+io_context_pool::~io_context_pool()
+{
+  for (std::size_t i = 0; i < entries_.size(); ++i)
+    delete entries_[i];
+}
+
+void io_context_pool::add(asio::io_context& io_context)
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  entries_.push_back(new entry(io_context));
+  if (sample_interval_ != asio::steady_timer::duration::zero())
+    schedule_sample(entries_.size() - 1);
+}
+
+std::size_t io_context_pool::size() const
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  return entries_.size();
+}
+
+io_context_pool::placement io_context_pool::policy() const
+{
+  return policy_;
+}
+
+asio::io_context& io_context_pool::place(asio::io_context& fallback)
+{
+  asio::io_context* io_context = place();
+  return io_context ? *io_context : fallback;
+}
+
+asio::io_context* io_context_pool::place()
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  if (entries_.empty())
+    return 0;
+
+  std::size_t chosen = 0;
+  switch (policy_)
+  {
+  case round_robin:
+    chosen = next_++ % entries_.size();
+    break;
+
+  case least_sessions:
+  case least_recent_cpu:
+    // Start the search after the last choice, so that ties are spread.
+    chosen = next_ % entries_.size();
+    for (std::size_t n = 1; n < entries_.size(); ++n)
+    {
+      std::size_t i = (next_ + n) % entries_.size();
+      const entry& e = *entries_[i];
+      const entry& best = *entries_[chosen];
+      if (policy_ == least_recent_cpu && e.recent_cpu_ != best.recent_cpu_)
+      {
+        if (e.recent_cpu_ < best.recent_cpu_)
+          chosen = i;
+      }
+      else if (e.sessions_ < best.sessions_)
+        chosen = i;
+    }
+    next_ = chosen + 1;
+    break;
+  }
+
+  ++entries_[chosen]->sessions_;
+  return entries_[chosen]->io_context_;
+}
+
+void io_context_pool::release(asio::io_context& io_context)
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  for (std::size_t i = 0; i < entries_.size(); ++i)
+  {
+    if (entries_[i]->io_context_ == &io_context)
+    {
+      if (entries_[i]->sessions_ > 0)
+        --entries_[i]->sessions_;
+      return;
+    }
+  }
+}
+
+std::size_t io_context_pool::sessions(std::size_t index) const
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  return index < entries_.size() ? entries_[index]->sessions_ : 0;
+}
+
+double io_context_pool::recent_cpu(std::size_t index) const
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  return index < entries_.size() ? entries_[index]->recent_cpu_ : 0;
+}
+
+void io_context_pool::start_load_sampling(
+    asio::steady_timer::duration interval)
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  bool running = sample_interval_ != asio::steady_timer::duration::zero();
+  sample_interval_ = interval;
+  if (running || interval == asio::steady_timer::duration::zero())
+    return;
+
+  for (std::size_t i = 0; i < entries_.size(); ++i)
+  {
+    entries_[i]->last_cpu_ = -1;
+    schedule_sample(i);
+  }
+}
+
+void io_context_pool::stop_load_sampling()
+{
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  sample_interval_ = asio::steady_timer::duration::zero();
+  for (std::size_t i = 0; i < entries_.size(); ++i)
+    entries_[i]->timer_.cancel();
+}
+
+void io_context_pool::schedule_sample(std::size_t index)
+{
+  sampler handler = { this, index };
+  entries_[index]->timer_.expires_after(sample_interval_);
+  entries_[index]->timer_.async_wait(handler);
+}
+
+void io_context_pool::sample(std::size_t index)
+{
+  double cpu = thread_cpu_time();
+  asio::chrono::steady_clock::time_point now =
+    asio::chrono::steady_clock::now();
+
+  asio::detail::mutex::scoped_lock lock(mutex_);
+  if (sample_interval_ == asio::steady_timer::duration::zero())
+    return;
+
+  entry& e = *entries_[index];
+  if (cpu >= 0 && e.last_cpu_ >= 0
+      && e.last_thread_ == std::this_thread::get_id())
+  {
+    double elapsed = asio::chrono::duration_cast<
+      asio::chrono::duration<double> >(now - e.last_sample_).count();
+    if (elapsed > 0)
+    {
+      double usage = (cpu - e.last_cpu_) / elapsed;
+      if (usage > 1)
+        usage = 1;
+
+      // Weigh the latest sample as much as all earlier ones together, so a
+      // thread that became busy is avoided after one or two intervals.
+      e.recent_cpu_ = (e.recent_cpu_ + usage) / 2;
+    }
+  }
+
+  e.last_cpu_ = cpu;
+  e.last_sample_ = now;
+  e.last_thread_ = std::this_thread::get_id();
+  schedule_sample(index);
+}
+
+double io_context_pool::thread_cpu_time()
+{
+#if defined(ASIO_WINDOWS)
+  FILETIME creation, exit, kernel, user;
+  if (!::GetThreadTimes(::GetCurrentThread(),
+        &creation, &exit, &kernel, &user))
+    return -1;
+
+  // FILETIME counts 100 nanosecond intervals.
+  return ((static_cast<double>(kernel.dwHighDateTime) * 4294967296.0
+        + kernel.dwLowDateTime)
+      + (static_cast<double>(user.dwHighDateTime) * 4294967296.0
+        + user.dwLowDateTime)) / 1e7;
+#else // defined(ASIO_WINDOWS)
+  struct timespec ts;
+  if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return -1;
+
+  return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+#endif // defined(ASIO_WINDOWS)
+}
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_IMPL_IO_CONTEXT_POOL_IPP
@@ -0,0 +1,381 @@
+//
+// ssl/dtls/impl/null_engine.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IMPL_NULL_ENGINE_IPP
+#define ASIO_SSL_DTLS_IMPL_NULL_ENGINE_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstring>
+#include "asio/error.hpp"
+#include "asio/ssl/dtls/null_engine.hpp"
+#include "asio/ssl/error.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+null_engine::null_engine(SSL_CTX*)
+  : mtu_(0),
+    sent_shutdown_(false),
+    received_shutdown_(false),
+    write_seq_(0)
+{
+}
+
+#if defined(ASIO_HAS_MOVE)
+null_engine::null_engine(null_engine&& other) ASIO_NOEXCEPT
+  : mtu_(other.mtu_),
+    sent_shutdown_(other.sent_shutdown_),
+    received_shutdown_(other.received_shutdown_),
+    write_seq_(other.write_seq_),
+    pending_records_(ASIO_MOVE_CAST(std::deque<pending_record>)(
+          other.pending_records_)),
+    record_input_(other.record_input_),
+    record_leftover_(other.record_leftover_)
+{
+  other.record_input_ = asio::const_buffer();
+  other.record_leftover_ = asio::const_buffer();
+}
+
+null_engine& null_engine::operator=(null_engine&& other) ASIO_NOEXCEPT
+{
+  if (this != &other)
+  {
+    mtu_ = other.mtu_;
+    sent_shutdown_ = other.sent_shutdown_;
+    received_shutdown_ = other.received_shutdown_;
+    write_seq_ = other.write_seq_;
+    pending_records_ = ASIO_MOVE_CAST(std::deque<pending_record>)(
+        other.pending_records_);
+    record_input_ = other.record_input_;
+    record_leftover_ = other.record_leftover_;
+    other.record_input_ = asio::const_buffer();
+    other.record_leftover_ = asio::const_buffer();
+  }
+  return *this;
+}
+#endif // defined(ASIO_HAS_MOVE)
+
+bool null_engine::set_mtu(int mtu)
+{
+  mtu_ = mtu;
+  return true;
+}
+
+int null_engine::mtu() const
+{
+  return mtu_;
+}
+
+std::size_t null_engine::max_payload_length() const
+{
+  std::size_t length = mtu_ > header_length
+    ? static_cast<std::size_t>(mtu_ - header_length) : 0;
+  return mtu_ <= 0 || length > SSL3_RT_MAX_PLAIN_LENGTH
+    ? SSL3_RT_MAX_PLAIN_LENGTH : length;
+}
+
+bool null_engine::in_handshake() const
+{
+  return false;
+}
+
+void null_engine::set_dtls_tmp_data(void*)
+{
+}
+
+null_engine::want null_engine::handshake(
+    stream_base::handshake_type, asio::error_code& ec)
+{
+  ec = asio::error_code();
+  return want_nothing;
+}
+
+bool null_engine::retransmit_timeout(
+    asio::chrono::steady_clock::duration&) const
+{
+  return false;
+}
+
+null_engine::want null_engine::handle_timeout(asio::error_code& ec)
+{
+  ec = asio::error_code();
+  return want_nothing;
+}
+
+detail::private_key_operation*
+null_engine::pending_private_key_operation() const
+{
+  return 0;
+}
+
+null_engine::want null_engine::shutdown(asio::error_code& ec)
+{
+  if (!sent_shutdown_)
+  {
+    static const unsigned char close_notify[2] = { 1, 0 };
+    pending_record record = { alert,
+      asio::buffer(close_notify), asio::mutable_buffer() };
+    pending_records_.push_back(record);
+    sent_shutdown_ = true;
+
+    ec = asio::error_code();
+    return received_shutdown_ ? want_output : want_output_and_retry;
+  }
+
+  // Then wait for the peer's close_notify, discarding any data before it.
+  // As with SSL_shutdown, completion is reported as eof.
+  while (!received_shutdown_)
+  {
+    unsigned char discard[1];
+    std::size_t bytes_transferred = 0;
+    record_leftover_ = asio::const_buffer();
+    want result = read(asio::buffer(discard), ec, bytes_transferred);
+    if (result == want_input_and_retry)
+      return result;
+    if (ec && ec != asio::error::eof)
+      return want_nothing;
+  }
+
+  ec = asio::error::eof;
+  return want_nothing;
+}
+
+null_engine::want null_engine::write(const asio::const_buffer& data,
+    asio::error_code& ec, std::size_t& bytes_transferred)
+{
+  if (data.size() == 0)
+  {
+    ec = asio::error_code();
+    return want_nothing;
+  }
+
+  if (data.size() > SSL3_RT_MAX_PLAIN_LENGTH)
+  {
+    ec = asio::error::message_size;
+    return want_nothing;
+  }
+
+  // The payload is copied behind its header by get_output().
+  pending_record record = { application_data, data, asio::mutable_buffer() };
+  pending_records_.push_back(record);
+
+  ec = asio::error_code();
+  bytes_transferred = data.size();
+  return want_output;
+}
+
+null_engine::want null_engine::read(const asio::mutable_buffer& data,
+    asio::error_code& ec, std::size_t& bytes_transferred)
+{
+  if (data.size() == 0)
+  {
+    ec = asio::error_code();
+    return want_nothing;
+  }
+
+  asio::const_buffer payload;
+  want result = read_in_place(payload, ec);
+  if (result != want_nothing || ec)
+    return result;
+
+  // Keep what does not fit for the next read.
+  std::size_t length = asio::buffer_copy(data, payload);
+  record_leftover_ = payload + length;
+
+  bytes_transferred = length;
+  return want_nothing;
+}
+
+bool null_engine::payload_pending() const
+{
+  return record_leftover_.size() != 0;
+}
+
+bool null_engine::can_read_in_place() const
+{
+  return true;
+}
+
+null_engine::want null_engine::read_in_place(asio::const_buffer& plaintext,
+    asio::error_code& ec)
+{
+  for (;;)
+  {
+    // Return the payload of the last record, or what is left of it after a
+    // read that it did not fit into.
+    if (record_leftover_.size() != 0)
+    {
+      plaintext = record_leftover_;
+      record_leftover_ = asio::const_buffer();
+
+      ec = asio::error_code();
+      return want_nothing;
+    }
+
+    if (record_input_.size() == 0)
+    {
+      ec = asio::error_code();
+      return want_input_and_retry;
+    }
+
+    const unsigned char* record =
+      static_cast<const unsigned char*>(record_input_.data());
+    asio::const_buffer payload = record_input_ + header_length;
+    record_input_ = asio::const_buffer();
+
+    switch (record[0])
+    {
+    case application_data:
+      record_leftover_ = payload;
+      continue;
+
+    case alert:
+      if (payload.size() == 2
+          && static_cast<const unsigned char*>(payload.data())[1]
+            == SSL_AD_CLOSE_NOTIFY)
+      {
+        received_shutdown_ = true;
+        ec = asio::error::eof;
+        return want_nothing;
+      }
+      continue;
+
+    default:
+      continue;
+    }
+  }
+}
+
+std::size_t null_engine::record_headroom() const
+{
+  return header_length;
+}
+
+std::size_t null_engine::record_tailroom() const
+{
+  return 0;
+}
+
+null_engine::want null_engine::write_in_place(
+    const asio::mutable_buffer& record, std::size_t length,
+    asio::error_code& ec, std::size_t& bytes_transferred)
+{
+  if (record.size() < header_length + length)
+  {
+    ec = asio::error::invalid_argument;
+    return want_nothing;
+  }
+
+  if (length == 0)
+  {
+    ec = asio::error_code();
+    return want_nothing;
+  }
+
+  if (length > SSL3_RT_MAX_PLAIN_LENGTH)
+  {
+    ec = asio::error::message_size;
+    return want_nothing;
+  }
+
+  write_header(static_cast<unsigned char*>(record.data()),
+      application_data, length);
+  pending_record pending = { application_data,
+    asio::const_buffer(), asio::buffer(record, header_length + length) };
+  pending_records_.push_back(pending);
+
+  ec = asio::error_code();
+  bytes_transferred = length;
+  return want_output;
+}
+
+asio::mutable_buffer null_engine::get_output(
+    const asio::mutable_buffer& data)
+{
+  if (pending_records_.empty())
+    return asio::mutable_buffer();
+
+  pending_record record = pending_records_.front();
+  pending_records_.pop_front();
+
+  if (record.framed.size() != 0)
+    return record.framed;
+
+  std::size_t size = header_length + record.payload.size();
+  if (data.size() < size)
+    return asio::mutable_buffer();
+
+  unsigned char* out = static_cast<unsigned char*>(data.data());
+  write_header(out, record.content_type, record.payload.size());
+  std::memcpy(out + header_length,
+      record.payload.data(), record.payload.size());
+  return asio::buffer(data, size);
+}
+
+bool null_engine::output_pending() const
+{
+  return !pending_records_.empty();
+}
+
+asio::const_buffer null_engine::put_input(
+    const asio::const_buffer& data)
+{
+  // Hand the records to read() one at a time. A malformed datagram is
+  // dropped as a whole.
+  const unsigned char* p = static_cast<const unsigned char*>(data.data());
+  std::size_t length = 0;
+  if (data.size() >= header_length)
+  {
+    length = header_length + ((p[11] << 8) | p[12]);
+    if (length > data.size())
+      length = 0;
+  }
+
+  record_input_ = asio::buffer(data, length);
+  return data + (length ? length : data.size());
+}
+
+const asio::error_code& null_engine::map_error_code(
+    asio::error_code& ec) const
+{
+  if (ec == asio::error::eof && !received_shutdown_)
+    ec = asio::ssl::error::stream_truncated;
+  return ec;
+}
+
+void null_engine::write_header(unsigned char* header,
+    unsigned char content_type, std::size_t length)
+{
+  // Type, version, epoch 0, sequence number and length.
+  header[0] = content_type;
+  header[1] = 0xfe;
+  header[2] = 0xfd;
+  header[3] = 0;
+  header[4] = 0;
+  uint64_t seq = write_seq_++;
+  for (int i = 10; i >= 5; --i, seq >>= 8)
+    header[i] = static_cast<unsigned char>(seq);
+  header[11] = static_cast<unsigned char>(length >> 8);
+  header[12] = static_cast<unsigned char>(length);
+}
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_IMPL_NULL_ENGINE_IPP
@@ -0,0 +1,156 @@
+//
+// ssl/dtls/impl/pinned_key_set.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IMPL_PINNED_KEY_SET_IPP
+#define ASIO_SSL_DTLS_IMPL_PINNED_KEY_SET_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/detail/throw_error.hpp"
+#include "asio/error.hpp"
+#include "asio/ssl/error.hpp"
+#include "asio/ssl/dtls/pinned_key_set.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+pinned_key_set::pinned_key_set()
+  : digests_(1)
+{
+}
+
+void pinned_key_set::add(const const_buffer& public_key,
+    context_base::file_format format)
+{
+  asio::error_code ec;
+  add(public_key, format, ec);
+  asio::detail::throw_error(ec, "add");
+}
+
+ASIO_SYNC_OP_VOID pinned_key_set::add(const const_buffer& public_key,
+    context_base::file_format format, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  BIO* bio = ::BIO_new_mem_buf(const_cast<void*>(public_key.data()),
+      static_cast<int>(public_key.size()));
+  do_add(bio, format, ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+void pinned_key_set::add_file(const std::string& filename,
+    context_base::file_format format)
+{
+  asio::error_code ec;
+  add_file(filename, format, ec);
+  asio::detail::throw_error(ec, "add_file");
+}
+
+ASIO_SYNC_OP_VOID pinned_key_set::add_file(const std::string& filename,
+    context_base::file_format format, asio::error_code& ec)
+{
+  ::ERR_clear_error();
+
+  BIO* bio = ::BIO_new_file(filename.c_str(), "rb");
+  do_add(bio, format, ec);
+  ASIO_SYNC_OP_VOID_RETURN(ec);
+}
+
+bool pinned_key_set::remove(const const_buffer& public_key,
+    context_base::file_format format)
+{
+  BIO* bio = ::BIO_new_mem_buf(const_cast<void*>(public_key.data()),
+      static_cast<int>(public_key.size()));
+  asio::error_code ec;
+  EVP_PKEY* key = bio ? read_key(bio, format, ec) : 0;
+  if (bio)
+    ::BIO_free(bio);
+
+  digest d;
+  bool computed = key && compute_digest(key, d);
+  ::EVP_PKEY_free(key);
+  return computed && digests_.erase(d);
+}
+
+bool pinned_key_set::contains(EVP_PKEY* key) const
+{
+  digest d;
+  return key && compute_digest(key, d) && digests_.contains(d);
+}
+
+std::size_t pinned_key_set::size() const
+{
+  return digests_.size();
+}
+
+void pinned_key_set::do_add(BIO* bio,
+    context_base::file_format format, asio::error_code& ec)
+{
+  ec = asio::error_code();
+  EVP_PKEY* key = bio ? read_key(bio, format, ec) : 0;
+  if (bio)
+    ::BIO_free(bio);
+
+  digest d;
+  if (key && compute_digest(key, d))
+    digests_.assign(d, true);
+  else if (!ec)
+  {
+    ec = asio::error_code(
+        static_cast<int>(::ERR_get_error()),
+        asio::error::get_ssl_category());
+  }
+
+  ::EVP_PKEY_free(key);
+}
+
+EVP_PKEY* pinned_key_set::read_key(BIO* bio,
+    context_base::file_format format, asio::error_code& ec)
+{
+  switch (format)
+  {
+  case context_base::asn1:
+    return ::d2i_PUBKEY_bio(bio, 0);
+  case context_base::pem:
+    return ::PEM_read_bio_PUBKEY(bio, 0, 0, 0);
+  default:
+    ec = asio::error::invalid_argument;
+    return 0;
+  }
+}
+
+bool pinned_key_set::compute_digest(EVP_PKEY* key, digest& d)
+{
+  int length = ::i2d_PUBKEY(key, 0);
+  if (length <= 0)
+    return false;
+
+  std::vector<unsigned char> der(static_cast<std::size_t>(length));
+  unsigned char* p = &der[0];
+  ::i2d_PUBKEY(key, &p);
+
+  unsigned int digest_length = 0;
+  return ::EVP_Digest(&der[0], der.size(), d.bytes,
+      &digest_length, ::EVP_sha256(), 0) == 1
+    && digest_length == sizeof(d.bytes);
+}
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_IMPL_PINNED_KEY_SET_IPP
@@ -0,0 +1,67 @@
+//
+// ssl/dtls/impl/psk_key_store.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IMPL_PSK_KEY_STORE_IPP
+#define ASIO_SSL_DTLS_IMPL_PSK_KEY_STORE_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/ssl/dtls/psk_key_store.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+psk_key_store::psk_key_store(std::size_t shards)
+  : map_(shards)
+{
+}
+
+psk_key_store::~psk_key_store()
+{
+}
+
+void psk_key_store::reserve(std::size_t count)
+{
+  map_.reserve(count);
+}
+
+void psk_key_store::add(const std::string& identity, const const_buffer& key)
+{
+  map_.assign(identity, std::string(
+        static_cast<const char*>(key.data()), key.size()));
+}
+
+bool psk_key_store::remove(const std::string& identity)
+{
+  return map_.erase(identity);
+}
+
+bool psk_key_store::find(const std::string& identity, std::string& key) const
+{
+  return map_.find(identity, key);
+}
+
+std::size_t psk_key_store::size() const
+{
+  return map_.size();
+}
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_IMPL_PSK_KEY_STORE_IPP
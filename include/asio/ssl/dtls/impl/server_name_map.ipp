@@ -0,0 +1,99 @@
+//
+// ssl/dtls/impl/server_name_map.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IMPL_SERVER_NAME_MAP_IPP
+#define ASIO_SSL_DTLS_IMPL_SERVER_NAME_MAP_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/ssl/dtls/server_name_map.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+server_name_map::server_name_map(std::size_t shards)
+  : map_(shards)
+{
+}
+
+server_name_map::~server_name_map()
+{
+}
+
+void server_name_map::reserve(std::size_t count)
+{
+  map_.reserve(count);
+}
+
+void server_name_map::add(const std::string& name, context& ctx)
+{
+  map_.assign(normalize(name), &ctx);
+}
+
+bool server_name_map::remove(const std::string& name)
+{
+  return map_.erase(normalize(name));
+}
+
+context* server_name_map::find(const std::string& name) const
+{
+  std::string key = normalize(name);
+  if (key.empty())
+    return 0;
+
+  if (context* ctx = find_exact(key))
+    return ctx;
+
+  // Replace the first label with a wildcard. A name without a dot is not
+  // matched, neither is a label that is empty.
+  std::string::size_type dot = key.find('.');
+  if (dot == std::string::npos || dot == 0 || dot + 1 == key.size())
+    return 0;
+
+  key.replace(0, dot, 1, '*');
+  return find_exact(key);
+}
+
+std::size_t server_name_map::size() const
+{
+  return map_.size();
+}
+
+std::string server_name_map::normalize(const std::string& name)
+{
+  // Host names are case-insensitive and may be written fully qualified.
+  std::string key(name);
+  if (!key.empty() && key[key.size() - 1] == '.')
+    key.resize(key.size() - 1);
+  for (std::size_t i = 0; i < key.size(); ++i)
+    if (key[i] >= 'A' && key[i] <= 'Z')
+      key[i] = static_cast<char>(key[i] - 'A' + 'a');
+  return key;
+}
+
+context* server_name_map::find_exact(const std::string& name) const
+{
+  context* ctx = 0;
+  map_.find(name, ctx);
+  return ctx;
+}
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_IMPL_SERVER_NAME_MAP_IPP
@@ -0,0 +1,387 @@
+//
+// ssl/dtls/impl/session_cache.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IMPL_SESSION_CACHE_IPP
+#define ASIO_SSL_DTLS_IMPL_SESSION_CACHE_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include "asio/detail/throw_error.hpp"
+#include "asio/error.hpp"
+#include "asio/ssl/dtls/detail/hash.hpp"
+#include "asio/ssl/dtls/session_cache.hpp"
+
+#if defined(ASIO_HAS_DTLS_SHARED_SESSION_CACHE)
+# include <pthread.h>
+# include <sys/mman.h>
+#endif // defined(ASIO_HAS_DTLS_SHARED_SESSION_CACHE)
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+sharded_session_cache::sharded_session_cache(std::size_t max_entries,
+    long ttl, std::size_t shards)
+  : max_entries_per_shard_(0),
+    ttl_(ttl)
+{
+  if (shards == 0)
+    shards = 1;
+
+  max_entries_per_shard_ = (max_entries + shards - 1) / shards;
+  if (max_entries_per_shard_ == 0)
+    max_entries_per_shard_ = 1;
+
+  shards_.reserve(shards);
+  for (std::size_t i = 0; i < shards; ++i)
+    shards_.push_back(new shard);
+}
+
+sharded_session_cache::~sharded_session_cache()
+{
+  for (std::size_t i = 0; i < shards_.size(); ++i)
+    delete shards_[i];
+}
+
+void sharded_session_cache::store(
+    const const_buffer& id, const const_buffer& session)
+{
+  std::string key(static_cast<const char*>(id.data()), id.size());
+  shard& s = shard_for(id);
+  asio::detail::mutex::scoped_lock lock(s.mutex_);
+
+  entry_map::iterator existing = s.index_.find(key);
+  if (existing != s.index_.end())
+  {
+    s.entries_.erase(existing->second);
+    s.index_.erase(existing);
+  }
+  else if (s.index_.size() >= max_entries_per_shard_)
+  {
+    s.index_.erase(s.entries_.back().id);
+    s.entries_.pop_back();
+  }
+
+  entry e;
+  e.id = key;
+  e.session.assign(static_cast<const char*>(session.data()), session.size());
+  e.expiry = std::time(0) + ttl_;
+  s.entries_.push_front(e);
+  s.index_[key] = s.entries_.begin();
+}
+
+bool sharded_session_cache::load(const const_buffer& id, std::string& session)
+{
+  std::string key(static_cast<const char*>(id.data()), id.size());
+  shard& s = shard_for(id);
+  asio::detail::mutex::scoped_lock lock(s.mutex_);
+
+  entry_map::iterator existing = s.index_.find(key);
+  if (existing == s.index_.end())
+    return false;
+
+  if (existing->second->expiry <= std::time(0))
+  {
+    s.entries_.erase(existing->second);
+    s.index_.erase(existing);
+    return false;
+  }
+
+  // Mark the session as most recently used.
+  s.entries_.splice(s.entries_.begin(), s.entries_, existing->second);
+  session = existing->second->session;
+  return true;
+}
+
+void sharded_session_cache::erase(const const_buffer& id)
+{
+  std::string key(static_cast<const char*>(id.data()), id.size());
+  shard& s = shard_for(id);
+  asio::detail::mutex::scoped_lock lock(s.mutex_);
+
+  entry_map::iterator existing = s.index_.find(key);
+  if (existing != s.index_.end())
+  {
+    s.entries_.erase(existing->second);
+    s.index_.erase(existing);
+  }
+}
+
+std::size_t sharded_session_cache::size() const
+{
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < shards_.size(); ++i)
+  {
+    asio::detail::mutex::scoped_lock lock(shards_[i]->mutex_);
+    total += shards_[i]->index_.size();
+  }
+  return total;
+}
+
+sharded_session_cache::shard& sharded_session_cache::shard_for(
+    const const_buffer& id)
+{
+  return *shards_[detail::fnv1a_hash(id.data(), id.size()) % shards_.size()];
+}
+
+#if defined(ASIO_HAS_DTLS_SHARED_SESSION_CACHE)
+
+struct shared_memory_session_cache::shard_header
+{
+  pthread_mutex_t mutex;
+
+  // Incremented on every access, used to find the least recently used slot.
+  unsigned long long clock;
+};
+
+struct shared_memory_session_cache::slot
+{
+  enum { max_id_length = 32 };
+
+  std::time_t expiry;
+  unsigned long long last_used;
+  std::size_t id_length;
+  unsigned char id[max_id_length];
+  std::size_t session_length;
+  unsigned char session[1];
+};
+
+class shared_memory_session_cache::shard_lock
+  : private asio::detail::noncopyable
+{
+public:
+  shard_lock(const shared_memory_session_cache& cache, shard_header* shard)
+    : shard_(shard)
+  {
+    int result = ::pthread_mutex_lock(&shard_->mutex);
+#if defined(__linux__)
+    if (result == EOWNERDEAD)
+    {
+      // A process died while holding the lock, so the shard may be torn.
+      // Drop its contents rather than serve a corrupt session.
+      for (std::size_t i = 0; i < cache.slots_per_shard_; ++i)
+        cache.slot_at(shard_, i)->id_length = 0;
+      ::pthread_mutex_consistent(&shard_->mutex);
+    }
+#else // defined(__linux__)
+    (void)cache;
+    (void)result;
+#endif // defined(__linux__)
+  }
+
+  ~shard_lock()
+  {
+    ::pthread_mutex_unlock(&shard_->mutex);
+  }
+
+private:
+  shard_header* shard_;
+};
+
+namespace detail {
+
+inline std::size_t align_to_word(std::size_t n)
+{
+  const std::size_t alignment = sizeof(unsigned long long);
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+} // namespace detail
+
+shared_memory_session_cache::shared_memory_session_cache(
+    std::size_t max_entries, long ttl,
+    std::size_t max_session_size, std::size_t shards)
+  : memory_(0),
+    memory_size_(0),
+    shard_count_(shards ? shards : 1),
+    slots_per_shard_(0),
+    slot_size_(0),
+    shard_size_(0),
+    ttl_(ttl)
+{
+  slots_per_shard_ = (max_entries + shard_count_ - 1) / shard_count_;
+  if (slots_per_shard_ == 0)
+    slots_per_shard_ = 1;
+  slot_size_ = detail::align_to_word(
+      offsetof(slot, session) + max_session_size);
+  shard_size_ = detail::align_to_word(sizeof(shard_header))
+    + slots_per_shard_ * slot_size_;
+  memory_size_ = shard_count_ * shard_size_;
+
+#if defined(MAP_ANONYMOUS)
+  int flags = MAP_SHARED | MAP_ANONYMOUS;
+#else // defined(MAP_ANONYMOUS)
+  int flags = MAP_SHARED | MAP_ANON;
+#endif // defined(MAP_ANONYMOUS)
+
+  void* memory = ::mmap(0, memory_size_,
+      PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (memory == MAP_FAILED)
+  {
+    asio::error_code ec(errno, asio::error::get_system_category());
+    asio::detail::throw_error(ec, "shared_memory_session_cache");
+  }
+  memory_ = memory;
+
+  // The mapping is zero-filled, so all slots start out empty.
+  pthread_mutexattr_t attr;
+  ::pthread_mutexattr_init(&attr);
+  ::pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#if defined(__linux__)
+  ::pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif // defined(__linux__)
+
+  int result = 0;
+  std::size_t initialized = 0;
+  for (; initialized < shard_count_ && result == 0; ++initialized)
+    result = ::pthread_mutex_init(&shard_at(initialized)->mutex, &attr);
+  ::pthread_mutexattr_destroy(&attr);
+
+  if (result != 0)
+  {
+    for (std::size_t i = 0; i + 1 < initialized; ++i)
+      ::pthread_mutex_destroy(&shard_at(i)->mutex);
+    ::munmap(memory_, memory_size_);
+    memory_ = 0;
+
+    asio::error_code ec(result, asio::error::get_system_category());
+    asio::detail::throw_error(ec, "shared_memory_session_cache");
+  }
+}
+
+shared_memory_session_cache::~shared_memory_session_cache()
+{
+  // The mutexes are still in use by other processes and are not destroyed.
+  if (memory_)
+    ::munmap(memory_, memory_size_);
+}
+
+void shared_memory_session_cache::store(
+    const const_buffer& id, const const_buffer& session)
+{
+  if (id.size() > slot::max_id_length
+      || session.size() > slot_size_ - offsetof(slot, session))
+    return;
+
+  shard_header* shard = shard_for(id);
+  shard_lock lock(*this, shard);
+  std::time_t now = std::time(0);
+
+  // Reuse the slot holding the same id, else an empty or expired one, else
+  // the least recently used one.
+  slot* target = find(shard, id);
+  for (std::size_t i = 0; !target && i < slots_per_shard_; ++i)
+  {
+    slot* s = slot_at(shard, i);
+    if (s->id_length == 0 || s->expiry <= now)
+      target = s;
+  }
+  if (!target)
+  {
+    target = slot_at(shard, 0);
+    for (std::size_t i = 1; i < slots_per_shard_; ++i)
+    {
+      slot* s = slot_at(shard, i);
+      if (s->last_used < target->last_used)
+        target = s;
+    }
+  }
+
+  target->expiry = now + ttl_;
+  target->last_used = ++shard->clock;
+  target->id_length = id.size();
+  std::memcpy(target->id, id.data(), id.size());
+  target->session_length = session.size();
+  std::memcpy(target->session, session.data(), session.size());
+}
+
+bool shared_memory_session_cache::load(
+    const const_buffer& id, std::string& session)
+{
+  shard_header* shard = shard_for(id);
+  shard_lock lock(*this, shard);
+
+  slot* s = find(shard, id);
+  if (!s)
+    return false;
+
+  if (s->expiry <= std::time(0))
+  {
+    s->id_length = 0;
+    return false;
+  }
+
+  s->last_used = ++shard->clock;
+  session.assign(reinterpret_cast<const char*>(s->session),
+      s->session_length);
+  return true;
+}
+
+void shared_memory_session_cache::erase(const const_buffer& id)
+{
+  shard_header* shard = shard_for(id);
+  shard_lock lock(*this, shard);
+
+  if (slot* s = find(shard, id))
+    s->id_length = 0;
+}
+
+shared_memory_session_cache::shard_header*
+shared_memory_session_cache::shard_at(std::size_t index) const
+{
+  return reinterpret_cast<shard_header*>(
+      static_cast<unsigned char*>(memory_) + index * shard_size_);
+}
+
+shared_memory_session_cache::slot* shared_memory_session_cache::slot_at(
+    shard_header* shard, std::size_t index) const
+{
+  return reinterpret_cast<slot*>(reinterpret_cast<unsigned char*>(shard)
+      + detail::align_to_word(sizeof(shard_header)) + index * slot_size_);
+}
+
+shared_memory_session_cache::shard_header*
+shared_memory_session_cache::shard_for(const const_buffer& id) const
+{
+  return shard_at(detail::fnv1a_hash(id.data(), id.size()) % shard_count_);
+}
+
+shared_memory_session_cache::slot* shared_memory_session_cache::find(
+    shard_header* shard, const const_buffer& id) const
+{
+  if (id.size() == 0 || id.size() > slot::max_id_length)
+    return 0;
+
+  for (std::size_t i = 0; i < slots_per_shard_; ++i)
+  {
+    slot* s = slot_at(shard, i);
+    if (s->id_length == id.size()
+        && std::memcmp(s->id, id.data(), id.size()) == 0)
+      return s;
+  }
+
+  return 0;
+}
+
+#endif // defined(ASIO_HAS_DTLS_SHARED_SESSION_CACHE)
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_IMPL_SESSION_CACHE_IPP
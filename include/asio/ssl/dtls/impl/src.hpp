@@ -19,6 +19,13 @@
 # error Do not compile Asio library source with ASIO_HEADER_ONLY defined
 #endif
 
+#include "asio/ssl/dtls/impl/buffer_pool.ipp"
 #include "asio/ssl/dtls/impl/context.ipp"
+#include "asio/ssl/dtls/impl/io_context_pool.ipp"
+#include "asio/ssl/dtls/impl/null_engine.ipp"
+#include "asio/ssl/dtls/impl/pinned_key_set.ipp"
+#include "asio/ssl/dtls/impl/psk_key_store.ipp"
+#include "asio/ssl/dtls/impl/server_name_map.ipp"
+#include "asio/ssl/dtls/impl/session_cache.ipp"
 
 #endif // ASIO_SSL_DTLS_IMPL_SRC_HPP
@@ -0,0 +1,204 @@
+//
+// ssl/dtls/io_context_pool.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_IO_CONTEXT_POOL_HPP
+#define ASIO_SSL_DTLS_IO_CONTEXT_POOL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <thread>
+#include <vector>
+#include "asio/detail/chrono.hpp"
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/error_code.hpp"
+#include "asio/io_context.hpp"
+#include "asio/steady_timer.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+/// Places accepted sessions onto a set of io_contexts.
+/**
+ * An acceptor using a pool moves every socket whose cookie has been verified
+ * to one of the pool's io_contexts, so that the sessions are spread over the
+ * threads running them instead of all living on the acceptor's thread. See
+ * acceptor::set_io_context_pool().
+ *
+ * The io_contexts are owned and run by the application, typically each by
+ * one thread. A socket counts as a session of its io_context from the time
+ * it is placed until it is destroyed.
+ *
+ * The pool must outlive the sockets placed by it, and must not be destroyed
+ * while any of its io_contexts is running.
+ *
+ * @par Example
+ * @code
+ * asio::ssl::dtls::io_context_pool pool(
+ *     asio::ssl::dtls::io_context_pool::least_sessions);
+ * for (std::size_t i = 0; i < workers.size(); ++i)
+ *   pool.add(workers[i]);
+ * acceptor.set_io_context_pool(pool);
+ * @endcode
+ */
+class io_context_pool
+  : private noncopyable
+{
+public:
+  /// How an io_context is chosen for a new session.
+  enum placement
+  {
+    /// Use the io_contexts in turn.
+    round_robin,
+
+    /// Use the io_context with the fewest sessions.
+    least_sessions,
+
+    /// Use the io_context whose thread used the least CPU time recently, as
+    /// measured by start_load_sampling(). Ties, including all io_contexts
+    /// before the first samples are taken, go to the fewest sessions.
+    least_recent_cpu
+  };
+
+  /// Constructor.
+  /**
+   * @param policy How an io_context is chosen for a new session.
+   */
+  ASIO_DECL explicit io_context_pool(placement policy = round_robin);
+
+  /// Destructor.
+  ASIO_DECL ~io_context_pool();
+
+  /// Add an io_context to the pool.
+  ASIO_DECL void add(asio::io_context& io_context);
+
+  /// Get the number of io_contexts in the pool.
+  ASIO_DECL std::size_t size() const;
+
+  /// Get the placement policy.
+  ASIO_DECL placement policy() const;
+
+  /// Choose the io_context for a new session and count it. Thread-safe.
+  /**
+   * @returns The chosen io_context, or the one passed as @c fallback if the
+   * pool is empty.
+   */
+  ASIO_DECL asio::io_context& place(asio::io_context& fallback);
+
+  /// Choose the io_context for a new session and count it. Thread-safe.
+  /**
+   * @returns The chosen io_context, or null if the pool is empty.
+   */
+  ASIO_DECL asio::io_context* place();
+
+  /// Stop counting a session placed on an io_context. Thread-safe.
+  ASIO_DECL void release(asio::io_context& io_context);
+
+  /// Get the number of sessions placed on an io_context. Thread-safe.
+  /**
+   * @param index The position of the io_context in the order it was added.
+   */
+  ASIO_DECL std::size_t sessions(std::size_t index) const;
+
+  /// Get the recent CPU usage of an io_context's thread. Thread-safe.
+  /**
+   * @param index The position of the io_context in the order it was added.
+   *
+   * @returns The share of time, smoothed over the last samples, the thread
+   * running the io_context spent on the CPU, from 0 to 1. Zero until load
+   * sampling has taken two samples.
+   */
+  ASIO_DECL double recent_cpu(std::size_t index) const;
+
+  /// Start measuring the CPU usage of the io_contexts' threads.
+  /**
+   * A timer on every io_context samples the CPU time used by the thread
+   * running it once per interval. An io_context run by several threads is
+   * only measured while the same thread takes consecutive samples.
+   *
+   * @param interval The time between samples.
+   */
+  ASIO_DECL void start_load_sampling(
+      asio::steady_timer::duration interval = asio::chrono::seconds(1));
+
+  /// Stop measuring the CPU usage. The last measurements are kept.
+  ASIO_DECL void stop_load_sampling();
+
+private:
+  struct entry
+  {
+    explicit entry(asio::io_context& io_context)
+      : io_context_(&io_context),
+        sessions_(0),
+        recent_cpu_(0),
+        timer_(io_context),
+        last_cpu_(-1)
+    {
+    }
+
+    asio::io_context* io_context_;
+    std::size_t sessions_;
+    double recent_cpu_;
+
+    // Load sampling state.
+    asio::steady_timer timer_;
+    double last_cpu_;
+    asio::chrono::steady_clock::time_point last_sample_;
+    std::thread::id last_thread_;
+  };
+
+  // Called by an entry's timer to take a sample.
+  struct sampler
+  {
+    void operator()(const asio::error_code& ec)
+    {
+      if (!ec)
+        pool_->sample(index_);
+    }
+
+    io_context_pool* pool_;
+    std::size_t index_;
+  };
+
+  // Start the timer for the next sample. The mutex must be held.
+  ASIO_DECL void schedule_sample(std::size_t index);
+
+  // Take a sample of the CPU time used by the current thread.
+  ASIO_DECL void sample(std::size_t index);
+
+  // Get the CPU time used by the current thread in seconds, or a negative
+  // value if it cannot be measured.
+  ASIO_DECL static double thread_cpu_time();
+
+  mutable asio::detail::mutex mutex_;
+  placement policy_;
+  std::vector<entry*> entries_;
+  std::size_t next_;
+
+  // The time between samples, zero while sampling is stopped.
+  asio::steady_timer::duration sample_interval_;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/impl/io_context_pool.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_IO_CONTEXT_POOL_HPP
@@ -0,0 +1,62 @@
+//
+// ssl/dtls/message_slot.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_MESSAGE_SLOT_HPP
+#define ASIO_SSL_DTLS_MESSAGE_SLOT_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstddef>
+#include "asio/buffer.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+/// A slot filled with one message by socket::async_receive_batch().
+struct message_slot
+{
+  /// Construct an empty slot.
+  message_slot()
+    : size(0),
+      complete(true)
+  {
+  }
+
+  /// Construct a slot receiving into the given buffer.
+  explicit message_slot(const asio::mutable_buffer& b)
+    : buffer(b),
+      size(0),
+      complete(true)
+  {
+  }
+
+  /// The buffer the message is received into. Set by the caller.
+  asio::mutable_buffer buffer;
+
+  /// The length of the message.
+  std::size_t size;
+
+  /// False if the record's payload did not fit into the buffer. The rest is
+  /// received into the next slot, or by the next receive.
+  bool complete;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_MESSAGE_SLOT_HPP
@@ -0,0 +1,196 @@
+//
+// ssl/dtls/null_engine.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_NULL_ENGINE_HPP
+#define ASIO_SSL_DTLS_NULL_ENGINE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <deque>
+#include "asio/buffer.hpp"
+#include "asio/detail/chrono.hpp"
+#include "asio/detail/cstdint.hpp"
+#include "asio/error_code.hpp"
+#include "asio/ssl/detail/openssl_types.hpp"
+#include "asio/ssl/stream_base.hpp"
+#include "asio/ssl/dtls/detail/engine_base.hpp"
+#include "asio/ssl/dtls/detail/private_key_operation.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+/// An engine that frames records without protecting them.
+/**
+ * Sockets using this engine send application data in plaintext DTLS 1.2
+ * records with epoch 0, so that the cost of the framework, the transport and
+ * the record framing can be measured separately from the cryptography. The
+ * handshake completes at once without exchanging any messages, and
+ * shutdown() exchanges close_notify alerts as with a real session.
+ *
+ * Both peers must use this engine. It provides no security whatsoever and
+ * is meant for benchmarks and tests only.
+ *
+ * @par Example
+ * @code
+ * asio::ssl::dtls::socket<udp::socket, asio::ssl::dtls::null_engine>
+ *   sock(io_context, ctx);
+ * @endcode
+ */
+class null_engine : public detail::engine_base
+{
+public:
+  /// Construct an engine. The context is not used.
+  ASIO_DECL explicit null_engine(SSL_CTX* context);
+
+#if defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+  /// Move-construct an engine from another.
+  ASIO_DECL null_engine(null_engine&& other) ASIO_NOEXCEPT;
+
+  /// Move-assign an engine from another.
+  ASIO_DECL null_engine& operator=(null_engine&& other) ASIO_NOEXCEPT;
+#endif // defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+
+  /// Set the MTU that max_payload_length() is based on.
+  ASIO_DECL bool set_mtu(int mtu);
+
+  /// Get the MTU set by set_mtu(), or 0 if none was set.
+  ASIO_DECL int mtu() const;
+
+  /// Get the largest payload whose record fits into one datagram of the MTU.
+  ASIO_DECL std::size_t max_payload_length() const;
+
+  /// Returns false, as the handshake completes at once.
+  ASIO_DECL bool in_handshake() const;
+
+  /// Ignored, as there is no cookie exchange.
+  ASIO_DECL void set_dtls_tmp_data(void* data);
+
+  /// Complete the handshake without exchanging messages.
+  ASIO_DECL want handshake(
+      stream_base::handshake_type type, asio::error_code& ec);
+
+  /// Returns false, as there are no handshake flights to retransmit.
+  ASIO_DECL bool retransmit_timeout(
+      asio::chrono::steady_clock::duration& timeout) const;
+
+  /// Does nothing, as there are no handshake flights to retransmit.
+  ASIO_DECL want handle_timeout(asio::error_code& ec);
+
+  /// Returns 0, as there are no private key operations.
+  ASIO_DECL detail::private_key_operation*
+  pending_private_key_operation() const;
+
+  /// Send a close_notify alert and wait for the peer's.
+  ASIO_DECL want shutdown(asio::error_code& ec);
+
+  /// Write a payload as one record.
+  ASIO_DECL want write(const asio::const_buffer& data,
+      asio::error_code& ec, std::size_t& bytes_transferred);
+
+  /// Read the payload of the next record.
+  ASIO_DECL want read(const asio::mutable_buffer& data,
+      asio::error_code& ec, std::size_t& bytes_transferred);
+
+  /// Whether part of the last payload did not fit into the last read.
+  ASIO_DECL bool payload_pending() const;
+
+  /// Returns true, as payloads are never copied out of the input.
+  ASIO_DECL bool can_read_in_place() const;
+
+  /// Read the payload of the next record where it lies in the input.
+  ASIO_DECL want read_in_place(asio::const_buffer& plaintext,
+      asio::error_code& ec);
+
+  /// Bytes to reserve in front of a payload passed to write_in_place().
+  ASIO_DECL std::size_t record_headroom() const;
+
+  /// Bytes to reserve behind a payload passed to write_in_place().
+  ASIO_DECL std::size_t record_tailroom() const;
+
+  /// Write a payload that sits at record_headroom() bytes into the record
+  /// buffer. The header is written in front of it and the buffer is returned
+  /// by get_output(), so it must stay valid until it has been sent.
+  ASIO_DECL want write_in_place(const asio::mutable_buffer& record,
+      std::size_t length, asio::error_code& ec,
+      std::size_t& bytes_transferred);
+
+  /// Get the next datagram to be written to the transport.
+  ASIO_DECL asio::mutable_buffer get_output(
+      const asio::mutable_buffer& data);
+
+  /// Whether output is waiting to be written to the transport.
+  ASIO_DECL bool output_pending() const;
+
+  /// Put input data that was read from the transport.
+  ASIO_DECL asio::const_buffer put_input(
+      const asio::const_buffer& data);
+
+  /// Map an error::eof code returned by the underlying transport to
+  /// ssl::error::stream_truncated unless the peer sent close_notify.
+  ASIO_DECL const asio::error_code& map_error_code(
+      asio::error_code& ec) const;
+
+private:
+  // Disallow copying and assignment.
+  null_engine(const null_engine&);
+  null_engine& operator=(const null_engine&);
+
+  // The DTLS record header length and the record content types used.
+  enum
+  {
+    header_length = 13,
+    alert = 21,
+    application_data = 23
+  };
+
+  // A record waiting to be passed to the transport. Records written in place
+  // are already framed, all others are framed by get_output().
+  struct pending_record
+  {
+    unsigned char content_type;
+    asio::const_buffer payload;
+    asio::mutable_buffer framed;
+  };
+
+  // Write the record header for a payload of the given length.
+  ASIO_DECL void write_header(unsigned char* header,
+      unsigned char content_type, std::size_t length);
+
+  int mtu_;
+  bool sent_shutdown_;
+  bool received_shutdown_;
+  uint64_t write_seq_;
+
+  // Records to be framed, in the order they were written.
+  std::deque<pending_record> pending_records_;
+
+  // The received record not yet read.
+  asio::const_buffer record_input_;
+
+  // The part of a record's payload that did not fit into the last read.
+  asio::const_buffer record_leftover_;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/impl/null_engine.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_NULL_ENGINE_HPP
@@ -0,0 +1,156 @@
+//
+// ssl/dtls/pinned_key_set.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_PINNED_KEY_SET_HPP
+#define ASIO_SSL_DTLS_PINNED_KEY_SET_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <cstring>
+#include <string>
+#include "asio/buffer.hpp"
+#include "asio/error_code.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/ssl/context_base.hpp"
+#include "asio/ssl/detail/openssl_types.hpp"
+#include "asio/ssl/dtls/detail/sharded_map.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+/// A set of public keys that peers are allowed to authenticate with.
+/**
+ * Keys are stored by the SHA-256 digest of their DER encoded
+ * SubjectPublicKeyInfo, in a hash table indexed by the digest, so checking
+ * a peer's key takes constant time regardless of the number of keys. Keys
+ * may be added and removed while the set is in use.
+ *
+ * Install the set on a context with context::set_pinned_keys().
+ */
+class pinned_key_set
+  : private noncopyable
+{
+public:
+  /// Constructor.
+  ASIO_DECL pinned_key_set();
+
+  /// Add a public key.
+  /**
+   * @param public_key A buffer containing the public key, either a PEM
+   * encoded "PUBLIC KEY" or a DER encoded SubjectPublicKeyInfo.
+   *
+   * @param format The encoding of the key.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  ASIO_DECL void add(const const_buffer& public_key,
+      context_base::file_format format);
+
+  /// Add a public key.
+  /**
+   * @param public_key A buffer containing the public key, either a PEM
+   * encoded "PUBLIC KEY" or a DER encoded SubjectPublicKeyInfo.
+   *
+   * @param format The encoding of the key.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID add(const const_buffer& public_key,
+      context_base::file_format format, asio::error_code& ec);
+
+  /// Add a public key from a file.
+  /**
+   * @param filename The name of the file containing the public key.
+   *
+   * @param format The encoding of the key.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  ASIO_DECL void add_file(const std::string& filename,
+      context_base::file_format format);
+
+  /// Add a public key from a file.
+  /**
+   * @param filename The name of the file containing the public key.
+   *
+   * @param format The encoding of the key.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   */
+  ASIO_DECL ASIO_SYNC_OP_VOID add_file(const std::string& filename,
+      context_base::file_format format, asio::error_code& ec);
+
+  /// Remove a public key.
+  /**
+   * @returns @c true if the key was present.
+   */
+  ASIO_DECL bool remove(const const_buffer& public_key,
+      context_base::file_format format);
+
+  /// Determine whether a public key is in the set.
+  ASIO_DECL bool contains(EVP_PKEY* key) const;
+
+  /// Get the number of keys in the set.
+  ASIO_DECL std::size_t size() const;
+
+private:
+  struct digest
+  {
+    unsigned char bytes[32];
+
+    friend bool operator==(const digest& a, const digest& b)
+    {
+      return std::memcmp(a.bytes, b.bytes, sizeof(a.bytes)) == 0;
+    }
+  };
+
+  // The digest is uniformly distributed, so its leading bytes serve as the
+  // hash.
+  struct digest_hash
+  {
+    std::size_t operator()(const digest& d) const
+    {
+      std::size_t hash = 0;
+      std::memcpy(&hash, d.bytes, sizeof(hash));
+      return hash;
+    }
+  };
+
+  // Add the key read from a BIO, taking ownership of the BIO.
+  ASIO_DECL void do_add(BIO* bio,
+      context_base::file_format format, asio::error_code& ec);
+
+  // Read a public key from a BIO.
+  ASIO_DECL static EVP_PKEY* read_key(BIO* bio,
+      context_base::file_format format, asio::error_code& ec);
+
+  // Compute the digest identifying a key.
+  ASIO_DECL static bool compute_digest(EVP_PKEY* key, digest& d);
+
+  // The digests of the keys. A single shard, the set is rarely changed.
+  detail::sharded_map<digest, bool, digest_hash> digests_;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/impl/pinned_key_set.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_PINNED_KEY_SET_HPP
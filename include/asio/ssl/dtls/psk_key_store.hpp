@@ -0,0 +1,94 @@
+//
+// ssl/dtls/psk_key_store.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_PSK_KEY_STORE_HPP
+#define ASIO_SSL_DTLS_PSK_KEY_STORE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <string>
+#include "asio/buffer.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/ssl/dtls/detail/hash.hpp"
+#include "asio/ssl/dtls/detail/sharded_map.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+/// A table of pre-shared keys indexed by client identity.
+/**
+ * The store is a hash table split into independently locked shards, so
+ * lookups take constant time regardless of the number of identities and
+ * handshakes on different threads rarely contend. Keys may be added and
+ * removed while the store is in use.
+ *
+ * Install the store on a server context with context::set_psk_key_store().
+ */
+class psk_key_store
+  : private noncopyable
+{
+public:
+  /// Constructor.
+  /**
+   * @param shards The number of independently locked shards.
+   */
+  ASIO_DECL explicit psk_key_store(std::size_t shards = 16);
+
+  /// Destructor.
+  ASIO_DECL ~psk_key_store();
+
+  /// Prepare the store to hold the given number of identities.
+  /**
+   * Calling this before adding many identities avoids rehashing.
+   */
+  ASIO_DECL void reserve(std::size_t count);
+
+  /// Add an identity, replacing its key if it is already present.
+  ASIO_DECL void add(const std::string& identity, const const_buffer& key);
+
+  /// Remove an identity.
+  /**
+   * @returns @c true if the identity was present.
+   */
+  ASIO_DECL bool remove(const std::string& identity);
+
+  /// Look up the key of an identity.
+  /**
+   * @param identity The identity sent by the client.
+   *
+   * @param key Set to the key if the identity was found.
+   *
+   * @returns @c true if the identity was found.
+   */
+  ASIO_DECL bool find(const std::string& identity, std::string& key) const;
+
+  /// Get the number of identities in the store.
+  ASIO_DECL std::size_t size() const;
+
+private:
+  detail::sharded_map<std::string, std::string, detail::string_hash> map_;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/impl/psk_key_store.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_PSK_KEY_STORE_HPP
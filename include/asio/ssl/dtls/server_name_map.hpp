@@ -0,0 +1,116 @@
+//
+// ssl/dtls/server_name_map.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_SERVER_NAME_MAP_HPP
+#define ASIO_SSL_DTLS_SERVER_NAME_MAP_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <string>
+#include "asio/detail/noncopyable.hpp"
+#include "asio/ssl/dtls/detail/hash.hpp"
+#include "asio/ssl/dtls/detail/sharded_map.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+class context;
+
+/// A table of server contexts indexed by host name.
+/**
+ * The map lets one server socket serve many host names, each with its own
+ * certificate: during the handshake the context registered for the name the
+ * client sent in its server name indication (SNI) extension replaces the
+ * one the socket was created with.
+ *
+ * Names are matched case-insensitively. A name of the form
+ * <tt>*.example.com</tt> matches every name with exactly one more label,
+ * e.g. <tt>www.example.com</tt> but neither <tt>example.com</tt> nor
+ * <tt>a.www.example.com</tt>. An exact match takes precedence over a
+ * wildcard, so a lookup takes at most two hash table probes regardless of
+ * the number of names.
+ *
+ * Like psk_key_store, the map is split into independently locked shards
+ * and names may be added and removed while it is in use.
+ *
+ * Install the map on a server context with context::set_server_name_map().
+ */
+class server_name_map
+  : private noncopyable
+{
+public:
+  /// Constructor.
+  /**
+   * @param shards The number of independently locked shards.
+   */
+  ASIO_DECL explicit server_name_map(std::size_t shards = 16);
+
+  /// Destructor.
+  ASIO_DECL ~server_name_map();
+
+  /// Prepare the map to hold the given number of names.
+  /**
+   * Calling this before adding many names avoids rehashing.
+   */
+  ASIO_DECL void reserve(std::size_t count);
+
+  /// Add a name, replacing its context if it is already present.
+  /**
+   * @param name The host name, or a wildcard of the form
+   * <tt>*.example.com</tt>.
+   *
+   * @param ctx The context used for the name. It is not copied and must
+   * outlive every handshake that may select it.
+   */
+  ASIO_DECL void add(const std::string& name, context& ctx);
+
+  /// Remove a name.
+  /**
+   * @returns @c true if the name was present.
+   */
+  ASIO_DECL bool remove(const std::string& name);
+
+  /// Find the context for a host name sent by a client.
+  /**
+   * @param name The host name. Wildcards are matched, see above.
+   *
+   * @returns The context, or 0 if no entry matches.
+   */
+  ASIO_DECL context* find(const std::string& name) const;
+
+  /// Get the number of names in the map.
+  ASIO_DECL std::size_t size() const;
+
+private:
+  // Convert a name to the form it is stored in.
+  ASIO_DECL static std::string normalize(const std::string& name);
+
+  // Look up a normalized name without wildcard matching.
+  ASIO_DECL context* find_exact(const std::string& name) const;
+
+  detail::sharded_map<std::string, context*, detail::string_hash> map_;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/impl/server_name_map.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_SERVER_NAME_MAP_HPP
@@ -0,0 +1,235 @@
+//
+// ssl/dtls/session_cache.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_SESSION_CACHE_HPP
+#define ASIO_SSL_DTLS_SESSION_CACHE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "asio/buffer.hpp"
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/noncopyable.hpp"
+
+#if !defined(ASIO_WINDOWS) \
+  && !defined(ASIO_WINDOWS_RUNTIME) \
+  && !defined(__CYGWIN__)
+# define ASIO_HAS_DTLS_SHARED_SESSION_CACHE 1
+#endif // !defined(ASIO_WINDOWS) ...
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+/// Interface of an external cache of server-side sessions.
+/**
+ * A session cache is installed on a context with
+ * context::set_session_cache(). OpenSSL's internal cache is then disabled,
+ * and every session established by a full handshake is passed to store().
+ * When a client asks to resume a session, load() is used to look it up.
+ *
+ * Implementations must be safe to call from multiple threads.
+ */
+class session_cache
+  : private noncopyable
+{
+public:
+  /// Destructor.
+  virtual ~session_cache()
+  {
+  }
+
+  /// Store a session.
+  /**
+   * @param id The session id.
+   *
+   * @param session The session in DER encoding.
+   */
+  virtual void store(const const_buffer& id, const const_buffer& session) = 0;
+
+  /// Look up a session.
+  /**
+   * @param id The session id.
+   *
+   * @param session Set to the session in DER encoding if it was found.
+   *
+   * @returns @c true if the session was found and has not expired.
+   */
+  virtual bool load(const const_buffer& id, std::string& session) = 0;
+
+  /// Remove a session, e.g. because it was used in a failed handshake.
+  /**
+   * @param id The session id.
+   */
+  virtual void erase(const const_buffer& id) = 0;
+};
+
+/// An in-process session cache split into independently locked shards.
+/**
+ * Sessions are assigned to shards by a hash of their id, so threads
+ * resuming different sessions rarely contend for the same lock. Each shard
+ * evicts its least recently used session once it is full.
+ */
+class sharded_session_cache
+  : public session_cache
+{
+public:
+  /// Constructor.
+  /**
+   * @param max_entries The maximum number of sessions held in the cache.
+   *
+   * @param ttl The number of seconds after which a session expires.
+   *
+   * @param shards The number of independently locked shards.
+   */
+  ASIO_DECL explicit sharded_session_cache(std::size_t max_entries = 20480,
+      long ttl = 300, std::size_t shards = 16);
+
+  /// Destructor.
+  ASIO_DECL ~sharded_session_cache();
+
+  /// Store a session.
+  ASIO_DECL void store(const const_buffer& id, const const_buffer& session);
+
+  /// Look up a session.
+  ASIO_DECL bool load(const const_buffer& id, std::string& session);
+
+  /// Remove a session.
+  ASIO_DECL void erase(const const_buffer& id);
+
+  /// Get the number of sessions held in the cache, including expired ones
+  /// that have not been evicted yet.
+  ASIO_DECL std::size_t size() const;
+
+private:
+  struct entry
+  {
+    std::string id;
+    std::string session;
+    std::time_t expiry;
+  };
+
+  typedef std::list<entry> entry_list;
+  typedef std::map<std::string, entry_list::iterator> entry_map;
+
+  struct shard
+  {
+    mutable asio::detail::mutex mutex_;
+
+    // Sessions, most recently used first.
+    entry_list entries_;
+    entry_map index_;
+  };
+
+  // Select the shard responsible for a session id.
+  ASIO_DECL shard& shard_for(const const_buffer& id);
+
+  std::vector<shard*> shards_;
+  std::size_t max_entries_per_shard_;
+  long ttl_;
+};
+
+#if defined(ASIO_HAS_DTLS_SHARED_SESSION_CACHE) \
+  || defined(GENERATING_DOCUMENTATION)
+
+/// A session cache in shared memory, for use by multiple processes.
+/**
+ * The cache lives in an anonymous shared mapping. Create it before forking
+ * the worker processes; each of them then installs it on its own context.
+ *
+ * The memory is divided into shards, each holding a fixed number of slots
+ * of a fixed size and guarded by a process-shared mutex. Sessions larger than
+ * a slot are not cached. A full shard replaces its least recently used slot.
+ */
+class shared_memory_session_cache
+  : public session_cache
+{
+public:
+  /// Constructor.
+  /**
+   * @param max_entries The maximum number of sessions held in the cache.
+   *
+   * @param ttl The number of seconds after which a session expires.
+   *
+   * @param max_session_size The largest DER-encoded session to cache. Sessions
+   * carrying the peer's certificate chain may need more than the default.
+   *
+   * @param shards The number of independently locked shards.
+   *
+   * @throws asio::system_error Thrown if the shared memory cannot be set up.
+   */
+  ASIO_DECL explicit shared_memory_session_cache(
+      std::size_t max_entries = 20480, long ttl = 300,
+      std::size_t max_session_size = 2048, std::size_t shards = 16);
+
+  /// Destructor.
+  /**
+   * Unmaps the shared memory in this process. Other processes are not
+   * affected.
+   */
+  ASIO_DECL ~shared_memory_session_cache();
+
+  /// Store a session.
+  ASIO_DECL void store(const const_buffer& id, const const_buffer& session);
+
+  /// Look up a session.
+  ASIO_DECL bool load(const const_buffer& id, std::string& session);
+
+  /// Remove a session.
+  ASIO_DECL void erase(const const_buffer& id);
+
+private:
+  struct shard_header;
+  struct slot;
+
+  // Locks a shard for the lifetime of the object.
+  class shard_lock;
+
+  // Get a shard and the slots belonging to it.
+  ASIO_DECL shard_header* shard_at(std::size_t index) const;
+  ASIO_DECL slot* slot_at(shard_header* shard, std::size_t index) const;
+
+  // Select the shard responsible for a session id.
+  ASIO_DECL shard_header* shard_for(const const_buffer& id) const;
+
+  // Find the slot holding a session id, or 0.
+  ASIO_DECL slot* find(shard_header* shard, const const_buffer& id) const;
+
+  void* memory_;
+  std::size_t memory_size_;
+  std::size_t shard_count_;
+  std::size_t slots_per_shard_;
+  std::size_t slot_size_;
+  std::size_t shard_size_;
+  long ttl_;
+};
+
+#endif // defined(ASIO_HAS_DTLS_SHARED_SESSION_CACHE)
+       //   || defined(GENERATING_DOCUMENTATION)
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#if defined(ASIO_HEADER_ONLY)
+# include "asio/ssl/dtls/impl/session_cache.ipp"
+#endif // defined(ASIO_HEADER_ONLY)
+
+#endif // ASIO_SSL_DTLS_SESSION_CACHE_HPP
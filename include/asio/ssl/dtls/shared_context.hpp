@@ -0,0 +1,100 @@
+//
+// ssl/dtls/shared_context.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASIO_SSL_DTLS_SHARED_CONTEXT_HPP
+#define ASIO_SSL_DTLS_SHARED_CONTEXT_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+# pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "asio/detail/config.hpp"
+
+#include "asio/detail/memory.hpp"
+#include "asio/detail/mutex.hpp"
+#include "asio/detail/noncopyable.hpp"
+#include "asio/ssl/dtls/context.hpp"
+
+#include "asio/detail/push_options.hpp"
+
+namespace asio {
+namespace ssl {
+namespace dtls {
+
+/// Holds the context used for new sockets and allows replacing it.
+/**
+ * A context must not be modified once sockets use it. To change
+ * certificates and keys at run time, build a new context and install it
+ * with replace(): sockets constructed from the holder afterwards use the
+ * new context, while existing sockets keep the one they were created with.
+ * Each socket shares ownership of its context, so a replaced context is
+ * destroyed together with the last socket using it.
+ *
+ * Clients can resume sessions established before a replacement if the new
+ * context uses the same session_cache and session ticket keys as the old
+ * one.
+ *
+ * @par Example
+ * @code
+ * asio::ssl::dtls::shared_context contexts(make_context());
+ * ...
+ * asio::ssl::dtls::socket<udp::socket> sock(io_context, contexts);
+ * ...
+ * // On certificate rotation:
+ * contexts.replace(make_context());
+ * @endcode
+ *
+ * @par Thread Safety
+ * @e Distinct @e objects: Safe.@n
+ * @e Shared @e objects: Safe.
+ */
+class shared_context
+  : private noncopyable
+{
+public:
+  /// Constructor.
+  /**
+   * @param ctx The context used for new sockets. Must not be null.
+   */
+  explicit shared_context(const asio::detail::shared_ptr<context>& ctx)
+    : context_(ctx)
+  {
+  }
+
+  /// Get the context used for new sockets.
+  asio::detail::shared_ptr<context> get() const
+  {
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    return context_;
+  }
+
+  /// Replace the context used for new sockets.
+  /**
+   * @param ctx The new context. Must not be null.
+   */
+  void replace(const asio::detail::shared_ptr<context>& ctx)
+  {
+    // Swap so that the old context is released outside the lock.
+    asio::detail::shared_ptr<context> old_context(ctx);
+    asio::detail::mutex::scoped_lock lock(mutex_);
+    context_.swap(old_context);
+    lock.unlock();
+  }
+
+private:
+  mutable asio::detail::mutex mutex_;
+  asio::detail::shared_ptr<context> context_;
+};
+
+} // namespace dtls
+} // namespace ssl
+} // namespace asio
+
+#include "asio/detail/pop_options.hpp"
+
+#endif // ASIO_SSL_DTLS_SHARED_CONTEXT_HPP
@@ -20,21 +20,33 @@
 #include "asio/async_result.hpp"
 #include "asio/detail/buffer_sequence_adapter.hpp"
 #include "asio/detail/handler_type_requirements.hpp"
-#include "asio/detail/noncopyable.hpp"
 #include "asio/detail/type_traits.hpp"
 #include "asio/ssl/context.hpp"
+#include "asio/ssl/dtls/detail/awaitable_op.hpp"
+#include "asio/ssl/dtls/detail/batch_read_op.hpp"
+#include "asio/ssl/dtls/detail/batch_write_op.hpp"
 #include "asio/ssl/dtls/detail/listen_op.hpp"
 #include "asio/ssl/dtls/detail/buffered_dtls_listen_op.hpp"
 #include "asio/ssl/dtls/detail/buffered_handshake_op.hpp"
 #include "asio/ssl/dtls/detail/handshake_op.hpp"
+#include "asio/ssl/dtls/detail/heartbeat_op.hpp"
 #include "asio/ssl/dtls/detail/datagram_io.hpp"
+#include "asio/ssl/dtls/detail/in_place_write_op.hpp"
+#include "asio/ssl/dtls/detail/lease_read_op.hpp"
+#include "asio/ssl/dtls/detail/owned_send_handler.hpp"
 #include "asio/ssl/dtls/detail/read_op.hpp"
 #include "asio/ssl/dtls/detail/shutdown_op.hpp"
 #include "asio/ssl/dtls/detail/core.hpp"
 #include "asio/ssl/dtls/detail/engine.hpp"
+#include "asio/ssl/dtls/detail/path_mtu.hpp"
+#include "asio/ssl/dtls/detail/pipelined_receive_op.hpp"
+#include "asio/ssl/dtls/detail/queued_send_op.hpp"
 #include "asio/ssl/dtls/detail/write_op.hpp"
 #include "asio/ssl/stream_base.hpp"
+#include "asio/ssl/dtls/buffer_pool.hpp"
 #include "asio/ssl/dtls/context.hpp"
+#include "asio/ssl/dtls/message_slot.hpp"
+#include "asio/ssl/dtls/shared_context.hpp"
 #include "asio/ssl/dtls/detail/datagram_helper.hpp"
 #include "asio/detail/type_traits.hpp"
 #include "asio/ssl/dtls/detail/cookie_generate_callback.hpp"
@@ -46,6 +58,9 @@ namespace asio {
 namespace ssl  {
 namespace dtls {
 
+template <typename DatagramSocketType>
+class acceptor;
+
 /// Provides Datagram-oriented functionality using SSL.
 /**
  * The dtls class template provides asynchronous and blocking stream-oriented
@@ -64,11 +79,26 @@ namespace dtls {
  * asio::ssl::context ctx(asio::ssl::context::dtlsv12);
  * asio::ssl::stream<asio:ip::udp::socket> sock(io_context, ctx);
  * @endcode
+ *
+ * The socket runs its internal operations and timers on the executor of the
+ * transport, so with a transport whose executor is a strand or any other
+ * executor the session never hops through an io_context. Completion
+ * handlers are invoked through their associated executor.
+ *
+ * Emitting a cancellation on the slot associated with a handler cancels the
+ * step on the transport the operation is waiting for, which completes the
+ * operation with asio::error::operation_aborted without closing the socket.
+ *
+ * The @c Engine parameter selects how records are protected. The default
+ * uses OpenSSL; asio::ssl::dtls::null_engine frames records without
+ * encryption, which measures the cost of everything but the cryptography.
+ * Functions that need features an engine lacks, such as cookies or peer
+ * verification, do not compile for it.
  */
-template <typename datagram_socket>
+template <typename datagram_socket,
+    typename Engine = ssl::dtls::detail::engine>
 class socket :
-  public stream_base,
-  private noncopyable
+  public stream_base
 {
 public:
   /// The native handle type of the SSL stream.
@@ -83,6 +113,9 @@ public:
   /// The type of the executor associated with the object.
   typedef typename lowest_layer_type::executor_type executor_type;
 
+  /// The type of the engine protecting records.
+  typedef Engine engine_type;
+
 #if defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
   /// Construct a stream.
   /**
@@ -90,7 +123,7 @@ public:
    * transport object.
    *
    * @param arg The argument to be passed to initialise the underlying
-   * transport.
+   * transport, such as the executor or execution context it runs on.
    *
    * @param ctx The SSL context to be used for the stream.
    */
@@ -98,7 +131,33 @@ public:
   socket(Arg&& arg, context& ctx)
     : next_layer_(ASIO_MOVE_CAST(Arg)(arg)),
       core_(ctx.native_handle(),
-          next_layer_.lowest_layer().get_executor().context())
+          next_layer_.lowest_layer().get_executor()),
+      path_mtu_(next_layer_)
+  {
+    // set mtu to safe value to prevent dtls-fragmentation of the handshake
+    set_mtu(1500);
+    core_.engine_.set_dtls_tmp_data(&remote_endpoint_tmp_);
+  }
+
+  /// Construct a stream using the current context of a holder.
+  /**
+   * This constructor creates a SSL object from the context currently held
+   * by @c contexts and initialises the underlying transport object. The
+   * socket shares ownership of the context, which therefore stays alive
+   * for as long as the socket even if the holder's context is replaced.
+   *
+   * @param arg The argument to be passed to initialise the underlying
+   * transport.
+   *
+   * @param contexts The holder of the SSL context to be used for the stream.
+   */
+  template <typename Arg>
+  socket(Arg&& arg, shared_context& contexts)
+    : context_(contexts.get()),
+      next_layer_(ASIO_MOVE_CAST(Arg)(arg)),
+      core_(context_->native_handle(),
+          next_layer_.lowest_layer().get_executor()),
+      path_mtu_(next_layer_)
   {
     // set mtu to safe value to prevent dtls-fragmentation of the handshake
     set_mtu(1500);
@@ -109,7 +168,21 @@ public:
   socket(Arg& arg, context& ctx)
     : next_layer_(arg),
       core_(ctx.native_handle(),
-          next_layer_.lowest_layer().get_executor().context())
+          next_layer_.lowest_layer().get_executor()),
+      path_mtu_(next_layer_)
+  {
+    // set mtu to safe value to prevent dtls-fragmentation of the handshake
+    set_mtu(1500);
+    core_.engine_.set_dtls_tmp_data(&remote_endpoint_tmp_);
+  }
+
+  template <typename Arg>
+  socket(Arg& arg, shared_context& contexts)
+    : context_(contexts.get()),
+      next_layer_(arg),
+      core_(context_->native_handle(),
+          next_layer_.lowest_layer().get_executor()),
+      path_mtu_(next_layer_)
   {
     // set mtu to safe value to prevent dtls-fragmentation of the handshake
     set_mtu(1500);
@@ -117,13 +190,78 @@ public:
   }
 #endif // defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
 
+#if defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+  /// Move-construct a socket from another.
+  /**
+   * This constructor moves the DTLS session, including the underlying
+   * transport, from one object to another.
+   *
+   * @param other The other socket object from which the move will occur.
+   *
+   * @note A @c socket object must not be moved while there are pending
+   * asynchronous operations associated with it. Following the move, the
+   * moved-from object may only be destroyed or assigned to.
+   */
+  socket(socket&& other)
+    : context_(ASIO_MOVE_CAST(asio::detail::shared_ptr<context>)(
+          other.context_)),
+      next_layer_(ASIO_MOVE_CAST(datagram_socket)(other.next_layer_)),
+      core_(ASIO_MOVE_CAST(core_type)(other.core_)),
+      remote_endpoint_tmp_(other.remote_endpoint_tmp_),
+      path_mtu_(next_layer_)
+  {
+    core_.engine_.set_dtls_tmp_data(&remote_endpoint_tmp_);
+    if (core_.path_mtu_)
+      core_.path_mtu_ = &path_mtu_;
+    if (ssl::dtls::detail::send_queue* queue = queued_sends())
+      queue->attach(&next_layer_, &core_);
+  }
+
+  /// Move-assign a socket from another.
+  /**
+   * This assignment operator moves the DTLS session, including the
+   * underlying transport, from one object to another. The session previously
+   * held by this object is freed.
+   *
+   * @param other The other socket object from which the move will occur.
+   *
+   * @note Neither object may have pending asynchronous operations associated
+   * with it.
+   */
+  socket& operator=(socket&& other)
+  {
+    if (this != &other)
+    {
+      if (ssl::dtls::detail::send_queue* queue = queued_sends())
+        queue->detach();
+      next_layer_ = ASIO_MOVE_CAST(datagram_socket)(other.next_layer_);
+      core_ = ASIO_MOVE_CAST(core_type)(other.core_);
+      context_ = ASIO_MOVE_CAST(asio::detail::shared_ptr<context>)(
+          other.context_);
+      remote_endpoint_tmp_ = other.remote_endpoint_tmp_;
+      core_.engine_.set_dtls_tmp_data(&remote_endpoint_tmp_);
+      if (core_.path_mtu_)
+        core_.path_mtu_ = &path_mtu_;
+      if (ssl::dtls::detail::send_queue* queue = queued_sends())
+        queue->attach(&next_layer_, &core_);
+    }
+    return *this;
+  }
+#endif // defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+
   /// Destructor.
   /**
+   * Messages passed to queue_send() that have not been sent yet are
+   * discarded.
+   *
    * @note A @c dtls object must not be destroyed while there are pending
-   * asynchronous operations associated with it.
+   * asynchronous operations associated with it. This includes a round of
+   * queued messages being sent, see async_wait_queued_sends().
    */
   ~socket()
   {
+    if (ssl::dtls::detail::send_queue* queue = queued_sends())
+      queue->detach();
   }
 
   /// Get the executor associated with the object.
@@ -277,6 +415,103 @@ public:
     asio::detail::throw_error(ec, "set_mtu");
   }
 
+  /// Enable path MTU discovery.
+  /**
+   * This function stops the IP layer from fragmenting datagrams and sizes
+   * handshake messages and application data to the path MTU, which the
+   * operating system learns from ICMP messages. The MTU is read again at
+   * the start of every handshake and whenever a datagram is rejected as too
+   * big, so that later handshake fragments and max_payload_length() follow
+   * changes of the path.
+   *
+   * A send of application data that does not fit the path fails with
+   * asio::error::message_size. During an asynchronous handshake the rejected
+   * flight is retransmitted in smaller fragments.
+   *
+   * The MTU is never set below the minimum the IP version guarantees, which
+   * keeps a ClientHello in a single datagram as the stateless cookie
+   * exchange requires.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Sets @c IP_MTU_DISCOVER or @c IPV6_MTU_DISCOVER where available,
+   * otherwise @c IP_DONTFRAG or @c IPV6_DONTFRAG. If the path MTU cannot be
+   * read, e.g. because the next layer is not connected yet, the MTU of an
+   * Ethernet link is assumed until the next handshake.
+   */
+  void enable_path_mtu_discovery()
+  {
+    asio::error_code ec;
+    enable_path_mtu_discovery(ec);
+    asio::detail::throw_error(ec, "enable_path_mtu_discovery");
+  }
+
+  /// Enable path MTU discovery.
+  /**
+   * This function stops the IP layer from fragmenting datagrams and sizes
+   * handshake messages and application data to the path MTU.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::operation_not_supported if the next layer is not an IP
+   * socket or the platform cannot disable fragmentation.
+   */
+  ASIO_SYNC_OP_VOID enable_path_mtu_discovery(asio::error_code& ec)
+  {
+    path_mtu_.disable_fragmentation(ec);
+    if (ec)
+      ASIO_SYNC_OP_VOID_RETURN(ec);
+
+    core_.path_mtu_ = &path_mtu_;
+    if (core_.update_path_mtu(ec))
+    {
+      std::size_t mtu = path_mtu_.default_mtu(ec);
+      if (!ec)
+        set_mtu(static_cast<int>(mtu), ec);
+    }
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  /// Read the path MTU again.
+  /**
+   * This function updates the MTU from the path MTU the operating system
+   * currently knows. It only needs to be called to pick up a change before
+   * the next send or handshake would.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  void update_path_mtu()
+  {
+    asio::error_code ec;
+    update_path_mtu(ec);
+    asio::detail::throw_error(ec, "update_path_mtu");
+  }
+
+  /// Read the path MTU again.
+  /**
+   * This function updates the MTU from the path MTU the operating system
+   * currently knows. Does nothing unless path MTU discovery is enabled.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   */
+  ASIO_SYNC_OP_VOID update_path_mtu(asio::error_code& ec)
+  {
+    core_.update_path_mtu(ec);
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  /// Get the largest payload that can be sent in one datagram.
+  /**
+   * @returns The largest number of bytes a single send() can transfer
+   * without exceeding the MTU. Exact once the handshake has negotiated a
+   * cipher suite, an upper bound on the record overhead is assumed before.
+   *
+   * @note Calls @c DTLS_get_data_mtu.
+   */
+  std::size_t max_payload_length() const
+  {
+    return core_.engine_.max_payload_length();
+  }
+
   /// Set the callback used to generate dtls cookies
   /**
    * This function is used to specify a callback function that will be called
@@ -559,6 +794,78 @@ public:
     ASIO_SYNC_OP_VOID_RETURN(ec);
   }
 
+  /// Set the identity and pre-shared key used to handshake as a client.
+  /**
+   * This function overrides any PSK client callback set on the context. A
+   * PSK cipher suite must also be enabled.
+   *
+   * @param identity The identity sent to the server.
+   *
+   * @param key The key of the identity.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Calls @c SSL_set_psk_client_callback.
+   */
+  void set_psk_identity(const std::string& identity, const const_buffer& key)
+  {
+    asio::error_code ec;
+    set_psk_identity(identity, key, ec);
+    asio::detail::throw_error(ec, "set_psk_identity");
+  }
+
+  /// Set the identity and pre-shared key used to handshake as a client.
+  /**
+   * This function overrides any PSK client callback set on the context. A
+   * PSK cipher suite must also be enabled.
+   *
+   * @param identity The identity sent to the server.
+   *
+   * @param key The key of the identity.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @note Calls @c SSL_set_psk_client_callback.
+   */
+  ASIO_SYNC_OP_VOID set_psk_identity(const std::string& identity,
+      const const_buffer& key, asio::error_code& ec)
+  {
+    core_.engine_.set_psk_identity(identity, key, ec);
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  /// Configure retransmission of lost handshake messages.
+  /**
+   * During an asynchronous handshake, a flight of handshake messages that is
+   * not answered in time is sent again. The timeout doubles with every
+   * retransmission, up to 60 seconds. The handshake fails with
+   * asio::error::timed_out once the retransmissions or the overall deadline
+   * are exhausted. The defaults are one second, six retransmissions and 60
+   * seconds.
+   *
+   * While waiting for a handshake message the retransmission timer may
+   * cancel the operations of the next layer.
+   *
+   * @param initial_timeout The time to wait for an answer to the first
+   * transmission of a flight.
+   *
+   * @param max_retransmits The number of times a flight is retransmitted.
+   *
+   * @param handshake_timeout The time within which the handshake must
+   * complete, or zero for no limit.
+   *
+   * @note Calls @c DTLS_set_timer_cb. Before OpenSSL 1.1.1 the initial
+   * timeout is always one second.
+   */
+  void set_handshake_retransmission(
+      const asio::steady_timer::duration& initial_timeout,
+      unsigned int max_retransmits,
+      const asio::steady_timer::duration& handshake_timeout)
+  {
+    core_.engine_.set_retransmission(
+        initial_timeout, max_retransmits, handshake_timeout);
+  }
+
   /// Perform SSL handshaking.
   /**
    * This function is used to perform SSL handshaking on the stream. The
@@ -590,6 +897,7 @@ public:
       asio::error_code& ec)
   {
     remote_endpoint_tmp_ = next_layer().remote_endpoint();
+    refresh_path_mtu();
 
     ssl::dtls::detail::datagram_io(
           dtls::detail::datagram_receive<next_layer_type>(this->next_layer_),
@@ -637,6 +945,7 @@ public:
       const ConstBufferSequence& buffers, asio::error_code& ec)
   {
     remote_endpoint_tmp_ = next_layer().remote_endpoint();
+    refresh_path_mtu();
     ssl::dtls::detail::datagram_io(
       dtls::detail::datagram_receive<next_layer_type>(this->next_layer_),
       dtls::detail::datagram_send<next_layer_type>(this->next_layer_, 0),
@@ -675,9 +984,11 @@ public:
       void (asio::error_code)> init(handler);
 
     remote_endpoint_tmp_ = next_layer().remote_endpoint();
+    refresh_path_mtu();
 
     ssl::dtls::detail::async_datagram_io(
-          dtls::detail::async_datagram_receive_timeout<next_layer_type>(next_layer_),
+          dtls::detail::async_datagram_receive_timeout<next_layer_type, core_type>(
+              next_layer_, core_),
           dtls::detail::async_datagram_send<next_layer_type>(next_layer_),
           core_,
           detail::handshake_op(type), init.completion_handler);
@@ -685,6 +996,73 @@ public:
     return init.result.get();
   }
 
+  /// Start an asynchronous SSL handshake with a deadline.
+  /**
+   * This function is used to asynchronously perform an SSL handshake on the
+   * stream, as async_handshake() does, giving up once the timeout expires.
+   * This function call always returns immediately.
+   *
+   * The deadline uses a timer shared with async_receive(), so only one
+   * handshake or receive with a deadline may be outstanding at a time.
+   * Another one started meanwhile fails with asio::error::already_started.
+   *
+   * @param type The type of handshaking to be performed, i.e. as a client or as
+   * a server.
+   *
+   * @param timeout The time after which the handshake is cancelled. The
+   * handler is then called with asio::error::timed_out.
+   *
+   * @param handler The handler to be called when the handshake operation
+   * completes. Copies will be made of the handler as required. The equivalent
+   * function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error // Result of operation.
+   * ); @endcode
+   */
+  template <typename Rep, typename Period, typename HandshakeHandler>
+  ASIO_INITFN_RESULT_TYPE(HandshakeHandler,
+      void (asio::error_code))
+  async_handshake(handshake_type type,
+      const asio::chrono::duration<Rep, Period>& timeout,
+      ASIO_MOVE_ARG(HandshakeHandler) handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a HandshakeHandler.
+    ASIO_HANDSHAKE_HANDLER_CHECK(HandshakeHandler, handler) type_check;
+
+    typedef asio::async_completion<HandshakeHandler,
+      void (asio::error_code)> completion_type;
+    completion_type init(handler);
+
+    remote_endpoint_tmp_ = next_layer().remote_endpoint();
+    refresh_path_mtu();
+
+    deadline_type& deadline = core_.receive_deadline();
+    if (!deadline.arm(timeout))
+    {
+      asio::post(core_.executor_, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(typename completion_type::completion_handler_type)(
+              init.completion_handler),
+            asio::error_code(asio::error::already_started)));
+      return init.result.get();
+    }
+
+    detail::deadline_handler<typename completion_type::completion_handler_type,
+      deadline_type> deadline_handler(init.completion_handler, deadline);
+
+    ssl::dtls::detail::async_datagram_io(
+          detail::make_deadline_function(
+            dtls::detail::async_datagram_receive_timeout<
+              next_layer_type, core_type>(next_layer_, core_), deadline),
+          detail::make_deadline_function(
+            dtls::detail::async_datagram_send<next_layer_type>(next_layer_),
+            deadline),
+          core_,
+          detail::handshake_op(type), deadline_handler);
+
+    return init.result.get();
+  }
+
   /// Start an asynchronous SSL handshake.
   /**
    * This function is used to asynchronously perform an SSL handshake on the
@@ -718,12 +1096,14 @@ public:
         BufferedHandshakeHandler, handler) type_check;
 
     remote_endpoint_tmp_ = next_layer().remote_endpoint();
+    refresh_path_mtu();
 
     asio::async_completion<BufferedHandshakeHandler,
       void (asio::error_code, std::size_t)> init(handler);
 
     ssl::dtls::detail::async_datagram_io(
-        dtls::detail::async_datagram_receive_timeout<next_layer_type>(next_layer_),
+        dtls::detail::async_datagram_receive_timeout<next_layer_type, core_type>(
+              next_layer_, core_),
         dtls::detail::async_datagram_send<next_layer_type>(next_layer_),
         core_,
         detail::buffered_handshake_op<ConstBufferSequence>(type, buffers),
@@ -892,111 +1272,1374 @@ public:
     return init.result.get();
   }
 
-  /// Receive some data from the socket.
+  /// Start an asynchronous send with a deadline.
   /**
-   * This function is used to receive data on the dtls socket.
-   * The function call will block until data has been received
-   * successfully or an error occurs. 
+   * This function is used to asynchronously send data on the stream, as
+   * async_send() does, giving up once the timeout expires. The function call
+   * always returns immediately.
    *
-   * @param buffers The buffers into which the data will be read.
+   * The deadline uses a timer of the socket reused by every send with a
+   * deadline, so only one of them may be outstanding at a time. Another
+   * one started meanwhile fails with asio::error::already_started. A send
+   * that times out may leave part of its record unsent.
    *
-   * @param ec Set to indicate what error occurred, if any.
+   * @param buffers The data to be sent. Although the buffers object may be
+   * copied as necessary, ownership of the underlying buffers is retained by
+   * the caller, which must guarantee that they remain valid until the
+   * handler is called.
    *
-   * @returns The number of bytes read. Returns 0 if an error occurred.
+   * @param timeout The time after which the send is cancelled. The handler is
+   * then called with asio::error::timed_out.
+   *
+   * @param handler The handler to be called when the send operation
+   * completes. Copies will be made of the handler as required. The equivalent
+   * function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error, // Result of operation.
+   *   std::size_t bytes_transferred // Number of bytes sent.
+   * ); @endcode
    */
-  template <typename BufferSequence>
-  std::size_t receive(BufferSequence mb)
+  template <typename ConstBufferSequence, typename Rep, typename Period,
+      typename WriteHandler>
+  ASIO_INITFN_RESULT_TYPE(WriteHandler,
+      void (asio::error_code, std::size_t))
+  async_send(const ConstBufferSequence& buffers,
+      const asio::chrono::duration<Rep, Period>& timeout,
+      ASIO_MOVE_ARG(WriteHandler) handler)
   {
-    asio::error_code ec;
-    std::size_t res = ssl::dtls::detail::datagram_io(
-      dtls::detail::datagram_receive<next_layer_type>(this->next_layer_),
-      dtls::detail::datagram_send<next_layer_type>(this->next_layer_, 0),
-      this->core_,
-      detail::read_op<BufferSequence>(mb),
-      ec);
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a WriteHandler.
+    ASIO_WRITE_HANDLER_CHECK(WriteHandler, handler) type_check;
 
-    asio::detail::throw_error(ec, "receive");
-    return res;
-  }
+    typedef asio::async_completion<WriteHandler,
+      void (asio::error_code, std::size_t)> completion_type;
+    completion_type init(handler);
 
-  /// Receive some data on a dtls connection.
-  /**
-   * This function is used to receive data on the dtls connection.
-   * The function call will block until data has been received successfully
-   * or an error occurs.
-   *
-   * @param buffers One or more buffers into which the data will be received.
-   *
-   * @returns The number of bytes received.
-   *
-   * @throws asio::system_error Thrown on failure.
-   *
-   * @par Example
-   * To receive into a single data buffer use the @ref buffer function as
-   * follows:
-   * @code socket.receive(asio::buffer(data, size)); @endcode
-   * See the @ref buffer documentation for information on receiving into
-   * multiple buffers in one go, and how to use it with arrays, boost::array or
-   * std::vector.
-   */
-  template <typename BufferSequence>
-  std::size_t receive(BufferSequence mb, asio::error_code &ec)
-  {
-    return ssl::dtls::detail::datagram_io(
-      dtls::detail::datagram_receive<next_layer_type>(this->next_layer_),
-      dtls::detail::datagram_send<next_layer_type>(this->next_layer_, 0),
-      this->core_,
-      detail::read_op<BufferSequence>(mb),
-      ec);
+    deadline_type& deadline = core_.send_deadline();
+    if (!deadline.arm(timeout))
+    {
+      asio::post(core_.executor_, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(typename completion_type::completion_handler_type)(
+              init.completion_handler),
+            asio::error_code(asio::error::already_started), 0));
+      return init.result.get();
+    }
+
+    detail::deadline_handler<typename completion_type::completion_handler_type,
+      deadline_type> deadline_handler(init.completion_handler, deadline);
+
+    ssl::dtls::detail::async_datagram_io(
+        detail::make_deadline_function(
+          detail::async_datagram_receive<next_layer_type>(next_layer_),
+          deadline),
+        detail::make_deadline_function(
+          detail::async_datagram_send<next_layer_type>(next_layer_),
+          deadline),
+        core_,
+        detail::write_op<ConstBufferSequence>(buffers),
+        deadline_handler);
+
+    return init.result.get();
   }
 
-  /// Start an asynchronous receive.
+  /// Start an asynchronous send of several messages.
   /**
-   * This function is used to asynchronously receive data on
-   * the dtls socket. The function call always returns immediately.
-   *
-   * @param buffers The buffers into which the data will be read. Although the
-   * buffers object may be copied as necessary, ownership of the underlying
-   * buffers is retained by the caller, which must guarantee that they remain
-   * valid until the handler is called.
-   *
-   * @param handler The handler to be called when the read operation completes.
-   * Copies will be made of the handler as required. The equivalent function
-   * signature of the handler must be:
+   * This function is used to asynchronously send each buffer of the
+   * sequence as a message of its own. All messages are passed to the
+   * session before any is sent, and their records are then sent back to
+   * back by a single operation. Once the fast path is active, see
+   * enable_fast_path(), each record is sent in a datagram of its own; before
+   * that the records of several messages may share a datagram of up to the
+   * MTU. The function call always returns immediately.
+   *
+   * @param messages The messages to be sent. Although the buffers object may
+   * be copied as necessary, ownership of the underlying buffers is retained
+   * by the caller, which must guarantee that they remain valid until the
+   * handler is called.
+   *
+   * @param handler The handler to be called when the send operation
+   * completes. Copies will be made of the handler as required. The
+   * equivalent function signature of the handler must be:
    * @code void handler(
    *   const asio::error_code& error, // Result of operation.
-   *   std::size_t bytes_transferred           // Number of bytes read.
+   *   std::size_t messages // Number of messages sent.
    * ); @endcode
+   * On failure the number counts the messages whose records had all been
+   * sent before the error, in the order of the sequence.
    */
-  template <typename MutableBufferSequence, typename ReadHandler>
-  ASIO_INITFN_RESULT_TYPE(ReadHandler,
+  template <typename ConstBufferSequence, typename WriteHandler>
+  ASIO_INITFN_RESULT_TYPE(WriteHandler,
       void (asio::error_code, std::size_t))
-  async_receive(const MutableBufferSequence& buffers,
-      ASIO_MOVE_ARG(ReadHandler) handler)
+  async_send_batch(const ConstBufferSequence& messages,
+      ASIO_MOVE_ARG(WriteHandler) handler)
   {
     // If you get an error on the following line it means that your handler does
-    // not meet the documented type requirements for a ReadHandler.
-    ASIO_READ_HANDLER_CHECK(ReadHandler, handler) type_check;
+    // not meet the documented type requirements for a WriteHandler.
+    ASIO_WRITE_HANDLER_CHECK(WriteHandler, handler) type_check;
 
-    asio::async_completion<ReadHandler,
+    asio::async_completion<WriteHandler,
       void (asio::error_code, std::size_t)> init(handler);
 
     ssl::dtls::detail::async_datagram_io(
-        dtls::detail::async_datagram_receive<next_layer_type>(next_layer_),
-        dtls::detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+        detail::async_datagram_receive<next_layer_type>(next_layer_),
+        detail::async_datagram_send<next_layer_type>(next_layer_),
+        core_,
+        detail::batch_write_op<ConstBufferSequence>(messages, core_.engine_),
+        init.completion_handler);
+
+    return init.result.get();
+  }
+
+#if defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+  /// Start an asynchronous send of a buffer the socket takes over.
+  /**
+   * This function is used to asynchronously send data, as async_send() does,
+   * without the caller having to keep the data alive. The buffer is moved
+   * into memory allocated through the handler's allocator, and destroyed
+   * before the handler is called. The function call always returns
+   * immediately.
+   *
+   * @param data The data to be sent, moved if passed as an rvalue. Either a
+   * container that asio::buffer() accepts, such as @c std::vector or
+   * @c std::string, or a type that is a buffer sequence, in which case its
+   * first buffer is sent.
+   *
+   * @param handler The handler to be called when the send operation
+   * completes. Copies will be made of the handler as required. The
+   * equivalent function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error, // Result of operation.
+   *   std::size_t bytes_transferred // Number of bytes sent.
+   * ); @endcode
+   */
+  template <typename Buffer, typename WriteHandler>
+  ASIO_INITFN_RESULT_TYPE(WriteHandler,
+      void (asio::error_code, std::size_t))
+  async_send_owned(Buffer&& data, WriteHandler&& handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a WriteHandler.
+    ASIO_WRITE_HANDLER_CHECK(WriteHandler, handler) type_check;
+
+    asio::async_completion<WriteHandler,
+      void (asio::error_code, std::size_t)> init(handler);
+
+    start_send_owned(ASIO_MOVE_CAST(Buffer)(data), init.completion_handler);
+
+    return init.result.get();
+  }
+
+  /// Send a buffer the socket takes over, without a handler.
+  /**
+   * This function starts an asynchronous send as the overload taking a
+   * handler does, and counts its failure, if any, instead of reporting it.
+   * See owned_send_failures(). The function call always returns immediately.
+   *
+   * @param data The data to be sent, moved if passed as an rvalue.
+   *
+   * @note The send is an asynchronous operation of the socket, so its other
+   * operations must not run on another thread at the same time, just as for
+   * async_send().
+   */
+  template <typename Buffer>
+  void async_send_owned(Buffer&& data)
+  {
+    ssl::dtls::detail::send_failure_counter handler(
+        core_.owned_send_failures_);
+    start_send_owned(ASIO_MOVE_CAST(Buffer)(data), handler);
+  }
+#endif // defined(ASIO_HAS_MOVE) || defined(GENERATING_DOCUMENTATION)
+
+  /// Get the number of owned sends without a handler that failed.
+  /**
+   * @returns The number of sends started by async_send_owned() without a
+   * handler that failed. Must be called on the socket's executor.
+   */
+  std::size_t owned_send_failures() const
+  {
+    return core_.owned_send_failures_;
+  }
+
+  /// Queue data for sending from any thread.
+  /**
+   * This function copies the data into a lock-free queue and returns
+   * immediately. It may be called from any thread, concurrently with other
+   * calls to queue_send(). The queue is drained on the socket's executor,
+   * where each round passes everything queued so far to the session and
+   * sends it as one operation, without a handler per message.
+   *
+   * Each call sends one record, so the data should not be larger than
+   * max_payload_length(). Sending failures are not reported to the caller,
+   * see queued_send_failures().
+   *
+   * @param data The data to be sent. Empty data is ignored.
+   *
+   * @note The drain is an asynchronous operation of the socket. It runs on
+   * the socket's executor, so its other operations must not run on
+   * another thread at the same time, just as for async_send(). Use
+   * async_wait_queued_sends() to find out when it has ended.
+   */
+  void queue_send(const asio::const_buffer& data)
+  {
+    if (data.size() == 0)
+      return;
+
+    ssl::dtls::detail::send_queue& queue = make_queued_sends();
+    if (queue.push(data))
+      asio::post(core_.executor_,
+          ssl::dtls::detail::queued_send_drain_op<
+            next_layer_type, core_type>(queue.shared_from_this()));
+  }
+
+  /// Wait until the messages queued for sending have been sent.
+  /**
+   * This function is used to asynchronously wait for the drain of the
+   * messages passed to queue_send() to end. It must be called on the
+   * socket's executor. The socket may be destroyed or moved once the
+   * handler has been called, unless messages have been queued since.
+   *
+   * @param handler The handler to be called when the queue has been
+   * drained. Copies will be made of the handler as required. The equivalent
+   * function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error // Result of operation.
+   * ); @endcode
+   * The error is asio::error::operation_aborted if messages were discarded
+   * by cancel_queued_sends().
+   */
+  template <typename WaitHandler>
+  ASIO_INITFN_RESULT_TYPE(WaitHandler,
+      void (asio::error_code))
+  async_wait_queued_sends(ASIO_MOVE_ARG(WaitHandler) handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a WaitHandler.
+    ASIO_WAIT_HANDLER_CHECK(WaitHandler, handler) type_check;
+
+    typedef asio::async_completion<WaitHandler,
+      void (asio::error_code)> completion_type;
+    completion_type init(handler);
+
+    // Without a queue nothing has been queued, so there is no drain.
+    if (ssl::dtls::detail::send_queue* queue = queued_sends())
+      queue->async_wait(core_.executor_, init.completion_handler);
+    else
+      asio::post(core_.executor_, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(typename completion_type::completion_handler_type)(
+              init.completion_handler), asio::error_code()));
+
+    return init.result.get();
+  }
+
+  /// Discard the messages queued for sending.
+  /**
+   * The messages passed to queue_send() that have not been passed to the
+   * session yet are discarded at the drain's next step, and counted by
+   * queued_send_failures(). A round already being sent is not recalled. May
+   * be called from any thread.
+   */
+  void cancel_queued_sends()
+  {
+    if (ssl::dtls::detail::send_queue* queue = queued_sends())
+      queue->cancel();
+  }
+
+  /// Get the number of queued messages that could not be sent.
+  /**
+   * @returns The number of messages passed to queue_send() that the session
+   * rejected, that were part of a round that failed to send, or that were
+   * discarded. May be called from any thread.
+   */
+  std::size_t queued_send_failures() const
+  {
+    ssl::dtls::detail::send_queue* queue = queued_sends();
+    return queue ? queue->failures() : 0;
+  }
+
+  /// Enable the fast data path.
+  /**
+   * This function switches an established session to a record layer that
+   * seals and opens application data records directly, bypassing
+   * @c SSL_write and @c SSL_read. The records are identical on the wire, so
+   * the peer does not need to enable the fast path as well.
+   *
+   * The switch happens once no handshake message can be retransmitted any
+   * more. On the side that sent the final handshake flight this is when the
+   * first application data arrives from the peer; until then data passes
+   * through OpenSSL as before.
+   *
+   * @throws asio::system_error Thrown on failure, in particular if the
+   * session does not use DTLS 1.2 with an AES-GCM or ChaCha20-Poly1305
+   * cipher suite.
+   *
+   * @note Renegotiation is not supported once the fast path is active.
+   */
+  void enable_fast_path()
+  {
+    asio::error_code ec;
+    enable_fast_path(ec);
+    asio::detail::throw_error(ec, "enable_fast_path");
+  }
+
+  /// Enable the fast data path.
+  /**
+   * This function switches an established session to a record layer that
+   * seals and opens application data records directly, bypassing
+   * @c SSL_write and @c SSL_read.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::operation_not_supported if the session does not use DTLS 1.2
+   * with an AES-GCM or ChaCha20-Poly1305 cipher suite.
+   */
+  ASIO_SYNC_OP_VOID enable_fast_path(asio::error_code& ec)
+  {
+    core_.engine_.enable_record_layer(ec);
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  /// Get the space to reserve in front of a payload sent in place.
+  /**
+   * @returns The number of bytes send_in_place() needs in front of the
+   * payload for the record header and explicit nonce. Valid once
+   * enable_fast_path() has succeeded, 0 before.
+   */
+  std::size_t fast_path_headroom() const
+  {
+    return core_.engine_.record_headroom();
+  }
+
+  /// Get the space to reserve behind a payload sent in place.
+  /**
+   * @returns The number of bytes send_in_place() needs behind the payload
+   * for the authentication tag. Valid once enable_fast_path() has succeeded,
+   * 0 before.
+   */
+  std::size_t fast_path_tailroom() const
+  {
+    return core_.engine_.record_tailroom();
+  }
+
+  /// Open and seal records on worker threads.
+  /**
+   * This function lets async_receive_pipelined() open several received
+   * datagrams at the same time on the given executor, and lets the drain of
+   * queue_send() seal the queued messages there. Each session keeps its own
+   * order: records are delivered, and sent, in the order they were received,
+   * or queued.
+   *
+   * Only records of the fast path are processed on the workers, once it is
+   * active, see enable_fast_path(). Handshake messages, alerts and
+   * heartbeats are handled on the socket's executor as before.
+   *
+   * @param workers The executor to run the cryptography on, typically that
+   * of an asio::thread_pool.
+   *
+   * @param depth The number of datagrams opened, and of parts of a send
+   * round sealed, at the same time.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @note Must not be called while an operation is pending. The workers must
+   * keep running until the socket's pending operations have completed.
+   */
+  template <typename Executor>
+  void enable_crypto_pipeline(const Executor& workers, std::size_t depth = 8)
+  {
+    asio::error_code ec;
+    enable_crypto_pipeline(workers, depth, ec);
+    asio::detail::throw_error(ec, "enable_crypto_pipeline");
+  }
+
+  /// Open and seal records on worker threads.
+  /**
+   * This function lets async_receive_pipelined() and the drain of
+   * queue_send() run the cryptography of the fast path on the given
+   * executor.
+   *
+   * @param workers The executor to run the cryptography on.
+   *
+   * @param depth The number of datagrams opened, and of parts of a send
+   * round sealed, at the same time.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::invalid_argument if @c depth is 0.
+   */
+  template <typename Executor>
+  ASIO_SYNC_OP_VOID enable_crypto_pipeline(const Executor& workers,
+      std::size_t depth, asio::error_code& ec)
+  {
+    if (depth == 0)
+    {
+      ec = asio::error::invalid_argument;
+      ASIO_SYNC_OP_VOID_RETURN(ec);
+    }
+
+    core_.crypto_pipeline_.reset(new ssl::dtls::detail::crypto_pipeline(
+        new ssl::dtls::detail::crypto_executor<Executor>(workers), depth));
+    ec = asio::error_code();
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  /// Send data that is sealed in the caller's buffer.
+  /**
+   * This function encrypts a payload in place and sends the resulting record
+   * without copying it. The payload must start fast_path_headroom() bytes
+   * into @c record, and @c record must extend fast_path_tailroom() bytes
+   * past its end. The function call will block until the record has been
+   * sent or an error occurs.
+   *
+   * @param record The buffer holding the payload. Its contents are
+   * overwritten with the record.
+   *
+   * @param length The length of the payload.
+   *
+   * @returns The number of payload bytes written.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  std::size_t send_in_place(const asio::mutable_buffer& record,
+      std::size_t length)
+  {
+    asio::error_code ec;
+    std::size_t res = send_in_place(record, length, ec);
+    asio::detail::throw_error(ec, "send_in_place");
+    return res;
+  }
+
+  /// Send data that is sealed in the caller's buffer.
+  /**
+   * This function encrypts a payload in place and sends the resulting record
+   * without copying it. The payload must start fast_path_headroom() bytes
+   * into @c record, and @c record must extend fast_path_tailroom() bytes
+   * past its end.
+   *
+   * @param record The buffer holding the payload. Its contents are
+   * overwritten with the record.
+   *
+   * @param length The length of the payload.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @returns The number of payload bytes written. Returns 0 if an error
+   * occurred.
+   */
+  std::size_t send_in_place(const asio::mutable_buffer& record,
+      std::size_t length, asio::error_code& ec)
+  {
+    return ssl::dtls::detail::datagram_io(
+      dtls::detail::datagram_receive<next_layer_type>(this->next_layer_),
+      dtls::detail::datagram_send<next_layer_type>(this->next_layer_, 0),
+      this->core_,
+      detail::in_place_write_op(record, length),
+      ec);
+  }
+
+  /// Start an asynchronous send of data sealed in the caller's buffer.
+  /**
+   * This function encrypts a payload in place and asynchronously sends the
+   * resulting record without copying it. The payload must start
+   * fast_path_headroom() bytes into @c record, and @c record must extend
+   * fast_path_tailroom() bytes past its end. The function call always
+   * returns immediately.
+   *
+   * @param record The buffer holding the payload. Its contents are
+   * overwritten with the record. Ownership of the buffer is retained by the
+   * caller, which must guarantee that it remains valid until the handler is
+   * called.
+   *
+   * @param length The length of the payload.
+   *
+   * @param handler The handler to be called when the send operation
+   * completes. Copies will be made of the handler as required. The equivalent
+   * function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error, // Result of operation.
+   *   std::size_t bytes_transferred  // Number of payload bytes written.
+   * ); @endcode
+   */
+  template <typename WriteHandler>
+  ASIO_INITFN_RESULT_TYPE(WriteHandler,
+      void (asio::error_code, std::size_t))
+  async_send_in_place(const asio::mutable_buffer& record, std::size_t length,
+      ASIO_MOVE_ARG(WriteHandler) handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a WriteHandler.
+    ASIO_WRITE_HANDLER_CHECK(WriteHandler, handler) type_check;
+
+    asio::async_completion<WriteHandler,
+      void (asio::error_code, std::size_t)> init(handler);
+
+    ssl::dtls::detail::async_datagram_io(
+        detail::async_datagram_receive<next_layer_type>(next_layer_),
+        detail::async_datagram_send<next_layer_type>(next_layer_),
+        core_,
+        detail::in_place_write_op(record, length),
+        init.completion_handler);
+
+    return init.result.get();
+  }
+
+  /// Receive some data from the socket.
+  /**
+   * This function is used to receive data on the dtls socket.
+   * The function call will block until data has been received
+   * successfully or an error occurs. 
+   *
+   * @param buffers The buffers into which the data will be read.
+   *
+   * @param ec Set to indicate what error occurred, if any.
+   *
+   * @returns The number of bytes read. Returns 0 if an error occurred.
+   */
+  template <typename BufferSequence>
+  std::size_t receive(BufferSequence mb)
+  {
+    asio::error_code ec;
+    std::size_t res = ssl::dtls::detail::datagram_io(
+      dtls::detail::datagram_receive<next_layer_type>(this->next_layer_),
+      dtls::detail::datagram_send<next_layer_type>(this->next_layer_, 0),
+      this->core_,
+      detail::read_op<BufferSequence>(mb),
+      ec);
+
+    asio::detail::throw_error(ec, "receive");
+    return res;
+  }
+
+  /// Receive some data on a dtls connection.
+  /**
+   * This function is used to receive data on the dtls connection.
+   * The function call will block until data has been received successfully
+   * or an error occurs.
+   *
+   * @param buffers One or more buffers into which the data will be received.
+   *
+   * @returns The number of bytes received.
+   *
+   * @throws asio::system_error Thrown on failure.
+   *
+   * @par Example
+   * To receive into a single data buffer use the @ref buffer function as
+   * follows:
+   * @code socket.receive(asio::buffer(data, size)); @endcode
+   * See the @ref buffer documentation for information on receiving into
+   * multiple buffers in one go, and how to use it with arrays, boost::array or
+   * std::vector.
+   */
+  template <typename BufferSequence>
+  std::size_t receive(BufferSequence mb, asio::error_code &ec)
+  {
+    return ssl::dtls::detail::datagram_io(
+      dtls::detail::datagram_receive<next_layer_type>(this->next_layer_),
+      dtls::detail::datagram_send<next_layer_type>(this->next_layer_, 0),
+      this->core_,
+      detail::read_op<BufferSequence>(mb),
+      ec);
+  }
+
+  /// Start an asynchronous receive.
+  /**
+   * This function is used to asynchronously receive data on
+   * the dtls socket. The function call always returns immediately.
+   *
+   * @param buffers The buffers into which the data will be read. Although the
+   * buffers object may be copied as necessary, ownership of the underlying
+   * buffers is retained by the caller, which must guarantee that they remain
+   * valid until the handler is called.
+   *
+   * @param handler The handler to be called when the read operation completes.
+   * Copies will be made of the handler as required. The equivalent function
+   * signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error, // Result of operation.
+   *   std::size_t bytes_transferred           // Number of bytes read.
+   * ); @endcode
+   */
+  template <typename MutableBufferSequence, typename ReadHandler>
+  ASIO_INITFN_RESULT_TYPE(ReadHandler,
+      void (asio::error_code, std::size_t))
+  async_receive(const MutableBufferSequence& buffers,
+      ASIO_MOVE_ARG(ReadHandler) handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a ReadHandler.
+    ASIO_READ_HANDLER_CHECK(ReadHandler, handler) type_check;
+
+    asio::async_completion<ReadHandler,
+      void (asio::error_code, std::size_t)> init(handler);
+
+    ssl::dtls::detail::async_datagram_io(
+        dtls::detail::async_datagram_receive<next_layer_type>(next_layer_),
+        dtls::detail::async_datagram_send<next_layer_type>(next_layer_, 0),
         core_,
         detail::read_op<MutableBufferSequence>(buffers),
         init.completion_handler);
 
     return init.result.get();
   }
+
+  /// Start an asynchronous receive with a deadline.
+  /**
+   * This function is used to asynchronously receive data on the stream, as
+   * async_receive() does, giving up once the timeout expires. The session is
+   * kept, so a request/response exchange can time out a single reply and
+   * carry on. The function call always returns immediately.
+   *
+   * The deadline uses a timer of the socket shared with async_handshake(),
+   * so only one receive or handshake with a deadline may be outstanding at a
+   * time. Another one started meanwhile fails with
+   * asio::error::already_started.
+   *
+   * @param buffers The buffers into which the data will be received.
+   * Although the buffers object may be copied as necessary, ownership of the
+   * underlying buffers is retained by the caller, which must guarantee that
+   * they remain valid until the handler is called.
+   *
+   * @param timeout The time after which the receive is cancelled. The handler
+   * is then called with asio::error::timed_out.
+   *
+   * @param handler The handler to be called when the receive operation
+   * completes. Copies will be made of the handler as required. The equivalent
+   * function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error, // Result of operation.
+   *   std::size_t bytes_transferred // Number of bytes received.
+   * ); @endcode
+   */
+  template <typename MutableBufferSequence, typename Rep, typename Period,
+      typename ReadHandler>
+  ASIO_INITFN_RESULT_TYPE(ReadHandler,
+      void (asio::error_code, std::size_t))
+  async_receive(const MutableBufferSequence& buffers,
+      const asio::chrono::duration<Rep, Period>& timeout,
+      ASIO_MOVE_ARG(ReadHandler) handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a ReadHandler.
+    ASIO_READ_HANDLER_CHECK(ReadHandler, handler) type_check;
+
+    typedef asio::async_completion<ReadHandler,
+      void (asio::error_code, std::size_t)> completion_type;
+    completion_type init(handler);
+
+    deadline_type& deadline = core_.receive_deadline();
+    if (!deadline.arm(timeout))
+    {
+      asio::post(core_.executor_, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(typename completion_type::completion_handler_type)(
+              init.completion_handler),
+            asio::error_code(asio::error::already_started), 0));
+      return init.result.get();
+    }
+
+    detail::deadline_handler<typename completion_type::completion_handler_type,
+      deadline_type> deadline_handler(init.completion_handler, deadline);
+
+    ssl::dtls::detail::async_datagram_io(
+        detail::make_deadline_function(
+          dtls::detail::async_datagram_receive<next_layer_type>(next_layer_),
+          deadline),
+        detail::make_deadline_function(
+          dtls::detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+          deadline),
+        core_,
+        detail::read_op<MutableBufferSequence>(buffers),
+        deadline_handler);
+
+    return init.result.get();
+  }
+
+  /// Set the pool that datagrams are received into.
+  /**
+   * This function makes the socket receive every datagram into a block of
+   * the pool instead of a buffer of its own. It is required by the
+   * async_receive() overload that passes a lease to its handler, and can be
+   * shared by many sockets.
+   *
+   * @param pool The pool to lease blocks from. Its blocks must hold the
+   * largest datagram the socket receives. The pool must outlive the socket
+   * and the leases the socket has passed out.
+   *
+   * @note Must not be called while an operation is pending.
+   */
+  void set_receive_pool(buffer_pool& pool)
+  {
+    core_.receive_pool_ = &pool;
+  }
+
+  /// Start an asynchronous receive that lends the message to the handler.
+  /**
+   * This function is used to asynchronously receive the next message on the
+   * dtls socket without copying it into a buffer of the caller. The function
+   * call always returns immediately.
+   *
+   * Once the fast path is active, see enable_fast_path(), each record is
+   * opened where it was received, in a block of the socket's receive pool,
+   * and the handler gets a lease on the plaintext within that block. The
+   * block returns to the pool once the last lease on it has been dropped.
+   * Before that, messages are read from OpenSSL into a block of their own.
+   *
+   * @param handler The handler to be called when the receive operation
+   * completes. Copies will be made of the handler as required. The equivalent
+   * function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error, // Result of operation.
+   *   asio::ssl::dtls::buffer_lease lease // The received message.
+   * ); @endcode
+   * The lease is empty if an error occurred. The error is
+   * asio::error::invalid_argument if no receive pool has been set, see
+   * set_receive_pool().
+   */
+  template <typename LeaseHandler>
+  ASIO_INITFN_RESULT_TYPE(LeaseHandler,
+      void (asio::error_code, buffer_lease))
+  async_receive(ASIO_MOVE_ARG(LeaseHandler) handler)
+  {
+    typedef asio::async_completion<LeaseHandler,
+      void (asio::error_code, buffer_lease)> completion_type;
+    completion_type init(handler);
+
+    if (!core_.receive_pool_)
+    {
+      asio::post(core_.executor_, asio::detail::bind_handler(
+            ASIO_MOVE_CAST(typename completion_type::completion_handler_type)(
+              init.completion_handler),
+            asio::error_code(asio::error::invalid_argument),
+            buffer_lease()));
+      return init.result.get();
+    }
+
+    ssl::dtls::detail::async_datagram_io(
+        dtls::detail::async_datagram_receive<next_layer_type>(next_layer_),
+        dtls::detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+        core_,
+        detail::lease_read_op(*core_.receive_pool_, core_.input_lease_),
+        init.completion_handler);
+
+    return init.result.get();
+  }
+
+  /// Start an asynchronous receive of several messages.
+  /**
+   * This function is used to asynchronously receive messages into the given
+   * slots, one message each, with a single handler call. It waits for the
+   * first message, then fills further slots for as long as that is possible
+   * without waiting: from the records left in the last datagram and from
+   * datagrams already waiting on the transport. The function call always
+   * returns immediately.
+   *
+   * @param slots The slots to receive into, each with its buffer set. The
+   * slots and their buffers must remain valid until the handler is called.
+   *
+   * @param count The number of slots.
+   *
+   * @param handler The handler to be called when the receive operation
+   * completes. Copies will be made of the handler as required. The
+   * equivalent function signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error, // Result of operation.
+   *   std::size_t messages // Number of slots filled.
+   * ); @endcode
+   * The slots filled before an error are passed to the handler with it.
+   *
+   * @par Example
+   * @code
+   * std::vector<asio::ssl::dtls::message_slot> slots;
+   * for (std::size_t i = 0; i < buffers.size(); ++i)
+   *   slots.push_back(asio::ssl::dtls::message_slot(buffers[i]));
+   * sock.async_receive_batch(&slots[0], slots.size(), handler);
+   * @endcode
+   */
+  template <typename ReadHandler>
+  ASIO_INITFN_RESULT_TYPE(ReadHandler,
+      void (asio::error_code, std::size_t))
+  async_receive_batch(message_slot* slots, std::size_t count,
+      ASIO_MOVE_ARG(ReadHandler) handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a ReadHandler.
+    ASIO_READ_HANDLER_CHECK(ReadHandler, handler) type_check;
+
+    asio::async_completion<ReadHandler,
+      void (asio::error_code, std::size_t)> init(handler);
+
+    ssl::dtls::detail::async_datagram_io(
+        dtls::detail::async_datagram_receive<next_layer_type>(next_layer_),
+        dtls::detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+        core_,
+        detail::batch_read_op<next_layer_type>(
+          slots, count, core_.input_, next_layer_),
+        init.completion_handler);
+
+    return init.result.get();
+  }
+
+  /// Start receiving messages until the session ends.
+  /**
+   * This function receives datagrams and passes every message they carry to
+   * @c on_message, on the handler's associated executor and in the order
+   * they were received, until the peer closes the session or an error
+   * occurs. The function call always returns immediately.
+   *
+   * With a crypto pipeline, see enable_crypto_pipeline(), the datagrams are
+   * opened on its workers, several at a time, once the fast path is active.
+   * Otherwise messages are read one at a time, as async_receive() does.
+   *
+   * @param on_message The function called with each message. The buffer is
+   * only valid during the call. The equivalent function signature must be:
+   * @code void on_message(
+   *   const asio::const_buffer& message // The received message.
+   * ); @endcode
+   *
+   * @param handler The handler to be called when receiving stops. Copies
+   * will be made of the handler as required. The equivalent function
+   * signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error // Result of operation.
+   * ); @endcode
+   * The error is asio::error::eof if the peer closed the session, or the
+   * error of a failed send of output the engine queued in reply, such as a
+   * heartbeat response.
+   *
+   * @note Emitting the handler's cancellation slot ends receiving with
+   * asio::error::operation_aborted. Only the receive of this operation is
+   * cancelled, other operations on the socket continue.
+   */
+  template <typename MessageHandler, typename ReadHandler>
+  ASIO_INITFN_RESULT_TYPE(ReadHandler,
+      void (asio::error_code))
+  async_receive_pipelined(MessageHandler on_message,
+      ASIO_MOVE_ARG(ReadHandler) handler)
+  {
+    asio::async_completion<ReadHandler,
+      void (asio::error_code)> init(handler);
+
+    ssl::dtls::detail::async_pipelined_receive(next_layer_, core_,
+        on_message, init.completion_handler);
+
+    return init.result.get();
+  }
+
+#if defined(ASIO_HAS_CO_AWAIT) || defined(GENERATING_DOCUMENTATION)
+  /// Perform an SSL handshake in a coroutine.
+  /**
+   * This function returns an awaitable that performs the handshake when a
+   * coroutine awaits it, as async_handshake() does. The state of the
+   * operation, including the memory its steps on the transport need, is kept
+   * in the awaitable, and so in the coroutine frame, instead of being
+   * allocated. The wait on the socket's retransmission timer reuses memory
+   * kept by the socket. The peer's address and the path MTU are picked up
+   * when the awaitable is awaited, not when it is created.
+   *
+   * @param type The type of handshaking to be performed, i.e. as a client or as
+   * a server.
+   *
+   * @throws asio::system_error Thrown from the co_await expression on
+   * failure.
+   *
+   * @par Example
+   * @code co_await socket.co_handshake(asio::ssl::stream_base::client);
+   * @endcode
+   *
+   * @note The awaitable works with any coroutine type that accepts standard
+   * awaitables. An asio::awaitable coroutine only accepts asio's own
+   * awaitables, so pass asio::use_awaitable to this and the other co_
+   * functions there instead.
+   */
+  auto co_handshake(handshake_type type)
+  {
+    return co_handshake(type, 0);
+  }
+
+  /// Perform an SSL handshake in an asio::awaitable coroutine.
+  /**
+   * This function returns an asio::awaitable that performs the handshake
+   * when the coroutine awaits it, as async_handshake() does. The handler
+   * memory is that of asio::use_awaitable, which asio recycles per thread.
+   *
+   * @param type The type of handshaking to be performed, i.e. as a client or as
+   * a server.
+   *
+   * @param token The asio::use_awaitable completion token.
+   *
+   * @par Example
+   * @code co_await socket.co_handshake(asio::ssl::stream_base::client,
+   *     asio::use_awaitable); @endcode
+   */
+  template <typename Executor>
+  auto co_handshake(handshake_type type,
+      const asio::use_awaitable_t<Executor>& token)
+  {
+    handshake_prepare prepare = { this };
+    return asio::async_initiate<const asio::use_awaitable_t<Executor>&,
+      void (asio::error_code)>(
+        detail::make_datagram_io_initiation(
+          detail::async_datagram_receive_timeout<next_layer_type, core_type>(
+            next_layer_, core_),
+          detail::async_datagram_send<next_layer_type>(next_layer_),
+          core_, detail::handshake_op(type), prepare),
+        token);
+  }
+
+  /// Perform an SSL handshake in a coroutine.
+  /**
+   * This function returns an awaitable that performs the handshake when a
+   * coroutine awaits it, keeping the memory of its steps on the transport in
+   * the awaitable.
+   *
+   * @param type The type of handshaking to be performed, i.e. as a client or as
+   * a server.
+   *
+   * @param ec Set to indicate what error occurred, if any, when the co_await
+   * expression completes.
+   */
+  auto co_handshake(handshake_type type, asio::error_code& ec)
+  {
+    return co_handshake(type, &ec);
+  }
+
+  /// Send data in a coroutine.
+  /**
+   * This function returns an awaitable that sends the data when a coroutine
+   * awaits it, as async_send() does, without allocating. The co_await
+   * expression yields the number of bytes sent.
+   *
+   * @param buffers The data to be sent. Ownership of the underlying buffers
+   * is retained by the caller, which must keep them valid until the co_await
+   * expression completes.
+   *
+   * @throws asio::system_error Thrown from the co_await expression on
+   * failure.
+   */
+  template <typename ConstBufferSequence>
+  auto co_send(const ConstBufferSequence& buffers)
+  {
+    return co_send(buffers, 0);
+  }
+
+  /// Send data in a coroutine.
+  /**
+   * This function returns an awaitable that sends the data when a coroutine
+   * awaits it, without allocating. The co_await expression yields the number
+   * of bytes sent.
+   *
+   * @param buffers The data to be sent.
+   *
+   * @param ec Set to indicate what error occurred, if any, when the co_await
+   * expression completes.
+   */
+  template <typename ConstBufferSequence>
+  auto co_send(const ConstBufferSequence& buffers, asio::error_code& ec)
+  {
+    return co_send(buffers, &ec);
+  }
+
+  /// Send data in an asio::awaitable coroutine.
+  /**
+   * This function returns an asio::awaitable that sends the data when the
+   * coroutine awaits it, as async_send() does. The co_await expression yields
+   * the number of bytes sent.
+   *
+   * @param buffers The data to be sent.
+   *
+   * @param token The asio::use_awaitable completion token.
+   */
+  template <typename ConstBufferSequence, typename Executor>
+  auto co_send(const ConstBufferSequence& buffers,
+      const asio::use_awaitable_t<Executor>& token)
+  {
+    return asio::async_initiate<const asio::use_awaitable_t<Executor>&,
+      void (asio::error_code, std::size_t)>(
+        detail::make_datagram_io_initiation(
+          detail::async_datagram_receive<next_layer_type>(next_layer_),
+          detail::async_datagram_send<next_layer_type>(next_layer_),
+          core_, detail::write_op<ConstBufferSequence>(buffers)),
+        token);
+  }
+
+  /// Receive data in a coroutine.
+  /**
+   * This function returns an awaitable that receives data when a coroutine
+   * awaits it, as async_receive() does, without allocating. The co_await
+   * expression yields the number of bytes received.
+   *
+   * @param buffers The buffers into which the data will be received.
+   * Ownership of the underlying buffers is retained by the caller, which must
+   * keep them valid until the co_await expression completes.
+   *
+   * @throws asio::system_error Thrown from the co_await expression on
+   * failure.
+   */
+  template <typename MutableBufferSequence>
+  auto co_receive(const MutableBufferSequence& buffers)
+  {
+    return co_receive(buffers, 0);
+  }
+
+  /// Receive data in a coroutine.
+  /**
+   * This function returns an awaitable that receives data when a coroutine
+   * awaits it, without allocating. The co_await expression yields the number
+   * of bytes received.
+   *
+   * @param buffers The buffers into which the data will be received.
+   *
+   * @param ec Set to indicate what error occurred, if any, when the co_await
+   * expression completes.
+   */
+  template <typename MutableBufferSequence>
+  auto co_receive(const MutableBufferSequence& buffers, asio::error_code& ec)
+  {
+    return co_receive(buffers, &ec);
+  }
+
+  /// Receive data in an asio::awaitable coroutine.
+  /**
+   * This function returns an asio::awaitable that receives data when the
+   * coroutine awaits it, as async_receive() does. The co_await expression
+   * yields the number of bytes received.
+   *
+   * @param buffers The buffers into which the data will be received.
+   *
+   * @param token The asio::use_awaitable completion token.
+   */
+  template <typename MutableBufferSequence, typename Executor>
+  auto co_receive(const MutableBufferSequence& buffers,
+      const asio::use_awaitable_t<Executor>& token)
+  {
+    return asio::async_initiate<const asio::use_awaitable_t<Executor>&,
+      void (asio::error_code, std::size_t)>(
+        detail::make_datagram_io_initiation(
+          detail::async_datagram_receive<next_layer_type>(next_layer_),
+          detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+          core_, detail::read_op<MutableBufferSequence>(buffers)),
+        token);
+  }
+
+  /// Shut down SSL in a coroutine.
+  /**
+   * This function returns an awaitable that shuts down SSL when a coroutine
+   * awaits it, as async_shutdown() does, without allocating.
+   *
+   * @throws asio::system_error Thrown from the co_await expression on
+   * failure.
+   */
+  auto co_shutdown()
+  {
+    return co_shutdown(0);
+  }
+
+  /// Shut down SSL in a coroutine.
+  /**
+   * This function returns an awaitable that shuts down SSL when a coroutine
+   * awaits it, without allocating.
+   *
+   * @param ec Set to indicate what error occurred, if any, when the co_await
+   * expression completes.
+   */
+  auto co_shutdown(asio::error_code& ec)
+  {
+    return co_shutdown(&ec);
+  }
+
+  /// Shut down SSL in an asio::awaitable coroutine.
+  /**
+   * This function returns an asio::awaitable that shuts down SSL when the
+   * coroutine awaits it, as async_shutdown() does.
+   *
+   * @param token The asio::use_awaitable completion token.
+   */
+  template <typename Executor>
+  auto co_shutdown(const asio::use_awaitable_t<Executor>& token)
+  {
+    return asio::async_initiate<const asio::use_awaitable_t<Executor>&,
+      void (asio::error_code)>(
+        detail::make_datagram_io_initiation(
+          detail::async_datagram_receive<next_layer_type>(next_layer_),
+          detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+          core_, detail::shutdown_op()),
+        token);
+  }
+#endif // defined(ASIO_HAS_CO_AWAIT) || defined(GENERATING_DOCUMENTATION)
+
+  /// Get the connection ID the peer puts into its records.
+  /**
+   * @returns The ID chosen by this side when connection IDs were negotiated,
+   * see context::enable_connection_id(), or an empty string otherwise. Valid
+   * once the handshake has completed.
+   */
+  std::string connection_id() const
+  {
+    return core_.engine_.connection_id();
+  }
+
+  /// Move the session to a new peer address.
+  /**
+   * This function is used by a server when a datagram with this session's
+   * connection ID arrived from an address other than the connected one,
+   * typically on the acceptor's socket after a NAT rebinding. The datagram is
+   * authenticated and, if its record is newer than all others, the
+   * underlying socket is connected to the new address.
+   *
+   * @param peer The address the datagram came from.
+   *
+   * @param datagram The datagram. Its first record is delivered by the next
+   * receive operation; any further records are dropped.
+   *
+   * @throws asio::system_error Thrown on failure.
+   */
+  void migrate(const typename next_layer_type::endpoint_type& peer,
+      const asio::const_buffer& datagram)
+  {
+    asio::error_code ec;
+    migrate(peer, datagram, ec);
+    asio::detail::throw_error(ec, "migrate");
+  }
+
+  /// Move the session to a new peer address.
+  /**
+   * This function is used by a server when a datagram with this session's
+   * connection ID arrived from an address other than the connected one.
+   *
+   * @param peer The address the datagram came from.
+   *
+   * @param datagram The datagram. Its first record is delivered by the next
+   * receive operation; any further records are dropped.
+   *
+   * @param ec Set to indicate what error occurred, if any. Set to
+   * asio::error::invalid_argument if the datagram does not
+   * authenticate as a new record of this session.
+   */
+  ASIO_SYNC_OP_VOID migrate(
+      const typename next_layer_type::endpoint_type& peer,
+      const asio::const_buffer& datagram, asio::error_code& ec)
+  {
+    if (!core_.engine_.accept_migration(datagram))
+    {
+      ec = asio::error::invalid_argument;
+      ASIO_SYNC_OP_VOID_RETURN(ec);
+    }
+
+    next_layer_.connect(peer, ec);
+    ASIO_SYNC_OP_VOID_RETURN(ec);
+  }
+
+  /// Start sending heartbeats to keep the session alive.
+  /**
+   * This function starts sending a heartbeat request (RFC 6520) every
+   * interval, which keeps NAT mappings open and measures the round-trip
+   * time, see heartbeat_rtt(). The peer's DTLS layer answers the requests
+   * without involving its application. This function call always returns
+   * immediately.
+   *
+   * Responses are only matched while a receive operation is outstanding on
+   * the socket, so a session using heartbeats should always have one
+   * pending. Heartbeat requests from the peer are answered the same way.
+   *
+   * The handler is only called once heartbeats stop: with
+   * asio::error::timed_out when the peer has left @c max_misses requests in
+   * a row unanswered, with asio::error::operation_aborted after
+   * cancel_heartbeat(), and with asio::error::operation_not_supported if
+   * heartbeats were not negotiated, see context::enable_heartbeat().
+   *
+   * @param interval The time between requests.
+   *
+   * @param max_misses The number of unanswered requests after which the peer
+   * is considered dead. A value of 0 is treated as 1.
+   *
+   * @param handler The handler to be called when heartbeats stop. Copies
+   * will be made of the handler as required. The equivalent function
+   * signature of the handler must be:
+   * @code void handler(
+   *   const asio::error_code& error // Result of operation.
+   * ); @endcode
+   *
+   * @note Only one heartbeat may be running at a time.
+   */
+  template <typename HeartbeatHandler>
+  ASIO_INITFN_RESULT_TYPE(HeartbeatHandler,
+      void (asio::error_code))
+  async_heartbeat(const asio::steady_timer::duration& interval,
+      std::size_t max_misses, ASIO_MOVE_ARG(HeartbeatHandler) handler)
+  {
+    // If you get an error on the following line it means that your handler does
+    // not meet the documented type requirements for a HeartbeatHandler.
+    ASIO_WAIT_HANDLER_CHECK(HeartbeatHandler, handler) type_check;
+
+    asio::async_completion<HeartbeatHandler,
+      void (asio::error_code)> init(handler);
+
+    core_.heartbeat_interval_ = interval;
+    ssl::dtls::detail::async_heartbeat_loop(next_layer_, core_,
+        max_misses ? max_misses : 1, init.completion_handler);
+
+    return init.result.get();
+  }
+
+  /// Stop sending heartbeats.
+  /**
+   * The handler passed to async_heartbeat() is called with
+   * asio::error::operation_aborted.
+   */
+  void cancel_heartbeat()
+  {
+    core_.heartbeat_interval_ = asio::steady_timer::duration::zero();
+    if (core_.heartbeat_timer_.get())
+      core_.heartbeat_timer_->cancel();
+  }
+
+  /// Get the round-trip time measured by heartbeats.
+  /**
+   * @returns The time between sending the last answered heartbeat request
+   * and receiving its response, or zero if none has been answered yet.
+   */
+  asio::steady_timer::duration heartbeat_rtt() const
+  {
+    return core_.engine_.heartbeat_rtt();
+  }
+
 private:
+  template <typename DatagramSocketType>
+  friend class acceptor;
+
+  // Disallow copying and assignment.
+  socket(const socket&);
+  socket& operator=(const socket&);
+
+  // Move the socket to an io_context chosen by a pool. Only valid before the
+  // transport is opened and while no operation is pending. A socket whose
+  // executor cannot be moved to an io_context stays where it is.
+  void place(io_context_pool& pool)
+  {
+    if (core_.place(pool))
+      next_layer_ = next_layer_type(core_.executor_);
+  }
+
+#if defined(ASIO_HAS_CO_AWAIT)
+  // Picks up the peer's address and the path MTU when an awaited handshake
+  // starts, as async_handshake() does when it is called.
+  struct handshake_prepare
+  {
+    bool operator()(asio::error_code& ec) const
+    {
+      endpoint_type endpoint = socket_->next_layer().remote_endpoint(ec);
+      if (ec)
+        return false;
+
+      socket_->remote_endpoint_tmp_ = endpoint;
+      socket_->refresh_path_mtu();
+      return true;
+    }
+
+    socket* socket_;
+  };
+
+  auto co_handshake(handshake_type type, asio::error_code* ec)
+  {
+    handshake_prepare prepare = { this };
+    return detail::make_awaitable_datagram_op<void>(
+        detail::async_datagram_receive_timeout<next_layer_type, core_type>(
+          next_layer_, core_),
+        detail::async_datagram_send<next_layer_type>(next_layer_),
+        core_, detail::handshake_op(type), ec, "handshake", prepare);
+  }
+
+  template <typename ConstBufferSequence>
+  auto co_send(const ConstBufferSequence& buffers, asio::error_code* ec)
+  {
+    return detail::make_awaitable_datagram_op<std::size_t>(
+        detail::async_datagram_receive<next_layer_type>(next_layer_),
+        detail::async_datagram_send<next_layer_type>(next_layer_),
+        core_, detail::write_op<ConstBufferSequence>(buffers), ec, "send");
+  }
+
+  template <typename MutableBufferSequence>
+  auto co_receive(const MutableBufferSequence& buffers, asio::error_code* ec)
+  {
+    return detail::make_awaitable_datagram_op<std::size_t>(
+        detail::async_datagram_receive<next_layer_type>(next_layer_),
+        detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+        core_, detail::read_op<MutableBufferSequence>(buffers), ec,
+        "receive");
+  }
+
+  auto co_shutdown(asio::error_code* ec)
+  {
+    return detail::make_awaitable_datagram_op<void>(
+        detail::async_datagram_receive<next_layer_type>(next_layer_),
+        detail::async_datagram_send<next_layer_type>(next_layer_, 0),
+        core_, detail::shutdown_op(), ec, "shutdown");
+  }
+#endif // defined(ASIO_HAS_CO_AWAIT)
+
+#if defined(ASIO_HAS_MOVE)
+  // Send the data of an owned buffer, which lives in the handler until the
+  // operation completes.
+  template <typename Buffer, typename Handler>
+  void start_send_owned(Buffer&& data, Handler& handler)
+  {
+    typedef ssl::dtls::detail::owned_send_handler<
+      typename decay<Buffer>::type, Handler> owned_handler_type;
+    owned_handler_type owned_handler(ASIO_MOVE_CAST(Buffer)(data), handler);
+    asio::const_buffer buffer = owned_handler.data();
+
+    ssl::dtls::detail::async_datagram_io(
+        dtls::detail::async_datagram_receive<next_layer_type>(next_layer_),
+        dtls::detail::async_datagram_send<next_layer_type>(next_layer_),
+        core_,
+        detail::write_op<asio::const_buffer>(buffer),
+        owned_handler);
+  }
+#endif // defined(ASIO_HAS_MOVE)
+
+  // The queue of queue_send(), or null if it has not been used yet.
+  ssl::dtls::detail::send_queue* queued_sends() const
+  {
+    return core_.send_queue_.load(std::memory_order_acquire);
+  }
+
+  // The queue of queue_send(), created on first use. A thread finding the
+  // queue being created by another drops its own and uses the other's.
+  ssl::dtls::detail::send_queue& make_queued_sends()
+  {
+    ssl::dtls::detail::send_queue* queue = queued_sends();
+    if (queue)
+      return *queue;
+
+    asio::detail::shared_ptr<ssl::dtls::detail::send_queue> created(
+        new ssl::dtls::detail::send_queue);
+    created->attach(&next_layer_, &core_);
+    if (!core_.send_queue_.compare_exchange_strong(queue, created.get(),
+          std::memory_order_acq_rel, std::memory_order_acquire))
+      return *queue;
+
+    core_.send_queue_owner_ = created;
+    return *created;
+  }
+
+  // Pick up a path MTU that changed since the last handshake. Failures leave
+  // the previous MTU in place.
+  void refresh_path_mtu()
+  {
+    asio::error_code ec;
+    core_.update_path_mtu(ec);
+  }
+
   typedef typename asio::remove_reference<
     datagram_socket>::type::endpoint_type endpoint_type;
 
+  typedef ssl::dtls::detail::basic_core<Engine, executor_type> core_type;
+
+  typedef typename core_type::deadline_type deadline_type;
+
+  // Keeps the context alive when the socket was created from a holder.
+  asio::detail::shared_ptr<context> context_;
+
   datagram_socket next_layer_;
-  ssl::dtls::detail::core core_;
+  core_type core_;
   endpoint_type remote_endpoint_tmp_;
+  ssl::dtls::detail::path_mtu<next_layer_type> path_mtu_;
 };
 
 } // namespace dtls
@@ -52,7 +52,7 @@ public:
 
     void listen()
     {
-        dtls_sock_ptr socket(new dtls_sock(m_acceptor.get_service(), ctx_));
+        dtls_sock_ptr socket(new dtls_sock(m_acceptor.get_executor(), ctx_));
 
         buffer_ptr buffer(new buffer_type(1500));
 
@@ -0,0 +1,125 @@
+#include <asio/ssl/dtls/buffer_pool.hpp>
+
+#include <iostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Checks that a block returns to its pool exactly when the last lease on it
+// is dropped, whether leases are copied, moved, narrowed or dropped on other
+// threads.
+
+using asio::ssl::dtls::buffer_lease;
+using asio::ssl::dtls::buffer_pool;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+void test_acquire()
+{
+    buffer_pool pool(512);
+    check(pool.block_size() == 512, "block size kept");
+    check(pool.allocated() == 0 && pool.idle() == 0, "new pool is empty");
+
+    {
+        buffer_lease lease = pool.acquire();
+        check(!lease.empty(), "acquired lease holds a block");
+        check(lease.size() == 512, "lease covers the whole block");
+        check(lease.unique(), "acquired lease is unique");
+        check(pool.allocated() == 1 && pool.idle() == 0,
+            "block allocated on demand");
+    }
+    check(pool.idle() == 1, "block returns when the lease is dropped");
+
+    buffer_lease lease = pool.acquire();
+    check(pool.allocated() == 1 && pool.idle() == 0, "idle block reused");
+
+    buffer_lease other = pool.acquire();
+    check(pool.allocated() == 2, "second block allocated");
+    check(lease.data().data() != other.data().data(),
+        "blocks do not overlap");
+}
+
+void test_sharing()
+{
+    buffer_pool pool(256);
+    buffer_lease lease = pool.acquire();
+
+    buffer_lease copy(lease);
+    check(!lease.unique() && !copy.unique(), "copies share the block");
+
+    buffer_lease part(lease, asio::buffer(lease.data() + 16, 32));
+    check(part.size() == 32, "narrowed lease refers to its part");
+    check(part.data().data()
+        == static_cast<unsigned char*>(lease.data().data()) + 16,
+        "narrowed lease points into the block");
+
+    buffer_lease moved(std::move(copy));
+    check(copy.empty() && copy.size() == 0, "moved-from lease is empty");
+    check(!moved.empty(), "moved-to lease holds the block");
+
+    lease = buffer_lease();
+    moved = buffer_lease();
+    check(pool.idle() == 0, "block kept while a lease is left");
+    check(part.unique(), "last lease is unique");
+
+    buffer_lease assigned;
+    assigned = part;
+    part = std::move(assigned);
+    check(part.unique(), "self-sharing assignments keep the count");
+
+    part = buffer_lease();
+    check(pool.idle() == 1, "block returns after the last lease");
+
+    buffer_lease a = pool.acquire();
+    buffer_lease b = pool.acquire();
+    void* a_data = a.data().data();
+    a.swap(b);
+    check(b.data().data() == a_data, "swap exchanges the blocks");
+}
+
+void test_threads()
+{
+    const int threads = 4;
+    const int rounds = 2000;
+
+    buffer_pool pool(64);
+    for (int r = 0; r < rounds; ++r)
+    {
+        buffer_lease lease = pool.acquire();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+            workers.push_back(std::thread([lease]() mutable
+                {
+                    buffer_lease copy(lease);
+                    lease = buffer_lease();
+                }));
+        lease = buffer_lease();
+        for (int t = 0; t < threads; ++t)
+            workers[t].join();
+    }
+
+    check(pool.allocated() == 1, "block reused by every round");
+    check(pool.idle() == 1, "block returned after leases dropped on threads");
+}
+
+} // namespace
+
+int main()
+{
+    test_acquire();
+    test_sharing();
+    test_threads();
+
+    return failures == 0 ? 0 : 1;
+}
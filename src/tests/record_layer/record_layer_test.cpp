@@ -0,0 +1,253 @@
+#include <asio/ssl/dtls/detail/record_layer.hpp>
+
+#include <openssl/ssl.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Runs a DTLS 1.2 handshake between two SSL objects in memory, then checks
+// that the record layers derived from both ends interoperate and reject
+// replayed, forged and damaged records.
+
+using asio::ssl::dtls::detail::record_layer;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+const char psk_identity[] = "record_layer_test";
+const unsigned char psk_key[16] = { 1, 2, 3, 4, 5, 6, 7, 8,
+    9, 10, 11, 12, 13, 14, 15, 16 };
+
+unsigned int client_psk(SSL*, const char*, char* identity,
+    unsigned int max_identity_len, unsigned char* psk,
+    unsigned int max_psk_len)
+{
+    if (sizeof(psk_identity) > max_identity_len
+        || sizeof(psk_key) > max_psk_len)
+        return 0;
+    std::memcpy(identity, psk_identity, sizeof(psk_identity));
+    std::memcpy(psk, psk_key, sizeof(psk_key));
+    return sizeof(psk_key);
+}
+
+unsigned int server_psk(SSL*, const char* identity,
+    unsigned char* psk, unsigned int max_psk_len)
+{
+    if (std::strcmp(identity, psk_identity) != 0
+        || sizeof(psk_key) > max_psk_len)
+        return 0;
+    std::memcpy(psk, psk_key, sizeof(psk_key));
+    return sizeof(psk_key);
+}
+
+struct endpoint
+{
+    explicit endpoint(SSL_CTX* ctx)
+      : ssl(::SSL_new(ctx)), ext_bio(0)
+    {
+        BIO* int_bio = 0;
+        ::BIO_new_bio_pair(&int_bio, 0, &ext_bio, 0);
+        ::SSL_set_bio(ssl, int_bio, int_bio);
+        ::SSL_set_options(ssl, SSL_OP_NO_QUERY_MTU);
+        ::DTLS_set_link_mtu(ssl, 1400);
+    }
+
+    ~endpoint()
+    {
+        ::SSL_free(ssl);
+        ::BIO_free(ext_bio);
+    }
+
+    SSL* ssl;
+    BIO* ext_bio;
+    record_layer::sequence_state written;
+};
+
+// Move everything one end has sent to the other.
+bool transfer(endpoint& from, endpoint& to)
+{
+    unsigned char buffer[4096];
+    bool moved = false;
+    int length;
+    while ((length = ::BIO_read(from.ext_bio, buffer, sizeof(buffer))) > 0)
+    {
+        record_layer::track(asio::buffer(buffer, length), from.written);
+        ::BIO_write(to.ext_bio, buffer, length);
+        moved = true;
+    }
+    return moved;
+}
+
+bool handshake(endpoint& client, endpoint& server)
+{
+    ::SSL_set_connect_state(client.ssl);
+    ::SSL_set_accept_state(server.ssl);
+    for (int round = 0; round < 20; ++round)
+    {
+        ::SSL_do_handshake(client.ssl);
+        transfer(client, server);
+        ::SSL_do_handshake(server.ssl);
+        transfer(server, client);
+        if (::SSL_is_init_finished(client.ssl)
+            && ::SSL_is_init_finished(server.ssl))
+            return true;
+    }
+    return false;
+}
+
+std::vector<unsigned char> seal(record_layer& layer, const std::string& text)
+{
+    std::vector<unsigned char> record(
+        layer.headroom() + text.size() + layer.tailroom());
+    asio::error_code ec;
+    std::size_t length = layer.seal(record_layer::application_data,
+        asio::buffer(text), asio::buffer(record), ec);
+    check(!ec, "seal succeeds");
+    record.resize(length);
+    return record;
+}
+
+bool open(record_layer& layer, const std::vector<unsigned char>& record,
+    std::string& text)
+{
+    std::vector<unsigned char> plaintext(
+        layer.max_payload_length(asio::buffer(record)) + 1);
+    unsigned char content_type = 0;
+    std::size_t length = 0;
+    if (!layer.open(asio::buffer(record), asio::buffer(plaintext),
+            content_type, length))
+        return false;
+    check(content_type == record_layer::application_data, "content type");
+    text.assign(plaintext.begin(), plaintext.begin() + length);
+    return true;
+}
+
+void test_seal_and_open(record_layer& client, record_layer& server)
+{
+    std::string text;
+    check(open(server, seal(client, "hello"), text) && text == "hello",
+        "client to server");
+    check(open(client, seal(server, "world"), text) && text == "world",
+        "server to client");
+
+    std::vector<unsigned char> record(
+        client.headroom() + 3 + client.tailroom());
+    std::memcpy(&record[client.headroom()], "abc", 3);
+    asio::error_code ec;
+    std::size_t length = client.seal_in_place(record_layer::application_data,
+        asio::buffer(record), 3, ec);
+    check(!ec && length == record.size(), "seal in place");
+
+    unsigned char content_type = 0;
+    asio::const_buffer plaintext;
+    check(server.open_in_place(asio::buffer(record), content_type, plaintext)
+        && plaintext.size() == 3
+        && std::memcmp(plaintext.data(), "abc", 3) == 0,
+        "open in place");
+}
+
+void test_replay_window(record_layer& client, record_layer& server)
+{
+    std::string text;
+    std::vector<unsigned char> first = seal(client, "first");
+    std::vector<unsigned char> second = seal(client, "second");
+    check(open(server, second, text), "newer record opens");
+    check(open(server, first, text) && text == "first",
+        "reordered record inside the window opens");
+    check(!open(server, first, text), "replayed record is rejected");
+    check(!open(server, second, text), "replayed newest record is rejected");
+
+    std::vector<unsigned char> old = seal(client, "old");
+    for (int i = 0; i < 64; ++i)
+        seal(client, "skipped");
+    check(open(server, seal(client, "new"), text), "record after gap opens");
+    check(!open(server, old, text), "record behind the window is rejected");
+}
+
+void test_forgery(record_layer& client, record_layer& server)
+{
+    std::string text;
+
+    // A header claiming the highest sequence number must not move the
+    // window, or every genuine record after it would be dropped.
+    std::vector<unsigned char> forged = seal(client, "forged");
+    for (int i = 5; i < 11; ++i)
+        forged[i] = 0xff;
+    check(!open(server, forged, text), "forged sequence number is rejected");
+    check(open(server, seal(client, "after"), text) && text == "after",
+        "forgery does not move the window");
+
+    // Authentication alone leaves the record to be opened.
+    std::vector<unsigned char> record = seal(client, "checked");
+    std::vector<unsigned char> scratch(record.size());
+    check(server.authenticate(asio::buffer(record), asio::buffer(scratch)),
+        "genuine record authenticates");
+    check(open(server, record, text) && text == "checked",
+        "authenticated record still opens");
+    check(!server.authenticate(asio::buffer(record), asio::buffer(scratch)),
+        "opened record no longer authenticates");
+    check(!server.authenticate(asio::buffer(forged), asio::buffer(scratch)),
+        "forged record does not authenticate");
+
+    std::vector<unsigned char> damaged = seal(client, "damaged");
+    damaged.back() ^= 1;
+    check(!open(server, damaged, text), "damaged tag is rejected");
+
+    std::vector<unsigned char> truncated = seal(client, "truncated");
+    truncated.resize(truncated.size() - 1);
+    check(!open(server, truncated, text), "truncated record is rejected");
+}
+
+} // namespace
+
+int main()
+{
+    SSL_CTX* client_ctx = ::SSL_CTX_new(::DTLS_client_method());
+    SSL_CTX* server_ctx = ::SSL_CTX_new(::DTLS_server_method());
+    for (SSL_CTX* ctx : { client_ctx, server_ctx })
+    {
+        ::SSL_CTX_set_min_proto_version(ctx, DTLS1_2_VERSION);
+        ::SSL_CTX_set_max_proto_version(ctx, DTLS1_2_VERSION);
+        ::SSL_CTX_set_cipher_list(ctx, "PSK-AES128-GCM-SHA256");
+    }
+    ::SSL_CTX_set_psk_client_callback(client_ctx, client_psk);
+    ::SSL_CTX_set_psk_server_callback(server_ctx, server_psk);
+
+    {
+        endpoint client(client_ctx);
+        endpoint server(server_ctx);
+        check(handshake(client, server), "handshake completes");
+
+        record_layer client_layer;
+        record_layer server_layer;
+        asio::error_code ec;
+        check(!client_layer.init(client.ssl, ec), "client keys derived");
+        check(!server_layer.init(server.ssl, ec), "server keys derived");
+        client_layer.activate(client.written);
+        server_layer.activate(server.written);
+
+        if (failures == 0)
+        {
+            test_seal_and_open(client_layer, server_layer);
+            test_replay_window(client_layer, server_layer);
+            test_forgery(client_layer, server_layer);
+        }
+    }
+
+    ::SSL_CTX_free(client_ctx);
+    ::SSL_CTX_free(server_ctx);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+#include <asio/ssl/dtls/detail/send_queue.hpp>
+
+#include <asio/io_context.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Checks that messages pushed by several threads reach the single consumer
+// in order and that none is left behind when a drain ends, and the failure
+// counting, discarding and waiting of the queue.
+
+using asio::ssl::dtls::detail::send_queue;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+struct message_id
+{
+    unsigned int producer;
+    unsigned int seq;
+};
+
+message_id id_of(const send_queue::message* m)
+{
+    message_id id;
+    std::memcpy(&id, m->data().data(), sizeof(id));
+    return id;
+}
+
+void push(send_queue& queue, unsigned int producer, unsigned int seq,
+    std::atomic<int>& drains)
+{
+    message_id id = { producer, seq };
+    if (queue.push(asio::buffer(&id, sizeof(id))))
+        drains.fetch_add(1);
+}
+
+// Producers push concurrently while the main thread drains whenever a
+// producer reports that a drain has to be started, like the socket does.
+void test_producers()
+{
+    const unsigned int producers = 4;
+    const unsigned int per_producer = 20000;
+
+    send_queue queue;
+    std::atomic<int> drains(0);
+    std::atomic<bool> done(false);
+
+    std::vector<std::thread> threads;
+    for (unsigned int p = 0; p < producers; ++p)
+        threads.push_back(std::thread([&queue, &drains, p]()
+            {
+                for (unsigned int i = 0; i < per_producer; ++i)
+                    push(queue, p, i, drains);
+            }));
+
+    std::thread joiner([&threads, &done]()
+        {
+            for (std::size_t i = 0; i < threads.size(); ++i)
+                threads[i].join();
+            done = true;
+        });
+
+    std::vector<unsigned int> next(producers, 0);
+    std::size_t received = 0;
+    bool in_order = true;
+    for (;;)
+    {
+        bool finished = done.load();
+        if (drains.load() == 0)
+        {
+            if (finished)
+                break;
+            std::this_thread::yield();
+            continue;
+        }
+
+        while (queue.fill_batch())
+        {
+            for (std::size_t i = 0; i < queue.batch().size(); ++i)
+            {
+                message_id id = id_of(queue.batch()[i]);
+                if (id.producer >= producers || id.seq != next[id.producer])
+                    in_order = false;
+                else
+                    ++next[id.producer];
+                ++received;
+            }
+            queue.next() = queue.batch().size();
+            queue.release_batch(false);
+        }
+        drains.fetch_sub(1);
+    }
+    joiner.join();
+
+    check(in_order, "messages of each producer arrive in order");
+    check(received == producers * per_producer,
+        "no message is left behind when a drain ends");
+    check(queue.failures() == 0, "no failures counted");
+}
+
+void test_failures()
+{
+    send_queue queue;
+    std::atomic<int> drains(0);
+    for (unsigned int i = 0; i < 3; ++i)
+        push(queue, 0, i, drains);
+    check(drains == 1, "only the first push starts a drain");
+
+    check(queue.fill_batch(), "batch filled");
+    check(queue.batch().size() == 3, "batch holds every queued message");
+    queue.next() = 1;
+    queue.release_batch(true);
+    check(queue.failures() == 3, "a failed round counts the whole batch");
+    check(!queue.fill_batch(), "drain ends on an empty queue");
+
+    push(queue, 0, 3, drains);
+    push(queue, 0, 4, drains);
+    check(drains == 2, "a push after the drain ended starts another");
+    check(queue.fill_batch(), "batch filled again");
+    queue.next() = 1;
+    push(queue, 0, 5, drains);
+    queue.drop();
+    check(queue.failures() == 5,
+        "drop counts the unsent part of the batch and the queued messages");
+    check(queue.batch().size() == 1, "drop keeps the messages already sent");
+    queue.release_batch(false);
+    check(!queue.fill_batch(), "nothing left after drop");
+}
+
+struct wait_handler
+{
+    wait_handler(int& calls, asio::error_code& ec)
+      : calls_(&calls), ec_(&ec)
+    {
+    }
+
+    void operator()(const asio::error_code& ec)
+    {
+        ++*calls_;
+        *ec_ = ec;
+    }
+
+    int* calls_;
+    asio::error_code* ec_;
+};
+
+void test_waiters()
+{
+    asio::io_context io_context;
+    send_queue queue;
+    std::atomic<int> drains(0);
+    int calls = 0;
+    asio::error_code ec;
+
+    wait_handler idle(calls, ec);
+    queue.async_wait(io_context.get_executor(), idle);
+    io_context.run();
+    check(calls == 1 && !ec, "waiting on an idle queue completes at once");
+
+    push(queue, 0, 0, drains);
+    wait_handler busy(calls, ec);
+    queue.async_wait(io_context.get_executor(), busy);
+    io_context.restart();
+    io_context.run();
+    check(calls == 1, "waiter parked while a drain is scheduled");
+
+    queue.fill_batch();
+    queue.next() = queue.batch().size();
+    queue.release_batch(false);
+    check(!queue.fill_batch(), "drain ends");
+    queue.complete_waiters();
+    io_context.restart();
+    io_context.run();
+    check(calls == 2 && !ec, "waiter completed when the drain ends");
+
+    push(queue, 0, 1, drains);
+    wait_handler cancelled(calls, ec);
+    queue.async_wait(io_context.get_executor(), cancelled);
+    queue.cancel();
+    check(queue.take_cancel(), "cancel is seen by the drain");
+    check(!queue.take_cancel(), "cancel is seen once");
+    queue.drop();
+    check(!queue.fill_batch(), "drain ends after drop");
+    queue.complete_waiters();
+    io_context.restart();
+    io_context.run();
+    check(calls == 3 && ec == asio::error::operation_aborted,
+        "waiter of a dropped queue gets operation_aborted");
+}
+
+void test_attach()
+{
+    send_queue queue;
+    int next_layer = 0;
+    int core = 0;
+    check(!queue.core() && !queue.next_layer(), "new queue is detached");
+    queue.attach(&next_layer, &core);
+    check(queue.core() == &core && queue.next_layer() == &next_layer,
+        "attach sets the socket");
+    queue.detach();
+    check(!queue.core() && !queue.next_layer(), "detach clears the socket");
+}
+
+} // namespace
+
+int main()
+{
+    test_producers();
+    test_failures();
+    test_waiters();
+    test_attach();
+
+    return failures == 0 ? 0 : 1;
+}
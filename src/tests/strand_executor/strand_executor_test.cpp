@@ -0,0 +1,89 @@
+#include <asio/ssl/dtls/acceptor.hpp>
+#include <asio/ssl/dtls/io_context_pool.hpp>
+#include <asio/ssl/dtls/socket.hpp>
+
+#include <asio/io_context.hpp>
+#include <asio/ip/udp.hpp>
+#include <asio/strand.hpp>
+
+#include <iostream>
+#include <vector>
+
+// Builds a socket and an acceptor whose transport runs on a strand, and
+// instantiates their operations, including the placement of accepted sockets
+// with an io_context_pool.
+
+typedef asio::strand<asio::io_context::executor_type> strand_type;
+typedef asio::basic_datagram_socket<asio::ip::udp, strand_type>
+    datagram_socket;
+typedef asio::ssl::dtls::socket<datagram_socket> dtls_socket;
+typedef asio::ssl::dtls::acceptor<datagram_socket> dtls_acceptor;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+struct handler
+{
+    void operator()(const asio::error_code&) {}
+    void operator()(const asio::error_code&, std::size_t) {}
+};
+
+struct message_handler
+{
+    void operator()(const asio::const_buffer&) {}
+};
+
+// Instantiates the socket's operations. Never called.
+void operations(dtls_socket& sock, dtls_acceptor& acceptor)
+{
+    std::vector<unsigned char> buffer(1500);
+    asio::error_code ec;
+
+    acceptor.async_accept(sock, asio::buffer(buffer), handler(), ec);
+    sock.async_handshake(dtls_socket::server, asio::buffer(buffer), handler());
+    sock.async_handshake(dtls_socket::client, handler());
+    sock.async_send(asio::buffer(buffer), handler());
+    std::vector<asio::const_buffer> messages(2, asio::buffer(buffer));
+    sock.async_send_batch(messages, handler());
+    sock.async_receive(asio::buffer(buffer), handler());
+    sock.async_receive_pipelined(message_handler(), handler());
+    sock.async_heartbeat(asio::chrono::seconds(1), 3, handler());
+    sock.queue_send(asio::buffer(buffer));
+    sock.async_wait_queued_sends(handler());
+    sock.async_shutdown(handler());
+}
+
+} // namespace
+
+int main()
+{
+    asio::io_context acceptor_context;
+    asio::io_context worker;
+    asio::ssl::dtls::context ctx(asio::ssl::dtls::context::dtls_server);
+
+    strand_type strand(acceptor_context.get_executor());
+    dtls_socket sock(strand, ctx);
+    check(sock.get_executor() == strand, "socket runs on its strand");
+
+    asio::ssl::dtls::io_context_pool pool;
+    pool.add(worker);
+
+    asio::ip::udp::endpoint endpoint(asio::ip::address_v4::loopback(), 0);
+    dtls_acceptor acceptor(strand, endpoint);
+    acceptor.set_io_context_pool(pool);
+
+    if (failures < 0)
+        operations(sock, acceptor);
+
+    return failures == 0 ? 0 : 1;
+}